@@ -109,10 +109,30 @@ void log_use_colors(int enable) {
   L.useColors = enable ? 1 : 0;
 }
 
+/*
+ * Each log line is formatted in full in a local buffer and then emitted with
+ * a single fwrite() call: stderr is unbuffered so that maps to a single
+ * write(2), which the kernel does not interleave with the writes of the
+ * other worker processes. That keeps log lines atomic without serializing
+ * every line on a cross-process lock. Longer messages are truncated.
+ */
+#define LOG_LINE_MAXSIZE 8192
+
+static int clamp_len(int len) {
+  if (len < 0) {
+    return 0;
+  }
+  if (len > LOG_LINE_MAXSIZE - 2) {
+    return LOG_LINE_MAXSIZE - 2;
+  }
+  return len;
+}
+
 void log_log(int level, const char *file, int line, const char *fmt, ...)
 {
 	time_t t;
 	struct tm *lt;
+	char logbuf[LOG_LINE_MAXSIZE];
 
   if (level < L.level) {
     return;
@@ -123,7 +143,7 @@ void log_log(int level, const char *file, int line, const char *fmt, ...)
 	  return;
   }
 
-  /* Acquire lock */
+  /* Acquire lock, a no-op unless a lock function has been set */
   lock();
 
   /* Get current time */
@@ -135,49 +155,75 @@ void log_log(int level, const char *file, int line, const char *fmt, ...)
     va_list args;
     char buf[16];
 	int showLineNumber = L.level <= 1;
+	int len = 0;
 
     buf[strftime(buf, sizeof(buf), "%H:%M:%S", lt)] = '\0';
 
 	if (L.useColors)
 	{
-		pg_fprintf(stderr, "%s %d %s%-6s\x1b[0m ",
-				   buf,
-				   getpid(),
-				   level_colors[level],
-				   level_names[level]);
+		len = pg_snprintf(logbuf, sizeof(logbuf),
+						  "%s %d %s%-6s\x1b[0m ",
+						  buf,
+						  getpid(),
+						  level_colors[level],
+						  level_names[level]);
+		len = clamp_len(len);
 
 		if (showLineNumber)
 		{
-			pg_fprintf(stderr, "\x1b[90m%s:%d:\x1b[0m ", file, line);
+			len += pg_snprintf(logbuf + len, sizeof(logbuf) - len,
+							   "\x1b[90m%s:%d:\x1b[0m ", file, line);
+			len = clamp_len(len);
 		}
 	}
 	else
 	{
-		pg_fprintf(stderr, "%s %d %-5s ", buf, getpid(), level_names[level]);
+		len = pg_snprintf(logbuf, sizeof(logbuf),
+						  "%s %d %-5s ", buf, getpid(), level_names[level]);
+		len = clamp_len(len);
 
 		if (showLineNumber)
 		{
-			pg_fprintf(stderr, "%s:%d ", file, line);
+			len += pg_snprintf(logbuf + len, sizeof(logbuf) - len,
+							   "%s:%d ", file, line);
+			len = clamp_len(len);
 		}
 	}
 
     va_start(args, fmt);
-    pg_vfprintf(stderr, fmt, args);
+	len += pg_vsnprintf(logbuf + len, sizeof(logbuf) - len, fmt, args);
     va_end(args);
-    pg_fprintf(stderr, "\n");
+	len = clamp_len(len);
+
+	logbuf[len++] = '\n';
+
+	fwrite(logbuf, 1, len, stderr);
   }
 
   /* Log to file */
   if (L.fp) {
     va_list args;
     char buf[32];
+	int len = 0;
+
     buf[strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", lt)] = '\0';
-    pg_fprintf(L.fp, "%s %d %-5s %s:%d: ",
-			   buf, getpid(), level_names[level], file, line);
+
+	len = pg_snprintf(logbuf, sizeof(logbuf),
+					  "%s %d %-5s %s:%d: ",
+					  buf, getpid(), level_names[level], file, line);
+	len = clamp_len(len);
+
     va_start(args, fmt);
-    pg_vfprintf(L.fp, fmt, args);
+	len += pg_vsnprintf(logbuf + len, sizeof(logbuf) - len, fmt, args);
     va_end(args);
-    pg_fprintf(L.fp, "\n");
+	len = clamp_len(len);
+
+	logbuf[len++] = '\n';
+
+	fwrite(logbuf, 1, len, L.fp);
+
+	/* one flush per line keeps O_APPEND log files line-atomic, too */
+	fflush(L.fp);
   }
 
   /* Release lock */
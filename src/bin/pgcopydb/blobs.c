@@ -10,9 +10,27 @@
 #include <unistd.h>
 
 #include "copydb.h"
+#include "file_utils.h"
 #include "log.h"
 #include "schema.h"
 #include "signals.h"
+#include "string_utils.h"
+
+/*
+ * Each BLOB worker checkpoints the highest contiguously-copied large object
+ * OID of its own partition into a small file next to its summary file, so
+ * that a resumed run skips the already-copied large objects without running
+ * per-object existence checks on the target database.
+ */
+typedef struct BlobsCheckpoint
+{
+	char filename[MAXPGPATH];
+	int blobJobs;
+} BlobsCheckpoint;
+
+static bool copydb_blobs_checkpoint_write(void *context, uint32_t lastOid);
+static bool copydb_blobs_checkpoint_read(BlobsCheckpoint *checkpoint,
+										 uint32_t *startAfterOid);
 
 /*
  * copydb_start_blob_process starts an auxilliary process that copies the large
@@ -26,7 +44,8 @@ copydb_start_blob_process(CopyDataSpec *specs)
 		return true;
 	}
 
-	log_info("STEP 5: copy Large Objects (BLOBs) in 1 sub-process");
+	log_info("STEP 5: copy Large Objects (BLOBs) in %d sub-processes",
+			 specs->blobJobs);
 
 	/*
 	 * Flush stdio channels just before fork, to avoid double-output problems.
@@ -70,7 +89,11 @@ copydb_start_blob_process(CopyDataSpec *specs)
 
 
 /*
- * copydb_copy_blobs copies the large objects.
+ * copydb_copy_blobs copies the large objects, using a pool of --blob-jobs
+ * worker processes. Each worker gets its own partition of the large objects
+ * (an OID modulo filter on pg_largeobject_metadata) and streams it over its
+ * own pair of connections, so that a large pg_largeobject does not serialize
+ * behind a single process.
  */
 bool
 copydb_copy_blobs(CopyDataSpec *specs)
@@ -79,7 +102,146 @@ copydb_copy_blobs(CopyDataSpec *specs)
 
 	INSTR_TIME_SET_CURRENT(startTime);
 
-	log_notice("Started BLOB worker %d [%d]", getpid(), getppid());
+	int blobJobs = specs->blobJobs < 1 ? 1 : specs->blobJobs;
+
+	pid_t *pids = (pid_t *) calloc(blobJobs, sizeof(pid_t));
+
+	if (pids == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int i = 0; i < blobJobs; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork a BLOB worker process: %m");
+				free(pids);
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				if (!copydb_copy_blobs_worker(specs, i))
+				{
+					log_error("Failed to copy large objects, "
+							  "see above for details");
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				pids[i] = fpid;
+				break;
+			}
+		}
+	}
+
+	/* wait until all the BLOB workers are done */
+	bool allDone = true;
+
+	for (int i = 0; i < blobJobs; i++)
+	{
+		int status = 0;
+
+		if (waitpid(pids[i], &status, 0) == -1)
+		{
+			log_error("Failed to wait for BLOB worker %d: %m", pids[i]);
+			allDone = false;
+			continue;
+		}
+
+		if (WEXITSTATUS(status) != 0)
+		{
+			log_error("BLOB worker process %d exited with code %d",
+					  pids[i], WEXITSTATUS(status));
+			allDone = false;
+		}
+	}
+
+	free(pids);
+
+	if (!allDone)
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* aggregate the per-worker summaries into the main blobs summary file */
+	uint32_t count = 0;
+
+	for (int i = 0; i < blobJobs; i++)
+	{
+		char workerDoneFile[MAXPGPATH] = { 0 };
+
+		sformat(workerDoneFile, sizeof(workerDoneFile), "%s.%d",
+				specs->cfPaths.done.blobs,
+				i);
+
+		CopyBlobsSummary workerSummary = { 0 };
+
+		if (!read_blobs_summary(&workerSummary, workerDoneFile))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		count += workerSummary.count;
+	}
+
+	instr_time duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, startTime);
+
+	/* and write that we successfully finished copying all blobs */
+	CopyBlobsSummary summary = {
+		.pid = getpid(),
+		.count = count,
+		.durationMs = INSTR_TIME_GET_MILLISEC(duration)
+	};
+
+	/* ignore errors on the blob file summary */
+	(void) write_blobs_summary(&summary, specs->cfPaths.done.blobs);
+
+	return true;
+}
+
+
+/*
+ * copydb_copy_blobs_worker copies the large objects that belong to the given
+ * worker's partition of pg_largeobject_metadata, over a private pair of
+ * source and target connections.
+ */
+bool
+copydb_copy_blobs_worker(CopyDataSpec *specs, int workerIndex)
+{
+	instr_time startTime;
+
+	INSTR_TIME_SET_CURRENT(startTime);
+
+	log_notice("Started BLOB worker %d/%d %d [%d]",
+			   workerIndex,
+			   specs->blobJobs,
+			   getpid(),
+			   getppid());
 
 	PGSQL *src = NULL;
 	PGSQL pgsql = { 0 };
@@ -90,36 +252,25 @@ copydb_copy_blobs(CopyDataSpec *specs)
 	if (specs->consistent)
 	{
 		/*
-		 * In the context of the `pgcopydb copy blobs` command, we want to
-		 * re-use the already prepared snapshot.
+		 * Each worker is a sub-process of its own and needs a private PGSQL
+		 * client connection instance that re-uses the already exported
+		 * snapshot.
 		 */
-		if (specs->section == DATA_SECTION_BLOBS)
+		if (!copydb_copy_snapshot(specs, &snapshot))
 		{
-			src = &(specs->sourceSnapshot.pgsql);
+			/* errors have already been logged */
+			return false;
 		}
-		else
-		{
-			/*
-			 * In the context of a full copy command, we want to re-use the
-			 * already exported snapshot and make sure to use a private PGSQL
-			 * client connection instance.
-			 */
-			if (!copydb_copy_snapshot(specs, &snapshot))
-			{
-				/* errors have already been logged */
-				return false;
-			}
 
-			/* swap the new instance in place of the previous one */
-			specs->sourceSnapshot = snapshot;
+		/* swap the new instance in place of the previous one */
+		specs->sourceSnapshot = snapshot;
 
-			src = &(specs->sourceSnapshot.pgsql);
+		src = &(specs->sourceSnapshot.pgsql);
 
-			if (!copydb_set_snapshot(specs))
-			{
-				/* errors have already been logged */
-				return false;
-			}
+		if (!copydb_set_snapshot(specs))
+		{
+			/* errors have already been logged */
+			return false;
 		}
 	}
 	else
@@ -158,11 +309,39 @@ copydb_copy_blobs(CopyDataSpec *specs)
 		return false;
 	}
 
+	BlobsCheckpoint checkpoint = { .blobJobs = specs->blobJobs };
+
+	sformat(checkpoint.filename, sizeof(checkpoint.filename), "%s.%d.oid",
+			specs->cfPaths.done.blobs,
+			workerIndex);
+
+	uint32_t startAfterOid = 0;
+
+	if (specs->resume && file_exists(checkpoint.filename))
+	{
+		if (!copydb_blobs_checkpoint_read(&checkpoint, &startAfterOid))
+		{
+			/* errors have already been logged, restart from the beginning */
+			startAfterOid = 0;
+		}
+		else if (startAfterOid > 0)
+		{
+			log_info("BLOB worker %d resumes after large object %u",
+					 workerIndex,
+					 startAfterOid);
+		}
+	}
+
 	uint32_t count = 0;
 
 	if (!pg_copy_large_objects(src,
 							   &dst,
 							   specs->restoreOptions.dropIfExists,
+							   specs->blobJobs,
+							   workerIndex,
+							   startAfterOid,
+							   &copydb_blobs_checkpoint_write,
+							   &checkpoint,
 							   &count))
 	{
 		log_error("Failed to copy large objects");
@@ -172,13 +351,10 @@ copydb_copy_blobs(CopyDataSpec *specs)
 	/* if we opened a snapshot, now is the time to close it */
 	if (specs->consistent)
 	{
-		if (specs->section != DATA_SECTION_BLOBS)
+		if (!copydb_close_snapshot(specs))
 		{
-			if (!copydb_close_snapshot(specs))
-			{
-				/* errors have already been logged */
-				return false;
-			}
+			/* errors have already been logged */
+			return false;
 		}
 	}
 	else
@@ -198,15 +374,106 @@ copydb_copy_blobs(CopyDataSpec *specs)
 	INSTR_TIME_SET_CURRENT(duration);
 	INSTR_TIME_SUBTRACT(duration, startTime);
 
-	/* and write that we successfully finished copying all blobs */
+	/* and write this worker's part of the summary */
 	CopyBlobsSummary summary = {
 		.pid = getpid(),
 		.count = count,
 		.durationMs = INSTR_TIME_GET_MILLISEC(duration)
 	};
 
-	/* ignore errors on the blob file summary */
-	(void) write_blobs_summary(&summary, specs->cfPaths.done.blobs);
+	char workerDoneFile[MAXPGPATH] = { 0 };
+
+	sformat(workerDoneFile, sizeof(workerDoneFile), "%s.%d",
+			specs->cfPaths.done.blobs,
+			workerIndex);
+
+	if (!write_blobs_summary(&summary, workerDoneFile))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_blobs_checkpoint_write persists the highest copied large object OID
+ * of a worker's partition, along with the partition count that the OID is
+ * only valid for. Called after each committed batch of large objects.
+ */
+static bool
+copydb_blobs_checkpoint_write(void *context, uint32_t lastOid)
+{
+	BlobsCheckpoint *checkpoint = (BlobsCheckpoint *) context;
+
+	char contents[BUFSIZE] = { 0 };
+
+	sformat(contents, sizeof(contents), "%d\n%u\n",
+			checkpoint->blobJobs,
+			lastOid);
+
+	if (!write_file(contents, strlen(contents), checkpoint->filename))
+	{
+		log_warn("Failed to write the large objects checkpoint file \"%s\"",
+				 checkpoint->filename);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_blobs_checkpoint_read reads a worker's large object checkpoint file
+ * back. The checkpointed OID is only used when the file was written with the
+ * same --blob-jobs setting, as the OID modulo partitions change with it.
+ */
+static bool
+copydb_blobs_checkpoint_read(BlobsCheckpoint *checkpoint,
+							 uint32_t *startAfterOid)
+{
+	char *fileContents = NULL;
+	long fileSize = 0L;
+
+	if (!read_file(checkpoint->filename, &fileContents, &fileSize))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char *fileLines[BUFSIZE] = { 0 };
+	int lineCount = splitLines(fileContents, fileLines, BUFSIZE);
+
+	int blobJobs = 0;
+	uint32_t lastOid = 0;
+
+	if (lineCount != 2 ||
+		!stringToInt(fileLines[0], &blobJobs) ||
+		!stringToUInt32(fileLines[1], &lastOid))
+	{
+		log_warn("Failed to parse large objects checkpoint file \"%s\", "
+				 "restarting this worker from the beginning",
+				 checkpoint->filename);
+
+		free(fileContents);
+		return false;
+	}
+
+	free(fileContents);
+
+	if (blobJobs != checkpoint->blobJobs)
+	{
+		log_warn("Large objects checkpoint file \"%s\" was written with "
+				 "--blob-jobs %d, now using %d: "
+				 "restarting this worker from the beginning",
+				 checkpoint->filename,
+				 blobJobs,
+				 checkpoint->blobJobs);
+		return false;
+	}
+
+	*startAfterOid = lastOid;
 
 	return true;
 }
@@ -0,0 +1,580 @@
+/*
+ * src/bin/pgcopydb/cli_bench.c
+ *     Implementation of a CLI which lets you benchmark pgcopydb operations
+ *     on synthetic data, to size --table-jobs for a given pair of hosts
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "postgres_fe.h"
+#include "portability/instr_time.h"
+
+#include "cli_common.h"
+#include "cli_root.h"
+#include "copydb.h"
+#include "commandline.h"
+#include "env_utils.h"
+#include "log.h"
+#include "parsing_utils.h"
+#include "pgsql.h"
+#include "string_utils.h"
+#include "summary.h"
+
+#define BENCH_SCHEMA_NAME "pgcopydb_bench"
+#define BENCH_MAX_RUNS 16
+
+typedef struct BenchCopyOptions
+{
+	int tables;
+	int rows;
+	int width;
+	char jobs[BUFSIZE];
+} BenchCopyOptions;
+
+static BenchCopyOptions benchOptions = { 0 };
+
+static int cli_bench_getopts(int argc, char **argv);
+static void cli_bench_copy(int argc, char **argv);
+
+static bool bench_parse_jobs(const char *spec, int *jobs, int size, int *count);
+static bool bench_prepare_tables(void);
+static bool bench_run_copy(int tableJobs,
+						   uint64_t *totalBytes,
+						   uint64_t *durationMs);
+
+static CommandLine bench_copy_command =
+	make_command(
+		"copy",
+		"Benchmark the COPY machinery on synthetic tables",
+		" --source ... --target ... [ --tables ... --rows ... --width ... ] ",
+		"  --source      Postgres URI to the source (scratch) database\n"
+		"  --target      Postgres URI to the target (scratch) database\n"
+		"  --dir         Work directory to use\n"
+		"  --tables      Number of synthetic tables to generate\n"
+		"  --rows        Number of rows to generate in each table\n"
+		"  --width       Width in bytes of the payload column\n"
+		"  --table-jobs  Comma-separated list of worker counts to benchmark\n",
+		cli_bench_getopts,
+		cli_bench_copy);
+
+static CommandLine *bench_subcommands[] = {
+	&bench_copy_command,
+	NULL
+};
+
+CommandLine bench_commands =
+	make_command_set("bench",
+					 "Benchmark pgcopydb operations on synthetic data",
+					 NULL, NULL, NULL, bench_subcommands);
+
+
+/*
+ * cli_bench_getopts parses the CLI options for the bench commands.
+ */
+static int
+cli_bench_getopts(int argc, char **argv)
+{
+	CopyDBOptions options = { 0 };
+	int c, option_index = 0;
+	int errors = 0, verboseCount = 0;
+
+	static struct option long_options[] = {
+		{ "source", required_argument, NULL, 'S' },
+		{ "target", required_argument, NULL, 'T' },
+		{ "dir", required_argument, NULL, 'D' },
+		{ "tables", required_argument, NULL, 'n' },
+		{ "rows", required_argument, NULL, 'r' },
+		{ "width", required_argument, NULL, 'w' },
+		{ "table-jobs", required_argument, NULL, 'J' },
+		{ "version", no_argument, NULL, 'V' },
+		{ "verbose", no_argument, NULL, 'v' },
+		{ "debug", no_argument, NULL, 'd' },
+		{ "trace", no_argument, NULL, 'z' },
+		{ "quiet", no_argument, NULL, 'q' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	optind = 0;
+
+	/* read values from the environment */
+	if (!cli_copydb_getenv(&options))
+	{
+		log_fatal("Failed to read default values from the environment");
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	/* the bench workload defaults: 4 tables of 100k rows of ~100 bytes */
+	options.tableJobs = DEFAULT_TABLE_JOBS;
+	options.indexJobs = DEFAULT_INDEX_JOBS;
+
+	benchOptions.tables = 4;
+	benchOptions.rows = 100 * 1000;
+	benchOptions.width = 100;
+
+	strlcpy(benchOptions.jobs, "1,2,4,8", sizeof(benchOptions.jobs));
+
+	while ((c = getopt_long(argc, argv, "S:T:D:n:r:w:J:Vvdzqh",
+							long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+			case 'S':
+			{
+				if (!validate_connection_string(optarg))
+				{
+					log_fatal("Failed to parse --source connection string, "
+							  "see above for details.");
+					exit(EXIT_CODE_BAD_ARGS);
+				}
+				strlcpy(options.source_pguri, optarg, MAXCONNINFO);
+				log_trace("--source %s", options.source_pguri);
+				break;
+			}
+
+			case 'T':
+			{
+				if (!validate_connection_string(optarg))
+				{
+					log_fatal("Failed to parse --target connection string, "
+							  "see above for details.");
+					exit(EXIT_CODE_BAD_ARGS);
+				}
+				strlcpy(options.target_pguri, optarg, MAXCONNINFO);
+				log_trace("--target %s", options.target_pguri);
+				break;
+			}
+
+			case 'D':
+			{
+				strlcpy(options.dir, optarg, MAXPGPATH);
+				log_trace("--dir %s", options.dir);
+				break;
+			}
+
+			case 'n':
+			{
+				if (!stringToInt(optarg, &benchOptions.tables) ||
+					benchOptions.tables < 1)
+				{
+					log_fatal("Failed to parse --tables count: \"%s\"", optarg);
+					exit(EXIT_CODE_BAD_ARGS);
+				}
+				log_trace("--tables %d", benchOptions.tables);
+				break;
+			}
+
+			case 'r':
+			{
+				if (!stringToInt(optarg, &benchOptions.rows) ||
+					benchOptions.rows < 1)
+				{
+					log_fatal("Failed to parse --rows count: \"%s\"", optarg);
+					exit(EXIT_CODE_BAD_ARGS);
+				}
+				log_trace("--rows %d", benchOptions.rows);
+				break;
+			}
+
+			case 'w':
+			{
+				if (!stringToInt(optarg, &benchOptions.width) ||
+					benchOptions.width < 1)
+				{
+					log_fatal("Failed to parse --width: \"%s\"", optarg);
+					exit(EXIT_CODE_BAD_ARGS);
+				}
+				log_trace("--width %d", benchOptions.width);
+				break;
+			}
+
+			case 'J':
+			{
+				strlcpy(benchOptions.jobs, optarg, sizeof(benchOptions.jobs));
+				log_trace("--table-jobs %s", benchOptions.jobs);
+				break;
+			}
+
+			case 'V':
+			{
+				/* keeper_cli_print_version prints version and exits. */
+				cli_print_version(argc, argv);
+				break;
+			}
+
+			case 'v':
+			{
+				++verboseCount;
+				switch (verboseCount)
+				{
+					case 1:
+					{
+						log_set_level(LOG_NOTICE);
+						break;
+					}
+
+					case 2:
+					{
+						log_set_level(LOG_DEBUG);
+						break;
+					}
+
+					default:
+					{
+						log_set_level(LOG_TRACE);
+						break;
+					}
+				}
+				break;
+			}
+
+			case 'd':
+			{
+				verboseCount = 2;
+				log_set_level(LOG_DEBUG);
+				break;
+			}
+
+			case 'z':
+			{
+				verboseCount = 3;
+				log_set_level(LOG_TRACE);
+				break;
+			}
+
+			case 'q':
+			{
+				log_set_level(LOG_ERROR);
+				break;
+			}
+
+			case 'h':
+			{
+				commandline_help(stderr);
+				exit(EXIT_CODE_QUIT);
+				break;
+			}
+		}
+	}
+
+	if (IS_EMPTY_STRING_BUFFER(options.source_pguri) ||
+		IS_EMPTY_STRING_BUFFER(options.target_pguri))
+	{
+		log_fatal("Options --source and --target are mandatory");
+		++errors;
+	}
+
+	if (errors > 0)
+	{
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	/* the benchmark generates its own data, runs must start from scratch */
+	options.restart = true;
+
+	/* publish our option parsing in the global variable */
+	copyDBoptions = options;
+
+	return optind;
+}
+
+
+/*
+ * cli_bench_copy generates synthetic tables on the source database, then runs
+ * the TABLE DATA copy machinery once per --table-jobs setting in the matrix,
+ * and reports the bytes per second achieved by each configuration. The idea is
+ * to size hosts and --table-jobs in minutes, rather than burn a full-size
+ * trial run per candidate setting.
+ */
+static void
+cli_bench_copy(int argc, char **argv)
+{
+	int jobs[BENCH_MAX_RUNS] = { 0 };
+	int runs = 0;
+
+	if (!bench_parse_jobs(benchOptions.jobs, jobs, BENCH_MAX_RUNS, &runs))
+	{
+		log_fatal("Failed to parse --table-jobs matrix: \"%s\"",
+				  benchOptions.jobs);
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	log_info("Generating %d table%s of %d rows "
+			 "with a %d bytes payload column each",
+			 benchOptions.tables,
+			 benchOptions.tables > 1 ? "s" : "",
+			 benchOptions.rows,
+			 benchOptions.width);
+
+	if (!bench_prepare_tables())
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_SOURCE);
+	}
+
+	uint64_t bytesPerSec[BENCH_MAX_RUNS] = { 0 };
+
+	for (int run = 0; run < runs; run++)
+	{
+		uint64_t totalBytes = 0;
+		uint64_t durationMs = 0;
+
+		log_info("Benchmarking with --table-jobs %d [%d/%d]",
+				 jobs[run], run + 1, runs);
+
+		if (!bench_run_copy(jobs[run], &totalBytes, &durationMs))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		bytesPerSec[run] =
+			durationMs > 0 ? totalBytes * 1000 / durationMs : 0;
+	}
+
+	fformat(stdout, "%12s | %12s\n", "table-jobs", "bytes/s");
+	fformat(stdout, "%12s-+-%12s\n", "------------", "------------");
+
+	for (int run = 0; run < runs; run++)
+	{
+		char bandwidth[BUFSIZE] = { 0 };
+
+		(void) pretty_print_bytes(bandwidth, BUFSIZE, bytesPerSec[run]);
+
+		fformat(stdout, "%12d | %12s\n", jobs[run], bandwidth);
+	}
+}
+
+
+/*
+ * bench_parse_jobs parses a comma-separated list of worker counts, such as
+ * "1,2,4,8", into the given array of integers.
+ */
+static bool
+bench_parse_jobs(const char *spec, int *jobs, int size, int *count)
+{
+	const char *ptr = spec;
+
+	*count = 0;
+
+	while (*ptr != '\0')
+	{
+		char value[BUFSIZE] = { 0 };
+		char *end = strchr(ptr, ',');
+		int len = end == NULL ? strlen(ptr) : end - ptr;
+
+		if (len <= 0 || len >= BUFSIZE)
+		{
+			log_error("Failed to parse worker count in \"%s\"", spec);
+			return false;
+		}
+
+		memcpy(value, ptr, len);
+
+		if (*count == size)
+		{
+			log_error("Failed to parse \"%s\": "
+					  "the matrix supports up to %d worker counts",
+					  spec, size);
+			return false;
+		}
+
+		if (!stringToInt(value, &(jobs[*count])) || jobs[*count] < 1)
+		{
+			log_error("Failed to parse worker count \"%s\"", value);
+			return false;
+		}
+
+		++(*count);
+
+		ptr = end == NULL ? ptr + len : end + 1;
+	}
+
+	if (*count == 0)
+	{
+		log_error("Failed to parse \"%s\": no worker count found", spec);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * bench_prepare_tables generates the synthetic tables on the source database,
+ * and creates their empty counterparts on the target database, where the
+ * TABLE DATA section of the operations expects them to exist already.
+ */
+static bool
+bench_prepare_tables(void)
+{
+	PGSQL src = { 0 };
+	PGSQL dst = { 0 };
+
+	if (!pgsql_init(&src, copyDBoptions.source_pguri, PGSQL_CONN_SOURCE))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!pgsql_init(&dst, copyDBoptions.target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char sql[BUFSIZE] = { 0 };
+
+	sformat(sql, sizeof(sql),
+			"drop schema if exists %s cascade", BENCH_SCHEMA_NAME);
+
+	if (!pgsql_execute(&src, sql) || !pgsql_execute(&dst, sql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	sformat(sql, sizeof(sql), "create schema %s", BENCH_SCHEMA_NAME);
+
+	if (!pgsql_execute(&src, sql) || !pgsql_execute(&dst, sql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	for (int i = 0; i < benchOptions.tables; i++)
+	{
+		sformat(sql, sizeof(sql),
+				"create table %s.table_%d(id bigint, payload text)",
+				BENCH_SCHEMA_NAME,
+				i + 1);
+
+		if (!pgsql_execute(&src, sql) || !pgsql_execute(&dst, sql))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		sformat(sql, sizeof(sql),
+				"insert into %s.table_%d "
+				"select i, repeat('x', %d) from generate_series(1, %d) t(i)",
+				BENCH_SCHEMA_NAME,
+				i + 1,
+				benchOptions.width,
+				benchOptions.rows);
+
+		if (!pgsql_execute(&src, sql))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	(void) pgsql_finish(&src);
+	(void) pgsql_finish(&dst);
+
+	return true;
+}
+
+
+/*
+ * bench_run_copy runs the TABLE DATA section of the operations with the given
+ * --table-jobs setting, restricted to the synthetic tables, and reports the
+ * total amount of bytes copied and the wall-clock duration of the copy.
+ */
+static bool
+bench_run_copy(int tableJobs, uint64_t *totalBytes, uint64_t *durationMs)
+{
+	CopyDataSpec copySpecs = { 0 };
+
+	copyDBoptions.tableJobs = tableJobs;
+
+	(void) cli_copy_prepare_specs(&copySpecs, DATA_SECTION_TABLE_DATA);
+
+	/* only consider the synthetic tables, scratch databases may be shared */
+	SourceFilters *filters = &(copySpecs.filters);
+	SourceFilterTableList *list = &(filters->includeOnlyTableList);
+
+	filters->type = SOURCE_FILTER_TYPE_INCL;
+
+	list->count = benchOptions.tables;
+	list->array = (SourceFilterTable *)
+				  calloc(benchOptions.tables, sizeof(SourceFilterTable));
+
+	if (list->array == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int i = 0; i < benchOptions.tables; i++)
+	{
+		SourceFilterTable *table = &(list->array[i]);
+
+		strlcpy(table->nspname, BENCH_SCHEMA_NAME, sizeof(table->nspname));
+		sformat(table->relname, sizeof(table->relname), "table_%d", i + 1);
+	}
+
+	if (!copydb_prepare_snapshot(&copySpecs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!copydb_fetch_schema_and_prepare_specs(&copySpecs))
+	{
+		/* errors have already been logged */
+		(void) copydb_close_snapshot(&copySpecs);
+		return false;
+	}
+
+	*totalBytes = 0;
+
+	for (int i = 0; i < copySpecs.sourceTableArray.count; i++)
+	{
+		*totalBytes += copySpecs.sourceTableArray.array[i].bytes;
+	}
+
+	instr_time startTime;
+	instr_time duration;
+
+	INSTR_TIME_SET_CURRENT(startTime);
+
+	if (!copydb_copy_all_table_data(&copySpecs))
+	{
+		/* errors have already been logged */
+		(void) copydb_close_snapshot(&copySpecs);
+		return false;
+	}
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, startTime);
+
+	*durationMs = INSTR_TIME_GET_MILLISEC(duration);
+
+	if (!copydb_close_snapshot(&copySpecs))
+	{
+		log_fatal("Failed to close snapshot \"%s\" on \"%s\"",
+				  copySpecs.sourceSnapshot.snapshot,
+				  copySpecs.sourceSnapshot.pguri);
+		return false;
+	}
+
+	/* the next run registers its own pid in a brand new work directory */
+	if (!unlink_file(copySpecs.cfPaths.pidfile))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char bytesPretty[BUFSIZE] = { 0 };
+
+	(void) pretty_print_bytes(bytesPretty, BUFSIZE, *totalBytes);
+
+	log_info("Copied %s with %d table-jobs in %lldms",
+			 bytesPretty, tableJobs, (long long) *durationMs);
+
+	return true;
+}
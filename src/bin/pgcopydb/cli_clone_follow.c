@@ -25,25 +25,41 @@
 
 #define PGCOPYDB_CLONE_GETOPTS_HELP \
 	"  --source                   Postgres URI to the source database\n" \
+	"  --source-standby           Postgres URI to a source hot standby (repeatable)\n" \
 	"  --target                   Postgres URI to the target database\n" \
 	"  --dir                      Work directory to use\n" \
 	"  --table-jobs               Number of concurrent COPY jobs to run\n" \
 	"  --index-jobs               Number of concurrent CREATE INDEX jobs to run\n" \
-	"  --split-tables-larger-than Same-table concurrency size threshold\n" \
+	"  --index-jobs-while-copy    CREATE INDEX jobs allowed during the COPY phase\n" \
+	"  --restore-jobs             Number of concurrent jobs for pg_restore\n" \
+	"  --index-memory             Memory budget shared by the CREATE INDEX jobs\n" \
+	"  --vacuum-jobs              Number of concurrent VACUUM ANALYZE jobs to run\n" \
+	"  --vacuum-io-budget         vacuum_cost_limit budget shared by the VACUUM jobs\n" \
+	"  --apply-jobs               Number of parallel apply processes in follow mode\n" \
+	"  --analyze-only             Run ANALYZE instead of VACUUM ANALYZE\n" \
+	"  --estimate-sizes           Size tables from pg_class estimates only\n" \
+	"  --target-session-gucs      SET name TO value on target sessions (name=value;...)\n" \
+	"  --split-tables-larger-than Same-table concurrency size threshold, or \"auto\"\n" \
 	"  --drop-if-exists           On the target database, clean-up from a previous run first\n" \
 	"  --roles                    Also copy roles found on source to target\n" \
 	"  --no-owner                 Do not set ownership of objects to match the original database\n" \
 	"  --no-acl                   Prevent restoration of access privileges (grant/revoke commands).\n" \
 	"  --no-comments              Do not output commands to restore comments\n" \
+	"  --blob-jobs                Number of concurrent BLOB copy jobs to run\n" \
 	"  --skip-large-objects       Skip copying large objects (blobs)\n" \
 	"  --skip-extensions          Skip restoring extensions\n" \
 	"  --skip-collations          Skip restoring collations\n" \
+	"  --copy-binary              Use the COPY BINARY protocol when possible\n" \
+	"  --drop-indexes             Drop target indexes before COPY, rebuild them after\n" \
+	"  --incremental              Skip tables unchanged since the previous run\n" \
 	"  --filters <filename>       Use the filters defined in <filename>\n" \
 	"  --restart                  Allow restarting when temp files exist already\n" \
 	"  --resume                   Allow resuming operations after a failure\n" \
 	"  --not-consistent           Allow taking a new snapshot on the source database\n" \
 	"  --snapshot                 Use snapshot obtained with pg_export_snapshot\n" \
+	"  --distributed              Share the table queue with other pgcopydb hosts\n" \
 	"  --follow                   Implement logical decoding to replay changes\n" \
+	"  --direct                   Apply changes directly as they are received\n" \
 	"  --plugin                   Output plugin to use (test_decoding, wal2json)\n" \
 	"  --slot-name                Use this Postgres replication slot name\n" \
 	"  --create-slot              Create the replication slot\n" \
@@ -82,6 +98,7 @@ CommandLine follow_command =
 		"  --resume              Allow resuming operations after a failure\n"
 		"  --not-consistent      Allow taking a new snapshot on the source database\n"
 		"  --snapshot            Use snapshot obtained with pg_export_snapshot\n"
+		"  --direct              Apply changes directly as they are received\n"
 		"  --plugin              Output plugin to use (test_decoding, wal2json)\n" \
 		"  --slot-name           Use this Postgres replication slot name\n"
 		"  --create-slot         Create the replication slot\n"
@@ -127,11 +144,28 @@ cli_clone(int argc, char **argv)
 							   copyDBoptions.slotName,
 							   copyDBoptions.origin,
 							   copyDBoptions.endpos,
+							   copyDBoptions.direct ?
+							   STREAM_MODE_DIRECT :
 							   STREAM_MODE_PREFETCH))
 		{
 			/* errors have already been logged */
 			exit(EXIT_CODE_INTERNAL_ERROR);
 		}
+
+		/* --target-session-gucs is not covered by stream_init_specs() */
+		strlcpy(streamSpecs.targetSessionGucs,
+				copyDBoptions.targetSessionGucs,
+				sizeof(streamSpecs.targetSessionGucs));
+
+		/* neither is --apply-jobs */
+		streamSpecs.applyJobs = copyDBoptions.applyJobs;
+
+		/* push table filtering down to the logical decoding plugin */
+		if (!stream_init_plugin_filters(&streamSpecs, &(copySpecs.filters)))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
 	}
 
 	/*
@@ -362,12 +396,29 @@ cli_follow(int argc, char **argv)
 						   copyDBoptions.slotName,
 						   copyDBoptions.origin,
 						   copyDBoptions.endpos,
+						   copyDBoptions.direct ?
+						   STREAM_MODE_DIRECT :
 						   STREAM_MODE_PREFETCH))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
 	}
 
+	/* --target-session-gucs is not covered by stream_init_specs() */
+	strlcpy(specs.targetSessionGucs,
+			copyDBoptions.targetSessionGucs,
+			sizeof(specs.targetSessionGucs));
+
+	/* neither is --apply-jobs */
+	specs.applyJobs = copyDBoptions.applyJobs;
+
+	/* push table filtering down to the logical decoding plugin */
+	if (!stream_init_plugin_filters(&specs, &(copySpecs.filters)))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
 	/*
 	 * First create the replication slot on the source database, and the origin
 	 * (replication progress tracking) on the target database.
@@ -576,6 +627,20 @@ cloneDB(CopyDataSpec *copySpecs)
 		return false;
 	}
 
+	/*
+	 * When --incremental has been used, register the per-table modification
+	 * evidence for the next run to compare against. A failure here is not
+	 * fatal: the next incremental run then copies every table again.
+	 */
+	if (copySpecs->incremental)
+	{
+		if (!incremental_register_table_state(copySpecs))
+		{
+			log_warn("Failed to register the incremental table state, "
+					 "the next --incremental run will copy all the tables");
+		}
+	}
+
 	/*
 	 * When --follow has been used, now is the time to allow for the catchup
 	 * process to start applying the prefetched changes.
@@ -734,9 +799,6 @@ cli_clone_follow_wait_subprocess(const char *name, pid_t pid)
 					  pid,
 					  returnCode);
 		}
-
-		/* avoid busy looping, wait for 150ms before checking again */
-		pg_usleep(150 * 1000);
 	}
 
 	return returnCode == 0;
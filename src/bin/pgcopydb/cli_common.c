@@ -20,6 +20,7 @@
 #include "copydb.h"
 #include "env_utils.h"
 #include "file_utils.h"
+#include "ld_stream.h"
 #include "log.h"
 #include "parsing_utils.h"
 #include "string_utils.h"
@@ -272,6 +273,96 @@ cli_copydb_getenv(CopyDBOptions *options)
 		}
 	}
 
+	if (env_exists(PGCOPYDB_VACUUM_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_VACUUM_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &options->vacuumJobs) ||
+				options->vacuumJobs < 1 ||
+				options->vacuumJobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_VACUUM_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_BLOB_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_BLOB_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &options->blobJobs) ||
+				options->blobJobs < 1 ||
+				options->blobJobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_BLOB_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_RESTORE_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_RESTORE_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &(options->restoreOptions.jobs)) ||
+				options->restoreOptions.jobs < 1 ||
+				options->restoreOptions.jobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_RESTORE_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_INDEX_MEMORY))
+	{
+		char bytes[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_INDEX_MEMORY, bytes, sizeof(bytes)))
+		{
+			if (!cli_parse_bytes_pretty(
+					bytes,
+					&options->indexMemory,
+					(char *) &options->indexMemoryPretty,
+					sizeof(options->indexMemoryPretty)))
+			{
+				log_fatal("Failed to parse PGCOPYDB_INDEX_MEMORY: \"%s\"",
+						  bytes);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
 	if (env_exists(PGCOPYDB_SPLIT_TABLES_LARGER_THAN))
 	{
 		char bytes[BUFSIZE] = { 0 };
@@ -329,6 +420,31 @@ cli_copydb_getenv(CopyDBOptions *options)
 		}
 	}
 
+	/* when --copy-binary has not been used, check PGCOPYDB_COPY_BINARY */
+	if (!options->useCopyBinary)
+	{
+		if (env_exists(PGCOPYDB_COPY_BINARY))
+		{
+			char COPY_BINARY[BUFSIZE] = { 0 };
+
+			if (!get_env_copy(PGCOPYDB_COPY_BINARY,
+							  COPY_BINARY,
+							  sizeof(COPY_BINARY)))
+			{
+				/* errors have already been logged */
+				++errors;
+			}
+			else if (!parse_bool(COPY_BINARY, &(options->useCopyBinary)))
+			{
+				log_error("Failed to parse environment variable \"%s\" "
+						  "value \"%s\", expected a boolean (on/off)",
+						  PGCOPYDB_COPY_BINARY,
+						  COPY_BINARY);
+				++errors;
+			}
+		}
+	}
+
 	/* when --drop-if-exists has not been used, check PGCOPYDB_DROP_IF_EXISTS */
 	if (!options->restoreOptions.dropIfExists)
 	{
@@ -497,11 +613,23 @@ cli_copy_db_getopts(int argc, char **argv)
 
 	static struct option long_options[] = {
 		{ "source", required_argument, NULL, 'S' },
+		{ "source-standby", required_argument, NULL, 'k' },
 		{ "target", required_argument, NULL, 'T' },
 		{ "dir", required_argument, NULL, 'D' },
 		{ "jobs", required_argument, NULL, 'J' },
 		{ "table-jobs", required_argument, NULL, 'J' },
 		{ "index-jobs", required_argument, NULL, 'I' },
+		{ "index-jobs-while-copy", required_argument, NULL, 'j' },
+		{ "restore-jobs", required_argument, NULL, 'P' },
+		{ "index-memory", required_argument, NULL, 'M' },
+		{ "vacuum-jobs", required_argument, NULL, 'U' },
+		{ "vacuum-io-budget", required_argument, NULL, 'W' },
+		{ "blob-jobs", required_argument, NULL, 'b' },
+		{ "large-objects-jobs", required_argument, NULL, 'b' },
+		{ "apply-jobs", required_argument, NULL, 'Y' },
+		{ "analyze-only", no_argument, NULL, 'a' },
+		{ "estimate-sizes", no_argument, NULL, 'G' },
+		{ "target-session-gucs", required_argument, NULL, 'u' },
 		{ "split-tables-larger-than", required_argument, NULL, 'L' },
 		{ "split-at", required_argument, NULL, 'L' },
 		{ "drop-if-exists", no_argument, NULL, 'c' }, /* pg_restore -c */
@@ -513,6 +641,9 @@ cli_copy_db_getopts(int argc, char **argv)
 		{ "skip-large-objects", no_argument, NULL, 'B' },
 		{ "skip-extensions", no_argument, NULL, 'e' },
 		{ "skip-collations", no_argument, NULL, 'l' },
+		{ "copy-binary", no_argument, NULL, 'y' },
+		{ "drop-indexes", no_argument, NULL, 'Q' },
+		{ "incremental", no_argument, NULL, 'i' },
 		{ "filter", required_argument, NULL, 'F' },
 		{ "filters", required_argument, NULL, 'F' },
 		{ "restart", no_argument, NULL, 'r' },
@@ -520,6 +651,8 @@ cli_copy_db_getopts(int argc, char **argv)
 		{ "not-consistent", no_argument, NULL, 'C' },
 		{ "snapshot", required_argument, NULL, 'N' },
 		{ "follow", no_argument, NULL, 'f' },
+		{ "direct", no_argument, NULL, 'w' },
+		{ "distributed", no_argument, NULL, 'g' },
 		{ "plugin", required_argument, NULL, 'p' },
 		{ "slot-name", required_argument, NULL, 's' },
 		{ "origin", required_argument, NULL, 'o' },
@@ -539,6 +672,10 @@ cli_copy_db_getopts(int argc, char **argv)
 	/* install default values */
 	options.tableJobs = DEFAULT_TABLE_JOBS;
 	options.indexJobs = DEFAULT_INDEX_JOBS;
+
+	/* --index-jobs-while-copy defaults to --index-jobs (no throttling) */
+	options.indexJobsWhileCopy = -1;
+	options.blobJobs = DEFAULT_BLOB_JOBS;
 	options.splitTablesLargerThan = DEFAULT_SPLIT_TABLES_LARGER_THAN;
 
 	/* read values from the environment */
@@ -549,7 +686,7 @@ cli_copy_db_getopts(int argc, char **argv)
 	}
 
 	while ((c = getopt_long(argc, argv,
-							"S:T:D:J:I:L:cOBelrRCN:xXCtfo:p:s:E:F:Vvdzqh",
+							"S:T:D:J:I:M:U:b:aGL:cOBelyQirRCN:xXCtfo:p:s:E:F:Vvdzqh",
 							long_options, &option_index)) != -1)
 	{
 		switch (c)
@@ -567,6 +704,31 @@ cli_copy_db_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'k':
+			{
+				if (!validate_connection_string(optarg))
+				{
+					log_fatal("Failed to parse --source-standby connection "
+							  "string, see above for details.");
+					++errors;
+				}
+
+				if (options.sourceStandbyCount >= MAX_SOURCE_STANDBYS)
+				{
+					log_fatal("Failed to add another --source-standby, "
+							  "pgcopydb supports up to %d of them",
+							  MAX_SOURCE_STANDBYS);
+					++errors;
+					break;
+				}
+
+				strlcpy(options.sourceStandbys[options.sourceStandbyCount++],
+						optarg,
+						MAXCONNINFO);
+				log_trace("--source-standby %s", optarg);
+				break;
+			}
+
 			case 'T':
 			{
 				if (!validate_connection_string(optarg))
@@ -613,6 +775,131 @@ cli_copy_db_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'j':
+			{
+				if (!stringToInt(optarg, &options.indexJobsWhileCopy) ||
+					options.indexJobsWhileCopy < 0 ||
+					options.indexJobsWhileCopy > 128)
+				{
+					log_fatal("Failed to parse --index-jobs-while-copy "
+							  "count: \"%s\"", optarg);
+					++errors;
+				}
+				log_trace("--index-jobs-while-copy %d",
+						  options.indexJobsWhileCopy);
+				break;
+			}
+
+			case 'P':
+			{
+				if (!stringToInt(optarg, &options.restoreOptions.jobs) ||
+					options.restoreOptions.jobs < 1 ||
+					options.restoreOptions.jobs > 128)
+				{
+					log_fatal("Failed to parse --restore-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--restore-jobs %d", options.restoreOptions.jobs);
+				break;
+			}
+
+			case 'M':
+			{
+				if (!cli_parse_bytes_pretty(
+						optarg,
+						&options.indexMemory,
+						(char *) &options.indexMemoryPretty,
+						sizeof(options.indexMemoryPretty)))
+				{
+					log_fatal("Failed to parse --index-memory: \"%s\"",
+							  optarg);
+					++errors;
+				}
+
+				log_trace("--index-memory %s (%lld)",
+						  options.indexMemoryPretty,
+						  (long long) options.indexMemory);
+				break;
+			}
+
+			case 'U':
+			{
+				if (!stringToInt(optarg, &options.vacuumJobs) ||
+					options.vacuumJobs < 1 ||
+					options.vacuumJobs > 128)
+				{
+					log_fatal("Failed to parse --vacuum-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--vacuum-jobs %d", options.vacuumJobs);
+				break;
+			}
+
+			case 'W':
+			{
+				if (!stringToInt(optarg, &options.vacuumIOBudget) ||
+					options.vacuumIOBudget < 1)
+				{
+					log_fatal("Failed to parse --vacuum-io-budget: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--vacuum-io-budget %d", options.vacuumIOBudget);
+				break;
+			}
+
+			case 'b':
+			{
+				if (!stringToInt(optarg, &options.blobJobs) ||
+					options.blobJobs < 1 ||
+					options.blobJobs > 128)
+				{
+					log_fatal("Failed to parse --blob-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--blob-jobs %d", options.blobJobs);
+				break;
+			}
+
+			case 'Y':
+			{
+				if (!stringToInt(optarg, &options.applyJobs) ||
+					options.applyJobs < 1 ||
+					options.applyJobs > STREAM_APPLY_MAX_JOBS)
+				{
+					log_fatal("Failed to parse --apply-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--apply-jobs %d", options.applyJobs);
+				break;
+			}
+
+			case 'a':
+			{
+				options.analyzeOnly = true;
+				log_trace("--analyze-only");
+				break;
+			}
+
+			case 'G':
+			{
+				options.estimateSizes = true;
+				log_trace("--estimate-sizes");
+				break;
+			}
+
+			case 'u':
+			{
+				strlcpy(options.targetSessionGucs, optarg,
+						sizeof(options.targetSessionGucs));
+				log_trace("--target-session-gucs %s", options.targetSessionGucs);
+				break;
+			}
+
 			case 'L':
 			{
 				if (!cli_parse_bytes_pretty(
@@ -688,6 +975,27 @@ cli_copy_db_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'y':
+			{
+				options.useCopyBinary = true;
+				log_trace("--copy-binary");
+				break;
+			}
+
+			case 'Q':
+			{
+				options.dropIndexes = true;
+				log_trace("--drop-indexes");
+				break;
+			}
+
+			case 'i':
+			{
+				options.incremental = true;
+				log_trace("--incremental");
+				break;
+			}
+
 			case 'r':
 			{
 				options.restart = true;
@@ -761,6 +1069,20 @@ cli_copy_db_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'w':
+			{
+				options.direct = true;
+				log_trace("--direct");
+				break;
+			}
+
+			case 'g':
+			{
+				options.distributed = true;
+				log_trace("--distributed");
+				break;
+			}
+
 			case 'E':
 			{
 				if (!parseLSN(optarg, &(options.endpos)))
@@ -864,6 +1186,17 @@ cli_copy_db_getopts(int argc, char **argv)
 		exit(EXIT_CODE_BAD_ARGS);
 	}
 
+	/*
+	 * Re-creating the target tables would leave the tables that --incremental
+	 * skips (because they are unchanged on the source) empty on the target.
+	 */
+	if (options.incremental && options.restoreOptions.dropIfExists)
+	{
+		log_fatal("Options --incremental and --drop-if-exists "
+				  "are not compatible");
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
 	/* when --slot-name is not used, use the default slot name "pgcopydb" */
 	if (IS_EMPTY_STRING_BUFFER(options.slotName))
 	{
@@ -921,6 +1254,19 @@ cli_parse_bytes_pretty(const char *byteString,
 					   char *bytesPretty,
 					   size_t bytesPrettySize)
 {
+	/*
+	 * The special value "auto" asks for a split threshold computed at runtime
+	 * from the total amount of bytes to copy and --table-jobs, see
+	 * copydb_prepare_table_specs.
+	 */
+	if (strcmp(byteString, "auto") == 0)
+	{
+		*bytes = SPLIT_TABLES_LARGER_THAN_AUTO;
+		strlcpy(bytesPretty, "auto", bytesPrettySize);
+
+		return true;
+	}
+
 	if (!parse_pretty_printed_bytes(byteString, bytes))
 	{
 		/* errors have already been logged */
@@ -1009,6 +1355,64 @@ cli_copy_prepare_specs(CopyDataSpec *copySpecs, CopyDataSection section)
 		exit(EXIT_CODE_INTERNAL_ERROR);
 	}
 
+	/* --copy-binary is not covered by copydb_init_specs() */
+	copySpecs->useCopyBinary = copyDBoptions.useCopyBinary;
+
+	/* neither is --drop-indexes */
+	copySpecs->dropIndexes = copyDBoptions.dropIndexes;
+
+	/* neither is --incremental */
+	copySpecs->incremental = copyDBoptions.incremental;
+
+	/* neither is --distributed */
+	copySpecs->distributed = copyDBoptions.distributed;
+
+	/* neither is --source-standby, used (repeatedly) for read scale-out */
+	copySpecs->sourceStandbyCount = copyDBoptions.sourceStandbyCount;
+
+	for (int i = 0; i < copyDBoptions.sourceStandbyCount; i++)
+	{
+		strlcpy(copySpecs->sourceStandbys[i],
+				copyDBoptions.sourceStandbys[i],
+				MAXCONNINFO);
+	}
+
+	/* neither is --index-memory */
+	copySpecs->indexMemory = copyDBoptions.indexMemory;
+
+	/* --index-jobs-while-copy defaults to the --index-jobs setting */
+	copySpecs->indexJobsWhileCopy =
+		copyDBoptions.indexJobsWhileCopy >= 0
+		? copyDBoptions.indexJobsWhileCopy
+		: copyDBoptions.indexJobs;
+
+	/* --vacuum-jobs defaults to the --table-jobs setting */
+	copySpecs->vacuumJobs =
+		copyDBoptions.vacuumJobs > 0
+		? copyDBoptions.vacuumJobs
+		: copyDBoptions.tableJobs;
+
+	/* --blob-jobs has its own default */
+	copySpecs->blobJobs =
+		copyDBoptions.blobJobs > 0
+		? copyDBoptions.blobJobs
+		: DEFAULT_BLOB_JOBS;
+
+	/* --restore-jobs defaults to the --index-jobs setting */
+	copySpecs->restoreOptions.jobs =
+		copyDBoptions.restoreOptions.jobs > 0
+		? copyDBoptions.restoreOptions.jobs
+		: copyDBoptions.indexJobs;
+
+	copySpecs->analyzeOnly = copyDBoptions.analyzeOnly;
+	copySpecs->estimateSizes = copyDBoptions.estimateSizes;
+	copySpecs->vacuumIOBudget = copyDBoptions.vacuumIOBudget;
+
+	/* --target-session-gucs applies to every target writer session */
+	strlcpy(copySpecs->targetSessionGucs,
+			copyDBoptions.targetSessionGucs,
+			sizeof(copySpecs->targetSessionGucs));
+
 	if (!IS_EMPTY_STRING_BUFFER(copyDBoptions.filterFileName))
 	{
 		SourceFilters *filters = &(copySpecs->filters);
@@ -26,10 +26,19 @@ typedef struct CopyDBOptions
 	char source_pguri[MAXCONNINFO];
 	char target_pguri[MAXCONNINFO];
 
+	int sourceStandbyCount;
+	char sourceStandbys[MAX_SOURCE_STANDBYS][MAXCONNINFO];
+
 	int tableJobs;
 	int indexJobs;
+	int indexJobsWhileCopy;
+	int vacuumJobs;
+	int blobJobs;
+	int applyJobs;
 	uint64_t splitTablesLargerThan;
 	char splitTablesLargerThanPretty[NAMEDATALEN];
+	uint64_t indexMemory;
+	char indexMemoryPretty[NAMEDATALEN];
 
 	RestoreOptions restoreOptions;
 
@@ -37,6 +46,14 @@ typedef struct CopyDBOptions
 	bool skipLargeObjects;
 	bool skipExtensions;
 	bool skipCollations;
+	bool useCopyBinary;
+	bool analyzeOnly;
+	bool estimateSizes;
+	bool dropIndexes;
+	bool incremental;
+	int vacuumIOBudget;
+
+	char targetSessionGucs[BUFSIZE];
 
 	bool restart;
 	bool resume;
@@ -45,6 +62,8 @@ typedef struct CopyDBOptions
 	char origin[BUFSIZE];
 
 	bool follow;
+	bool direct;
+	bool distributed;
 	bool createSlot;
 	bool currentpos;
 	uint64_t endpos;
@@ -0,0 +1,99 @@
+/*
+ * src/bin/pgcopydb/cli_compare.c
+ *     Implementation of a CLI which lets you compare source and target
+ *     databases after a migration
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "cli_common.h"
+#include "cli_root.h"
+#include "copydb.h"
+#include "commandline.h"
+#include "env_utils.h"
+#include "log.h"
+#include "parsing_utils.h"
+#include "pgsql.h"
+#include "string_utils.h"
+
+static void cli_compare_data(int argc, char **argv);
+
+static CommandLine compare_data_command =
+	make_command(
+		"data",
+		"Compare table contents between source and target databases",
+		" --source ... --target ... [ --table-jobs ... ] ",
+		"  --source              Postgres URI to the source database\n"
+		"  --target              Postgres URI to the target database\n"
+		"  --dir                 Work directory to use\n"
+		"  --table-jobs          Number of concurrent checksum jobs to run\n"
+		"  --split-tables-larger-than  Checksum large tables one range at a time\n"
+		"  --filters <filename>  Use the filters defined in <filename>\n"
+		"  --restart             Allow restarting when temp files exist already\n"
+		"  --not-consistent      Allow taking a new snapshot on the source database\n"
+		"  --snapshot            Use snapshot obtained with pg_export_snapshot\n",
+		cli_copy_db_getopts,
+		cli_compare_data);
+
+static CommandLine *compare_subcommands[] = {
+	&compare_data_command,
+	NULL
+};
+
+CommandLine compare_commands =
+	make_command_set("compare",
+					 "Compare source and target databases",
+					 NULL, NULL, NULL, compare_subcommands);
+
+
+/*
+ * cli_compare_data computes per-table content checksums on both the source
+ * and the target databases, concurrently, and reports the tables which
+ * contents do not match.
+ */
+static void
+cli_compare_data(int argc, char **argv)
+{
+	CopyDataSpec copySpecs = { 0 };
+
+	(void) cli_copy_prepare_specs(&copySpecs, DATA_SECTION_TABLE_DATA);
+
+	/*
+	 * First, we need to open a snapshot that we're going to re-use in all our
+	 * connections to the source database. When the --snapshot option has been
+	 * used, instead of exporting a new snapshot, we can just re-use it.
+	 */
+	if (!copydb_prepare_snapshot(&copySpecs))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	/* fetch schema information from source catalogs, including filtering */
+	if (!copydb_fetch_schema_and_prepare_specs(&copySpecs))
+	{
+		/* errors have already been logged */
+		(void) copydb_close_snapshot(&copySpecs);
+		exit(EXIT_CODE_TARGET);
+	}
+
+	bool success = compare_data(&copySpecs);
+
+	if (!copydb_close_snapshot(&copySpecs))
+	{
+		log_fatal("Failed to close snapshot \"%s\" on \"%s\"",
+				  copySpecs.sourceSnapshot.snapshot,
+				  copySpecs.sourceSnapshot.pguri);
+		exit(EXIT_CODE_SOURCE);
+	}
+
+	if (!success)
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_TARGET);
+	}
+
+	log_info("All tables pass the checksum comparison");
+}
@@ -40,11 +40,16 @@ CommandLine copy__db_command =
 		"  --dir                 Work directory to use\n"
 		"  --table-jobs          Number of concurrent COPY jobs to run\n"
 		"  --index-jobs          Number of concurrent CREATE INDEX jobs to run\n"
+		"  --restore-jobs        Number of concurrent jobs for pg_restore\n"
+		"  --index-memory        Memory budget shared by the CREATE INDEX jobs\n"
+		"  --vacuum-jobs         Number of concurrent VACUUM ANALYZE jobs to run\n"
+		"  --analyze-only        Run ANALYZE instead of VACUUM ANALYZE\n"
 		"  --drop-if-exists      On the target database, clean-up from a previous run first\n"
 		"  --roles               Also copy roles found on source to target\n"
 		"  --no-owner            Do not set ownership of objects to match the original database\n"
 		"  --no-acl              Prevent restoration of access privileges (grant/revoke commands).\n"
 		"  --no-comments         Do not output commands to restore comments\n"
+		"  --blob-jobs           Number of concurrent BLOB copy jobs to run\n"
 		"  --skip-large-objects  Skip copying large objects (blobs)\n"
 		"  --filters <filename>  Use the filters defined in <filename>\n"
 		"  --restart             Allow restarting when temp files exist already\n"
@@ -64,11 +69,16 @@ static CommandLine copy_db_command =
 		"  --dir                 Work directory to use\n"
 		"  --table-jobs          Number of concurrent COPY jobs to run\n"
 		"  --index-jobs          Number of concurrent CREATE INDEX jobs to run\n"
+		"  --restore-jobs        Number of concurrent jobs for pg_restore\n"
+		"  --index-memory        Memory budget shared by the CREATE INDEX jobs\n"
+		"  --vacuum-jobs         Number of concurrent VACUUM ANALYZE jobs to run\n"
+		"  --analyze-only        Run ANALYZE instead of VACUUM ANALYZE\n"
 		"  --drop-if-exists      On the target database, clean-up from a previous run first\n"
 		"  --roles               Also copy roles found on source to target\n"
 		"  --no-owner            Do not set ownership of objects to match the original database\n"
 		"  --no-acl              Prevent restoration of access privileges (grant/revoke commands).\n"
 		"  --no-comments         Do not output commands to restore comments\n"
+		"  --blob-jobs           Number of concurrent BLOB copy jobs to run\n"
 		"  --skip-large-objects  Skip copying large objects (blobs)\n"
 		"  --filters <filename>  Use the filters defined in <filename>\n"
 		"  --restart             Allow restarting when temp files exist already\n"
@@ -130,6 +140,11 @@ static CommandLine copy_data_command =
 		"  --dir                 Work directory to use\n"
 		"  --table-jobs          Number of concurrent COPY jobs to run\n"
 		"  --index-jobs          Number of concurrent CREATE INDEX jobs to run\n"
+		"  --restore-jobs        Number of concurrent jobs for pg_restore\n"
+		"  --index-memory        Memory budget shared by the CREATE INDEX jobs\n"
+		"  --vacuum-jobs         Number of concurrent VACUUM ANALYZE jobs to run\n"
+		"  --analyze-only        Run ANALYZE instead of VACUUM ANALYZE\n"
+		"  --blob-jobs           Number of concurrent BLOB copy jobs to run\n"
 		"  --skip-large-objects  Skip copying large objects (blobs)\n"
 		"  --filters <filename>  Use the filters defined in <filename>\n"
 		"  --restart             Allow restarting when temp files exist already\n"
@@ -164,6 +179,7 @@ static CommandLine copy_blobs_command =
 		"  --source          Postgres URI to the source database\n"
 		"  --target          Postgres URI to the target database\n"
 		"  --dir             Work directory to use\n"
+		"  --blob-jobs       Number of concurrent BLOB copy jobs to run\n"
 		"  --drop-if-exists  On the target database, drop and create large objects\n"
 		"  --restart         Allow restarting when temp files exist already\n"
 		"  --resume          Allow resuming operations after a failure\n"
@@ -318,6 +318,9 @@ cli_create_snapshot(int argc, char **argv)
 
 	fformat(stdout, "%s\n", copySpecs.sourceSnapshot.snapshot);
 
+	log_info("Other pgcopydb commands using the same work directory "
+			 "now attach to this snapshot automatically");
+
 	for (;;)
 	{
 		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
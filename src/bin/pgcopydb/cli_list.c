@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <unistd.h>
 
 #include "cli_common.h"
 #include "cli_list.h"
@@ -16,11 +17,13 @@
 #include "env_utils.h"
 #include "filtering.h"
 #include "log.h"
+#include "mem_utils.h"
 #include "parsing_utils.h"
 #include "pgcmd.h"
 #include "pgsql.h"
 #include "progress.h"
 #include "schema.h"
+#include "signals.h"
 #include "string_utils.h"
 
 ListDBOptions listDBoptions = { 0 };
@@ -33,8 +36,13 @@ static void cli_list_table_parts(int argc, char **argv);
 static void cli_list_sequences(int argc, char **argv);
 static void cli_list_indexes(int argc, char **argv);
 static void cli_list_depends(int argc, char **argv);
+static void cli_list_all(int argc, char **argv);
 static void cli_list_schema(int argc, char **argv);
 static void cli_list_progress(int argc, char **argv);
+static bool cli_list_progress_sample(CopyDataSpec *copySpecs,
+									 CopyProgress *progress);
+static void cli_list_progress_follow(CopyDataSpec *copySpecs);
+static void cli_list_metrics(int argc, char **argv);
 
 static CommandLine list_extensions_command =
 	make_command(
@@ -63,6 +71,7 @@ static CommandLine list_tables_command =
 		"  --filter <filename> Use the filters defined in <filename>\n"
 		"  --cache             Cache table size in relation pgcopydb.table_size\n"
 		"  --drop-cache        Drop relation pgcopydb.table_size\n"
+		"  --estimate          Size tables from pg_class estimates only\n"
 		"  --list-skipped      List only tables that are setup to be skipped\n"
 		"  --without-pkey      List only tables that have no primary key\n",
 		cli_list_db_getopts,
@@ -117,6 +126,18 @@ static CommandLine list_depends_command =
 		cli_list_db_getopts,
 		cli_list_depends);
 
+static CommandLine list_all_command =
+	make_command(
+		"all",
+		"List tables, indexes, sequences and dependencies, in JSON",
+		" --source ... ",
+		"  --source            Postgres URI to the source database\n"
+		"  --filter <filename> Use the filters defined in <filename>\n"
+		"  --estimate          Size tables from pg_class estimates only\n"
+		"  --from-cache        Re-use the cached schema file, skip the source\n",
+		cli_list_db_getopts,
+		cli_list_all);
+
 static CommandLine list_schema_command =
 	make_command(
 		"schema",
@@ -134,10 +155,22 @@ static CommandLine list_progress_command =
 		" --source ... ",
 		"  --source  Postgres URI to the source database\n"
 		"  --json    Format the output using JSON\n"
+		"  --follow  Sample progress continuously, with throughput rates\n"
 		"  --dir     Work directory to use\n",
 		cli_list_db_getopts,
 		cli_list_progress);
 
+static CommandLine list_metrics_command =
+	make_command(
+		"metrics",
+		"List the metrics data points collected in the work directory",
+		" --source ... ",
+		"  --source  Postgres URI to the source database\n"
+		"  --json    Format the output using JSON\n"
+		"  --dir     Work directory to use\n",
+		cli_list_db_getopts,
+		cli_list_metrics);
+
 
 static CommandLine *list_subcommands[] = {
 	&list_extensions_command,
@@ -147,8 +180,10 @@ static CommandLine *list_subcommands[] = {
 	&list_sequences_command,
 	&list_indexes_command,
 	&list_depends_command,
+	&list_all_command,
 	&list_schema_command,
 	&list_progress_command,
+	&list_metrics_command,
 	NULL
 };
 
@@ -180,6 +215,9 @@ cli_list_db_getopts(int argc, char **argv)
 		{ "split-at", required_argument, NULL, 'L' },
 		{ "cache", no_argument, NULL, 'c' },
 		{ "drop-cache", no_argument, NULL, 'C' },
+		{ "from-cache", no_argument, NULL, 'A' },
+		{ "estimate", no_argument, NULL, 'e' },
+		{ "follow", no_argument, NULL, 'f' },
 		{ "json", no_argument, NULL, 'J' },
 		{ "version", no_argument, NULL, 'V' },
 		{ "debug", no_argument, NULL, 'd' },
@@ -192,7 +230,7 @@ cli_list_db_getopts(int argc, char **argv)
 
 	optind = 0;
 
-	while ((c = getopt_long(argc, argv, "S:T:D:j:s:t:PL:cCJVvdzqh",
+	while ((c = getopt_long(argc, argv, "S:T:D:j:s:t:PL:cCfJVvdzqh",
 							long_options, &option_index)) != -1)
 	{
 		switch (c)
@@ -286,6 +324,12 @@ cli_list_db_getopts(int argc, char **argv)
 					++errors;
 				}
 
+				if (options.estimate)
+				{
+					log_fatal("Please choose either --cache or --estimate");
+					++errors;
+				}
+
 				options.cache = true;
 				log_trace("--cache");
 				break;
@@ -304,6 +348,33 @@ cli_list_db_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'A':
+			{
+				options.fromCache = true;
+				log_trace("--from-cache");
+				break;
+			}
+
+			case 'e':
+			{
+				if (options.cache)
+				{
+					log_fatal("Please choose either --cache or --estimate");
+					++errors;
+				}
+
+				options.estimate = true;
+				log_trace("--estimate");
+				break;
+			}
+
+			case 'f':
+			{
+				options.follow = true;
+				log_trace("--follow");
+				break;
+			}
+
 			case 'J':
 			{
 				outputJSON = true;
@@ -393,7 +464,7 @@ cli_list_db_getopts(int argc, char **argv)
 		}
 	}
 
-	if (IS_EMPTY_STRING_BUFFER(options.source_pguri))
+	if (IS_EMPTY_STRING_BUFFER(options.source_pguri) && !options.fromCache)
 	{
 		log_fatal("Option --source is mandatory");
 		++errors;
@@ -616,6 +687,7 @@ cli_list_tables(int argc, char **argv)
 
 	if (!schema_prepare_pgcopydb_table_size(&pgsql,
 											&filters,
+											listDBoptions.estimate,
 											listDBoptions.cache, /* force */
 											&createdTableSizeTable))
 	{
@@ -637,6 +709,12 @@ cli_list_tables(int argc, char **argv)
 	}
 	else
 	{
+		if (listDBoptions.estimate)
+		{
+			log_info("Table sizes are derived from pg_class estimates "
+					 "(--estimate), not measured on-disk");
+		}
+
 		log_info("Listing ordinary tables in source database");
 
 		if (!schema_list_ordinary_tables(&pgsql, &filters, &tableArray))
@@ -670,7 +748,8 @@ cli_list_tables(int argc, char **argv)
 
 	fformat(stdout, "%8s | %20s | %20s | %15s | %15s\n",
 			"OID", "Schema Name", "Table Name",
-			"Est. Row Count", "On-disk size");
+			"Est. Row Count",
+			listDBoptions.estimate ? "Est. size" : "On-disk size");
 
 	fformat(stdout, "%8s-+-%20s-+-%20s-+-%15s-+-%15s\n",
 			"--------",
@@ -1160,6 +1239,187 @@ cli_list_depends(int argc, char **argv)
 }
 
 
+/*
+ * cli_list_all implements the command: pgcopydb list all
+ *
+ * The tables, indexes, sequences and dependencies are all fetched over a
+ * single source connection and transaction, and output as a single JSON
+ * document. With the --from-cache option the cached schema file is printed
+ * instead, and the source database is not contacted at all.
+ */
+static void
+cli_list_all(int argc, char **argv)
+{
+	if (listDBoptions.fromCache)
+	{
+		CopyDataSpec copySpecs = { 0 };
+
+		(void) find_pg_commands(&(copySpecs.pgPaths));
+
+		char *dir =
+			IS_EMPTY_STRING_BUFFER(listDBoptions.dir)
+			? NULL
+			: listDBoptions.dir;
+
+		/*
+		 * Assume --resume so that we can run the command alongside the main
+		 * process being active.
+		 */
+		bool auxilliary = true;
+		bool createWorkDir = false;
+
+		if (!copydb_init_workdir(&copySpecs,
+								 dir,
+								 false, /* restart */
+								 true, /* resume */
+								 createWorkDir,
+								 auxilliary))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		if (!file_exists(copySpecs.cfPaths.schemafile))
+		{
+			log_fatal("Failed to find cached schema file \"%s\", "
+					  "consider using `pgcopydb list schema` to prepare it",
+					  copySpecs.cfPaths.schemafile);
+			exit(EXIT_CODE_BAD_ARGS);
+		}
+
+		/* output the JSON contents from the cached json schema file */
+		char *json = NULL;
+		long size = 0L;
+
+		if (!read_file(copySpecs.cfPaths.schemafile, &json, &size))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		fformat(stdout, "%s\n", json);
+		free(json);
+
+		return;
+	}
+
+	PGSQL pgsql = { 0 };
+	SourceFilters filters = { 0 };
+
+	SourceTableArray tableArray = { 0, NULL };
+	SourceIndexArray indexArray = { 0, NULL };
+	SourceSequenceArray sequenceArray = { 0, NULL };
+	SourceDependArray dependArray = { 0, NULL };
+
+	if (!IS_EMPTY_STRING_BUFFER(listDBoptions.filterFileName))
+	{
+		if (!parse_filters(listDBoptions.filterFileName, &filters))
+		{
+			log_error("Failed to parse filters in file \"%s\"",
+					  listDBoptions.filterFileName);
+			exit(EXIT_CODE_BAD_ARGS);
+		}
+	}
+
+	log_info("Listing tables, indexes, sequences and dependencies "
+			 "in source database");
+
+	if (!pgsql_init(&pgsql, listDBoptions.source_pguri, PGSQL_CONN_SOURCE))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_SOURCE);
+	}
+
+	/* batch all the catalog queries in a single connection and transaction */
+	if (!pgsql_begin(&pgsql))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_SOURCE);
+	}
+
+	bool createdTableSizeTable = false;
+
+	if (!schema_prepare_pgcopydb_table_size(&pgsql,
+											&filters,
+											listDBoptions.estimate,
+											false, /* force */
+											&createdTableSizeTable))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	if (!schema_list_ordinary_tables(&pgsql, &filters, &tableArray))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	if (!schema_list_all_indexes(&pgsql, &filters, &indexArray))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	if (!schema_list_sequences(&pgsql, &filters, &sequenceArray))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	/* the pg_depend queries only make sense when filtering is installed */
+	if (filters.type != SOURCE_FILTER_TYPE_NONE)
+	{
+		if (!schema_list_pg_depend(&pgsql, &filters, &dependArray))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+	}
+
+	if (createdTableSizeTable && !listDBoptions.cache)
+	{
+		if (!schema_drop_pgcopydb_table_size(&pgsql))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+	}
+
+	if (!pgsql_commit(&pgsql))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_SOURCE);
+	}
+
+	log_info("Fetched information for %d tables, %d indexes, %d sequences, "
+			 "and %d dependencies",
+			 tableArray.count,
+			 indexArray.count,
+			 sequenceArray.count,
+			 dependArray.count);
+
+	JSON_Value *js = json_value_init_object();
+	JSON_Object *jsobj = json_value_get_object(js);
+
+	if (!copydb_table_array_as_json(&tableArray, jsobj, "tables") ||
+		!copydb_index_array_as_json(&indexArray, jsobj, "indexes") ||
+		!copydb_seq_array_as_json(&sequenceArray, jsobj, "sequences") ||
+		!copydb_depend_array_as_json(&dependArray, jsobj, "depends"))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	char *serialized_string = json_serialize_to_string_pretty(js);
+
+	fformat(stdout, "%s\n", serialized_string);
+
+	json_free_serialized_string(serialized_string);
+	json_value_free(js);
+}
+
+
 /*
  * cli_list_schema implements the command: pgcopydb list schema
  */
@@ -1324,6 +1584,18 @@ cli_list_progress(int argc, char **argv)
 		exit(EXIT_CODE_INTERNAL_ERROR);
 	}
 
+	if (listDBoptions.follow)
+	{
+		if (outputJSON)
+		{
+			log_fatal("Please choose either --follow or --json");
+			exit(EXIT_CODE_BAD_ARGS);
+		}
+
+		(void) cli_list_progress_follow(&copySpecs);
+		return;
+	}
+
 	CopyProgress progress = { 0 };
 
 	if (!copydb_update_progress(&copySpecs, &progress))
@@ -1376,3 +1648,357 @@ cli_list_progress(int argc, char **argv)
 				progress.indexDoneCount);
 	}
 }
+
+
+/*
+ * cli_list_progress_sample fetches a point-in-time progress sample, and then
+ * releases the allocations that copydb_update_progress makes when it has to
+ * scan the work directory files, so that the follow loop can sample
+ * repeatedly without growing its memory footprint.
+ */
+static bool
+cli_list_progress_sample(CopyDataSpec *copySpecs, CopyProgress *progress)
+{
+	if (!copydb_update_progress(copySpecs, progress))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (copySpecs->progress == NULL)
+	{
+		arena_release(&(progress->tableInProgress.arena));
+		arena_release(&(progress->indexInProgress.arena));
+
+		free(progress->tableSummaryArray.array);
+		free(progress->indexSummaryArray.array);
+
+		progress->tableInProgress.array = NULL;
+		progress->indexInProgress.array = NULL;
+		progress->tableSummaryArray.array = NULL;
+		progress->indexSummaryArray.array = NULL;
+	}
+
+	return true;
+}
+
+
+/*
+ * cli_list_progress_follow samples the progress of the pgcopydb command that
+ * uses the same work directory about once per second, computes throughput
+ * rates from successive samples, and refreshes a one-screen status until the
+ * copy is done or we're asked to stop.
+ *
+ * When the live progress counters shared memory segment is around, sampling
+ * reads a handful of counters; otherwise every sample has to scan the work
+ * directory files, which is heavier, and the byte counters are not
+ * available.
+ */
+static void
+cli_list_progress_follow(CopyDataSpec *copySpecs)
+{
+	SourceTableArray *tableArray = &(copySpecs->sourceTableArray);
+
+	uint64_t totalBytes = 0;
+
+	for (int i = 0; i < tableArray->count; i++)
+	{
+		totalBytes += tableArray->array[i].bytes;
+	}
+
+	bool liveCounters = copySpecs->progress != NULL;
+
+	if (!liveCounters)
+	{
+		log_notice("The live progress counters are not available, "
+				   "every sample scans the work directory files");
+	}
+
+	bool onTerminal = isatty(fileno(stdout)) == 1;
+
+	CopyProgress previous = { 0 };
+
+	if (!cli_list_progress_sample(copySpecs, &previous))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	int firstTableDoneCount = previous.tableDoneCount;
+	uint64_t firstBytesDone = previous.tableBytesDone;
+
+	instr_time startTime;
+
+	INSTR_TIME_SET_CURRENT(startTime);
+
+	instr_time previousTime = startTime;
+
+	for (;;)
+	{
+		/* sleep one second between samples, checking for interrupts */
+		for (int t = 0; t < 10; t++)
+		{
+			if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
+			{
+				return;
+			}
+
+			pg_usleep(100 * 1000);
+		}
+
+		CopyProgress sample = { 0 };
+
+		if (!cli_list_progress_sample(copySpecs, &sample))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		instr_time now;
+
+		INSTR_TIME_SET_CURRENT(now);
+
+		instr_time sincePrevious = now;
+		instr_time sinceStart = now;
+
+		INSTR_TIME_SUBTRACT(sincePrevious, previousTime);
+		INSTR_TIME_SUBTRACT(sinceStart, startTime);
+
+		double intervalSecs = INSTR_TIME_GET_DOUBLE(sincePrevious);
+		double elapsedSecs = INSTR_TIME_GET_DOUBLE(sinceStart);
+
+		/* rates over the last sampling interval */
+		double tablesPerSec =
+			(sample.tableDoneCount - previous.tableDoneCount) / intervalSecs;
+
+		double indexesPerSec =
+			(sample.indexDoneCount - previous.indexDoneCount) / intervalSecs;
+
+		uint64_t bytesPerSec = (uint64_t)
+							   ((sample.tableBytesDone -
+								 previous.tableBytesDone) / intervalSecs);
+
+		/* the ETA uses the average throughput since the watch started */
+		char eta[BUFSIZE] = { 0 };
+
+		strlcpy(eta, "unknown", sizeof(eta));
+
+		if (liveCounters && totalBytes > 0)
+		{
+			double avgBytesPerSec =
+				(sample.tableBytesDone - firstBytesDone) / elapsedSecs;
+
+			if (avgBytesPerSec > 0 && sample.tableBytesDone <= totalBytes)
+			{
+				uint64_t etaMs = (uint64_t)
+								 ((totalBytes - sample.tableBytesDone) /
+								  avgBytesPerSec * 1000);
+
+				(void) IntervalToString(etaMs, eta, sizeof(eta));
+			}
+		}
+		else
+		{
+			double avgTablesPerSec =
+				(sample.tableDoneCount - firstTableDoneCount) / elapsedSecs;
+
+			if (avgTablesPerSec > 0)
+			{
+				uint64_t etaMs = (uint64_t)
+								 ((sample.tableCount - sample.tableDoneCount) /
+								  avgTablesPerSec * 1000);
+
+				(void) IntervalToString(etaMs, eta, sizeof(eta));
+			}
+		}
+
+		char bytesDonePretty[BUFSIZE] = { 0 };
+		char totalBytesPretty[BUFSIZE] = { 0 };
+		char bytesRatePretty[BUFSIZE] = { 0 };
+
+		(void) pretty_print_bytes(bytesDonePretty, sizeof(bytesDonePretty),
+								  sample.tableBytesDone);
+
+		(void) pretty_print_bytes(totalBytesPretty, sizeof(totalBytesPretty),
+								  totalBytes);
+
+		(void) pretty_print_bytes(bytesRatePretty, sizeof(bytesRatePretty),
+								  bytesPerSec);
+
+		if (onTerminal)
+		{
+			/* clear the screen and put the cursor back top-left */
+			fformat(stdout, "\033[2J\033[H");
+
+			fformat(stdout, "Progress for pgcopydb in \"%s\"\n\n",
+					copySpecs->cfPaths.topdir);
+
+			fformat(stdout, "%12s | %12s | %12s | %12s\n",
+					"",
+					"Done",
+					"Total",
+					"Per Second");
+
+			fformat(stdout, "%12s-+-%12s-+-%12s-+-%12s\n",
+					"------------",
+					"------------",
+					"------------",
+					"------------");
+
+			fformat(stdout, "%12s | %12d | %12d | %12.1f\n",
+					"Tables",
+					sample.tableDoneCount,
+					sample.tableCount,
+					tablesPerSec);
+
+			if (liveCounters)
+			{
+				fformat(stdout, "%12s | %12s | %12s | %10s/s\n",
+						"Bytes",
+						bytesDonePretty,
+						totalBytesPretty,
+						bytesRatePretty);
+			}
+
+			fformat(stdout, "%12s | %12d | %12d | %12.1f\n",
+					"Indexes",
+					sample.indexDoneCount,
+					sample.indexCount,
+					indexesPerSec);
+
+			fformat(stdout, "\nETA %s\n", eta);
+		}
+		else
+		{
+			/* when redirected to a file, append one line per sample */
+			fformat(stdout,
+					"tables %d/%d (%.1f/s) indexes %d/%d (%.1f/s) "
+					"bytes %s/%s (%s/s) eta %s\n",
+					sample.tableDoneCount,
+					sample.tableCount,
+					tablesPerSec,
+					sample.indexDoneCount,
+					sample.indexCount,
+					indexesPerSec,
+					bytesDonePretty,
+					totalBytesPretty,
+					bytesRatePretty,
+					eta);
+		}
+
+		fflush(stdout);
+
+		/* stop by ourselves when all the tables and indexes are done */
+		if (sample.tableCount > 0 &&
+			sample.tableDoneCount >= sample.tableCount &&
+			sample.indexDoneCount >= sample.indexCount)
+		{
+			return;
+		}
+
+		previous = sample;
+		previousTime = now;
+	}
+}
+
+
+/*
+ * cli_list_metrics implements the command: pgcopydb list metrics
+ *
+ * The metrics file is a JSON-lines file where each line is a data point
+ * appended by a worker process, see metrics_emit(). By default the raw
+ * contents are printed as-is; with --json the lines are assembled into a
+ * single JSON array.
+ */
+static void
+cli_list_metrics(int argc, char **argv)
+{
+	CopyDataSpec copySpecs = { 0 };
+
+	(void) find_pg_commands(&(copySpecs.pgPaths));
+
+	char *dir =
+		IS_EMPTY_STRING_BUFFER(listDBoptions.dir)
+		? NULL
+		: listDBoptions.dir;
+
+	/*
+	 * Assume --resume so that we can run the command alongside the main
+	 * process being active.
+	 */
+	bool auxilliary = true;
+	bool createWorkDir = false;
+
+	if (!copydb_init_workdir(&copySpecs,
+							 dir,
+							 false, /* restart */
+							 true, /* resume */
+							 createWorkDir,
+							 auxilliary))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	if (!file_exists(copySpecs.cfPaths.metricsfile))
+	{
+		log_fatal("No metrics have been collected yet in \"%s\"",
+				  copySpecs.cfPaths.metricsfile);
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	char *contents = NULL;
+	long size = 0L;
+
+	if (!read_file(copySpecs.cfPaths.metricsfile, &contents, &size))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	if (!outputJSON)
+	{
+		/* the metrics file already is JSON-lines, print it as-is */
+		fformat(stdout, "%s", contents);
+		free(contents);
+		return;
+	}
+
+	int lineCount = countLines(contents);
+	char **lines = (char **) calloc(lineCount, sizeof(char *));
+
+	if (lines == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	lineCount = splitLines(contents, lines, lineCount);
+
+	JSON_Value *js = json_value_init_array();
+	JSON_Array *jsArray = json_value_get_array(js);
+
+	for (int i = 0; i < lineCount; i++)
+	{
+		JSON_Value *jsLine = json_parse_string(lines[i]);
+
+		if (jsLine == NULL)
+		{
+			/* skip torn lines, a worker might be appending right now */
+			log_debug("Failed to parse metrics line %d: %s", i + 1, lines[i]);
+			continue;
+		}
+
+		json_array_append_value(jsArray, jsLine);
+	}
+
+	char *serialized_string = json_serialize_to_string_pretty(js);
+
+	fformat(stdout, "%s\n", serialized_string);
+
+	json_free_serialized_string(serialized_string);
+	json_value_free(js);
+
+	free(lines);
+	free(contents);
+}
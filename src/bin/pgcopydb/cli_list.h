@@ -28,6 +28,9 @@ typedef struct ListDBOptions
 	bool noPKey;
 	bool cache;
 	bool dropCache;
+	bool fromCache;
+	bool estimate;
+	bool follow;
 
 	uint64_t splitTablesLargerThan;
 	char splitTablesLargerThanPretty[NAMEDATALEN];
@@ -38,6 +38,7 @@ static CommandLine restore_schema_command =
 		"  --source             Postgres URI to the source database\n"
 		"  --target             Postgres URI to the target database\n"
 		"  --dir                Work directory to use\n"
+		"  --restore-jobs       Number of concurrent jobs for the post-data restore\n"
 		"  --drop-if-exists     On the target database, clean-up from a previous run first\n"
 		"  --no-owner           Do not set ownership of objects to match the original database\n"
 		"  --no-acl             Prevent restoration of access privileges (grant/revoke commands).\n"
@@ -76,6 +77,7 @@ static CommandLine restore_schema_post_data_command =
 		"  --source             Postgres URI to the source database\n"
 		"  --target             Postgres URI to the target database\n"
 		"  --dir                Work directory to use\n"
+		"  --restore-jobs       Number of concurrent jobs for pg_restore\n"
 		"  --no-owner           Do not set ownership of objects to match the original database\n"
 		"  --no-acl             Prevent restoration of access privileges (grant/revoke commands).\n"
 		"  --no-comments        Do not output commands to restore comments\n"
@@ -144,6 +146,7 @@ cli_restore_schema_getopts(int argc, char **argv)
 		{ "target", required_argument, NULL, 'T' },
 		{ "dir", required_argument, NULL, 'D' },
 		{ "schema", required_argument, NULL, 's' },
+		{ "restore-jobs", required_argument, NULL, 'P' },
 		{ "drop-if-exists", no_argument, NULL, 'c' }, /* pg_restore -c */
 		{ "no-owner", no_argument, NULL, 'O' },       /* pg_restore -O */
 		{ "no-comments", no_argument, NULL, 'X' },
@@ -211,6 +214,20 @@ cli_restore_schema_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'P':
+			{
+				if (!stringToInt(optarg, &options.restoreOptions.jobs) ||
+					options.restoreOptions.jobs < 1 ||
+					options.restoreOptions.jobs > 128)
+				{
+					log_fatal("Failed to parse --restore-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--restore-jobs %d", options.restoreOptions.jobs);
+				break;
+			}
+
 			case 'c':
 			{
 				options.restoreOptions.dropIfExists = true;
@@ -32,6 +32,8 @@ CommandLine *root_subcommands_with_debug[] = {
 	&restore_commands,
 	&list_commands,
 	&stream_commands,
+	&compare_commands,
+	&bench_commands,
 	&help,
 	&version,
 	NULL
@@ -57,6 +59,8 @@ CommandLine *root_subcommands[] = {
 	&restore_commands,
 	&list_commands,
 	&stream_commands,
+	&compare_commands,
+	&bench_commands,
 	&help,
 	&version,
 	NULL
@@ -63,4 +63,10 @@ extern CommandLine stream_commands;
 /* cli_sentinel.h */
 extern CommandLine sentinel_commands;
 
+/* cli_bench.c */
+extern CommandLine bench_commands;
+
+/* cli_compare.c */
+extern CommandLine compare_commands;
+
 #endif  /* CLI_ROOT_H */
@@ -681,6 +681,15 @@ cli_sentinel_get(int argc, char **argv)
 		json_object_set_string(jsobj, "flush_lsn", flush_lsn);
 		json_object_set_string(jsobj, "replay_lsn", replay_lsn);
 
+		json_object_dotset_number(jsobj, "apply_lag.p50_ms",
+								  (double) sentinel.lag.p50);
+		json_object_dotset_number(jsobj, "apply_lag.p95_ms",
+								  (double) sentinel.lag.p95);
+		json_object_dotset_number(jsobj, "apply_lag.p99_ms",
+								  (double) sentinel.lag.p99);
+		json_object_dotset_number(jsobj, "apply_lag.txns",
+								  (double) sentinel.lag.txns);
+
 		char *serialized_string = json_serialize_to_string_pretty(js);
 
 		fformat(stdout, "%s\n", serialized_string);
@@ -702,5 +711,12 @@ cli_sentinel_get(int argc, char **argv)
 				LSN_FORMAT_ARGS(sentinel.flush_lsn));
 		fformat(stdout, "%-10s %X/%X\n", "replay_lsn",
 				LSN_FORMAT_ARGS(sentinel.replay_lsn));
+		fformat(stdout, "%-10s p50 %lld ms, p95 %lld ms, p99 %lld ms "
+						"(%lld txns)\n",
+				"apply_lag",
+				(long long) sentinel.lag.p50,
+				(long long) sentinel.lag.p95,
+				(long long) sentinel.lag.p99,
+				(long long) sentinel.lag.txns);
 	}
 }
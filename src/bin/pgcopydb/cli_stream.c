@@ -4,6 +4,7 @@
  *     directly
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
@@ -12,6 +13,8 @@
 #include "access/xlog_internal.h"
 #include "access/xlogdefs.h"
 
+#include "portability/instr_time.h"
+
 #include "cli_common.h"
 #include "cli_root.h"
 #include "commandline.h"
@@ -28,9 +31,13 @@
 CopyDBOptions streamDBoptions = { 0 };
 
 static int cli_stream_getopts(int argc, char **argv);
+static int cli_stream_bench_getopts(int argc, char **argv);
 static void cli_stream_receive(int argc, char **argv);
 static void cli_stream_transform(int argc, char **argv);
 static void cli_stream_apply(int argc, char **argv);
+static void cli_stream_bench(int argc, char **argv);
+
+static bool stream_bench_count_lines(const char *filename, uint64_t *count);
 
 static void cli_stream_setup(int argc, char **argv);
 static void cli_stream_cleanup(int argc, char **argv);
@@ -39,6 +46,9 @@ static void cli_stream_catchup(int argc, char **argv);
 
 static void stream_start_in_mode(LogicalStreamMode mode);
 
+/* replaying a segment archive is bounded to keep bench runs short */
+#define STREAM_BENCH_MAX_FILES 1024
+
 static CommandLine stream_setup_command =
 	make_command(
 		"setup",
@@ -147,6 +157,20 @@ static CommandLine stream_apply_command =
 		cli_stream_getopts,
 		cli_stream_apply);
 
+static CommandLine stream_bench_command =
+	make_command(
+		"bench",
+		"Replay captured JSON segment files and report throughput",
+		" <json dir> ",
+		"  --target         Postgres URI to the target database, "
+		"enables the apply stage\n"
+		"  --dir            Work directory to use\n"
+		"  --restart        Allow restarting when temp files exist already\n"
+		"  --origin         Name of the Postgres replication origin\n"
+		"  --endpos         LSN position where to stop applying changes",
+		cli_stream_bench_getopts,
+		cli_stream_bench);
+
 
 static CommandLine *stream_subcommands[] = {
 	&stream_setup_command,
@@ -159,6 +183,7 @@ static CommandLine *stream_subcommands[] = {
 	&stream_receive_command,
 	&stream_transform_command,
 	&stream_apply_command,
+	&stream_bench_command,
 	NULL
 };
 
@@ -186,6 +211,7 @@ cli_stream_getopts(int argc, char **argv)
 		{ "slot-name", required_argument, NULL, 's' },
 		{ "snapshot", required_argument, NULL, 'N' },
 		{ "origin", required_argument, NULL, 'o' },
+		{ "apply-jobs", required_argument, NULL, 'Y' },
 		{ "endpos", required_argument, NULL, 'E' },
 		{ "restart", no_argument, NULL, 'r' },
 		{ "resume", no_argument, NULL, 'R' },
@@ -319,6 +345,20 @@ cli_stream_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'Y':
+			{
+				if (!stringToInt(optarg, &options.applyJobs) ||
+					options.applyJobs < 1 ||
+					options.applyJobs > STREAM_APPLY_MAX_JOBS)
+				{
+					log_fatal("Failed to parse --apply-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--apply-jobs %d", options.applyJobs);
+				break;
+			}
+
 			case 'V':
 			{
 				/* keeper_cli_print_version prints version and exits. */
@@ -679,6 +719,14 @@ cli_stream_catchup(int argc, char **argv)
 		exit(EXIT_CODE_INTERNAL_ERROR);
 	}
 
+	/* --target-session-gucs is not covered by stream_init_specs() */
+	strlcpy(specs.targetSessionGucs,
+			streamDBoptions.targetSessionGucs,
+			sizeof(specs.targetSessionGucs));
+
+	/* neither is --apply-jobs */
+	specs.applyJobs = streamDBoptions.applyJobs;
+
 	/*
 	 * First, we need to know enough about the source database system to be
 	 * able to generate WAL file names. That's means the current timeline and
@@ -779,6 +827,10 @@ cli_stream_apply(int argc, char **argv)
 	/* prepare the replication origin tracking */
 	StreamApplyContext context = { 0 };
 
+	strlcpy(context.targetSessionGucs,
+			streamDBoptions.targetSessionGucs,
+			sizeof(context.targetSessionGucs));
+
 	if (!setupReplicationOrigin(&context,
 								&(copySpecs.cfPaths.cdc),
 								streamDBoptions.source_pguri,
@@ -876,9 +928,479 @@ stream_start_in_mode(LogicalStreamMode mode)
 		exit(EXIT_CODE_INTERNAL_ERROR);
 	}
 
+	/* --target-session-gucs is not covered by stream_init_specs() */
+	strlcpy(specs.targetSessionGucs,
+			streamDBoptions.targetSessionGucs,
+			sizeof(specs.targetSessionGucs));
+
+	/* neither is --apply-jobs */
+	specs.applyJobs = streamDBoptions.applyJobs;
+
 	if (!startLogicalStreaming(&specs))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_SOURCE);
 	}
 }
+
+
+/*
+ * cli_stream_bench_getopts parses the CLI options for the `stream bench`
+ * command. Only the apply stage needs a (throwaway) target database, the
+ * transform stage runs entirely offline.
+ */
+static int
+cli_stream_bench_getopts(int argc, char **argv)
+{
+	CopyDBOptions options = { 0 };
+	int c, option_index = 0;
+	int verboseCount = 0;
+
+	static struct option long_options[] = {
+		{ "target", required_argument, NULL, 'T' },
+		{ "dir", required_argument, NULL, 'D' },
+		{ "origin", required_argument, NULL, 'o' },
+		{ "endpos", required_argument, NULL, 'E' },
+		{ "restart", no_argument, NULL, 'r' },
+		{ "version", no_argument, NULL, 'V' },
+		{ "verbose", no_argument, NULL, 'v' },
+		{ "debug", no_argument, NULL, 'd' },
+		{ "trace", no_argument, NULL, 'z' },
+		{ "quiet", no_argument, NULL, 'q' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	optind = 0;
+
+	/* read values from the environment */
+	if (!cli_copydb_getenv(&options))
+	{
+		log_fatal("Failed to read default values from the environment");
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	while ((c = getopt_long(argc, argv, "T:D:o:E:rVvdzqh",
+							long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+			case 'T':
+			{
+				if (!validate_connection_string(optarg))
+				{
+					log_fatal("Failed to parse --target connection string, "
+							  "see above for details.");
+					exit(EXIT_CODE_BAD_ARGS);
+				}
+				strlcpy(options.target_pguri, optarg, MAXCONNINFO);
+				log_trace("--target %s", options.target_pguri);
+				break;
+			}
+
+			case 'D':
+			{
+				strlcpy(options.dir, optarg, MAXPGPATH);
+				log_trace("--dir %s", options.dir);
+				break;
+			}
+
+			case 'o':
+			{
+				strlcpy(options.origin, optarg, NAMEDATALEN);
+				log_trace("--origin %s", options.origin);
+				break;
+			}
+
+			case 'E':
+			{
+				if (!parseLSN(optarg, &(options.endpos)))
+				{
+					log_fatal("Failed to parse endpos LSN: \"%s\"", optarg);
+					exit(EXIT_CODE_BAD_ARGS);
+				}
+
+				log_trace("--endpos %X/%X",
+						  LSN_FORMAT_ARGS(options.endpos));
+				break;
+			}
+
+			case 'r':
+			{
+				options.restart = true;
+				log_trace("--restart");
+				break;
+			}
+
+			case 'V':
+			{
+				/* keeper_cli_print_version prints version and exits. */
+				cli_print_version(argc, argv);
+				break;
+			}
+
+			case 'v':
+			{
+				++verboseCount;
+				switch (verboseCount)
+				{
+					case 1:
+					{
+						log_set_level(LOG_NOTICE);
+						break;
+					}
+
+					case 2:
+					{
+						log_set_level(LOG_DEBUG);
+						break;
+					}
+
+					default:
+					{
+						log_set_level(LOG_TRACE);
+						break;
+					}
+				}
+				break;
+			}
+
+			case 'd':
+			{
+				verboseCount = 2;
+				log_set_level(LOG_DEBUG);
+				break;
+			}
+
+			case 'z':
+			{
+				verboseCount = 3;
+				log_set_level(LOG_TRACE);
+				break;
+			}
+
+			case 'q':
+			{
+				log_set_level(LOG_ERROR);
+				break;
+			}
+
+			case 'h':
+			{
+				commandline_help(stderr);
+				exit(EXIT_CODE_QUIT);
+				break;
+			}
+		}
+	}
+
+	if (IS_EMPTY_STRING_BUFFER(options.origin))
+	{
+		strlcpy(options.origin, REPLICATION_ORIGIN, sizeof(options.origin));
+	}
+
+	/* publish our option parsing in the global variable */
+	streamDBoptions = options;
+
+	return optind;
+}
+
+
+/*
+ * cli_stream_bench replays a directory of captured JSON segment files, the
+ * format written by `pgcopydb stream receive`, through the transform stage,
+ * and through the apply stage when --target has been used, then reports the
+ * messages/sec and statements/sec achieved by each stage.
+ */
+static void
+cli_stream_bench(int argc, char **argv)
+{
+	CopyDataSpec copySpecs = { 0 };
+
+	if (argc != 1)
+	{
+		log_fatal("Please provide a directory of JSON segment files");
+		commandline_help(stderr);
+
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	char *jsondir = argv[0];
+
+	if (!directory_exists(jsondir))
+	{
+		log_fatal("Directory \"%s\" does not exists", jsondir);
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	struct dirent **namelist = NULL;
+	int entries = scandir(jsondir, &namelist, NULL, alphasort);
+
+	if (entries < 0)
+	{
+		log_fatal("Failed to scan directory \"%s\": %m", jsondir);
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	(void) find_pg_commands(&(copySpecs.pgPaths));
+
+	bool auxilliary = false;
+	bool createWorkDir = true;
+
+	if (!copydb_init_workdir(&copySpecs,
+							 streamDBoptions.dir,
+							 streamDBoptions.restart,
+							 streamDBoptions.resume,
+							 createWorkDir,
+							 auxilliary))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	char (*sqlFileNames)[MAXPGPATH] =
+		calloc(STREAM_BENCH_MAX_FILES, MAXPGPATH);
+	int sqlFileCount = 0;
+
+	if (sqlFileNames == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		exit(EXIT_CODE_INTERNAL_ERROR);
+	}
+
+	uint64_t totalMessages = 0;
+	uint64_t totalStatements = 0;
+
+	/*
+	 * First stage: transform every JSON segment file into its SQL
+	 * counterpart, written in our own work directory.
+	 */
+	instr_time transformDuration;
+
+	INSTR_TIME_SET_ZERO(transformDuration);
+
+	for (int i = 0; i < entries; i++)
+	{
+		char *name = namelist[i]->d_name;
+		int len = strlen(name);
+
+		if (len <= 5 || !streq(name + len - 5, ".json"))
+		{
+			continue;
+		}
+
+		if (sqlFileCount == STREAM_BENCH_MAX_FILES)
+		{
+			log_fatal("Failed to replay more than %d segment files",
+					  STREAM_BENCH_MAX_FILES);
+			exit(EXIT_CODE_BAD_ARGS);
+		}
+
+		char jsonFileName[MAXPGPATH] = { 0 };
+		char *sqlFileName = sqlFileNames[sqlFileCount++];
+
+		sformat(jsonFileName, sizeof(jsonFileName), "%s/%s", jsondir, name);
+		sformat(sqlFileName, MAXPGPATH, "%s/%.*s.sql",
+				copySpecs.cfPaths.cdc.dir,
+				len - 5,
+				name);
+
+		uint64_t messages = 0;
+
+		if (!stream_bench_count_lines(jsonFileName, &messages))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		totalMessages += messages;
+
+		instr_time start;
+
+		INSTR_TIME_SET_CURRENT(start);
+
+		if (!stream_transform_file(jsonFileName, sqlFileName))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		instr_time elapsed;
+
+		INSTR_TIME_SET_CURRENT(elapsed);
+		INSTR_TIME_SUBTRACT(elapsed, start);
+		INSTR_TIME_ADD(transformDuration, elapsed);
+	}
+
+	for (int i = 0; i < entries; i++)
+	{
+		free(namelist[i]);
+	}
+	free(namelist);
+
+	if (sqlFileCount == 0)
+	{
+		log_fatal("Failed to find JSON segment files in \"%s\"", jsondir);
+		exit(EXIT_CODE_BAD_ARGS);
+	}
+
+	uint64_t transformMs = INSTR_TIME_GET_MILLISEC(transformDuration);
+
+	log_info("Transformed %lld messages from %d files in %lldms",
+			 (long long) totalMessages,
+			 sqlFileCount,
+			 (long long) transformMs);
+
+	fformat(stdout, "%12s | %12s | %12s\n", "stage", "events", "events/s");
+	fformat(stdout, "%12s-+-%12s-+-%12s\n",
+			"------------", "------------", "------------");
+	fformat(stdout, "%12s | %12lld | %12lld\n",
+			"transform",
+			(long long) totalMessages,
+			(long long) (transformMs > 0
+						 ? totalMessages * 1000 / transformMs
+						 : 0));
+
+	/*
+	 * Second stage: apply the SQL files to the throwaway target database,
+	 * when one has been provided with --target.
+	 */
+	if (IS_EMPTY_STRING_BUFFER(streamDBoptions.target_pguri))
+	{
+		log_info("Skipping the apply stage: --target has not been used");
+		free(sqlFileNames);
+		return;
+	}
+
+	PGSQL dst = { 0 };
+	uint32_t originOid = 0;
+
+	if (!pgsql_init(&dst, streamDBoptions.target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_TARGET);
+	}
+
+	if (!pgsql_replication_origin_oid(&dst,
+									  streamDBoptions.origin,
+									  &originOid))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_TARGET);
+	}
+
+	/* a throwaway target is not expected to have been setup already */
+	if (originOid == 0 &&
+		!pgsql_replication_origin_create(&dst, streamDBoptions.origin))
+	{
+		/* errors have already been logged */
+		exit(EXIT_CODE_TARGET);
+	}
+
+	(void) pgsql_finish(&dst);
+
+	StreamApplyContext context = { 0 };
+
+	strlcpy(context.targetSessionGucs,
+			streamDBoptions.targetSessionGucs,
+			sizeof(context.targetSessionGucs));
+
+	if (!setupReplicationOrigin(&context,
+								&(copySpecs.cfPaths.cdc),
+								streamDBoptions.source_pguri,
+								streamDBoptions.target_pguri,
+								streamDBoptions.origin,
+								streamDBoptions.endpos,
+								true))
+	{
+		log_error("Failed to setup replication origin on the target database");
+		exit(EXIT_CODE_TARGET);
+	}
+
+	instr_time applyDuration;
+
+	INSTR_TIME_SET_ZERO(applyDuration);
+
+	for (int i = 0; i < sqlFileCount; i++)
+	{
+		uint64_t statements = 0;
+
+		if (!stream_bench_count_lines(sqlFileNames[i], &statements))
+		{
+			/* errors have already been logged */
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		totalStatements += statements;
+
+		strlcpy(context.sqlFileName,
+				sqlFileNames[i],
+				sizeof(context.sqlFileName));
+
+		instr_time start;
+
+		INSTR_TIME_SET_CURRENT(start);
+
+		if (!stream_apply_file(&context))
+		{
+			/* errors have already been logged */
+			pgsql_finish(&(context.pgsql));
+			exit(EXIT_CODE_INTERNAL_ERROR);
+		}
+
+		instr_time elapsed;
+
+		INSTR_TIME_SET_CURRENT(elapsed);
+		INSTR_TIME_SUBTRACT(elapsed, start);
+		INSTR_TIME_ADD(applyDuration, elapsed);
+	}
+
+	pgsql_finish(&(context.pgsql));
+	free(sqlFileNames);
+
+	uint64_t applyMs = INSTR_TIME_GET_MILLISEC(applyDuration);
+
+	log_info("Applied %lld statements from %d files in %lldms",
+			 (long long) totalStatements,
+			 sqlFileCount,
+			 (long long) applyMs);
+
+	fformat(stdout, "%12s | %12lld | %12lld\n",
+			"apply",
+			(long long) totalStatements,
+			(long long) (applyMs > 0
+						 ? totalStatements * 1000 / applyMs
+						 : 0));
+}
+
+
+/*
+ * stream_bench_count_lines counts the lines of the given file, each line of a
+ * JSON segment file is a message and each line of a SQL file is a statement.
+ */
+static bool
+stream_bench_count_lines(const char *filename, uint64_t *count)
+{
+	char *contents = NULL;
+	long size = 0L;
+	bool mapped = false;
+
+	if (!read_file_mmap(filename, &contents, &size, &mapped))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	*count = countLines(contents);
+
+	if (mapped)
+	{
+		(void) unmap_file(contents, size);
+	}
+	else
+	{
+		free(contents);
+	}
+
+	return true;
+}
@@ -0,0 +1,466 @@
+/*
+ * src/bin/pgcopydb/compare.c
+ *     Implementation of the data validation parts of pgcopydb, where
+ *     per-table content checksums are computed on both the source and the
+ *     target databases and then compared.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "portability/instr_time.h"
+
+#include "copydb.h"
+#include "env_utils.h"
+#include "lock_utils.h"
+#include "log.h"
+#include "metrics.h"
+#include "schema.h"
+#include "signals.h"
+#include "string_utils.h"
+#include "summary.h"
+
+/* a per-table content checksum, as computed on one side of the copy */
+typedef struct TableChecksum
+{
+	uint64_t rows;
+	int64_t checksum;
+} TableChecksum;
+
+typedef struct TableChecksumContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	TableChecksum *sum;
+	bool parsedOk;
+} TableChecksumContext;
+
+static bool compare_data_start_workers(CopyDataSpec *specs);
+static bool compare_data_worker(CopyDataSpec *specs);
+static bool compare_data_send_stop(CopyDataSpec *specs);
+static bool compare_data_table_by_oid(CopyDataSpec *specs,
+									  PGSQL *dst,
+									  uint32_t oid);
+static bool compare_table_checksum(PGSQL *pgsql,
+								   SourceTable *table,
+								   TableChecksum *sum);
+static void parseTableChecksum(void *ctx, PGresult *result);
+
+
+/*
+ * compare_data fetches the per-table content checksums concurrently on the
+ * source and target databases, using as many worker processes as the
+ * --table-jobs setting, and reports the tables which checksums do not match.
+ */
+bool
+compare_data(CopyDataSpec *specs)
+{
+	SourceTableArray *tableArray = &(specs->sourceTableArray);
+
+	/* create the compare process queue */
+	int capacity = 0;
+
+	if (!queue_create(&(specs->compareQueue), capacity))
+	{
+		log_error("Failed to create the compare process queue");
+		return false;
+	}
+
+	log_info("Comparing data for %d tables with %d worker processes",
+			 tableArray->count,
+			 specs->tableJobs);
+
+	if (!compare_data_start_workers(specs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	int errors = 0;
+
+	for (int i = 0; i < tableArray->count; i++)
+	{
+		SourceTable *source = &(tableArray->array[i]);
+
+		if (source->excludeData)
+		{
+			continue;
+		}
+
+		QMessage mesg = {
+			.type = QMSG_TYPE_TABLEOID,
+			.data.oid = source->oid
+		};
+
+		if (!queue_send(&(specs->compareQueue), &mesg))
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (!compare_data_send_stop(specs))
+	{
+		/* errors have already been logged */
+		++errors;
+	}
+
+	/* a mismatched table makes its worker exit with a non-zero code */
+	if (!copydb_wait_for_subprocesses())
+	{
+		log_error("Some tables failed the checksum comparison, "
+				  "see above for details");
+		++errors;
+	}
+
+	if (!queue_unlink(&(specs->compareQueue)))
+	{
+		/* errors have already been logged */
+		++errors;
+	}
+
+	return errors == 0;
+}
+
+
+/*
+ * compare_data_start_workers creates as many sub-process as needed, per
+ * --table-jobs.
+ */
+static bool
+compare_data_start_workers(CopyDataSpec *specs)
+{
+	for (int i = 0; i < specs->tableJobs; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork a worker process: %m");
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				if (!compare_data_worker(specs))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * compare_data_worker is a worker process that loops over messages received
+ * from a queue, each message being the Oid of a table which contents to
+ * checksum on both the source and the target databases.
+ */
+static bool
+compare_data_worker(CopyDataSpec *specs)
+{
+	int errors = 0;
+	bool stop = false;
+
+	log_notice("Started compare worker %d [%d]", getpid(), getppid());
+
+	/* connect once to the source database for the whole process */
+	if (!copydb_set_snapshot(specs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* also connect once to the target database for the whole process */
+	PGSQL dst = { 0 };
+
+	if (!pgsql_init(&dst, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	dst.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	while (!stop)
+	{
+		QMessage mesg = { 0 };
+
+		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
+		{
+			return false;
+		}
+
+		if (!queue_receive(&(specs->compareQueue), &mesg))
+		{
+			/* errors have already been logged */
+			break;
+		}
+
+		switch (mesg.type)
+		{
+			case QMSG_TYPE_STOP:
+			{
+				stop = true;
+				log_debug("Stop message received by compare worker");
+				break;
+			}
+
+			case QMSG_TYPE_TABLEOID:
+			{
+				if (!compare_data_table_by_oid(specs, &dst, mesg.data.oid))
+				{
+					++errors;
+				}
+				break;
+			}
+
+			default:
+			{
+				log_error("Received unknown message type %ld "
+						  "on compare queue %d",
+						  mesg.type,
+						  specs->compareQueue.qId);
+				break;
+			}
+		}
+	}
+
+	(void) pgsql_finish(&dst);
+	(void) copydb_close_snapshot(specs);
+
+	return stop == true && errors == 0;
+}
+
+
+/*
+ * compare_data_send_stop sends the STOP message to the compare workers.
+ *
+ * Each worker will consume one STOP message before stopping, so we need to
+ * send as many STOP messages as we have started worker processes.
+ */
+static bool
+compare_data_send_stop(CopyDataSpec *specs)
+{
+	for (int i = 0; i < specs->tableJobs; i++)
+	{
+		QMessage stop = { .type = QMSG_TYPE_STOP };
+
+		log_debug("Send STOP message to compare queue %d",
+				  specs->compareQueue.qId);
+
+		if (!queue_send(&(specs->compareQueue), &stop))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * compare_data_table_by_oid computes the content checksum of the given table
+ * on both the source and the target databases, and compares them.
+ */
+static bool
+compare_data_table_by_oid(CopyDataSpec *specs, PGSQL *dst, uint32_t oid)
+{
+	PGSQL *src = &(specs->sourceSnapshot.pgsql);
+
+	SourceTable *table = NULL;
+
+	HASH_FIND(hh, specs->sourceTableHashByOid, &oid, sizeof(oid), table);
+
+	if (table == NULL)
+	{
+		log_error("Failed to find table %u in sourceTableHashByOid", oid);
+		return false;
+	}
+
+	TableChecksum srcSum = { 0 };
+	TableChecksum dstSum = { 0 };
+
+	instr_time startTime;
+
+	INSTR_TIME_SET_CURRENT(startTime);
+
+	if (!compare_table_checksum(src, table, &srcSum))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!compare_table_checksum(dst, table, &dstSum))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	instr_time duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, startTime);
+
+	uint64_t durationMs = INSTR_TIME_GET_MILLISEC(duration);
+
+	(void) metrics_emit(specs->cfPaths.metricsfile,
+						"compare", oid, srcSum.rows, durationMs);
+
+	if (srcSum.rows != dstSum.rows || srcSum.checksum != dstSum.checksum)
+	{
+		log_error("Table \"%s\".\"%s\" fails the checksum comparison: "
+				  "source has %lld rows with checksum %llx, "
+				  "target has %lld rows with checksum %llx",
+				  table->nspname,
+				  table->relname,
+				  (long long) srcSum.rows,
+				  (long long unsigned) srcSum.checksum,
+				  (long long) dstSum.rows,
+				  (long long unsigned) dstSum.checksum);
+		return false;
+	}
+
+	log_notice("Table \"%s\".\"%s\" passes the checksum comparison: "
+			   "%lld rows with checksum %llx, in %lldms",
+			   table->nspname,
+			   table->relname,
+			   (long long) srcSum.rows,
+			   (long long unsigned) srcSum.checksum,
+			   (long long) durationMs);
+
+	return true;
+}
+
+
+/*
+ * compare_table_checksum computes the content checksum of the given table on
+ * the given Postgres connection, as the sum of the per-row hashes. The sum is
+ * order independent, so the checksum does not depend on the physical layout
+ * of the rows, which of course differs between the source and the target.
+ *
+ * When the table has been partitioned for the COPY (--split-tables-larger
+ * than), the checksum is computed one partition range at a time, keeping
+ * every single query short enough that it can be cancelled without losing
+ * hours of work.
+ */
+static bool
+compare_table_checksum(PGSQL *pgsql, SourceTable *table, TableChecksum *sum)
+{
+	char *sqlTemplate =
+		"select count(1), "
+		"       coalesce(sum(hashtext(t::text)::bigint), 0) "
+		"  from only \"%s\".\"%s\" t%s";
+
+	int partCount = table->partsArray.count;
+	int queryCount = partCount >= 1 ? partCount : 1;
+
+	for (int partNumber = 0; partNumber < queryCount; partNumber++)
+	{
+		char where[BUFSIZE] = { 0 };
+
+		if (partCount >= 1)
+		{
+			SourceTableParts *part = &(table->partsArray.array[partNumber]);
+
+			/* see schema_list_partitions: boundaries are non overlapping */
+			sformat(where, sizeof(where),
+					" where \"%s\" between %lld and %lld",
+					table->partKey,
+					(long long) part->min,
+					(long long) part->max);
+		}
+
+		char sql[BUFSIZE] = { 0 };
+
+		sformat(sql, sizeof(sql), sqlTemplate,
+				table->nspname, table->relname, where);
+
+		TableChecksum partSum = { 0 };
+		TableChecksumContext parseContext = { { 0 }, &partSum, false };
+
+		if (!pgsql_execute_with_params(pgsql, sql, 0, NULL, NULL,
+									   &parseContext, &parseTableChecksum))
+		{
+			log_error("Failed to compute checksum for table \"%s\".\"%s\"",
+					  table->nspname, table->relname);
+			return false;
+		}
+
+		if (!parseContext.parsedOk)
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		sum->rows += partSum.rows;
+		sum->checksum += partSum.checksum;
+	}
+
+	return true;
+}
+
+
+/*
+ * parseTableChecksum parses the result of the checksum query, a single row
+ * with the row count and the sum of the per-row hashes.
+ */
+static void
+parseTableChecksum(void *ctx, PGresult *result)
+{
+	TableChecksumContext *context = (TableChecksumContext *) ctx;
+
+	if (PQntuples(result) != 1 || PQnfields(result) != 2)
+	{
+		log_error("Query returned %d rows and %d columns, "
+				  "expected 1 row of 2 columns",
+				  PQntuples(result),
+				  PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	char *value = PQgetvalue(result, 0, 0);
+
+	if (!stringToUInt64(value, &(context->sum->rows)))
+	{
+		log_error("Failed to parse row count \"%s\"", value);
+		context->parsedOk = false;
+		return;
+	}
+
+	value = PQgetvalue(result, 0, 1);
+
+	if (!stringToInt64(value, &(context->sum->checksum)))
+	{
+		log_error("Failed to parse checksum \"%s\"", value);
+		context->parsedOk = false;
+		return;
+	}
+
+	context->parsedOk = true;
+}
@@ -0,0 +1,276 @@
+/*
+ * src/bin/pgcopydb/coordination.c
+ *     Implementation of the cross-host coordination parts of pgcopydb, used
+ *     in --distributed mode where several pgcopydb hosts share the work.
+ *
+ * The local coordination of the worker processes is file and shared-memory
+ * based and does not reach across hosts. In --distributed mode the claims on
+ * the tables (or table parts) are registered in a small table on the target
+ * database instead, where the INSERT .. ON CONFLICT DO NOTHING atomicity
+ * guarantees that a single host wins each claim.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "copydb.h"
+#include "env_utils.h"
+#include "log.h"
+#include "pgsql.h"
+#include "signals.h"
+#include "string_utils.h"
+
+
+/*
+ * coordination_create_claims_table creates the pgcopydb.table_claims table
+ * on the target database, where every pgcopydb host of a distributed run
+ * registers its claims.
+ *
+ * The table is shared by all the hosts: only the first host of a --restart
+ * run resets it, the other hosts are expected to be started with --resume
+ * and re-use the claims already registered.
+ */
+bool
+coordination_create_claims_table(CopyDataSpec *specs)
+{
+	char *sql[] = {
+		"create schema if not exists pgcopydb",
+		"create table if not exists pgcopydb.table_claims"
+		"(oid oid not null, part integer not null, "
+		" hostname text, pid integer, "
+		" claimed_at timestamptz not null default now(), "
+		" done boolean not null default false, "
+		" primary key(oid, part))",
+		NULL
+	};
+
+	PGSQL pgsql = { 0 };
+
+	if (!pgsql_init(&pgsql, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!pgsql_begin(&pgsql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	for (int i = 0; sql[i] != NULL; i++)
+	{
+		log_info("%s", sql[i]);
+
+		if (!pgsql_execute(&pgsql, sql[i]))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/*
+	 * When --restart is used, drop the claims of the previous run. The other
+	 * hosts of the same run are expected to use --resume and keep them.
+	 */
+	if (specs->restart)
+	{
+		if (!pgsql_execute(&pgsql, "truncate pgcopydb.table_claims"))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	if (!pgsql_commit(&pgsql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * coordination_claim_table attempts to claim the given table (or table part)
+ * for the current host and process. The claim is won by inserting our row in
+ * pgcopydb.table_claims, and lost when another host has inserted its own row
+ * first, in which case *isDone says if that other host is already done with
+ * the table.
+ */
+bool
+coordination_claim_table(CopyDataSpec *specs,
+						 CopyTableDataSpec *tableSpecs,
+						 bool *claimed,
+						 bool *isDone)
+{
+	PGSQL pgsql = { 0 };
+
+	*claimed = false;
+	*isDone = false;
+
+	if (!pgsql_init(&pgsql, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	pgsql.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	char hostname[BUFSIZE] = { 0 };
+
+	if (gethostname(hostname, sizeof(hostname)) != 0)
+	{
+		log_warn("Failed to get local hostname: %m");
+		strlcpy(hostname, "unknown", sizeof(hostname));
+	}
+
+	char oid[INTSTRING_MAX_DIGITS] = { 0 };
+	char part[INTSTRING_MAX_DIGITS] = { 0 };
+	char pid[INTSTRING_MAX_DIGITS] = { 0 };
+
+	sformat(oid, sizeof(oid), "%u", tableSpecs->sourceTable->oid);
+	sformat(part, sizeof(part), "%d", tableSpecs->part.partNumber);
+	sformat(pid, sizeof(pid), "%d", getpid());
+
+	char *insert =
+		"insert into pgcopydb.table_claims(oid, part, hostname, pid) "
+		"values($1, $2, $3, $4) "
+		"on conflict do nothing "
+		"returning 1";
+
+	int paramCount = 4;
+	Oid paramTypes[4] = { OIDOID, INT4OID, TEXTOID, INT4OID };
+	const char *paramValues[4] = { oid, part, hostname, pid };
+
+	SingleValueResultContext context = { { 0 }, PGSQL_RESULT_INT, false };
+
+	if (!pgsql_execute_with_params(&pgsql, insert,
+								   paramCount, paramTypes, paramValues,
+								   &context, &parseSingleValueResult))
+	{
+		log_error("Failed to claim table %s in pgcopydb.table_claims",
+				  tableSpecs->qname);
+		(void) pgsql_finish(&pgsql);
+		return false;
+	}
+
+	if (context.ntuples == 1)
+	{
+		/* our insert won the claim */
+		*claimed = true;
+		(void) pgsql_finish(&pgsql);
+		return true;
+	}
+
+	/* another host claimed the table first, is it done already? */
+	char *select =
+		"select done from pgcopydb.table_claims where oid = $1 and part = $2";
+
+	SingleValueResultContext doneContext = { { 0 }, PGSQL_RESULT_BOOL, false };
+
+	if (!pgsql_execute_with_params(&pgsql, select,
+								   2, paramTypes, paramValues,
+								   &doneContext, &parseSingleValueResult))
+	{
+		log_error("Failed to fetch the claim for table %s "
+				  "from pgcopydb.table_claims",
+				  tableSpecs->qname);
+		(void) pgsql_finish(&pgsql);
+		return false;
+	}
+
+	*isDone = doneContext.parsedOk && doneContext.boolVal;
+
+	(void) pgsql_finish(&pgsql);
+
+	return true;
+}
+
+
+/*
+ * coordination_mark_table_as_done registers that the current host is done
+ * with the given table (or table part).
+ */
+bool
+coordination_mark_table_as_done(CopyDataSpec *specs,
+								CopyTableDataSpec *tableSpecs)
+{
+	PGSQL pgsql = { 0 };
+
+	if (!pgsql_init(&pgsql, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char oid[INTSTRING_MAX_DIGITS] = { 0 };
+	char part[INTSTRING_MAX_DIGITS] = { 0 };
+
+	sformat(oid, sizeof(oid), "%u", tableSpecs->sourceTable->oid);
+	sformat(part, sizeof(part), "%d", tableSpecs->part.partNumber);
+
+	char *update =
+		"update pgcopydb.table_claims set done = true "
+		" where oid = $1 and part = $2";
+
+	int paramCount = 2;
+	Oid paramTypes[2] = { OIDOID, INT4OID };
+	const char *paramValues[2] = { oid, part };
+
+	if (!pgsql_execute_with_params(&pgsql, update,
+								   paramCount, paramTypes, paramValues,
+								   NULL, NULL))
+	{
+		log_error("Failed to mark table %s as done in pgcopydb.table_claims",
+				  tableSpecs->qname);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * coordination_unclaim_table releases our claim on the given table (or table
+ * part), so that another host may retry it, typically after a COPY failure.
+ */
+bool
+coordination_unclaim_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
+{
+	PGSQL pgsql = { 0 };
+
+	if (!pgsql_init(&pgsql, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char oid[INTSTRING_MAX_DIGITS] = { 0 };
+	char part[INTSTRING_MAX_DIGITS] = { 0 };
+
+	sformat(oid, sizeof(oid), "%u", tableSpecs->sourceTable->oid);
+	sformat(part, sizeof(part), "%d", tableSpecs->part.partNumber);
+
+	char *delete =
+		"delete from pgcopydb.table_claims "
+		" where oid = $1 and part = $2 and not done";
+
+	int paramCount = 2;
+	Oid paramTypes[2] = { OIDOID, INT4OID };
+	const char *paramValues[2] = { oid, part };
+
+	if (!pgsql_execute_with_params(&pgsql, delete,
+								   paramCount, paramTypes, paramValues,
+								   NULL, NULL))
+	{
+		log_error("Failed to release the claim on table %s "
+				  "in pgcopydb.table_claims",
+				  tableSpecs->qname);
+		return false;
+	}
+
+	return true;
+}
@@ -216,10 +216,90 @@ copydb_init_workdir(CopyDataSpec *copySpecs,
 		}
 	}
 
+	/*
+	 * The main commands create the live progress counters shared memory
+	 * segment, the inspection commands attach the one from the main command
+	 * when it exists.
+	 */
+	if (createWorkDir)
+	{
+		if (!copydb_create_progress_counters(copySpecs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else
+	{
+		(void) copydb_attach_progress_counters(copySpecs);
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_create_progress_counters creates (or re-uses) the shared memory
+ * segment that holds the live progress counters. The segment is keyed to the
+ * work directory so that inspection commands such as `pgcopydb list
+ * progress` can attach the same segment from another process.
+ */
+bool
+copydb_create_progress_counters(CopyDataSpec *copySpecs)
+{
+	SharedMemSegment *segment = &(copySpecs->progressSegment);
+
+	if (!shmseg_create_keyed(segment,
+							 copySpecs->cfPaths.topdir,
+							 sizeof(CopyProgressCounters)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	copySpecs->progress = (CopyProgressCounters *) segment->ptr;
+
+	return true;
+}
+
+
+/*
+ * copydb_attach_progress_counters attaches the live progress counters shared
+ * memory segment created by the main pgcopydb command. Failing to find the
+ * segment is not an error, callers then fall back to scanning the work
+ * directory files.
+ */
+bool
+copydb_attach_progress_counters(CopyDataSpec *copySpecs)
+{
+	SharedMemSegment *segment = &(copySpecs->progressSegment);
+
+	if (!shmseg_attach_keyed(segment,
+							 copySpecs->cfPaths.topdir,
+							 sizeof(CopyProgressCounters)))
+	{
+		/* no live counters around, see log_debug for details */
+		return false;
+	}
+
+	copySpecs->progress = (CopyProgressCounters *) segment->ptr;
+
 	return true;
 }
 
 
+/*
+ * copydb_progress_add atomically adds given value to one of the live
+ * progress counters, which are updated concurrently by several worker
+ * processes and read by inspection commands.
+ */
+void
+copydb_progress_add(uint64_t *counter, uint64_t value)
+{
+	(void) __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+
 /*
  * copydb_inspect_workdir inspects the given target directory to see what work
  * has been tracked in there. From the doneFile(s) and the lockFile(s) that we
@@ -379,10 +459,19 @@ copydb_prepare_filepaths(CopyFilePaths *cfPaths, const char *dir, bool auxilliar
 	sformat(cfPaths->rundir, MAXPGPATH, "%s/run", cfPaths->topdir);
 	sformat(cfPaths->tbldir, MAXPGPATH, "%s/run/tables", cfPaths->topdir);
 	sformat(cfPaths->idxdir, MAXPGPATH, "%s/run/indexes", cfPaths->topdir);
+	sformat(cfPaths->summarylog, MAXPGPATH, "%s/run/summary.dat", cfPaths->topdir);
+	sformat(cfPaths->metricsfile, MAXPGPATH,
+			"%s/run/metrics.jsonl",
+			cfPaths->topdir);
 
 	/* prepare also the name of the schema file (JSON) */
 	sformat(cfPaths->schemafile, MAXPGPATH, "%s/schema.json", cfPaths->topdir);
 
+	/* and the name of the binary schema cache file, used with --resume */
+	sformat(cfPaths->schemacachefile, MAXPGPATH,
+			"%s/schema.cache",
+			cfPaths->topdir);
+
 	/* now prepare the done files */
 	struct pair
 	{
@@ -468,6 +557,9 @@ copydb_prepare_filepaths(CopyFilePaths *cfPaths, const char *dir, bool auxilliar
 			"%s/wal_segment_size",
 			cfPaths->cdc.dir);
 
+	/* the streaming processes emit samples to the shared metrics file */
+	strlcpy(cfPaths->cdc.metricsfile, cfPaths->metricsfile, MAXPGPATH);
+
 	return true;
 }
 
@@ -491,9 +583,15 @@ copydb_prepare_dump_paths(CopyFilePaths *cfPaths, DumpPaths *dumpPaths)
 	sformat(dumpPaths->postFilename, MAXPGPATH, "%s/%s",
 			cfPaths->schemadir, "post.dump");
 
+	sformat(dumpPaths->preTocFilename, MAXPGPATH, "%s/%s",
+			cfPaths->schemadir, "pre.toc");
+
 	sformat(dumpPaths->preListFilename, MAXPGPATH, "%s/%s",
 			cfPaths->schemadir, "pre.list");
 
+	sformat(dumpPaths->postTocFilename, MAXPGPATH, "%s/%s",
+			cfPaths->schemadir, "post.toc");
+
 	sformat(dumpPaths->postListFilename, MAXPGPATH, "%s/%s",
 			cfPaths->schemadir, "post.list");
 
@@ -590,9 +688,12 @@ copydb_init_specs(CopyDataSpec *specs,
 		.tableJobs = tableJobs,
 		.indexJobs = indexJobs,
 
-		/* at the moment we don't have --vacuumJobs separately */
+		/* --vacuum-jobs is not covered here, and defaults to --table-jobs */
 		.vacuumJobs = tableJobs,
 
+		/* --blob-jobs is not covered here either */
+		.blobJobs = DEFAULT_BLOB_JOBS,
+
 		.splitTablesLargerThan = splitTablesLargerThan,
 
 		.tableSemaphore = { 0 },
@@ -668,19 +769,32 @@ copydb_init_specs(CopyDataSpec *specs,
 	if (specs->section == DATA_SECTION_ALL ||
 		specs->section == DATA_SECTION_TABLE_DATA)
 	{
+		/*
+		 * The table count is not known yet at this point, ask for the
+		 * maximum queue capacity: senders block when a queue is full anyway.
+		 */
+		int capacity = 0;
+
 		/* create the VACUUM process queue */
-		if (!queue_create(&(specs->vacuumQueue)))
+		if (!queue_create(&(specs->vacuumQueue), capacity))
 		{
 			log_error("Failed to create the VACUUM process queue");
 			return false;
 		}
 
 		/* create the CREATE INDEX process queue */
-		if (!queue_create(&(specs->indexQueue)))
+		if (!queue_create(&(specs->indexQueue), capacity))
 		{
 			log_error("Failed to create the INDEX process queue");
 			return false;
 		}
+
+		/* create the ALTER TABLE ... ADD CONSTRAINT process queue */
+		if (!queue_create(&(specs->constraintQueue), capacity))
+		{
+			log_error("Failed to create the CONSTRAINTS process queue");
+			return false;
+		}
 	}
 
 	/* we only respect the --skip-blobs option in pgcopydb copy-db command */
@@ -816,6 +930,36 @@ copydb_init_table_specs(CopyTableDataSpec *tableSpecs,
 }
 
 
+/*
+ * copydb_init_table_specs_for_item builds the full CopyTableDataSpec for a
+ * given entry of the compact tableSpecsArray. The array only registers a
+ * SourceTable pointer and a part number per entry, so that the supervisor
+ * process does not have to materialize hundreds of thousands of multi-kB
+ * specs upfront: the worker that claims an entry builds its spec here.
+ */
+bool
+copydb_init_table_specs_for_item(CopyTableDataSpec *tableSpecs,
+								 CopyDataSpec *specs,
+								 int specIndex)
+{
+	CopyTableDataSpecItem *item = &(specs->tableSpecsArray.array[specIndex]);
+
+	if (!copydb_init_table_specs(tableSpecs,
+								 specs,
+								 item->sourceTable,
+								 item->partNumber))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* the spec index is the entry's slot in the shared state table */
+	tableSpecs->specIndex = specIndex;
+
+	return true;
+}
+
+
 /*
  * copydb_init_tablepaths computes the lockFile, doneFile, and idxListFile
  * pathnames for a given table oid and global cfPaths setup.
@@ -837,6 +981,10 @@ copydb_init_tablepaths(CopyFilePaths *cfPaths,
 			cfPaths->tbldir,
 			oid);
 
+	sformat(tablePaths->chkptFile, MAXPGPATH, "%s/%u.chkpt",
+			cfPaths->tbldir,
+			oid);
+
 	return true;
 }
 
@@ -889,6 +1037,12 @@ copydb_fatal_exit()
  * copydb_wait_for_subprocesses calls waitpid() until no child process is known
  * running. It also fetches the return code of all the sub-processes, and
  * returns true only when all the subprocesses have returned zero (success).
+ *
+ * The waitpid() call blocks until a child exits: the kernel wakes us up
+ * within milliseconds of the last child being done, where a polling loop
+ * would add its sleep delay to every phase transition. When a signal
+ * interrupts the wait, our signal handlers have already run, and we just
+ * call waitpid() again.
  */
 bool
 copydb_wait_for_subprocesses()
@@ -900,53 +1054,35 @@ copydb_wait_for_subprocesses()
 	{
 		int status;
 
-		/* ignore errors */
-		pid_t pid = waitpid(-1, &status, WNOHANG);
+		/* block until a child process has exited */
+		pid_t pid = waitpid(-1, &status, 0);
 
-		switch (pid)
+		if (pid == -1)
 		{
-			case -1:
+			if (errno == ECHILD)
 			{
-				if (errno == ECHILD)
-				{
-					/* no more childrens */
-					log_debug("copydb_wait_for_subprocesses: no more children");
-					return allReturnCodeAreZero;
-				}
-
-				pg_usleep(100 * 1000); /* 100 ms */
-				break;
+				/* no more childrens */
+				log_debug("copydb_wait_for_subprocesses: no more children");
+				return allReturnCodeAreZero;
 			}
 
-			case 0:
-			{
-				/*
-				 * We're using WNOHANG, 0 means there are no stopped or exited
-				 * children sleep for awhile and ask again later.
-				 */
-				pg_usleep(100 * 1000); /* 100 ms */
-				break;
-			}
+			/* the wait has been interrupted by a signal (EINTR), try again */
+			continue;
+		}
 
-			default:
-			{
-				int returnCode = WEXITSTATUS(status);
-
-				if (returnCode == 0)
-				{
-					log_debug("Sub-processes %d exited with code %d",
-							  pid, returnCode);
-				}
-				else
-				{
-					allReturnCodeAreZero = false;
-
-					log_error("Sub-processes %d exited with code %d",
-							  pid, returnCode);
-				}
-
-				break;
-			}
+		int returnCode = WEXITSTATUS(status);
+
+		if (returnCode == 0)
+		{
+			log_debug("Sub-processes %d exited with code %d",
+					  pid, returnCode);
+		}
+		else
+		{
+			allReturnCodeAreZero = false;
+
+			log_error("Sub-processes %d exited with code %d",
+					  pid, returnCode);
 		}
 	}
 
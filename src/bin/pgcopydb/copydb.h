@@ -101,6 +101,8 @@ typedef struct CopyTableDataSpec
 	CopyTableSummary *summary;
 	SourceIndexArray *indexArray;
 
+	int specIndex;              /* index in tableSpecsArray and tableState */
+
 	int tableJobs;
 	int indexJobs;
 	Semaphore *indexSemaphore;  /* pointer to the main specs semaphore */
@@ -114,13 +116,67 @@ typedef struct CopyTableDataSpec
 } CopyTableDataSpec;
 
 
+/*
+ * The tableSpecsArray has one entry per COPY source: each full table, and
+ * each table part when same-table concurrency is in use. A CopyTableDataSpec
+ * weighs several kilo-bytes of file paths and SQL buffers, which adds up to
+ * gigabytes of memory when cloning a database with hundreds of thousands of
+ * tables. The array only registers a compact record per entry, the process
+ * that works on an entry builds the full CopyTableDataSpec on-demand, see
+ * copydb_init_table_specs_for_item.
+ */
+typedef struct CopyTableDataSpecItem
+{
+	SourceTable *sourceTable;   /* entry in the specs' sourceTableArray */
+	int partNumber;
+} CopyTableDataSpecItem;
+
 typedef struct CopyTableDataSpecsArray
 {
 	int count;
-	CopyTableDataSpec *array;   /* malloc'ed area */
+	CopyTableDataSpecItem *array;   /* malloc'ed area */
 } CopyTableDataSpecsArray;
 
 
+/*
+ * In-run coordination between COPY worker processes uses a shared-memory
+ * state table with one entry per CopyTableDataSpec, guarded by the table
+ * semaphore, rather than one lock and one done file per table. The on-disk
+ * doneFiles are still written, as the durability snapshot used to resume an
+ * interrupted run.
+ */
+typedef enum
+{
+	TABLE_COPY_STATE_NOT_STARTED = 0,
+	TABLE_COPY_STATE_IN_PROGRESS,
+	TABLE_COPY_STATE_DONE
+} TableCopyState;
+
+typedef struct TableStateEntry
+{
+	uint32_t oid;
+	int partNumber;
+	pid_t pid;                  /* pid of the worker that claimed the entry */
+	TableCopyState state;
+} TableStateEntry;
+
+
+/*
+ * Live progress counters maintained by the worker processes in a shared
+ * memory segment keyed to the work directory, so that `pgcopydb list
+ * progress` can attach the segment from another process and report progress
+ * without scanning the work directory files.
+ */
+typedef struct CopyProgressCounters
+{
+	uint64_t tableDoneCount;
+	uint64_t tableBytesDone;
+	uint64_t indexDoneCount;
+	uint64_t constraintDoneCount;
+	uint64_t vacuumDoneCount;
+} CopyProgressCounters;
+
+
 /*
  * Build a hash-table of all the SQL level objects that we filter-out when
  * applying our filtering rules. We need to find those objects again when
@@ -179,33 +235,65 @@ typedef struct CopyDataSpec
 	char source_pguri[MAXCONNINFO];
 	char target_pguri[MAXCONNINFO];
 
+	/* --source-standby: spread the COPY read load over hot standbys */
+	int sourceStandbyCount;
+	char sourceStandbys[MAX_SOURCE_STANDBYS][MAXCONNINFO];
+
 	TransactionSnapshot sourceSnapshot;
 
+	/* per-process target connection, kept open for a worker's lifetime */
+	PGSQL targetConn;
+
 	CopyDataSection section;
 	RestoreOptions restoreOptions;
 	bool roles;
 	bool skipLargeObjects;
 	bool skipExtensions;
 	bool skipCollations;
+	bool useCopyBinary;
+	bool analyzeOnly;
+	bool estimateSizes;
+	bool dropIndexes;
+	bool incremental;
+	int vacuumIOBudget;
+
+	char targetSessionGucs[BUFSIZE];
 
 	bool restart;
 	bool resume;
 	bool consistent;
 
+	bool schemaCacheLoaded;     /* source schema read back from schema.cache */
+
 	bool follow;                /* pgcopydb fork --follow */
+	bool distributed;           /* several pgcopydb hosts share the work */
 
 	int tableJobs;
 	int indexJobs;
+	int indexJobsWhileCopy;     /* CREATE INDEX budget during the COPY phase */
 	int vacuumJobs;
+	int blobJobs;
 
 	uint64_t splitTablesLargerThan;
 	char splitTablesLargerThanPretty[NAMEDATALEN];
 
+	uint64_t indexMemory;       /* memory budget for all CREATE INDEX jobs */
+
 	Semaphore tableSemaphore;
 	Semaphore indexSemaphore;
 
+	SharedMemSegment tableStateSegment;
+	TableStateEntry *tableState; /* one entry per tableSpecsArray item */
+
+	SharedMemSegment progressSegment;
+	CopyProgressCounters *progress; /* live counters, see list progress */
+
 	Queue vacuumQueue;
 	Queue indexQueue;
+	Queue constraintQueue;
+	Queue compareQueue;
+
+	pid_t *indexWorkerPids;     /* malloc'ed area, used in the parent only */
 
 	DumpPaths dumpPaths;
 	SourceExtensionArray extensionArray;
@@ -251,6 +339,10 @@ bool copydb_prepare_filepaths(CopyFilePaths *cfPaths,
 							  bool auxilliary);
 bool copydb_inspect_workdir(CopyFilePaths *cfPaths, DirectoryState *dirState);
 
+bool copydb_create_progress_counters(CopyDataSpec *copySpecs);
+bool copydb_attach_progress_counters(CopyDataSpec *copySpecs);
+void copydb_progress_add(uint64_t *counter, uint64_t value);
+
 bool copydb_rmdir_or_mkdir(const char *dir, bool removeDir);
 bool copydb_prepare_dump_paths(CopyFilePaths *cfPaths, DumpPaths *dumpPaths);
 
@@ -277,6 +369,10 @@ bool copydb_init_table_specs(CopyTableDataSpec *tableSpecs,
 							 SourceTable *source,
 							 int partNumber);
 
+bool copydb_init_table_specs_for_item(CopyTableDataSpec *tableSpecs,
+									  CopyDataSpec *specs,
+									  int specIndex);
+
 bool copydb_init_tablepaths(CopyFilePaths *cfPaths,
 							TableFilePaths *tablePaths,
 							uint32_t oid);
@@ -294,6 +390,7 @@ bool copydb_wait_for_subprocesses(void);
 /* snapshot.c */
 bool copydb_copy_snapshot(CopyDataSpec *specs, TransactionSnapshot *snapshot);
 bool copydb_prepare_snapshot(CopyDataSpec *copySpecs);
+bool copydb_attach_snapshot_service(CopyDataSpec *copySpecs);
 bool copydb_set_snapshot(CopyDataSpec *copySpecs);
 bool copydb_close_snapshot(CopyDataSpec *copySpecs);
 
@@ -304,12 +401,22 @@ bool copydb_create_logical_replication_slot(CopyDataSpec *copySpecs,
 
 /* extensions.c */
 bool copydb_copy_extensions(CopyDataSpec *copySpecs, bool createExtensions);
+bool copydb_copy_extensions_worker(CopyDataSpec *copySpecs,
+								   int workerIndex,
+								   int nbWorkers);
 
 /* indexes.c */
 
 bool copydb_start_index_workers(CopyDataSpec *specs);
-bool copydb_index_worker(CopyDataSpec *specs);
+bool copydb_index_worker(CopyDataSpec *specs, int workerIndex);
+bool copydb_wait_for_index_workers(CopyDataSpec *specs);
 bool copydb_create_index_by_oid(CopyDataSpec *specs, uint32_t indexOid);
+bool copydb_index_steal_work(CopyDataSpec *specs, bool *helped);
+
+bool copydb_start_constraint_workers(CopyDataSpec *specs);
+bool copydb_constraint_worker(CopyDataSpec *specs);
+bool copydb_create_constraints_by_oid(CopyDataSpec *specs, uint32_t tableOid);
+bool copydb_constraint_workers_send_stop(CopyDataSpec *specs);
 
 bool copydb_add_table_indexes(CopyDataSpec *specs,
 							  CopyTableDataSpec *tableSpecs);
@@ -340,7 +447,7 @@ bool copydb_start_index_process(CopyDataSpec *specs,
 								SourceIndexArray *indexArray,
 								IndexFilePathsArray *indexPathsArray);
 
-bool copydb_create_index(const char *pguri,
+bool copydb_create_index(CopyDataSpec *specs,
 						 SourceIndex *index,
 						 IndexFilePaths *indexPaths,
 						 Semaphore *lockFileSemaphore,
@@ -401,6 +508,9 @@ bool copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql);
 bool copydb_prepare_index_specs(CopyDataSpec *specs, PGSQL *pgsql);
 bool copydb_fetch_filtered_oids(CopyDataSpec *specs, PGSQL *pgsql);
 
+bool copydb_schema_cache_read(CopyDataSpec *specs);
+bool copydb_schema_cache_write(CopyDataSpec *specs);
+
 char * copydb_ObjectKindToString(ObjectKind kind);
 
 /* table-data.c */
@@ -421,6 +531,9 @@ bool copydb_table_is_being_processed(CopyDataSpec *specs,
 bool copydb_mark_table_as_done(CopyDataSpec *specs,
 							   CopyTableDataSpec *tableSpecs);
 
+bool copydb_unclaim_table(CopyDataSpec *specs,
+						  CopyTableDataSpec *tableSpecs);
+
 bool copydb_table_parts_are_all_done(CopyDataSpec *specs,
 									 CopyTableDataSpec *tableSpecs,
 									 bool *allPartsDone,
@@ -429,14 +542,34 @@ bool copydb_table_parts_are_all_done(CopyDataSpec *specs,
 /* blobs.c */
 bool copydb_start_blob_process(CopyDataSpec *specs);
 bool copydb_copy_blobs(CopyDataSpec *specs);
+bool copydb_copy_blobs_worker(CopyDataSpec *specs, int workerIndex);
 
 /* vacuum.c */
 bool vacuum_start_workers(CopyDataSpec *specs);
 bool vacuum_worker(CopyDataSpec *specs);
 bool vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid);
+bool vacuum_steal_work(CopyDataSpec *specs, bool *helped);
 bool vacuum_add_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs);
 bool vacuum_send_stop(CopyDataSpec *specs);
 
+/* coordination.c */
+bool coordination_create_claims_table(CopyDataSpec *specs);
+bool coordination_claim_table(CopyDataSpec *specs,
+							  CopyTableDataSpec *tableSpecs,
+							  bool *claimed,
+							  bool *isDone);
+bool coordination_mark_table_as_done(CopyDataSpec *specs,
+									 CopyTableDataSpec *tableSpecs);
+bool coordination_unclaim_table(CopyDataSpec *specs,
+								CopyTableDataSpec *tableSpecs);
+
+/* incremental.c */
+bool incremental_prepare_table_state(CopyDataSpec *specs, PGSQL *src);
+bool incremental_register_table_state(CopyDataSpec *specs);
+
+/* compare.c */
+bool compare_data(CopyDataSpec *specs);
+
 /* summary.c */
 bool prepare_summary_table(Summary *summary, CopyDataSpec *specs);
 bool print_summary(Summary *summary, CopyDataSpec *specs);
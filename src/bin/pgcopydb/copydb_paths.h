@@ -52,6 +52,7 @@ typedef struct CDCPaths
 	char walsegsizefile[MAXPGPATH];   /* /tmp/pgcopydb/cdc/wal_segment_size */
 	char tlifile[MAXPGPATH];          /* /tmp/pgcopydb/cdc/tli */
 	char tlihistfile[MAXPGPATH];      /* /tmp/pgcopydb/cdc/tli.history */
+	char metricsfile[MAXPGPATH];      /* /tmp/pgcopydb/run/metrics.jsonl */
 } CDCPaths;
 
 /* maintain all the internal paths we need in one place */
@@ -62,9 +63,12 @@ typedef struct CopyFilePaths
 	char snfile[MAXPGPATH];           /* /tmp/pgcopydb/snapshot */
 	char schemadir[MAXPGPATH];        /* /tmp/pgcopydb/schema */
 	char schemafile[MAXPGPATH];       /* /tmp/pgcopydb/schema.json */
+	char schemacachefile[MAXPGPATH];  /* /tmp/pgcopydb/schema.cache */
 	char rundir[MAXPGPATH];           /* /tmp/pgcopydb/run */
 	char tbldir[MAXPGPATH];           /* /tmp/pgcopydb/run/tables */
 	char idxdir[MAXPGPATH];           /* /tmp/pgcopydb/run/indexes */
+	char summarylog[MAXPGPATH];       /* /tmp/pgcopydb/run/summary.dat */
+	char metricsfile[MAXPGPATH];      /* /tmp/pgcopydb/run/metrics.jsonl */
 
 	CDCPaths cdc;
 	CopyDoneFilePaths done;
@@ -78,10 +82,12 @@ typedef struct DumpPaths
 	char extnspFilename[MAXPGPATH];  /* pg_dump --schema-only -n ... */
 
 	char preFilename[MAXPGPATH];     /* pg_dump --section=pre-data */
-	char preListFilename[MAXPGPATH]; /* pg_restore --list */
+	char preTocFilename[MAXPGPATH];  /* pg_restore --list */
+	char preListFilename[MAXPGPATH]; /* edited, pg_restore --use-list */
 
 	char postFilename[MAXPGPATH];     /* pg_dump --section=post-data */
-	char postListFilename[MAXPGPATH]; /* pg_restore --list */
+	char postTocFilename[MAXPGPATH];  /* pg_restore --list */
+	char postListFilename[MAXPGPATH]; /* edited, pg_restore --use-list */
 } DumpPaths;
 
 
@@ -91,6 +97,7 @@ typedef struct TableFilePaths
 	char lockFile[MAXPGPATH];    /* table lock file */
 	char doneFile[MAXPGPATH];    /* table done file (summary) */
 	char idxListFile[MAXPGPATH]; /* index oids list file */
+	char chkptFile[MAXPGPATH];   /* COPY checkpoint ranges file */
 
 	char truncateDoneFile[MAXPGPATH];    /* table truncate done file */
 } TableFilePaths;
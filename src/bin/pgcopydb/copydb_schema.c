@@ -13,12 +13,42 @@
 #include "env_utils.h"
 #include "lock_utils.h"
 #include "log.h"
+#include "mem_utils.h"
 #include "pidfile.h"
 #include "schema.h"
 #include "signals.h"
 #include "string_utils.h"
 #include "summary.h"
 
+static int compareTableSpecs(const void *a, const void *b);
+
+static bool copydb_prepare_split_points(CopyDataSpec *specs,
+										PGSQL *pgsql,
+										SourceTable **tables,
+										int count);
+
+static bool copydb_split_points_worker(CopyDataSpec *specs,
+									   SourceTable **tables,
+									   int count,
+									   int workerIndex,
+									   int nbWorkers);
+
+static bool copydb_read_split_points_file(const char *filename,
+										  SourceTable **tables,
+										  int count);
+
+static bool cache_write_bytes(char **cur, char *end, void *data, size_t size);
+static bool cache_read_bytes(char **cur, char *end, void *dest, size_t size);
+
+/*
+ * The schema cache file format is a raw dump of our in-memory arrays, keyed by
+ * the snapshot the schema was fetched under. The magic spells "pgsc" and the
+ * version must be bumped every time the SourceTable, SourceIndex, or
+ * SourceSequence structures change.
+ */
+#define SCHEMA_CACHE_MAGIC 0x70677363
+#define SCHEMA_CACHE_VERSION 2
+
 
 /*
  * copydb_fetch_schema_and_prepare_specs fetches the list of tables from the
@@ -63,6 +93,20 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 		}
 	}
 
+	/*
+	 * When resuming, a previous run that re-uses the same exported snapshot
+	 * may have left a schema cache file behind: loading it skips the catalog
+	 * introspection queries entirely.
+	 */
+	if (specs->resume && specs->section == DATA_SECTION_ALL)
+	{
+		if (!copydb_schema_cache_read(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	/* first, are we doing extensions? */
 	if (specs->section == DATA_SECTION_ALL ||
 		specs->section == DATA_SECTION_EXTENSION)
@@ -106,8 +150,10 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 		 * In order to allow for users to prepare that table in advance, we do
 		 * not use a TEMP table here.
 		 */
-		if (!schema_prepare_pgcopydb_table_size(src,
+		if (!specs->schemaCacheLoaded &&
+			!schema_prepare_pgcopydb_table_size(src,
 												&(specs->filters),
+												specs->estimateSizes,
 												false, /* force */
 												&createdTableSizeTable))
 		{
@@ -120,6 +166,20 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 			/* errors have already been logged */
 			return false;
 		}
+
+		/*
+		 * In --incremental mode, compare the per-table modification evidence
+		 * with the state registered by the previous run and skip the COPY of
+		 * the tables that are unchanged on the source.
+		 */
+		if (specs->incremental)
+		{
+			if (!incremental_prepare_table_state(specs, src))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
 	}
 
 	/* fetch the list of all the indexes that are going to be created again */
@@ -151,6 +211,24 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 		return false;
 	}
 
+	/*
+	 * Now that the source schema is entirely known, cache it on-disk: when
+	 * resuming this operation we can then skip the catalog introspection
+	 * queries. The cache is just an optimisation, failing to write it is not
+	 * a reason to stop.
+	 */
+	if (specs->section == DATA_SECTION_ALL &&
+		!specs->schemaCacheLoaded &&
+		!IS_EMPTY_STRING_BUFFER(specs->sourceSnapshot.snapshot))
+	{
+		if (!copydb_schema_cache_write(specs))
+		{
+			log_warn("Failed to write schema cache file \"%s\", "
+					 "see above for details",
+					 specs->cfPaths.schemacachefile);
+		}
+	}
+
 	if (createdTableSizeTable)
 	{
 		if (!schema_drop_pgcopydb_table_size(src))
@@ -186,11 +264,18 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 	CopyTableDataSpecsArray *tableSpecsArray = &(specs->tableSpecsArray);
 
 	/*
-	 * Now get the list of the tables we want to COPY over.
+	 * Now get the list of the tables we want to COPY over, unless the schema
+	 * cache file has been loaded already.
 	 */
-	if (!schema_list_ordinary_tables(pgsql,
-									 &(specs->filters),
-									 tableArray))
+	if (specs->schemaCacheLoaded)
+	{
+		log_info("Re-using %d tables from schema cache file \"%s\"",
+				 tableArray->count,
+				 specs->cfPaths.schemacachefile);
+	}
+	else if (!schema_list_ordinary_tables(pgsql,
+										  &(specs->filters),
+										  tableArray))
 	{
 		/* errors have already been logged */
 		return false;
@@ -198,12 +283,91 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 
 	int copySpecsCount = 0;
 
+	/*
+	 * When --split-tables-larger-than is "auto", target roughly equal bytes
+	 * per COPY worker: split tables larger than the total amount of bytes to
+	 * copy divided by --table-jobs, with a floor to avoid splitting tables
+	 * into very small chunks. That way a clone of one giant table plus many
+	 * small ones uses all the workers instead of leaving most of them idle.
+	 */
+	if (specs->splitTablesLargerThan == SPLIT_TABLES_LARGER_THAN_AUTO)
+	{
+		uint64_t totalBytes = 0;
+
+		for (int tableIndex = 0; tableIndex < tableArray->count; tableIndex++)
+		{
+			totalBytes += tableArray->array[tableIndex].bytes;
+		}
+
+		uint64_t partSize = totalBytes / specs->tableJobs + 1;
+
+		if (partSize < (uint64_t) COPY_CHECKPOINT_SIZE)
+		{
+			partSize = (uint64_t) COPY_CHECKPOINT_SIZE;
+		}
+
+		specs->splitTablesLargerThan = partSize;
+
+		(void) pretty_print_bytes(specs->splitTablesLargerThanPretty,
+								  sizeof(specs->splitTablesLargerThanPretty),
+								  partSize);
+
+		log_info("Computed --split-tables-larger-than \"auto\" as %s, "
+				 "from %d tables and %d table jobs",
+				 specs->splitTablesLargerThanPretty,
+				 tableArray->count,
+				 specs->tableJobs);
+	}
+
 	if (specs->splitTablesLargerThan > 0)
 	{
 		log_info("Splitting source candidate tables larger than %s",
 				 specs->splitTablesLargerThanPretty);
 	}
 
+	/*
+	 * Compute the split points of the tables that qualify for same-table
+	 * concurrency before walking the array: when several tables qualify, the
+	 * per-table min/max scans are spread over a pool of worker processes. The
+	 * schema cache file already includes the COPY partitions.
+	 */
+	if (specs->splitTablesLargerThan > 0 && !specs->schemaCacheLoaded)
+	{
+		int qualifyingCount = 0;
+
+		SourceTable **qualifying =
+			(SourceTable **) calloc(tableArray->count, sizeof(SourceTable *));
+
+		if (qualifying == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return false;
+		}
+
+		for (int tableIndex = 0; tableIndex < tableArray->count; tableIndex++)
+		{
+			SourceTable *source = &(tableArray->array[tableIndex]);
+
+			if (specs->splitTablesLargerThan <= source->bytes &&
+				!IS_EMPTY_STRING_BUFFER(source->partKey))
+			{
+				qualifying[qualifyingCount++] = source;
+			}
+		}
+
+		if (!copydb_prepare_split_points(specs,
+										 pgsql,
+										 qualifying,
+										 qualifyingCount))
+		{
+			/* errors have already been logged */
+			free(qualifying);
+			return false;
+		}
+
+		free(qualifying);
+	}
+
 	/* prepare a SourceTable hash table, indexed by Oid */
 	SourceTable *sourceTableHashByOid = NULL;
 
@@ -240,14 +404,6 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 				continue;
 			}
 
-			if (!schema_list_partitions(pgsql,
-										source,
-										specs->splitTablesLargerThan))
-			{
-				/* errors have already been logged */
-				return false;
-			}
-
 			if (source->partsArray.count > 1)
 			{
 				log_info("Table \"%s\".\"%s\" is %s large, "
@@ -277,82 +433,554 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 	/* only use as many processes as required */
 	if (copySpecsCount < specs->tableJobs)
 	{
-		specs->tableJobs = copySpecsCount;
+		specs->tableJobs = copySpecsCount;
+	}
+
+	specs->tableSpecsArray.count = copySpecsCount;
+	specs->tableSpecsArray.array =
+		(CopyTableDataSpecItem *)
+		malloc(copySpecsCount * sizeof(CopyTableDataSpecItem));
+
+	if (specs->tableSpecsArray.array == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	uint64_t totalBytes = 0;
+	uint64_t totalTuples = 0;
+
+	/*
+	 * Register each COPY source we have: each full table and each table part
+	 * when partitionning/splitting is in use. The array entries are compact
+	 * on purpose, the full CopyTableDataSpec is only built on-demand by the
+	 * worker process that claims an entry.
+	 */
+	int specsIndex = 0;
+
+	for (int tableIndex = 0; tableIndex < tableArray->count; tableIndex++)
+	{
+		SourceTable *source = &(tableArray->array[tableIndex]);
+
+		int partCount = source->partsArray.count;
+
+		if (partCount <= 1)
+		{
+			CopyTableDataSpecItem *item = &(tableSpecsArray->array[specsIndex++]);
+
+			item->sourceTable = source;
+			item->partNumber = 0;
+		}
+		else
+		{
+			for (int partIndex = 0; partIndex < partCount; partIndex++)
+			{
+				CopyTableDataSpecItem *item =
+					&(tableSpecsArray->array[specsIndex++]);
+
+				item->sourceTable = source;
+				item->partNumber = partIndex;
+			}
+		}
+
+		totalBytes += source->bytes;
+		totalTuples += source->reltuples;
+	}
+
+	/*
+	 * COPY workers claim entries in array order: sort the specs array so that
+	 * the largest tables are processed first, and the whole-run wall clock
+	 * time is not hostage to a large table starting last. The SQL queries
+	 * already order tables by size, the explicit sort makes the scheduling
+	 * policy independent from the catalog queries (and from how NULL sizes
+	 * sort there).
+	 */
+	qsort(tableSpecsArray->array,
+		  tableSpecsArray->count,
+		  sizeof(CopyTableDataSpecItem),
+		  &compareTableSpecs);
+
+	char bytesPretty[BUFSIZE] = { 0 };
+	char relTuplesPretty[BUFSIZE] = { 0 };
+
+	(void) pretty_print_bytes(bytesPretty, BUFSIZE, totalBytes);
+	(void) pretty_print_count(relTuplesPretty, BUFSIZE, totalTuples);
+
+	log_info("Fetched information for %d tables, "
+			 "with an estimated total of %s tuples and %s",
+			 tableArray->count,
+			 relTuplesPretty,
+			 bytesPretty);
+
+	return true;
+}
+
+
+/*
+ * copydb_prepare_split_points computes the COPY partition boundaries of the
+ * given qualifying tables. When several tables qualify and several table jobs
+ * have been setup, the per-table min/max scans are spread over a pool of
+ * worker processes with a private source connection each, and the results are
+ * written to files in the run directory for the main process to read back.
+ */
+static bool
+copydb_prepare_split_points(CopyDataSpec *specs,
+							PGSQL *pgsql,
+							SourceTable **tables,
+							int count)
+{
+	if (count == 0)
+	{
+		return true;
+	}
+
+	/* no need for more workers than qualifying tables */
+	int nbWorkers = specs->tableJobs < count ? specs->tableJobs : count;
+
+	if (nbWorkers <= 1)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (!schema_list_partitions(pgsql,
+										tables[i],
+										specs->splitTablesLargerThan))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	log_info("Computing split points for %d tables in %d sub-processes",
+			 count,
+			 nbWorkers);
+
+	pid_t *pids = (pid_t *) calloc(nbWorkers, sizeof(pid_t));
+
+	if (pids == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int i = 0; i < nbWorkers; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork a split-point worker process: %m");
+				free(pids);
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				if (!copydb_split_points_worker(specs,
+												tables,
+												count,
+												i,
+												nbWorkers))
+				{
+					log_error("Failed to compute table split points, "
+							  "see above for details");
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				pids[i] = fpid;
+				break;
+			}
+		}
+	}
+
+	int errors = 0;
+
+	/* wait until all the split-point workers are done */
+	for (int i = 0; i < nbWorkers; i++)
+	{
+		int status = 0;
+
+		if (waitpid(pids[i], &status, 0) == -1)
+		{
+			log_error("Failed to wait for split-point worker %d: %m", pids[i]);
+			++errors;
+			continue;
+		}
+
+		if (WEXITSTATUS(status) != 0)
+		{
+			log_error("Split-point worker process %d exited with code %d",
+					  pids[i], WEXITSTATUS(status));
+			++errors;
+		}
+	}
+
+	free(pids);
+
+	if (errors > 0)
+	{
+		return false;
+	}
+
+	/* now read back the split points computed by the workers */
+	for (int i = 0; i < nbWorkers; i++)
+	{
+		char filename[MAXPGPATH] = { 0 };
+
+		sformat(filename, sizeof(filename), "%s/split.%d",
+				specs->cfPaths.rundir,
+				i);
+
+		if (!copydb_read_split_points_file(filename, tables, count))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		(void) unlink_file(filename);
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_split_points_worker computes the COPY partition boundaries of the
+ * tables that belong to the given worker's partition of the qualifying tables
+ * array, over a private source connection, and writes the boundaries to the
+ * worker's split file in the run directory.
+ */
+static bool
+copydb_split_points_worker(CopyDataSpec *specs,
+						   SourceTable **tables,
+						   int count,
+						   int workerIndex,
+						   int nbWorkers)
+{
+	log_notice("Started split-point worker %d/%d %d [%d]",
+			   workerIndex,
+			   nbWorkers,
+			   getpid(),
+			   getppid());
+
+	PGSQL *src = NULL;
+	PGSQL pgsql = { 0 };
+
+	TransactionSnapshot snapshot = { 0 };
+
+	if (specs->consistent)
+	{
+		/*
+		 * Each worker is a sub-process of its own and needs a private PGSQL
+		 * client connection instance that re-uses the already exported
+		 * snapshot.
+		 */
+		if (!copydb_copy_snapshot(specs, &snapshot))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		/* swap the new instance in place of the previous one */
+		specs->sourceSnapshot = snapshot;
+
+		src = &(specs->sourceSnapshot.pgsql);
+
+		if (!copydb_set_snapshot(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else
+	{
+		/*
+		 * In the context of --not-consistent we don't have an already
+		 * established snapshot to set nor a connection to piggyback onto, so
+		 * we have to initialize our client connection now.
+		 */
+		if (!pgsql_init(&pgsql, specs->source_pguri, PGSQL_CONN_SOURCE))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		src = &pgsql;
+
+		if (!pgsql_begin(src))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	PQExpBuffer contents = createPQExpBuffer();
+
+	if (contents == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		/* skip tables that belong to another worker in the pool */
+		if (i % nbWorkers != workerIndex)
+		{
+			continue;
+		}
+
+		SourceTable *table = tables[i];
+
+		if (!schema_list_partitions(src,
+									table,
+									specs->splitTablesLargerThan))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(contents);
+			return false;
+		}
+
+		for (int p = 0; p < table->partsArray.count; p++)
+		{
+			SourceTableParts *part = &(table->partsArray.array[p]);
+
+			appendPQExpBuffer(contents, "%u %d %d %lld %lld %lld\n",
+							  table->oid,
+							  part->partNumber,
+							  part->partCount,
+							  (long long) part->min,
+							  (long long) part->max,
+							  (long long) part->count);
+		}
+	}
+
+	if (PQExpBufferBroken(contents))
+	{
+		log_error("Failed to prepare split points file: out of memory");
+		destroyPQExpBuffer(contents);
+		return false;
+	}
+
+	/* if we opened a snapshot, now is the time to close it */
+	if (specs->consistent)
+	{
+		if (!copydb_close_snapshot(specs))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(contents);
+			return false;
+		}
+	}
+	else
+	{
+		if (!pgsql_commit(src))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(contents);
+			return false;
+		}
+	}
+
+	char filename[MAXPGPATH] = { 0 };
+
+	sformat(filename, sizeof(filename), "%s/split.%d",
+			specs->cfPaths.rundir,
+			workerIndex);
+
+	if (!write_file(contents->data, contents->len, filename))
+	{
+		/* errors have already been logged */
+		destroyPQExpBuffer(contents);
+		return false;
+	}
+
+	destroyPQExpBuffer(contents);
+
+	return true;
+}
+
+
+/*
+ * copydb_read_split_points_file reads the split points computed by a worker
+ * process and installs them in the partsArray of the matching source tables.
+ */
+static bool
+copydb_read_split_points_file(const char *filename,
+							  SourceTable **tables,
+							  int count)
+{
+	char *contents = NULL;
+	long size = 0L;
+
+	if (!read_file(filename, &contents, &size))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	int lineCount = countLines(contents);
+
+	char **lines = (char **) calloc(lineCount, sizeof(char *));
+
+	if (lines == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(contents);
+		return false;
 	}
 
-	specs->tableSpecsArray.count = copySpecsCount;
-	specs->tableSpecsArray.array =
-		(CopyTableDataSpec *) malloc(copySpecsCount * sizeof(CopyTableDataSpec));
-
-	uint64_t totalBytes = 0;
-	uint64_t totalTuples = 0;
+	lineCount = splitLines(contents, lines, lineCount);
 
 	/*
-	 * Prepare the copy specs for each COPY source we have: each full table and
-	 * each table part when partitionning/splitting is in use.
+	 * The partNumber is the 1-based ordinality from the partition listing
+	 * query, and the worker writes the parts of a given table in that order:
+	 * keep a per-table fill index to install the parts in array order.
 	 */
-	int specsIndex = 0;
-	CopyTableDataSpec *tableSpecs = &(tableSpecsArray->array[specsIndex]);
+	int *filled = (int *) calloc(count, sizeof(int));
 
-	for (int tableIndex = 0; tableIndex < tableArray->count; tableIndex++)
+	if (filled == NULL)
 	{
-		/* initialize our TableDataProcess entry now */
-		SourceTable *source = &(tableArray->array[tableIndex]);
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(lines);
+		free(contents);
+		return false;
+	}
 
-		/*
-		 * The CopyTableDataSpec structure has its own memory area for the
-		 * SourceTable entry, which is copied by the following function. This
-		 * means that 'SourceTableArray tableArray' is actually local memory.
-		 */
-		int partCount = source->partsArray.count;
+	for (int l = 0; l < lineCount; l++)
+	{
+		uint32_t oid = 0;
+		int partNumber = 0;
+		int partCount = 0;
+		long long min = 0LL;
+		long long max = 0LL;
+		long long partTupleCount = 0LL;
+
+		if (sscanf(lines[l], "%u %d %d %lld %lld %lld", /* IGNORE-BANNED */
+				   &oid, &partNumber, &partCount,
+				   &min, &max, &partTupleCount) != 6)
+		{
+			log_error("Failed to parse split points file \"%s\" line %d: \"%s\"",
+					  filename, l + 1, lines[l]);
+			free(filled);
+			free(lines);
+			free(contents);
+			return false;
+		}
 
-		if (partCount <= 1)
+		int tableIndex = -1;
+
+		for (int i = 0; i < count; i++)
 		{
-			if (!copydb_init_table_specs(tableSpecs, specs, source, 0))
+			if (tables[i]->oid == oid)
 			{
-				/* errors have already been logged */
-				return false;
+				tableIndex = i;
+				break;
 			}
+		}
 
-			tableSpecs = &(tableSpecsArray->array[++specsIndex]);
+		if (tableIndex == -1)
+		{
+			log_error("Failed to match oid %u from split points file \"%s\" "
+					  "with a qualifying source table",
+					  oid, filename);
+			free(filled);
+			free(lines);
+			free(contents);
+			return false;
 		}
-		else
+
+		SourceTable *table = tables[tableIndex];
+
+		if (table->partsArray.array == NULL)
 		{
-			for (int partIndex = 0; partIndex < partCount; partIndex++)
-			{
-				if (!copydb_init_table_specs(tableSpecs,
-											 specs,
-											 source,
-											 partIndex))
-				{
-					/* errors have already been logged */
-					return false;
-				}
+			table->partsArray.count = partCount;
+			table->partsArray.array =
+				(SourceTableParts *) calloc(partCount,
+											sizeof(SourceTableParts));
 
-				tableSpecs = &(tableSpecsArray->array[++specsIndex]);
+			if (table->partsArray.array == NULL)
+			{
+				log_error(ALLOCATION_FAILED_ERROR);
+				free(filled);
+				free(lines);
+				free(contents);
+				return false;
 			}
 		}
 
-		totalBytes += source->bytes;
-		totalTuples += source->reltuples;
-	}
+		if (filled[tableIndex] >= table->partsArray.count)
+		{
+			log_error("Failed to parse split points file \"%s\": table %u "
+					  "has more than %d parts",
+					  filename, oid, table->partsArray.count);
+			free(filled);
+			free(lines);
+			free(contents);
+			return false;
+		}
 
-	char bytesPretty[BUFSIZE] = { 0 };
-	char relTuplesPretty[BUFSIZE] = { 0 };
+		SourceTableParts *part =
+			&(table->partsArray.array[filled[tableIndex]++]);
 
-	(void) pretty_print_bytes(bytesPretty, BUFSIZE, totalBytes);
-	(void) pretty_print_count(relTuplesPretty, BUFSIZE, totalTuples);
+		part->partNumber = partNumber;
+		part->partCount = partCount;
+		part->min = (int64_t) min;
+		part->max = (int64_t) max;
+		part->count = (int64_t) partTupleCount;
+	}
 
-	log_info("Fetched information for %d tables, "
-			 "with an estimated total of %s tuples and %s",
-			 tableArray->count,
-			 relTuplesPretty,
-			 bytesPretty);
+	free(filled);
+	free(lines);
+	free(contents);
 
 	return true;
 }
 
 
+/*
+ * compareTableSpecs sorts the table specs array with the largest tables
+ * first, keeping the COPY partitions of a given table adjacent and in part
+ * order.
+ */
+static int
+compareTableSpecs(const void *a, const void *b)
+{
+	CopyTableDataSpecItem *lhs = (CopyTableDataSpecItem *) a;
+	CopyTableDataSpecItem *rhs = (CopyTableDataSpecItem *) b;
+
+	if (lhs->sourceTable->bytes != rhs->sourceTable->bytes)
+	{
+		return lhs->sourceTable->bytes < rhs->sourceTable->bytes ? 1 : -1;
+	}
+
+	if (lhs->sourceTable->oid != rhs->sourceTable->oid)
+	{
+		return lhs->sourceTable->oid < rhs->sourceTable->oid ? -1 : 1;
+	}
+
+	return lhs->partNumber - rhs->partNumber;
+}
+
+
 /*
  * copydb_prepare_index_specs fetches the list of indexes to create again on
  * the target database, and set our internal hash table entries with a
@@ -363,13 +991,22 @@ copydb_prepare_index_specs(CopyDataSpec *specs, PGSQL *pgsql)
 {
 	SourceIndexArray *indexArray = &(specs->sourceIndexArray);
 
-	if (!schema_list_all_indexes(pgsql, &(specs->filters), indexArray))
+	if (specs->schemaCacheLoaded)
 	{
-		/* errors have already been logged */
-		return false;
+		log_info("Re-using %d indexes from schema cache file \"%s\"",
+				 indexArray->count,
+				 specs->cfPaths.schemacachefile);
 	}
+	else
+	{
+		if (!schema_list_all_indexes(pgsql, &(specs->filters), indexArray))
+		{
+			/* errors have already been logged */
+			return false;
+		}
 
-	log_info("Fetched information for %d indexes", indexArray->count);
+		log_info("Fetched information for %d indexes", indexArray->count);
+	}
 
 	/*
 	 * Now build a SourceIndexList per table, when we retrieved both the table
@@ -412,8 +1049,9 @@ copydb_prepare_index_specs(CopyDataSpec *specs, PGSQL *pgsql)
 
 			if (table->firstIndex == NULL)
 			{
-				table->firstIndex =
-					(SourceIndexList *) calloc(1, sizeof(SourceIndexList));
+				table->firstIndex = (SourceIndexList *)
+									arena_alloc(&(indexArray->arena),
+												sizeof(SourceIndexList));
 
 				if (table->firstIndex == NULL)
 				{
@@ -430,8 +1068,9 @@ copydb_prepare_index_specs(CopyDataSpec *specs, PGSQL *pgsql)
 			{
 				SourceIndexList *current = table->lastIndex;
 
-				table->lastIndex =
-					(SourceIndexList *) calloc(1, sizeof(SourceIndexList));
+				table->lastIndex = (SourceIndexList *)
+								   arena_alloc(&(indexArray->arena),
+											   sizeof(SourceIndexList));
 
 				if (table->lastIndex == NULL)
 				{
@@ -648,30 +1287,15 @@ copydb_fetch_filtered_oids(CopyDataSpec *specs, PGSQL *pgsql)
 	}
 
 	/*
-	 * Now fetch the OIDs of tables, indexes, and sequences that we filter out.
+	 * Now fetch the OIDs of tables, indexes, and sequences that we filter
+	 * out, batching the four catalog queries in a single libpq pipeline.
 	 */
-	if (!schema_list_ordinary_tables(pgsql, filters, &tableArray))
-	{
-		/* errors have already been logged */
-		filters->type = type;
-		return false;
-	}
-
-	if (!schema_list_all_indexes(pgsql, filters, &indexArray))
-	{
-		/* errors have already been logged */
-		filters->type = type;
-		return false;
-	}
-
-	if (!schema_list_sequences(pgsql, filters, &sequenceArray))
-	{
-		/* errors have already been logged */
-		filters->type = type;
-		return false;
-	}
-
-	if (!schema_list_pg_depend(pgsql, filters, &dependArray))
+	if (!schema_list_filtered_objects(pgsql,
+									  filters,
+									  &tableArray,
+									  &indexArray,
+									  &sequenceArray,
+									  &dependArray))
 	{
 		/* errors have already been logged */
 		filters->type = type;
@@ -809,9 +1433,377 @@ copydb_fetch_filtered_oids(CopyDataSpec *specs, PGSQL *pgsql)
 	specs->hName = hName;
 
 	/* free dynamic memory that's not needed anymore */
-	free(tableArray.array);
-	free(indexArray.array);
-	free(sequenceArray.array);
+	arena_release(&(tableArray.arena));
+	arena_release(&(indexArray.arena));
+	arena_release(&(sequenceArray.arena));
+
+	return true;
+}
+
+
+/*
+ * copydb_schema_cache_write persists the source schema arrays (tables, their
+ * COPY partitions, indexes, and sequences) to a compact binary file in the
+ * work directory, keyed by the exported snapshot name.
+ *
+ * The structures are written as-is: embedded pointers (partsArray.array, the
+ * per-table index lists, the uthash handles) are meaningless on-disk and are
+ * re-initialized at read time.
+ */
+bool
+copydb_schema_cache_write(CopyDataSpec *specs)
+{
+	char *filename = specs->cfPaths.schemacachefile;
+
+	SourceTableArray *tableArray = &(specs->sourceTableArray);
+	SourceIndexArray *indexArray = &(specs->sourceIndexArray);
+	SourceSequenceArray *sequenceArray = &(specs->sequenceArray);
+
+	uint32_t magic = SCHEMA_CACHE_MAGIC;
+	uint32_t version = SCHEMA_CACHE_VERSION;
+
+	/* compute the on-disk size first, then fill-in a single buffer */
+	long size =
+		sizeof(magic) + sizeof(version) +
+		sizeof(specs->sourceSnapshot.snapshot) +
+		sizeof(int) + tableArray->count * sizeof(SourceTable) +
+		sizeof(int) + indexArray->count * sizeof(SourceIndex) +
+		sizeof(int) + sequenceArray->count * sizeof(SourceSequence);
+
+	for (int i = 0; i < tableArray->count; i++)
+	{
+		size += sizeof(int) +
+				tableArray->array[i].partsArray.count * sizeof(SourceTableParts);
+	}
+
+	char *contents = (char *) calloc(size, sizeof(char));
+
+	if (contents == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	char *cur = contents;
+	char *end = contents + size;
+
+	bool success =
+		cache_write_bytes(&cur, end, &magic, sizeof(magic)) &&
+		cache_write_bytes(&cur, end, &version, sizeof(version)) &&
+		cache_write_bytes(&cur, end,
+						  specs->sourceSnapshot.snapshot,
+						  sizeof(specs->sourceSnapshot.snapshot)) &&
+		cache_write_bytes(&cur, end,
+						  &(tableArray->count), sizeof(int)) &&
+		cache_write_bytes(&cur, end,
+						  tableArray->array,
+						  tableArray->count * sizeof(SourceTable));
+
+	/* each table is followed by its COPY partitions, when it has some */
+	for (int i = 0; success && i < tableArray->count; i++)
+	{
+		SourceTablePartsArray *parts = &(tableArray->array[i].partsArray);
+
+		success =
+			cache_write_bytes(&cur, end, &(parts->count), sizeof(int)) &&
+			cache_write_bytes(&cur, end,
+							  parts->array,
+							  parts->count * sizeof(SourceTableParts));
+	}
+
+	success = success &&
+			  cache_write_bytes(&cur, end,
+								&(indexArray->count), sizeof(int)) &&
+			  cache_write_bytes(&cur, end,
+								indexArray->array,
+								indexArray->count * sizeof(SourceIndex)) &&
+			  cache_write_bytes(&cur, end,
+								&(sequenceArray->count), sizeof(int)) &&
+			  cache_write_bytes(&cur, end,
+								sequenceArray->array,
+								sequenceArray->count * sizeof(SourceSequence));
+
+	if (!success || cur != end)
+	{
+		log_error("BUG: failed to serialize %ld bytes of schema cache", size);
+		free(contents);
+		return false;
+	}
+
+	if (!write_file(contents, size, filename))
+	{
+		/* errors have already been logged */
+		free(contents);
+		return false;
+	}
+
+	free(contents);
+
+	log_notice("Wrote schema cache file \"%s\" (%d tables, %d indexes, "
+			   "%d sequences)",
+			   filename,
+			   tableArray->count,
+			   indexArray->count,
+			   sequenceArray->count);
+
+	return true;
+}
+
+
+/*
+ * copydb_schema_cache_read loads the source schema arrays back from the schema
+ * cache file, when it exists and was written for the same snapshot we are
+ * re-using. The sequence last values are part of the cache: they were fetched
+ * under the very same snapshot, re-querying them would give the same values.
+ *
+ * A cache file that can't be parsed (or that belongs to another snapshot) is
+ * not an error, we then just fetch the source schema again.
+ */
+bool
+copydb_schema_cache_read(CopyDataSpec *specs)
+{
+	char *filename = specs->cfPaths.schemacachefile;
+
+	specs->schemaCacheLoaded = false;
+
+	if (IS_EMPTY_STRING_BUFFER(specs->sourceSnapshot.snapshot) ||
+		!file_exists(filename))
+	{
+		return true;
+	}
+
+	char *contents = NULL;
+	long size = 0L;
+
+	if (!read_file(filename, &contents, &size))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char *cur = contents;
+	char *end = contents + size;
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	char snapshot[BUFSIZE] = { 0 };
+
+	if (!cache_read_bytes(&cur, end, &magic, sizeof(magic)) ||
+		!cache_read_bytes(&cur, end, &version, sizeof(version)) ||
+		!cache_read_bytes(&cur, end, snapshot, sizeof(snapshot)) ||
+		magic != SCHEMA_CACHE_MAGIC ||
+		version != SCHEMA_CACHE_VERSION)
+	{
+		log_warn("Failed to parse schema cache file \"%s\", "
+				 "fetching the source schema again",
+				 filename);
+		free(contents);
+		return true;
+	}
+
+	if (!streq(snapshot, specs->sourceSnapshot.snapshot))
+	{
+		log_notice("Schema cache file \"%s\" was written for snapshot \"%s\", "
+				   "current snapshot is \"%s\": fetching the source schema again",
+				   filename,
+				   snapshot,
+				   specs->sourceSnapshot.snapshot);
+		free(contents);
+		return true;
+	}
+
+	SourceTableArray *tableArray = &(specs->sourceTableArray);
+	SourceIndexArray *indexArray = &(specs->sourceIndexArray);
+	SourceSequenceArray *sequenceArray = &(specs->sequenceArray);
+
+	bool success =
+		cache_read_bytes(&cur, end, &(tableArray->count), sizeof(int)) &&
+		tableArray->count >= 0;
+
+	if (success && tableArray->count > 0)
+	{
+		tableArray->array = (SourceTable *)
+							arena_alloc(&(tableArray->arena),
+										tableArray->count *
+										sizeof(SourceTable));
+
+		if (tableArray->array == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			free(contents);
+			return false;
+		}
+
+		success = cache_read_bytes(&cur, end,
+								   tableArray->array,
+								   tableArray->count * sizeof(SourceTable));
+	}
+
+	for (int i = 0; success && i < tableArray->count; i++)
+	{
+		SourceTable *table = &(tableArray->array[i]);
+		SourceTablePartsArray *parts = &(table->partsArray);
+
+		/* in-memory only pointers are not valid anymore, reset them */
+		table->firstIndex = NULL;
+		table->lastIndex = NULL;
+		memset(&(table->hh), 0, sizeof(table->hh));
+
+		parts->array = NULL;
+
+		success = cache_read_bytes(&cur, end, &(parts->count), sizeof(int)) &&
+				  parts->count >= 0;
+
+		if (success && parts->count > 0)
+		{
+			parts->array = (SourceTableParts *)
+						   calloc(parts->count, sizeof(SourceTableParts));
+
+			if (parts->array == NULL)
+			{
+				log_error(ALLOCATION_FAILED_ERROR);
+				free(contents);
+				return false;
+			}
+
+			success = cache_read_bytes(&cur, end,
+									   parts->array,
+									   parts->count *
+									   sizeof(SourceTableParts));
+		}
+	}
+
+	success = success &&
+			  cache_read_bytes(&cur, end, &(indexArray->count), sizeof(int)) &&
+			  indexArray->count >= 0;
+
+	if (success && indexArray->count > 0)
+	{
+		indexArray->array = (SourceIndex *)
+							arena_alloc(&(indexArray->arena),
+										indexArray->count *
+										sizeof(SourceIndex));
+
+		if (indexArray->array == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			free(contents);
+			return false;
+		}
+
+		success = cache_read_bytes(&cur, end,
+								   indexArray->array,
+								   indexArray->count * sizeof(SourceIndex));
+
+		for (int i = 0; success && i < indexArray->count; i++)
+		{
+			memset(&(indexArray->array[i].hh), 0,
+				   sizeof(indexArray->array[i].hh));
+		}
+	}
+
+	success = success &&
+			  cache_read_bytes(&cur, end,
+							   &(sequenceArray->count), sizeof(int)) &&
+			  sequenceArray->count >= 0;
+
+	if (success && sequenceArray->count > 0)
+	{
+		sequenceArray->array = (SourceSequence *)
+							   arena_alloc(&(sequenceArray->arena),
+										   sequenceArray->count *
+										   sizeof(SourceSequence));
+
+		if (sequenceArray->array == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			free(contents);
+			return false;
+		}
+
+		success = cache_read_bytes(&cur, end,
+								   sequenceArray->array,
+								   sequenceArray->count *
+								   sizeof(SourceSequence));
+	}
+
+	free(contents);
+
+	if (!success || cur != end)
+	{
+		log_warn("Failed to parse schema cache file \"%s\", "
+				 "fetching the source schema again",
+				 filename);
+
+		/* throw away whatever we read so far */
+		arena_release(&(tableArray->arena));
+		arena_release(&(indexArray->arena));
+		arena_release(&(sequenceArray->arena));
+
+		*tableArray = (SourceTableArray) { 0, NULL };
+		*indexArray = (SourceIndexArray) { 0, NULL };
+		*sequenceArray = (SourceSequenceArray) { 0, NULL };
+
+		return true;
+	}
+
+	specs->schemaCacheLoaded = true;
+
+	log_info("Loaded schema cache file \"%s\": %d tables, %d indexes, "
+			 "%d sequences",
+			 filename,
+			 tableArray->count,
+			 indexArray->count,
+			 sequenceArray->count);
+
+	return true;
+}
+
+
+/*
+ * cache_write_bytes copies the given bytes at the current cursor position and
+ * advances the cursor, refusing to write past the end of the buffer.
+ */
+static bool
+cache_write_bytes(char **cur, char *end, void *data, size_t size)
+{
+	if (size == 0)
+	{
+		return true;
+	}
+
+	if (*cur + size > end)
+	{
+		return false;
+	}
+
+	memcpy(*cur, data, size);
+	*cur += size;
+
+	return true;
+}
+
+
+/*
+ * cache_read_bytes copies the given number of bytes from the current cursor
+ * position and advances the cursor, refusing to read past the end of the
+ * buffer.
+ */
+static bool
+cache_read_bytes(char **cur, char *end, void *dest, size_t size)
+{
+	if (size == 0)
+	{
+		return true;
+	}
+
+	if (*cur + size > end)
+	{
+		return false;
+	}
+
+	memcpy(dest, *cur, size);
+	*cur += size;
 
 	return true;
 }
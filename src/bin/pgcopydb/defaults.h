@@ -29,16 +29,32 @@
 #define PGCOPYDB_TABLE_JOBS "PGCOPYDB_TABLE_JOBS"
 #define PGCOPYDB_INDEX_JOBS "PGCOPYDB_INDEX_JOBS"
 #define PGCOPYDB_SPLIT_TABLES_LARGER_THAN "PGCOPYDB_SPLIT_TABLES_LARGER_THAN"
+#define PGCOPYDB_INDEX_MEMORY "PGCOPYDB_INDEX_MEMORY"
+#define PGCOPYDB_VACUUM_JOBS "PGCOPYDB_VACUUM_JOBS"
+#define PGCOPYDB_BLOB_JOBS "PGCOPYDB_BLOB_JOBS"
+#define PGCOPYDB_RESTORE_JOBS "PGCOPYDB_RESTORE_JOBS"
+#define PGCOPYDB_COPY_BINARY "PGCOPYDB_COPY_BINARY"
 #define PGCOPYDB_DROP_IF_EXISTS "PGCOPYDB_DROP_IF_EXISTS"
 #define PGCOPYDB_SNAPSHOT "PGCOPYDB_SNAPSHOT"
 #define PGCOPYDB_OUTPUT_PLUGIN "PGCOPYDB_OUTPUT_PLUGIN"
+#define PGCOPYDB_COMPRESSION "PGCOPYDB_COMPRESSION"
+#define PGCOPYDB_TCP_RCVBUF "PGCOPYDB_TCP_RCVBUF"
+#define PGCOPYDB_TCP_SNDBUF "PGCOPYDB_TCP_SNDBUF"
+#define PGCOPYDB_TCP_NODELAY "PGCOPYDB_TCP_NODELAY"
 #define PGCOPYDB_PGAPPNAME "pgcopydb"
 
 /* default values for the command line options */
 #define DEFAULT_TABLE_JOBS 4
 #define DEFAULT_INDEX_JOBS 4
+#define DEFAULT_BLOB_JOBS 4
 #define DEFAULT_SPLIT_TABLES_LARGER_THAN 0 /* no COPY partitioning by default */
 
+/* --source-standby can be used up to that many times */
+#define MAX_SOURCE_STANDBYS 8
+
+/* --split-tables-larger-than auto: threshold computed from --table-jobs */
+#define SPLIT_TABLES_LARGER_THAN_AUTO ((uint64_t) -1)
+
 #define POSTGRES_CONNECT_TIMEOUT "10"
 
 
@@ -62,6 +78,27 @@
 /* internal default for allocating strings  */
 #define BUFSIZE 1024
 
+/*
+ * COPY buffers from the source are accumulated in large reusable chunks
+ * before being sent to the target, amortizing per-row costs in the COPY
+ * loop of pg_copy().
+ */
+#define COPY_CHUNK_SIZE (8 * 1024 * 1024)
+
+/*
+ * Large tables are copied in several ctid ranges of about that many bytes,
+ * each committed separately on the target, so that resuming an interrupted
+ * clone only has to COPY the missing ranges again.
+ */
+#define COPY_CHECKPOINT_SIZE ((int64_t) 1024 * 1024 * 1024)
+
+/*
+ * While the COPY phase is still running, tables larger than this are not
+ * vacuumed yet, so that VACUUM does not steal I/O bandwidth from the COPY
+ * processes; the large tables are vacuumed when the COPY phase is done.
+ */
+#define VACUUM_DEFER_LARGER_THAN ((int64_t) 1024 * 1024 * 1024)
+
 /*
  * 50kB seems enough to store the PATH environment variable if you have more,
  * simply set PATH to something smaller.
@@ -19,6 +19,11 @@
 #include "string_utils.h"
 #include "summary.h"
 
+static bool copydb_archive_checksum(const char *filename, uint32_t *checksum);
+static bool copydb_toc_cache_is_valid(const char *tocFilename,
+									  const char *sumFilename,
+									  uint32_t checksum);
+
 
 /*
  * copydb_objectid_has_been_processed_already returns true when a doneFile
@@ -39,70 +44,182 @@ copydb_objectid_has_been_processed_already(CopyDataSpec *specs, uint32_t oid)
 
 
 /*
- * copydb_dump_source_schema uses pg_dump -Fc --schema --section=pre-data or
- * --section=post-data to dump the source database schema to files.
+ * copydb_dump_section runs pg_dump for a single schema section (pre-data or
+ * post-data), skipping the work and keeping track of it with the section
+ * doneFile.
  */
-bool
-copydb_dump_source_schema(CopyDataSpec *specs,
-						  const char *snapshot,
-						  PostgresDumpSection section)
+static bool
+copydb_dump_section(CopyDataSpec *specs,
+					const char *snapshot,
+					PostgresDumpSection section)
 {
-	if (section == PG_DUMP_SECTION_SCHEMA ||
-		section == PG_DUMP_SECTION_PRE_DATA ||
-		section == PG_DUMP_SECTION_ALL)
+	char *sectionName = NULL;
+	char *dumpFilename = NULL;
+	char *doneFilename = NULL;
+
+	switch (section)
 	{
-		if (file_exists(specs->cfPaths.done.preDataDump))
+		case PG_DUMP_SECTION_PRE_DATA:
 		{
-			log_info("Skipping pg_dump --section=pre-data, "
-					 "as \"%s\" already exists",
-					 specs->cfPaths.done.preDataDump);
+			sectionName = "pre-data";
+			dumpFilename = specs->dumpPaths.preFilename;
+			doneFilename = specs->cfPaths.done.preDataDump;
+			break;
 		}
-		else if (!pg_dump_db(&(specs->pgPaths),
-							 specs->source_pguri,
-							 snapshot,
-							 "pre-data",
-							 specs->dumpPaths.preFilename))
+
+		case PG_DUMP_SECTION_POST_DATA:
 		{
-			/* errors have already been logged */
-			return false;
+			sectionName = "post-data";
+			dumpFilename = specs->dumpPaths.postFilename;
+			doneFilename = specs->cfPaths.done.postDataDump;
+			break;
 		}
 
-		/* now write the doneFile to keep track */
-		if (!write_file("", 0, specs->cfPaths.done.preDataDump))
+		default:
 		{
-			log_error("Failed to write the tracking file \%s\"",
-					  specs->cfPaths.done.preDataDump);
+			log_error("BUG: copydb_dump_section: unknown pg_dump section %d",
+					  section);
 			return false;
 		}
 	}
 
-	if (section == PG_DUMP_SECTION_SCHEMA ||
+	if (file_exists(doneFilename))
+	{
+		log_info("Skipping pg_dump --section=%s, as \"%s\" already exists",
+				 sectionName,
+				 doneFilename);
+	}
+	else if (!pg_dump_db(&(specs->pgPaths),
+						 specs->source_pguri,
+						 snapshot,
+						 sectionName,
+						 dumpFilename))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* now write the doneFile to keep track */
+	if (!write_file("", 0, doneFilename))
+	{
+		log_error("Failed to write the tracking file \%s\"", doneFilename);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_dump_source_schema uses pg_dump -Fc --schema --section=pre-data or
+ * --section=post-data to dump the source database schema to files.
+ *
+ * When both sections are wanted, the two pg_dump commands run concurrently:
+ * both are catalog-only reads sharing the same exported snapshot, and the
+ * schema dump time then is the max of the two instead of their sum.
+ */
+bool
+copydb_dump_source_schema(CopyDataSpec *specs,
+						  const char *snapshot,
+						  PostgresDumpSection section)
+{
+	bool dumpPreData =
+		section == PG_DUMP_SECTION_SCHEMA ||
+		section == PG_DUMP_SECTION_PRE_DATA ||
+		section == PG_DUMP_SECTION_ALL;
+
+	bool dumpPostData =
+		section == PG_DUMP_SECTION_SCHEMA ||
 		section == PG_DUMP_SECTION_POST_DATA ||
-		section == PG_DUMP_SECTION_ALL)
+		section == PG_DUMP_SECTION_ALL;
+
+	if (dumpPreData && dumpPostData)
 	{
-		if (file_exists(specs->cfPaths.done.postDataDump))
-		{
-			log_info("Skipping pg_dump --section=post-data, "
-					 "as \"%s\" already exists",
-					 specs->cfPaths.done.postDataDump);
-		}
-		else if (!pg_dump_db(&(specs->pgPaths),
-							 specs->source_pguri,
-							 snapshot,
-							 "post-data",
-							 specs->dumpPaths.postFilename))
+		PostgresDumpSection sections[] = {
+			PG_DUMP_SECTION_PRE_DATA,
+			PG_DUMP_SECTION_POST_DATA
+		};
+
+		int count = sizeof(sections) / sizeof(sections[0]);
+		pid_t pids[2] = { 0 };
+
+		for (int i = 0; i < count; i++)
 		{
-			/* errors have already been logged */
-			return false;
+			/*
+			 * Flush stdio channels just before fork, to avoid double-output
+			 * problems.
+			 */
+			fflush(stdout);
+			fflush(stderr);
+
+			int fpid = fork();
+
+			switch (fpid)
+			{
+				case -1:
+				{
+					log_error("Failed to fork a pg_dump process: %m");
+					return false;
+				}
+
+				case 0:
+				{
+					/* child process runs the command */
+					if (!copydb_dump_section(specs, snapshot, sections[i]))
+					{
+						/* errors have already been logged */
+						exit(EXIT_CODE_INTERNAL_ERROR);
+					}
+
+					exit(EXIT_CODE_QUIT);
+				}
+
+				default:
+				{
+					pids[i] = fpid;
+					break;
+				}
+			}
 		}
 
-		/* now write the doneFile to keep track */
-		if (!write_file("", 0, specs->cfPaths.done.postDataDump))
+		bool allDone = true;
+
+		for (int i = 0; i < count; i++)
 		{
-			log_error("Failed to write the tracking file \%s\"",
-					  specs->cfPaths.done.postDataDump);
-			return false;
+			int status = 0;
+
+			if (waitpid(pids[i], &status, 0) == -1)
+			{
+				log_error("Failed to wait for pg_dump process %d: %m",
+						  pids[i]);
+				allDone = false;
+				continue;
+			}
+
+			if (WEXITSTATUS(status) != 0)
+			{
+				log_error("pg_dump sub-process %d exited with code %d",
+						  pids[i],
+						  WEXITSTATUS(status));
+				allDone = false;
+			}
 		}
+
+		return allDone;
+	}
+
+	if (dumpPreData &&
+		!copydb_dump_section(specs, snapshot, PG_DUMP_SECTION_PRE_DATA))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (dumpPostData &&
+		!copydb_dump_section(specs, snapshot, PG_DUMP_SECTION_POST_DATA))
+	{
+		/* errors have already been logged */
+		return false;
 	}
 
 	return true;
@@ -153,11 +270,20 @@ copydb_target_prepare_schema(CopyDataSpec *specs)
 		}
 	}
 
+	/*
+	 * The pre-data section is quick to restore and benefits from the
+	 * all-or-nothing semantics of --single-transaction: keep --restore-jobs
+	 * parallelism for the post-data section, where ACLs, comments, and
+	 * REFRESH MATERIALIZED VIEW entries dominate.
+	 */
+	RestoreOptions preDataOptions = specs->restoreOptions;
+	preDataOptions.jobs = 0;
+
 	if (!pg_restore_db(&(specs->pgPaths),
 					   specs->target_pguri,
 					   specs->dumpPaths.preFilename,
 					   specs->dumpPaths.preListFilename,
-					   specs->restoreOptions))
+					   preDataOptions))
 	{
 		/* errors have already been logged */
 		return false;
@@ -297,6 +423,7 @@ bool
 copydb_write_restore_list(CopyDataSpec *specs, PostgresDumpSection section)
 {
 	char *dumpFilename = NULL;
+	char *tocFilename = NULL;
 	char *listFilename = NULL;
 
 	switch (section)
@@ -304,6 +431,7 @@ copydb_write_restore_list(CopyDataSpec *specs, PostgresDumpSection section)
 		case PG_DUMP_SECTION_PRE_DATA:
 		{
 			dumpFilename = specs->dumpPaths.preFilename;
+			tocFilename = specs->dumpPaths.preTocFilename;
 			listFilename = specs->dumpPaths.preListFilename;
 			break;
 		}
@@ -311,6 +439,7 @@ copydb_write_restore_list(CopyDataSpec *specs, PostgresDumpSection section)
 		case PG_DUMP_SECTION_POST_DATA:
 		{
 			dumpFilename = specs->dumpPaths.postFilename;
+			tocFilename = specs->dumpPaths.postTocFilename;
 			listFilename = specs->dumpPaths.postListFilename;
 			break;
 		}
@@ -336,81 +465,250 @@ copydb_write_restore_list(CopyDataSpec *specs, PostgresDumpSection section)
 	 *
 	 * Here's how to filter out some objects with pg_restore:
 	 *
-	 *   1. pg_restore -f- --list post.dump > post.list
-	 *   2. edit post.list to comment out lines
+	 *   1. pg_restore -f post.toc --list post.dump
+	 *   2. stream post.toc into post.list, commenting out lines
 	 *   3. pg_restore --use-list post.list post.dump
+	 *
+	 * The archive TOC of a large database counts hundreds of thousands of
+	 * entries: rather than materializing it in memory, we stream-parse the
+	 * TOC file one line at a time and emit the use-list incrementally.
+	 *
+	 * Running pg_restore --list walks the whole archive and takes minutes on
+	 * such databases, and a resumed run uses the very same dump files as the
+	 * previous one: keep the TOC file around with a sidecar checksum of the
+	 * archive, and skip pg_restore --list when the checksum still matches.
 	 */
-	ArchiveContentArray contents = { 0 };
+	char sumFilename[MAXPGPATH] = { 0 };
+
+	sformat(sumFilename, sizeof(sumFilename), "%s.sum", tocFilename);
 
-	if (!pg_restore_list(&(specs->pgPaths), dumpFilename, &contents))
+	uint32_t checksum = 0;
+
+	if (!copydb_archive_checksum(dumpFilename, &checksum))
 	{
 		/* errors have already been logged */
 		return false;
 	}
 
-	/* edit our post.list file now */
-	PQExpBuffer listContents = createPQExpBuffer();
+	if (copydb_toc_cache_is_valid(tocFilename, sumFilename, checksum))
+	{
+		log_info("Re-using archive TOC file \"%s\" for \"%s\"",
+				 tocFilename,
+				 dumpFilename);
+	}
+	else
+	{
+		if (!pg_restore_list(&(specs->pgPaths), dumpFilename, tocFilename))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		char sum[INTSTRING_MAX_DIGITS] = { 0 };
+		int len = sformat(sum, sizeof(sum), "%u", checksum);
 
-	if (listContents == NULL)
+		if (!write_file(sum, len, sumFilename))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	FILE *toc = fopen_read_only(tocFilename);
+
+	if (toc == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
-		free(listContents);
+		log_error("Failed to open file \"%s\": %m", tocFilename);
 		return false;
 	}
 
+	FILE *list = fopen_with_umask(listFilename, "wb", FOPEN_FLAGS_W, 0644);
+
+	if (list == NULL)
+	{
+		/* errors have already been logged */
+		fclose(toc);
+		return false;
+	}
+
+	char line[BUFSIZE] = { 0 };
+
 	/* for each object in the list, comment when we already processed it */
-	for (int i = 0; i < contents.count; i++)
+	while (fgets(line, sizeof(line), toc) != NULL)
 	{
-		uint32_t oid = contents.array[i].objectOid;
-		char *name = contents.array[i].restoreListName;
+		/* strip the trailing newline before parsing */
+		size_t len = strlen(line);
+
+		if (len > 0 && line[len - 1] == '\n')
+		{
+			line[len - 1] = '\0';
+		}
+
+		ArchiveContentItem item = { 0 };
+		bool isEntry = false;
+
+		if (!parse_archive_list_entry(line, &item, &isEntry))
+		{
+			/* errors have already been logged */
+			fclose(toc);
+			fclose(list);
+			return false;
+		}
+
+		/* comment and preamble lines are not part of the use-list */
+		if (!isEntry)
+		{
+			continue;
+		}
+
 		char *prefix = "";
 
-		if (copydb_objectid_has_been_processed_already(specs, oid))
+		if (copydb_objectid_has_been_processed_already(specs, item.objectOid))
 		{
 			prefix = ";";
 
 			log_notice("Skipping already processed dumpId %d: %s %u %s",
-					   contents.array[i].dumpId,
-					   contents.array[i].desc,
-					   contents.array[i].objectOid,
-					   contents.array[i].restoreListName);
+					   item.dumpId,
+					   item.desc,
+					   item.objectOid,
+					   item.restoreListName);
 		}
-		else if (copydb_objectid_is_filtered_out(specs, oid, name))
+		else if (copydb_objectid_is_filtered_out(specs,
+												 item.objectOid,
+												 item.restoreListName))
 		{
 			prefix = ";";
 
 			log_notice("Skipping filtered-out dumpId %d: %s %u %s",
-					   contents.array[i].dumpId,
-					   contents.array[i].desc,
-					   contents.array[i].objectOid,
-					   contents.array[i].restoreListName);
+					   item.dumpId,
+					   item.desc,
+					   item.objectOid,
+					   item.restoreListName);
 		}
 
-		appendPQExpBuffer(listContents, "%s%d; %u %u %s %s\n",
-						  prefix,
-						  contents.array[i].dumpId,
-						  contents.array[i].catalogOid,
-						  contents.array[i].objectOid,
-						  contents.array[i].desc,
-						  contents.array[i].restoreListName);
+		fformat(list, "%s%d; %u %u %s %s\n",
+				prefix,
+				item.dumpId,
+				item.catalogOid,
+				item.objectOid,
+				item.desc,
+				item.restoreListName);
 	}
 
-	/* memory allocation could have failed while building string */
-	if (PQExpBufferBroken(listContents))
+	if (ferror(toc) != 0)
+	{
+		log_error("Failed to read file \"%s\": %m", tocFilename);
+		fclose(toc);
+		fclose(list);
+		return false;
+	}
+
+	fclose(toc);
+
+	if (fclose(list) != 0)
+	{
+		log_error("Failed to write file \"%s\": %m", listFilename);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_archive_checksum computes an FNV-1a checksum of the given pg_dump
+ * archive file. The pre-data and post-data archives are schema-only, so
+ * reading them through is much cheaper than a pg_restore --list run.
+ */
+static bool
+copydb_archive_checksum(const char *filename, uint32_t *checksum)
+{
+	FILE *file = fopen_read_only(filename);
+
+	if (file == NULL)
 	{
-		log_error("Failed to create pg_restore list file: out of memory");
-		destroyPQExpBuffer(listContents);
+		log_error("Failed to open file \"%s\": %m", filename);
 		return false;
 	}
 
-	if (!write_file(listContents->data, listContents->len, listFilename))
+	uint32_t hash = 0x811c9dc5;
+	unsigned char buffer[BUFSIZE] = { 0 };
+	size_t bytes = 0;
+
+	while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		for (size_t i = 0; i < bytes; i++)
+		{
+			hash = (hash ^ buffer[i]) * 0x01000193;
+		}
+	}
+
+	if (ferror(file) != 0)
+	{
+		log_error("Failed to read file \"%s\": %m", filename);
+		fclose(file);
+		return false;
+	}
+
+	fclose(file);
+
+	*checksum = hash;
+
+	return true;
+}
+
+
+/*
+ * copydb_toc_cache_is_valid returns true when the TOC file obtained with
+ * pg_restore --list on a previous run can be re-used, that is when both the
+ * TOC file and its sidecar checksum file exist and the sidecar contains the
+ * checksum of the current archive file.
+ */
+static bool
+copydb_toc_cache_is_valid(const char *tocFilename,
+						  const char *sumFilename,
+						  uint32_t checksum)
+{
+	if (!file_exists(tocFilename) || !file_exists(sumFilename))
+	{
+		return false;
+	}
+
+	char *contents = NULL;
+	long size = 0L;
+
+	if (!read_file(sumFilename, &contents, &size))
 	{
 		/* errors have already been logged */
-		destroyPQExpBuffer(listContents);
 		return false;
 	}
 
-	destroyPQExpBuffer(listContents);
+	/* make sure to use only the first line of the file, without \n */
+	char *lines[BUFSIZE] = { 0 };
+	int lineCount = splitLines(contents, lines, BUFSIZE);
+
+	uint32_t previous = 0;
+
+	if (lineCount != 1 || !stringToUInt32(lines[0], &previous))
+	{
+		log_warn("Failed to parse archive checksum file \"%s\", "
+				 "listing the archive contents again",
+				 sumFilename);
+
+		free(contents);
+		return false;
+	}
+
+	free(contents);
+
+	if (previous != checksum)
+	{
+		log_notice("Archive checksum %u does not match \"%s\", "
+				   "listing the archive contents again",
+				   checksum,
+				   sumFilename);
+		return false;
+	}
 
 	return true;
 }
@@ -17,27 +17,35 @@
 /*
  * copydb_copy_extensions copies extensions from the source instance into the
  * target instance.
+ *
+ * The create extension statements are run serially, because extensions may
+ * depend on each other (cascade). The extension configuration tables are then
+ * copied by a pool of --table-jobs worker processes: each worker owns a
+ * partition of the extensions and copies that extension's configuration
+ * tables in their extconfig registration order, so that dependencies between
+ * configuration tables of a same extension are still honored.
  */
 bool
 copydb_copy_extensions(CopyDataSpec *copySpecs, bool createExtensions)
 {
 	int errors = 0;
-	PGSQL dst = { 0 };
 
 	SourceExtensionArray *extensionArray = &(copySpecs->extensionArray);
 
-	if (!pgsql_init(&dst, copySpecs->target_pguri, PGSQL_CONN_TARGET))
+	if (createExtensions)
 	{
-		/* errors have already been logged */
-		return false;
-	}
+		PGSQL dst = { 0 };
 
-	for (int i = 0; i < extensionArray->count; i++)
-	{
-		SourceExtension *ext = &(extensionArray->array[i]);
+		if (!pgsql_init(&dst, copySpecs->target_pguri, PGSQL_CONN_TARGET))
+		{
+			/* errors have already been logged */
+			return false;
+		}
 
-		if (createExtensions)
+		for (int i = 0; i < extensionArray->count; i++)
 		{
+			SourceExtension *ext = &(extensionArray->array[i]);
+
 			char sql[BUFSIZE] = { 0 };
 
 			sformat(sql, sizeof(sql),
@@ -53,51 +61,266 @@ copydb_copy_extensions(CopyDataSpec *copySpecs, bool createExtensions)
 			}
 		}
 
-		/* do we have to take care of extensions config table? */
-		if (ext->config.count > 0)
+		(void) pgsql_finish(&dst);
+	}
+
+	/* do we have to take care of extensions config tables? */
+	int nbExtensionsWithConfig = 0;
+
+	for (int i = 0; i < extensionArray->count; i++)
+	{
+		if (extensionArray->array[i].config.count > 0)
 		{
-			for (int i = 0; i < ext->config.count; i++)
-			{
-				SourceExtensionConfig *config = &(ext->config.array[i]);
+			++nbExtensionsWithConfig;
+		}
+	}
 
-				log_info("COPY extension \"%s\" "
-						 "configuration table \"%s\".\"%s\"",
-						 ext->extname,
-						 config->nspname,
-						 config->relname);
+	if (nbExtensionsWithConfig == 0)
+	{
+		return errors == 0;
+	}
 
-				/* apply extcondition to the source table */
-				char qname[NAMEDATALEN * 2 + 5] = { 0 };
+	/* no need for more workers than extensions with configuration tables */
+	int nbWorkers = copySpecs->tableJobs < nbExtensionsWithConfig
+					? copySpecs->tableJobs
+					: nbExtensionsWithConfig;
 
-				sformat(qname, sizeof(qname), "\"%s\".\"%s\"",
-						config->nspname,
-						config->relname);
+	log_info("COPY configuration tables for %d extensions in %d sub-processes",
+			 nbExtensionsWithConfig,
+			 nbWorkers);
 
-				char *sqlTemplate = "(SELECT * FROM %s %s)";
+	pid_t *pids = (pid_t *) calloc(nbWorkers, sizeof(pid_t));
 
-				size_t sqlLen =
-					strlen(sqlTemplate) +
-					strlen(qname) +
-					strlen(config->condition) +
-					1;
+	if (pids == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
 
-				char *sql = (char *) calloc(sqlLen, sizeof(char));
+	for (int i = 0; i < nbWorkers; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
 
-				sformat(sql, sqlLen, sqlTemplate, qname, config->condition);
+		int fpid = fork();
 
-				bool truncate = false;
-				PGSQL *src = &(copySpecs->sourceSnapshot.pgsql);
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork an extension worker process: %m");
+				free(pids);
+				return false;
+			}
 
-				if (!pg_copy(src, &dst, sql, qname, truncate))
+			case 0:
+			{
+				/* child process runs the command */
+				if (!copydb_copy_extensions_worker(copySpecs, i, nbWorkers))
 				{
-					/* errors have already been logged */
-					return false;
+					log_error("Failed to copy extension configuration tables, "
+							  "see above for details");
+					exit(EXIT_CODE_INTERNAL_ERROR);
 				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				pids[i] = fpid;
+				break;
 			}
 		}
 	}
 
-	(void) pgsql_finish(&dst);
+	/* wait until all the extension workers are done */
+	for (int i = 0; i < nbWorkers; i++)
+	{
+		int status = 0;
+
+		if (waitpid(pids[i], &status, 0) == -1)
+		{
+			log_error("Failed to wait for extension worker %d: %m", pids[i]);
+			++errors;
+			continue;
+		}
+
+		if (WEXITSTATUS(status) != 0)
+		{
+			log_error("Extension worker process %d exited with code %d",
+					  pids[i], WEXITSTATUS(status));
+			++errors;
+		}
+	}
+
+	free(pids);
 
 	return errors == 0;
 }
+
+
+/*
+ * copydb_copy_extensions_worker copies the configuration tables of the
+ * extensions that belong to the given worker's partition of the extension
+ * array, over a private pair of source and target connections.
+ */
+bool
+copydb_copy_extensions_worker(CopyDataSpec *copySpecs,
+							  int workerIndex,
+							  int nbWorkers)
+{
+	log_notice("Started extension worker %d/%d %d [%d]",
+			   workerIndex,
+			   nbWorkers,
+			   getpid(),
+			   getppid());
+
+	PGSQL *src = NULL;
+	PGSQL pgsql = { 0 };
+	PGSQL dst = { 0 };
+
+	TransactionSnapshot snapshot = { 0 };
+
+	if (copySpecs->consistent)
+	{
+		/*
+		 * Each worker is a sub-process of its own and needs a private PGSQL
+		 * client connection instance that re-uses the already exported
+		 * snapshot.
+		 */
+		if (!copydb_copy_snapshot(copySpecs, &snapshot))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		/* swap the new instance in place of the previous one */
+		copySpecs->sourceSnapshot = snapshot;
+
+		src = &(copySpecs->sourceSnapshot.pgsql);
+
+		if (!copydb_set_snapshot(copySpecs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else
+	{
+		/*
+		 * In the context of --not-consistent we don't have an already
+		 * established snapshot to set nor a connection to piggyback onto, so
+		 * we have to initialize our client connection now.
+		 */
+		if (!pgsql_init(&pgsql, copySpecs->source_pguri, PGSQL_CONN_SOURCE))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		src = &pgsql;
+
+		if (!pgsql_begin(src))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	if (!pgsql_init(&dst, copySpecs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	SourceExtensionArray *extensionArray = &(copySpecs->extensionArray);
+
+	for (int extIndex = 0; extIndex < extensionArray->count; extIndex++)
+	{
+		SourceExtension *ext = &(extensionArray->array[extIndex]);
+
+		if (ext->config.count == 0)
+		{
+			continue;
+		}
+
+		/* skip extensions that belong to another worker in the pool */
+		if (extIndex % nbWorkers != workerIndex)
+		{
+			continue;
+		}
+
+		for (int i = 0; i < ext->config.count; i++)
+		{
+			SourceExtensionConfig *config = &(ext->config.array[i]);
+
+			log_info("COPY extension \"%s\" "
+					 "configuration table \"%s\".\"%s\"",
+					 ext->extname,
+					 config->nspname,
+					 config->relname);
+
+			/* apply extcondition to the source table */
+			char qname[NAMEDATALEN * 2 + 5] = { 0 };
+
+			sformat(qname, sizeof(qname), "\"%s\".\"%s\"",
+					config->nspname,
+					config->relname);
+
+			char *sqlTemplate = "(SELECT * FROM %s %s)";
+
+			size_t sqlLen =
+				strlen(sqlTemplate) +
+				strlen(qname) +
+				strlen(config->condition) +
+				1;
+
+			char *sql = (char *) calloc(sqlLen, sizeof(char));
+
+			sformat(sql, sqlLen, sqlTemplate, qname, config->condition);
+
+			bool truncate = false;
+
+			/* extension config tables may use extension data types */
+			bool binary = false;
+
+			if (!pg_copy(src, &dst, sql, qname, truncate, binary, NULL, NULL))
+			{
+				/* errors have already been logged */
+				free(sql);
+				return false;
+			}
+
+			free(sql);
+		}
+	}
+
+	/* if we opened a snapshot, now is the time to close it */
+	if (copySpecs->consistent)
+	{
+		if (!copydb_close_snapshot(copySpecs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else
+	{
+		if (!pgsql_commit(src))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/* close connection to the target database now */
+	(void) pgsql_finish(&dst);
+
+	return true;
+}
@@ -4,8 +4,10 @@
  */
 
 #include <limits.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #if defined(__APPLE__)
 #include <mach-o/dyld.h>
@@ -26,6 +28,13 @@ static bool read_file_internal(FILE *fileStream,
 							   char **contents,
 							   long *fileSize);
 
+#if defined(__APPLE__)
+static int gzip_cookie_read(void *cookie, char *buf, int size);
+#else
+static ssize_t gzip_cookie_read(void *cookie, char *buf, size_t size);
+#endif
+static int gzip_cookie_close(void *cookie);
+
 /*
  * file_exists returns true if the given filename is known to exist
  * on the file system or false if it does not exist or in case of
@@ -371,6 +380,358 @@ read_file_internal(FILE *fileStream,
 }
 
 
+/*
+ * gzip_cookie_read implements the read callback of the stream returned by
+ * fopen_read_gzip, calling into zlib to inflate the data. The callback is
+ * registered with fopencookie(3) on glibc/musl systems and with funopen(3)
+ * on macOS, which expects int-sized reads.
+ */
+#if defined(__APPLE__)
+static int
+gzip_cookie_read(void *cookie, char *buf, int size)
+{
+	gzFile gzf = (gzFile) cookie;
+
+	return gzread(gzf, buf, size);
+}
+
+
+#else
+static ssize_t
+gzip_cookie_read(void *cookie, char *buf, size_t size)
+{
+	gzFile gzf = (gzFile) cookie;
+
+	return (ssize_t) gzread(gzf, buf, size);
+}
+
+
+#endif
+
+
+/*
+ * gzip_cookie_close implements the close callback of the stream returned by
+ * fopen_read_gzip.
+ */
+static int
+gzip_cookie_close(void *cookie)
+{
+	gzFile gzf = (gzFile) cookie;
+
+	return gzclose(gzf) == Z_OK ? 0 : EOF;
+}
+
+
+/*
+ * fopen_read_gzip opens a FILE stream that transparently decompresses the
+ * given file when it's gzip compressed: zlib detects the gzip magic bytes and
+ * reads plain files as-is, so callers can use the usual stdio read functions
+ * (getline etc) on files that may have been written either way.
+ */
+FILE *
+fopen_read_gzip(const char *filePath)
+{
+	gzFile gzf = gzopen(filePath, "rb");
+
+	if (gzf == NULL)
+	{
+		return NULL;
+	}
+
+	/* use a larger internal zlib buffer than the 8kB default */
+	(void) gzbuffer(gzf, 128 * 1024);
+
+#if defined(__APPLE__)
+	FILE *fileStream = funopen((void *) gzf,
+							   gzip_cookie_read,
+							   NULL, /* write */
+							   NULL, /* seek */
+							   gzip_cookie_close);
+#else
+	cookie_io_functions_t io = {
+		.read = gzip_cookie_read,
+		.write = NULL,
+		.seek = NULL,
+		.close = gzip_cookie_close
+	};
+
+	FILE *fileStream = fopencookie((void *) gzf, "r", io);
+#endif
+
+	if (fileStream == NULL)
+	{
+		(void) gzclose(gzf);
+		return NULL;
+	}
+
+	return fileStream;
+}
+
+
+/*
+ * read_file_gzip is the same as read_file for files that may have been
+ * written gzip compressed: zlib reads plain files transparently, so this
+ * function accepts both formats. The uncompressed size is not known upfront,
+ * the contents buffer is grown as needed while inflating.
+ */
+bool
+read_file_gzip(const char *filePath, char **contents, long *fileSize)
+{
+	gzFile gzf = gzopen(filePath, "rb");
+
+	if (gzf == NULL)
+	{
+		log_error("Failed to open file \"%s\": %m", filePath);
+		return false;
+	}
+
+	(void) gzbuffer(gzf, 128 * 1024);
+
+	size_t capacity = 1024 * 1024;
+	size_t total = 0;
+
+	char *data = malloc(capacity);
+
+	if (data == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		(void) gzclose(gzf);
+		return false;
+	}
+
+	for (;;)
+	{
+		int bytes = gzread(gzf, data + total, capacity - total - 1);
+
+		if (bytes < 0)
+		{
+			int errnum = 0;
+			const char *message = gzerror(gzf, &errnum);
+
+			log_error("Failed to read file \"%s\": %s", filePath, message);
+			(void) gzclose(gzf);
+			free(data);
+			return false;
+		}
+
+		total += bytes;
+
+		if (bytes == 0)
+		{
+			break;
+		}
+
+		if ((capacity - total) <= 1)
+		{
+			capacity *= 2;
+
+			char *bigger = realloc(data, capacity);
+
+			if (bigger == NULL)
+			{
+				log_error(ALLOCATION_FAILED_ERROR);
+				(void) gzclose(gzf);
+				free(data);
+				return false;
+			}
+
+			data = bigger;
+		}
+	}
+
+	if (gzclose(gzf) != Z_OK)
+	{
+		log_error("Failed to read file \"%s\"", filePath);
+		free(data);
+		return false;
+	}
+
+	data[total] = '\0';
+
+	*contents = data;
+	*fileSize = total;
+
+	return true;
+}
+
+
+/* below this size, mmap machinery costs more than a plain read */
+#define READ_FILE_MMAP_THRESHOLD (1024 * 1024)
+
+/*
+ * read_file_mmap is a variant of read_file that maps large files into memory
+ * instead of copying them into a malloc'ed buffer, halving the peak RSS when
+ * loading multi-gigabyte CDC segment files and avoiding double-buffering
+ * through the page cache. The mapping is private (copy-on-write), because
+ * callers like splitLines write line terminators into the buffer.
+ *
+ * On success *mapped says whether the contents must be released with
+ * unmap_file instead of free. Small files, gzip compressed files, and files
+ * whose size precludes a NUL terminating byte in the last page all fall back
+ * to the plain read path.
+ */
+bool
+read_file_mmap(const char *filePath, char **contents, long *fileSize,
+			   bool *mapped)
+{
+	*mapped = false;
+
+	int fd = open(filePath, O_RDONLY);
+
+	if (fd < 0)
+	{
+		log_error("Failed to open file \"%s\": %m", filePath);
+		return false;
+	}
+
+	struct stat st = { 0 };
+
+	if (fstat(fd, &st) != 0)
+	{
+		log_error("Failed to stat file \"%s\": %m", filePath);
+		(void) close(fd);
+		return false;
+	}
+
+	long size = st.st_size;
+	long pagesize = sysconf(_SC_PAGESIZE);
+
+	/*
+	 * The callers expect a NUL terminated buffer, which the mapping only
+	 * provides in the zero-filled remainder of the last page: a file of an
+	 * exact multiple of the page size has no such remainder.
+	 */
+	if (size < READ_FILE_MMAP_THRESHOLD || size % pagesize == 0)
+	{
+		(void) close(fd);
+		return read_file_gzip(filePath, contents, fileSize);
+	}
+
+	char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+	/* the mapping remains valid after closing the file descriptor */
+	(void) close(fd);
+
+	if (map == MAP_FAILED)
+	{
+		log_error("Failed to mmap %ld bytes of file \"%s\": %m",
+				  size, filePath);
+		return false;
+	}
+
+	/* gzip compressed files need inflating, use the in-memory path */
+	if (size >= 2 &&
+		(unsigned char) map[0] == 0x1f &&
+		(unsigned char) map[1] == 0x8b)
+	{
+		(void) munmap(map, size);
+		return read_file_gzip(filePath, contents, fileSize);
+	}
+
+	if (madvise(map, size, MADV_SEQUENTIAL) != 0)
+	{
+		log_debug("Failed to madvise(MADV_SEQUENTIAL) file \"%s\": %m",
+				  filePath);
+	}
+
+	*contents = map;
+	*fileSize = size;
+	*mapped = true;
+
+	return true;
+}
+
+
+/*
+ * unmap_file releases a file mapping obtained with read_file_mmap.
+ */
+bool
+unmap_file(char *contents, long fileSize)
+{
+	if (contents == NULL)
+	{
+		return true;
+	}
+
+	if (munmap(contents, fileSize) != 0)
+	{
+		log_error("Failed to munmap %ld bytes: %m", fileSize);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * write_file_gzip_chunk compresses the given buffer as a standalone gzip
+ * member and appends it to the given already opened FILE stream. A file made
+ * of several concatenated gzip members is a valid gzip file, so large files
+ * can be written one chunk at a time while readers just see a single stream.
+ */
+bool
+write_file_gzip_chunk(FILE *fileStream, const char *filePath,
+					  const char *buffer, size_t size)
+{
+	if (size == 0)
+	{
+		return true;
+	}
+
+	z_stream strm = { 0 };
+
+	/* windowBits 15 + 16 asks zlib for the gzip framing */
+	if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+					 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		log_error("Failed to compress %zu bytes for file \"%s\": %s",
+				  size, filePath, strm.msg ? strm.msg : "deflateInit2");
+		return false;
+	}
+
+	uLong bound = deflateBound(&strm, size);
+	char *compressed = malloc(bound);
+
+	if (compressed == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		(void) deflateEnd(&strm);
+		return false;
+	}
+
+	strm.next_in = (Bytef *) buffer;
+	strm.avail_in = size;
+	strm.next_out = (Bytef *) compressed;
+	strm.avail_out = bound;
+
+	if (deflate(&strm, Z_FINISH) != Z_STREAM_END)
+	{
+		log_error("Failed to compress %zu bytes for file \"%s\": %s",
+				  size, filePath, strm.msg ? strm.msg : "deflate");
+		(void) deflateEnd(&strm);
+		free(compressed);
+		return false;
+	}
+
+	size_t compressedSize = bound - strm.avail_out;
+
+	(void) deflateEnd(&strm);
+
+	if (fwrite(compressed, sizeof(char), compressedSize, fileStream) !=
+		compressedSize)
+	{
+		log_error("Failed to write %zu bytes to file \"%s\": %m",
+				  compressedSize, filePath);
+		free(compressed);
+		return false;
+	}
+
+	free(compressed);
+
+	return true;
+}
+
+
 /*
  * move_file is a utility function to move a file from sourcePath to
  * destinationPath. It behaves like mv system command. First attempts to move
@@ -43,6 +43,13 @@ bool write_file(char *data, long fileSize, const char *filePath);
 bool append_to_file(char *data, long fileSize, const char *filePath);
 bool read_file(const char *filePath, char **contents, long *fileSize);
 bool read_file_if_exists(const char *filePath, char **contents, long *fileSize);
+FILE * fopen_read_gzip(const char *filePath);
+bool read_file_gzip(const char *filePath, char **contents, long *fileSize);
+bool read_file_mmap(const char *filePath,
+					char **contents, long *fileSize, bool *mapped);
+bool unmap_file(char *contents, long fileSize);
+bool write_file_gzip_chunk(FILE *fileStream, const char *filePath,
+						   const char *buffer, size_t size);
 bool move_file(char *sourcePath, char *destinationPath);
 bool duplicate_file(char *sourcePath, char *destinationPath);
 bool create_symbolic_link(char *sourcePath, char *targetPath);
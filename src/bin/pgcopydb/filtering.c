@@ -20,6 +20,13 @@
 static bool parse_filter_quoted_table_name(SourceFilterTable *table,
 										   const char *qname);
 
+static bool filters_add_hash_key(SourceFilterItemHash **hash, const char *key);
+static bool filters_add_table_list(SourceFilterItemHash **hash,
+								   SourceFilterTableList *list);
+static bool filters_hash_lookup(SourceFilterItemHash *hash,
+								const char *nspname,
+								const char *relname);
+
 
 /*
  * filterTypeToString returns a string reprensentation of the enum value.
@@ -399,3 +406,285 @@ parse_filter_quoted_table_name(SourceFilterTable *table, const char *qname)
 
 	return true;
 }
+
+
+/*
+ * filters_add_hash_key adds the given key to the given hash table, unless the
+ * key is already known there.
+ */
+static bool
+filters_add_hash_key(SourceFilterItemHash **hash, const char *key)
+{
+	SourceFilterItemHash *item = NULL;
+
+	HASH_FIND_STR(*hash, key, item);
+
+	if (item != NULL)
+	{
+		return true;
+	}
+
+	item = (SourceFilterItemHash *) calloc(1, sizeof(SourceFilterItemHash));
+
+	if (item == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	strlcpy(item->key, key, sizeof(item->key));
+
+	HASH_ADD_STR(*hash, key, item);
+
+	return true;
+}
+
+
+/*
+ * filters_add_table_list hashes every entry of the given table list by its
+ * qualified name.
+ */
+static bool
+filters_add_table_list(SourceFilterItemHash **hash,
+					   SourceFilterTableList *list)
+{
+	for (int i = 0; i < list->count; i++)
+	{
+		char key[2 * NAMEDATALEN + 2] = { 0 };
+
+		sformat(key, sizeof(key), "%s.%s",
+				list->array[i].nspname,
+				list->array[i].relname);
+
+		if (!filters_add_hash_key(hash, key))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * filters_prepare_hash_tables builds the in-memory hash tables that implement
+ * the filtering lists client-side, so that catalog queries do not need the
+ * pg_temp filter tables on the source server.
+ */
+bool
+filters_prepare_hash_tables(SourceFilters *filters)
+{
+	if (filters->hashTablesPrepared)
+	{
+		return true;
+	}
+
+	for (int i = 0; i < filters->excludeSchemaList.count; i++)
+	{
+		char *nspname = filters->excludeSchemaList.array[i].nspname;
+
+		if (!filters_add_hash_key(&(filters->hExcludeSchema), nspname))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	struct hash_list_pair
+	{
+		SourceFilterItemHash **hash;
+		SourceFilterTableList *list;
+	};
+
+	struct hash_list_pair hashListPair[] = {
+		{ &(filters->hIncludeOnlyTable), &(filters->includeOnlyTableList) },
+		{ &(filters->hExcludeTable), &(filters->excludeTableList) },
+		{ &(filters->hExcludeTableData), &(filters->excludeTableDataList) },
+		{ &(filters->hExcludeIndex), &(filters->excludeIndexList) },
+		{ NULL, NULL },
+	};
+
+	for (int i = 0; hashListPair[i].hash != NULL; i++)
+	{
+		if (!filters_add_table_list(hashListPair[i].hash,
+									hashListPair[i].list))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	filters->hashTablesPrepared = true;
+
+	return true;
+}
+
+
+/*
+ * filters_hash_lookup returns true when the qualified name of the given
+ * relation is found in the given hash table.
+ */
+static bool
+filters_hash_lookup(SourceFilterItemHash *hash,
+					const char *nspname,
+					const char *relname)
+{
+	SourceFilterItemHash *item = NULL;
+
+	char key[2 * NAMEDATALEN + 2] = { 0 };
+
+	sformat(key, sizeof(key), "%s.%s", nspname, relname);
+
+	HASH_FIND_STR(hash, key, item);
+
+	return item != NULL;
+}
+
+
+/*
+ * filters_table_excluded returns true when the given table is filtered-out,
+ * implementing the same semantics as the SQL joins against the pg_temp filter
+ * tables.
+ */
+bool
+filters_table_excluded(SourceFilters *filters,
+					   const char *nspname,
+					   const char *relname)
+{
+	switch (filters->type)
+	{
+		case SOURCE_FILTER_TYPE_NONE:
+		{
+			return false;
+		}
+
+		case SOURCE_FILTER_TYPE_INCL:
+		{
+			return !filters_hash_lookup(filters->hIncludeOnlyTable,
+										nspname,
+										relname);
+		}
+
+		case SOURCE_FILTER_TYPE_EXCL:
+		{
+			SourceFilterItemHash *schema = NULL;
+
+			HASH_FIND_STR(filters->hExcludeSchema, nspname, schema);
+
+			return schema != NULL ||
+				   filters_hash_lookup(filters->hExcludeTable,
+									   nspname,
+									   relname) ||
+				   filters_hash_lookup(filters->hExcludeTableData,
+									   nspname,
+									   relname);
+		}
+
+		default:
+		{
+			log_error("BUG: filters_table_excluded called with "
+					  "filtering type %d",
+					  filters->type);
+			return false;
+		}
+	}
+}
+
+
+/*
+ * filters_table_data_excluded returns true when the given table belongs to the
+ * exclude-table-data filtering list: its schema is created on the target, and
+ * its data is skipped.
+ */
+bool
+filters_table_data_excluded(SourceFilters *filters,
+							const char *nspname,
+							const char *relname)
+{
+	return filters_hash_lookup(filters->hExcludeTableData, nspname, relname);
+}
+
+
+/*
+ * filters_index_excluded returns true when the given index is filtered-out,
+ * either because its table is, or because the index belongs to the
+ * exclude-index filtering list.
+ */
+bool
+filters_index_excluded(SourceFilters *filters,
+					   const char *tableNspname,
+					   const char *tableRelname,
+					   const char *indexNspname,
+					   const char *indexRelname)
+{
+	switch (filters->type)
+	{
+		case SOURCE_FILTER_TYPE_NONE:
+		{
+			return false;
+		}
+
+		case SOURCE_FILTER_TYPE_INCL:
+		case SOURCE_FILTER_TYPE_EXCL:
+		{
+			return filters_table_excluded(filters,
+										  tableNspname,
+										  tableRelname);
+		}
+
+		case SOURCE_FILTER_TYPE_EXCL_INDEX:
+		{
+			return filters_hash_lookup(filters->hExcludeIndex,
+									   indexNspname,
+									   indexRelname);
+		}
+
+		default:
+		{
+			log_error("BUG: filters_index_excluded called with "
+					  "filtering type %d",
+					  filters->type);
+			return false;
+		}
+	}
+}
+
+
+/*
+ * filters_sequence_excluded returns true when the given sequence is
+ * filtered-out. When filtering is installed, only sequences attached to a
+ * column default of a table that is itself selected are processed, same as
+ * with the SQL join through pg_depend and pg_attrdef.
+ */
+bool
+filters_sequence_excluded(SourceFilters *filters,
+						  bool hasOwnerTable,
+						  const char *ownerNspname,
+						  const char *ownerRelname)
+{
+	switch (filters->type)
+	{
+		case SOURCE_FILTER_TYPE_NONE:
+		{
+			return false;
+		}
+
+		case SOURCE_FILTER_TYPE_INCL:
+		case SOURCE_FILTER_TYPE_EXCL:
+		{
+			return !hasOwnerTable ||
+				   filters_table_excluded(filters,
+										  ownerNspname,
+										  ownerRelname);
+		}
+
+		default:
+		{
+			log_error("BUG: filters_sequence_excluded called with "
+					  "filtering type %d",
+					  filters->type);
+			return false;
+		}
+	}
+}
@@ -13,6 +13,13 @@
 
 #include "pgsql.h"
 
+/* keep the uthash bloom filter setup in sync with schema.h */
+#ifndef HASH_BLOOM
+#define HASH_BLOOM 16
+#endif
+
+#include "uthash.h"
+
 
 typedef enum
 {
@@ -81,6 +88,17 @@ typedef enum
 	SOURCE_FILTER_TYPE_LIST_EXCL_INDEX
 } SourceFilterType;
 
+/*
+ * To evaluate the filtering lists client-side, rather than uploading them to
+ * temp tables on the source server, we hash the list entries by their
+ * qualified name ("nspname.relname", or just "nspname" for schemas).
+ */
+typedef struct SourceFilterItemHash
+{
+	char key[2 * NAMEDATALEN + 2];
+	UT_hash_handle hh;          /* makes this structure hashable */
+} SourceFilterItemHash;
+
 typedef struct SourceFilters
 {
 	bool prepared;
@@ -90,10 +108,35 @@ typedef struct SourceFilters
 	SourceFilterTableList excludeTableList;
 	SourceFilterTableList excludeTableDataList;
 	SourceFilterTableList excludeIndexList;
+
+	/* client-side evaluation, see filters_prepare_hash_tables */
+	bool hashTablesPrepared;
+	SourceFilterItemHash *hExcludeSchema;
+	SourceFilterItemHash *hIncludeOnlyTable;
+	SourceFilterItemHash *hExcludeTable;
+	SourceFilterItemHash *hExcludeTableData;
+	SourceFilterItemHash *hExcludeIndex;
 } SourceFilters;
 
 char * filterTypeToString(SourceFilterType type);
 SourceFilterType filterTypeComplement(SourceFilterType type);
 bool parse_filters(const char *filebname, SourceFilters *filters);
 
+bool filters_prepare_hash_tables(SourceFilters *filters);
+bool filters_table_excluded(SourceFilters *filters,
+							const char *nspname,
+							const char *relname);
+bool filters_table_data_excluded(SourceFilters *filters,
+								 const char *nspname,
+								 const char *relname);
+bool filters_index_excluded(SourceFilters *filters,
+							const char *tableNspname,
+							const char *tableRelname,
+							const char *indexNspname,
+							const char *indexRelname);
+bool filters_sequence_excluded(SourceFilters *filters,
+							   bool hasOwnerTable,
+							   const char *ownerNspname,
+							   const char *ownerRelname);
+
 #endif  /* FILTERING_H */
@@ -66,6 +66,13 @@ follow_start_prefetch(StreamSpecs *specs, pid_t *pid)
 bool
 follow_start_catchup(StreamSpecs *specs, pid_t *pid)
 {
+	/* in direct mode the apply happens in the receive process itself */
+	if (specs->mode == STREAM_MODE_DIRECT)
+	{
+		*pid = -1;
+		return true;
+	}
+
 	/* now we can fork a sub-process to transform the current file */
 	pid_t fpid = fork();
 
@@ -103,7 +110,9 @@ follow_start_catchup(StreamSpecs *specs, pid_t *pid)
 
 
 /*
- * follow_wait_subprocesses waits until both sub-processes are finished.
+ * follow_wait_subprocesses waits until both sub-processes are finished,
+ * blocking in waitpid() and reaping whichever of the two sub-processes
+ * exits first, without a polling delay.
  */
 bool
 follow_wait_subprocesses(StreamSpecs *specs, pid_t prefetch, pid_t catchup)
@@ -115,50 +124,53 @@ follow_wait_subprocesses(StreamSpecs *specs, pid_t prefetch, pid_t catchup)
 
 	while (!prefetchExited || !catchupExited)
 	{
-		if (!prefetchExited)
-		{
-			int returnCode = -1;
+		int status = 0;
 
-			if (!follow_wait_pid(prefetch, &prefetchExited, &returnCode))
-			{
-				/* errors have already been logged */
-				return false;
-			}
+		/* block until one of the sub-processes has exited */
+		pid_t pid = waitpid(-1, &status, 0);
 
-			if (prefetchExited)
+		if (pid == -1)
+		{
+			if (errno == ECHILD)
 			{
-				log_level(returnCode == 0 ? LOG_INFO : LOG_ERROR,
-						  "Prefetch process %d has terminated [%d]",
-						  prefetch,
-						  returnCode);
+				/* no more childrens */
+				prefetchExited = true;
+				catchupExited = true;
+				break;
 			}
 
-			success = success || returnCode == 0;
+			/* the wait has been interrupted by a signal (EINTR), try again */
+			continue;
 		}
 
-		if (!catchupExited)
+		int returnCode = WEXITSTATUS(status);
+
+		if (pid == prefetch)
 		{
-			int returnCode = -1;
+			prefetchExited = true;
 
-			if (!follow_wait_pid(catchup, &catchupExited, &returnCode))
-			{
-				/* errors have already been logged */
-				return false;
-			}
-
-			if (catchupExited)
-			{
-				log_level(returnCode == 0 ? LOG_INFO : LOG_ERROR,
-						  "Catch-up process %d has terminated [%d]",
-						  catchup,
-						  returnCode);
-			}
+			log_level(returnCode == 0 ? LOG_INFO : LOG_ERROR,
+					  "Prefetch process %d has terminated [%d]",
+					  prefetch,
+					  returnCode);
 
 			success = success || returnCode == 0;
 		}
+		else if (pid == catchup)
+		{
+			catchupExited = true;
+
+			log_level(returnCode == 0 ? LOG_INFO : LOG_ERROR,
+					  "Catch-up process %d has terminated [%d]",
+					  catchup,
+					  returnCode);
 
-		/* avoid busy looping, wait for 150ms before checking again */
-		pg_usleep(150 * 1000);
+			success = success || returnCode == 0;
+		}
+		else
+		{
+			log_debug("Reaped unknown sub-process %d [%d]", pid, returnCode);
+		}
 	}
 
 	return true;
@@ -166,52 +178,38 @@ follow_wait_subprocesses(StreamSpecs *specs, pid_t prefetch, pid_t catchup)
 
 
 /*
- * follow_wait_pid waits for a given known sub-process.
+ * follow_wait_pid waits for a given known sub-process, blocking until it has
+ * exited. When the wait is interrupted by a signal (EINTR), our signal
+ * handlers have already run, and *exited is false: the caller gets a chance
+ * to check the signal flags before waiting again.
  */
 bool
 follow_wait_pid(pid_t subprocess, bool *exited, int *returnCode)
 {
 	int status = 0;
-	int pid = waitpid(subprocess, &status, WNOHANG);
+	int pid = waitpid(subprocess, &status, 0);
 
-	switch (pid)
+	if (pid == -1)
 	{
-		case -1:
+		if (errno == ECHILD)
 		{
-			if (errno == ECHILD)
-			{
-				/* no more childrens */
-				*exited = true;
-				return true;
-			}
-			else
-			{
-				log_warn("Failed to call waitpid(): %m");
-				return false;
-			}
-
-			break;
+			/* no more childrens */
+			*exited = true;
+			return true;
 		}
-
-		case 0:
+		else if (errno == EINTR)
 		{
-			/*
-			 * We're using WNOHANG, 0 means there are no stopped or
-			 * exited children, it's all good.
-			 */
 			*exited = false;
-			break;
+			return true;
 		}
 
-		default:
-		{
-			/* sub-process has finished now */
-			*exited = true;
-			*returnCode = WEXITSTATUS(status);
-
-			break;
-		}
+		log_warn("Failed to call waitpid(): %m");
+		return false;
 	}
 
+	/* sub-process has finished now */
+	*exited = true;
+	*returnCode = WEXITSTATUS(status);
+
 	return true;
 }
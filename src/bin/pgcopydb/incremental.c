@@ -0,0 +1,401 @@
+/*
+ * src/bin/pgcopydb/incremental.c
+ *     Skip unchanged tables on repeated clone runs, per --incremental.
+ *
+ * Each successful run registers per-table modification evidence in the
+ * pgcopydb.table_sync table on the target database: the source relfilenode,
+ * the table size, and the cumulative tuple-change counters from
+ * pg_stat_all_tables. The next run fetches the same evidence from the source
+ * and skips the COPY of every table whose evidence is unchanged, which turns
+ * a full refresh of a mostly-static schema into a copy of the few tables
+ * that saw any activity.
+ *
+ * The comparison is conservative: a table is only skipped when every piece
+ * of evidence matches exactly, so a statistics reset on the source (which
+ * makes the counters go backwards) forces a new copy rather than a skip, and
+ * a dropped-and-recreated table gets a new oid and is copied again too.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "copydb.h"
+#include "log.h"
+#include "schema.h"
+#include "string_utils.h"
+
+#define TABLE_SYNC_BATCH_SIZE 512
+
+static bool incremental_create_state_table(PGSQL *dst);
+static bool incremental_skip_unchanged_tables(CopyDataSpec *specs, PGSQL *dst);
+static void getUnchangedTableArray(void *ctx, PGresult *result);
+
+/* Context used when fetching the list of unchanged tables */
+typedef struct UnchangedTableContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	CopyDataSpec *specs;
+	int skippedCount;
+	uint64_t skippedBytes;
+	bool parsedOk;
+} UnchangedTableContext;
+
+
+/*
+ * incremental_prepare_table_state fetches the per-table modification
+ * evidence from the source database, compares it with the state registered
+ * on the target database by the previous run, and marks the tables whose
+ * evidence is unchanged so that their COPY is skipped and their target data
+ * is kept.
+ */
+bool
+incremental_prepare_table_state(CopyDataSpec *specs, PGSQL *src)
+{
+	SourceTableArray *tableArray = &(specs->sourceTableArray);
+
+	if (tableArray->count == 0)
+	{
+		return true;
+	}
+
+	if (!schema_list_table_activity(src, tableArray))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	PGSQL dst = { 0 };
+
+	if (!pgsql_init(&dst, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	dst.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	if (!incremental_create_state_table(&dst))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!incremental_skip_unchanged_tables(specs, &dst))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	(void) pgsql_finish(&dst);
+
+	return true;
+}
+
+
+/*
+ * incremental_create_state_table creates the pgcopydb.table_sync table on
+ * the target database, where each --incremental run registers the per-table
+ * modification evidence it copied under.
+ */
+static bool
+incremental_create_state_table(PGSQL *dst)
+{
+	char *sql[] = {
+		"create schema if not exists pgcopydb",
+		"create table if not exists pgcopydb.table_sync"
+		"(oid oid not null primary key, "
+		" relfilenode bigint not null, "
+		" bytes bigint not null, "
+		" n_tup_ins bigint not null, "
+		" n_tup_upd bigint not null, "
+		" n_tup_del bigint not null, "
+		" synced_at timestamptz not null default now())",
+		NULL
+	};
+
+	if (!pgsql_begin(dst))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	for (int i = 0; sql[i] != NULL; i++)
+	{
+		if (!pgsql_execute(dst, sql[i]))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	if (!pgsql_commit(dst))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * incremental_skip_unchanged_tables sends the current evidence of batches of
+ * tables to the target database and joins it with the registered state of
+ * the previous run: the tables that come back are unchanged, and their COPY
+ * is skipped by setting their excludeData flag, the same mechanism as the
+ * exclude-table-data filtering.
+ */
+static bool
+incremental_skip_unchanged_tables(CopyDataSpec *specs, PGSQL *dst)
+{
+	SourceTableArray *tableArray = &(specs->sourceTableArray);
+
+	UnchangedTableContext context = { { 0 }, specs, 0, 0, false };
+
+	for (int batchStart = 0;
+		 batchStart < tableArray->count;
+		 batchStart += TABLE_SYNC_BATCH_SIZE)
+	{
+		int batchEnd = batchStart + TABLE_SYNC_BATCH_SIZE;
+
+		if (tableArray->count < batchEnd)
+		{
+			batchEnd = tableArray->count;
+		}
+
+		PQExpBuffer sql = createPQExpBuffer();
+
+		appendPQExpBufferStr(sql,
+							 "select c.oid "
+							 "  from pgcopydb.table_sync s "
+							 "  join (values ");
+
+		for (int i = batchStart; i < batchEnd; i++)
+		{
+			SourceTable *table = &(tableArray->array[i]);
+
+			appendPQExpBuffer(sql,
+							  "%s(%u::oid, %lld, %lld, %lld, %lld, %lld)",
+							  i == batchStart ? "" : ", ",
+							  table->oid,
+							  (long long) table->relfilenode,
+							  (long long) table->bytes,
+							  (long long) table->nTupIns,
+							  (long long) table->nTupUpd,
+							  (long long) table->nTupDel);
+		}
+
+		appendPQExpBufferStr(sql,
+							 ") as c(oid, relfilenode, bytes, "
+							 "       n_tup_ins, n_tup_upd, n_tup_del) "
+							 "    on s.oid = c.oid "
+							 " where s.relfilenode = c.relfilenode "
+							 "   and s.bytes = c.bytes "
+							 "   and s.n_tup_ins = c.n_tup_ins "
+							 "   and s.n_tup_upd = c.n_tup_upd "
+							 "   and s.n_tup_del = c.n_tup_del");
+
+		if (PQExpBufferBroken(sql))
+		{
+			log_error("Failed to build table sync query: out of memory");
+			destroyPQExpBuffer(sql);
+			return false;
+		}
+
+		context.parsedOk = false;
+
+		bool done =
+			pgsql_execute_with_params(dst, sql->data, 0, NULL, NULL,
+									  &context, &getUnchangedTableArray);
+
+		destroyPQExpBuffer(sql);
+
+		if (!done || !context.parsedOk)
+		{
+			log_error("Failed to compare the modification evidence of "
+					  "%d tables, see above for details",
+					  batchEnd - batchStart);
+			return false;
+		}
+	}
+
+	if (context.skippedCount > 0)
+	{
+		char bytesPretty[BUFSIZE] = { 0 };
+
+		(void) pretty_print_bytes(bytesPretty, sizeof(bytesPretty),
+								  context.skippedBytes);
+
+		log_info("Incremental mode: skipping %d tables (%s) "
+				 "unchanged since the previous run, "
+				 "now copying %d tables",
+				 context.skippedCount,
+				 bytesPretty,
+				 tableArray->count - context.skippedCount);
+	}
+	else
+	{
+		log_info("Incremental mode: no table evidence matches the "
+				 "previous run, copying all %d tables",
+				 tableArray->count);
+	}
+
+	return true;
+}
+
+
+/*
+ * getUnchangedTableArray parses the list of unchanged table OIDs and sets
+ * the excludeData flag on the matching source table entries.
+ */
+static void
+getUnchangedTableArray(void *ctx, PGresult *result)
+{
+	UnchangedTableContext *context = (UnchangedTableContext *) ctx;
+	CopyDataSpec *specs = context->specs;
+
+	if (PQnfields(result) != 1)
+	{
+		log_error("Query returned %d columns, expected 1", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	int errors = 0;
+	int nTuples = PQntuples(result);
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		char *value = PQgetvalue(result, rowNumber, 0);
+		uint32_t oid = 0;
+
+		if (!stringToUInt32(value, &oid))
+		{
+			log_error("Invalid unchanged table oid \"%s\"", value);
+			++errors;
+			continue;
+		}
+
+		SourceTable *table = NULL;
+
+		HASH_FIND(hh, specs->sourceTableHashByOid, &oid, sizeof(oid), table);
+
+		if (table == NULL)
+		{
+			log_error("Failed to find unchanged table %u "
+					  "in sourceTableHashByOid",
+					  oid);
+			++errors;
+			continue;
+		}
+
+		log_debug("Incremental mode: skipping unchanged table \"%s\".\"%s\"",
+				  table->nspname,
+				  table->relname);
+
+		table->excludeData = true;
+
+		++context->skippedCount;
+		context->skippedBytes += table->bytes;
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
+/*
+ * incremental_register_table_state registers the modification evidence that
+ * this run copied under in the pgcopydb.table_sync table on the target
+ * database, for the next --incremental run to compare against. The evidence
+ * of skipped tables is refreshed too, as it matched.
+ */
+bool
+incremental_register_table_state(CopyDataSpec *specs)
+{
+	SourceTableArray *tableArray = &(specs->sourceTableArray);
+
+	if (tableArray->count == 0)
+	{
+		return true;
+	}
+
+	PGSQL dst = { 0 };
+
+	if (!pgsql_init(&dst, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	dst.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	for (int batchStart = 0;
+		 batchStart < tableArray->count;
+		 batchStart += TABLE_SYNC_BATCH_SIZE)
+	{
+		int batchEnd = batchStart + TABLE_SYNC_BATCH_SIZE;
+
+		if (tableArray->count < batchEnd)
+		{
+			batchEnd = tableArray->count;
+		}
+
+		PQExpBuffer sql = createPQExpBuffer();
+
+		appendPQExpBufferStr(sql,
+							 "insert into pgcopydb.table_sync"
+							 "(oid, relfilenode, bytes, "
+							 " n_tup_ins, n_tup_upd, n_tup_del) "
+							 "values ");
+
+		for (int i = batchStart; i < batchEnd; i++)
+		{
+			SourceTable *table = &(tableArray->array[i]);
+
+			appendPQExpBuffer(sql,
+							  "%s(%u::oid, %lld, %lld, %lld, %lld, %lld)",
+							  i == batchStart ? "" : ", ",
+							  table->oid,
+							  (long long) table->relfilenode,
+							  (long long) table->bytes,
+							  (long long) table->nTupIns,
+							  (long long) table->nTupUpd,
+							  (long long) table->nTupDel);
+		}
+
+		appendPQExpBufferStr(sql,
+							 " on conflict (oid) do update "
+							 "   set relfilenode = excluded.relfilenode, "
+							 "       bytes = excluded.bytes, "
+							 "       n_tup_ins = excluded.n_tup_ins, "
+							 "       n_tup_upd = excluded.n_tup_upd, "
+							 "       n_tup_del = excluded.n_tup_del, "
+							 "       synced_at = now()");
+
+		if (PQExpBufferBroken(sql))
+		{
+			log_error("Failed to build table sync query: out of memory");
+			destroyPQExpBuffer(sql);
+			return false;
+		}
+
+		if (!pgsql_execute(&dst, sql->data))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(sql);
+			return false;
+		}
+
+		destroyPQExpBuffer(sql);
+	}
+
+	(void) pgsql_finish(&dst);
+
+	log_info("Registered the modification evidence of %d tables "
+			 "for the next --incremental run",
+			 tableArray->count);
+
+	return true;
+}
@@ -13,6 +13,8 @@
 #include "env_utils.h"
 #include "lock_utils.h"
 #include "log.h"
+#include "mem_utils.h"
+#include "metrics.h"
 #include "pidfile.h"
 #include "schema.h"
 #include "signals.h"
@@ -28,7 +30,15 @@ bool
 copydb_start_index_workers(CopyDataSpec *specs)
 {
 	log_info("STEP 6: starting %d CREATE INDEX processes", specs->indexJobs);
-	log_info("STEP 7: constraints are built by the CREATE INDEX processes");
+
+	specs->indexWorkerPids =
+		(pid_t *) calloc(specs->indexJobs, sizeof(pid_t));
+
+	if (specs->indexWorkerPids == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
 
 	for (int i = 0; i < specs->indexJobs; i++)
 	{
@@ -52,7 +62,7 @@ copydb_start_index_workers(CopyDataSpec *specs)
 			case 0:
 			{
 				/* child process runs the command */
-				if (!copydb_index_worker(specs))
+				if (!copydb_index_worker(specs, i))
 				{
 					/* errors have already been logged */
 					exit(EXIT_CODE_INTERNAL_ERROR);
@@ -64,6 +74,7 @@ copydb_start_index_workers(CopyDataSpec *specs)
 			default:
 			{
 				/* fork succeeded, in parent */
+				specs->indexWorkerPids[i] = fpid;
 				break;
 			}
 		}
@@ -73,13 +84,68 @@ copydb_start_index_workers(CopyDataSpec *specs)
 }
 
 
+/*
+ * copydb_wait_for_index_workers waits until all the CREATE INDEX worker
+ * processes have exited, and only those: other sub-processes (vacuum,
+ * constraints, blobs, sequences) are left running.
+ */
+bool
+copydb_wait_for_index_workers(CopyDataSpec *specs)
+{
+	bool allReturnCodeAreZero = true;
+
+	log_debug("Waiting for %d CREATE INDEX worker processes to finish",
+			  specs->indexJobs);
+
+	for (int i = 0; i < specs->indexJobs; i++)
+	{
+		int status;
+
+		if (waitpid(specs->indexWorkerPids[i], &status, 0) == -1)
+		{
+			log_error("Failed to wait for CREATE INDEX worker %d: %m",
+					  specs->indexWorkerPids[i]);
+			allReturnCodeAreZero = false;
+			continue;
+		}
+
+		int returnCode = WEXITSTATUS(status);
+
+		if (returnCode == 0)
+		{
+			log_debug("Sub-processes %d exited with code %d",
+					  specs->indexWorkerPids[i], returnCode);
+		}
+		else
+		{
+			allReturnCodeAreZero = false;
+
+			log_error("Sub-processes %d exited with code %d",
+					  specs->indexWorkerPids[i], returnCode);
+		}
+	}
+
+	free(specs->indexWorkerPids);
+	specs->indexWorkerPids = NULL;
+
+	return allReturnCodeAreZero;
+}
+
+
 /*
  * copydb_index_worker is a worker process that loops over messages received
  * from a queue, each message being the Oid of an index to create on the target
  * database.
+ *
+ * Index builds overlap the COPY phase: tables queue their indexes as soon as
+ * their own COPY is done, while large COPY processes are still running. The
+ * workerIndex implements the --index-jobs-while-copy budget: only the first
+ * workers build indexes during the COPY phase, so that the CREATE INDEX heap
+ * scans do not starve the remaining large COPY streams of I/O; the other
+ * workers join when the COPY phase is over.
  */
 bool
-copydb_index_worker(CopyDataSpec *specs)
+copydb_index_worker(CopyDataSpec *specs, int workerIndex)
 {
 	int errors = 0;
 	bool stop = false;
@@ -88,43 +154,90 @@ copydb_index_worker(CopyDataSpec *specs)
 
 	while (!stop)
 	{
-		QMessage mesg = { 0 };
+		QMessage mesgs[QUEUE_RECEIVE_BATCH_SIZE] = { 0 };
+
+		/*
+		 * Receive a single message at a time. A CREATE INDEX command runs
+		 * for seconds or minutes, so the queue round trips are noise here;
+		 * and because one table's indexes are queued contiguously, taking
+		 * them one by one spreads them over all the workers at once, where
+		 * Postgres synchronized sequential scans let the concurrent builds
+		 * share a single heap pass instead of each scanning the table.
+		 */
+		int count = 1;
 
 		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
 		{
 			return false;
 		}
 
-		if (!queue_receive(&(specs->indexQueue), &mesg))
+		if (!queue_receive_batch(&(specs->indexQueue), mesgs, &count))
 		{
 			/* errors have already been logged */
 			break;
 		}
 
-		switch (mesg.type)
+		/* sample the queue depth, helps spotting index backlog build-up */
+		int depth = 0;
+
+		if (queue_depth(&(specs->indexQueue), &depth))
 		{
-			case QMSG_TYPE_STOP:
-			{
-				stop = true;
-				log_debug("Stop message received by create index worker");
-				break;
-			}
+			(void) metrics_emit(specs->cfPaths.metricsfile,
+								"index-queue-depth", 0, depth, 0);
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			QMessage *mesg = &(mesgs[i]);
 
-			case QMSG_TYPE_INDEXOID:
+			switch (mesg->type)
 			{
-				if (!copydb_create_index_by_oid(specs, mesg.data.oid))
+				case QMSG_TYPE_STOP:
 				{
-					++errors;
+					if (stop)
+					{
+						/* this STOP message belongs to a sibling worker */
+						(void) queue_send(&(specs->indexQueue), mesg);
+					}
+					else
+					{
+						stop = true;
+						log_debug("Stop message received by create index worker");
+					}
+					break;
 				}
-				break;
-			}
 
-			default:
-			{
-				log_error("Received unknown message type %ld on index queue %d",
-						  mesg.type,
-						  specs->indexQueue.qId);
-				break;
+				case QMSG_TYPE_INDEXOID:
+				{
+					/*
+					 * Over-budget workers push the message back and sleep a
+					 * little, rather than block outside of the queue: this
+					 * way they still receive their STOP message when the
+					 * COPY phase errors out before writing its done file.
+					 */
+					if (workerIndex >= specs->indexJobsWhileCopy &&
+						!file_exists(specs->cfPaths.done.tables))
+					{
+						(void) queue_send(&(specs->indexQueue), mesg);
+						pg_usleep(1 * 1000 * 1000);
+						break;
+					}
+
+					if (!copydb_create_index_by_oid(specs, mesg->data.oid))
+					{
+						++errors;
+					}
+					break;
+				}
+
+				default:
+				{
+					log_error("Received unknown message type %ld "
+							  "on index queue %d",
+							  mesg->type,
+							  specs->indexQueue.qId);
+					break;
+				}
 			}
 		}
 	}
@@ -133,6 +246,51 @@ copydb_index_worker(CopyDataSpec *specs)
 }
 
 
+/*
+ * copydb_index_steal_work lets an idle COPY worker process lend a hand to
+ * the CREATE INDEX workers: receive one message from the CREATE INDEX queue
+ * when one is immediately available, and build that index.
+ *
+ * Late in a run the remaining tables are all claimed by a few COPY workers
+ * while the CREATE INDEX queue backs up: stealing from the queue keeps the
+ * host parallelism constant without restarting any process. The stolen
+ * builds come on top of the --index-jobs-while-copy budget, which caps the
+ * dedicated workers only: a stealing worker uses a COPY slot that just got
+ * idle.
+ */
+bool
+copydb_index_steal_work(CopyDataSpec *specs, bool *helped)
+{
+	QMessage mesg = { 0 };
+	bool received = false;
+
+	*helped = false;
+
+	if (!queue_receive_nowait(&(specs->indexQueue), &mesg, &received))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!received)
+	{
+		return true;
+	}
+
+	if (mesg.type == QMSG_TYPE_INDEXOID)
+	{
+		*helped = true;
+
+		return copydb_create_index_by_oid(specs, mesg.data.oid);
+	}
+
+	/* STOP (and unknown) messages belong to the dedicated index workers */
+	(void) queue_send(&(specs->indexQueue), &mesg);
+
+	return true;
+}
+
+
 /*
  * copydb_create_index_by_oid finds the SourceIndex entry by its OID and then
  * creates the index on the target database.
@@ -200,7 +358,7 @@ copydb_create_index_by_oid(CopyDataSpec *specs, uint32_t indexOid)
 		specs->resume || specs->section == DATA_SECTION_INDEXES;
 
 	/* child process runs the command */
-	if (!copydb_create_index(specs->target_pguri,
+	if (!copydb_create_index(specs,
 							 index,
 							 &indexPaths,
 							 &(specs->indexSemaphore),
@@ -232,11 +390,24 @@ copydb_create_index_by_oid(CopyDataSpec *specs, uint32_t indexOid)
 
 	if (builtAllIndexes && !constraintsAreBeingBuilt)
 	{
-		if (!copydb_create_constraints(specs, table))
+		/*
+		 * The constraints are built by their own pool of worker processes,
+		 * so that several tables' ALTER TABLE ... ADD CONSTRAINT commands
+		 * run concurrently while this worker goes back to building indexes.
+		 */
+		QMessage mesg = {
+			.type = QMSG_TYPE_TABLEOID,
+			.data.oid = table->oid
+		};
+
+		log_debug("Queueing constraints for table \"%s\".\"%s\" [%u]",
+				  table->nspname,
+				  table->relname,
+				  table->oid);
+
+		if (!queue_send(&(specs->constraintQueue), &mesg))
 		{
-			log_error("Failed to create constraints for table \"%s\".\"%s\"",
-					  table->nspname,
-					  table->relname);
+			/* errors have already been logged */
 			return false;
 		}
 	}
@@ -322,37 +493,108 @@ copydb_table_indexes_are_done(CopyDataSpec *specs,
 
 
 /*
- * copydb_add_table_indexes sends a message to the CREATE INDEX process queue
+ * compareIndexesBySize is a qsort callback that sorts indexes by their
+ * estimated build cost, largest first, using pg_relation_size() as measured
+ * on the source database as the cost estimate.
+ */
+static int
+compareIndexesBySize(const void *a, const void *b)
+{
+	SourceIndex *lha = *(SourceIndex **) a;
+	SourceIndex *rha = *(SourceIndex **) b;
+
+	if (lha->bytes < rha->bytes)
+	{
+		return 1;
+	}
+
+	if (lha->bytes > rha->bytes)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * copydb_add_table_indexes sends messages to the CREATE INDEX process queue
  * to process indexes attached to the given table.
+ *
+ * The indexes are queued largest first: the workers all pull from the same
+ * shared queue, so scheduling the most expensive builds first balances the
+ * total build cost across --index-jobs workers and avoids finishing the run
+ * with a single worker busy on the biggest index.
+ *
+ * All of a table's indexes are sent in a single batch, keeping them
+ * contiguous in the queue: workers then build one table's indexes
+ * concurrently before moving on to the next table, sharing heap scans
+ * thanks to Postgres synchronized sequential scans.
  */
 bool
 copydb_add_table_indexes(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 {
+	int count = 0;
 	SourceIndexList *indexListEntry = tableSpecs->sourceTable->firstIndex;
 
 	for (; indexListEntry != NULL; indexListEntry = indexListEntry->next)
 	{
-		SourceIndex *index = indexListEntry->index;
+		++count;
+	}
 
-		QMessage mesg = {
-			.type = QMSG_TYPE_INDEXOID,
-			.data.oid = index->indexOid
-		};
+	if (count == 0)
+	{
+		return true;
+	}
+
+	SourceIndex **indexes =
+		(SourceIndex **) calloc(count, sizeof(SourceIndex *));
+
+	QMessage *mesgs = (QMessage *) calloc(count, sizeof(QMessage));
+
+	if (indexes == NULL || mesgs == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	int i = 0;
+
+	for (indexListEntry = tableSpecs->sourceTable->firstIndex;
+		 indexListEntry != NULL;
+		 indexListEntry = indexListEntry->next)
+	{
+		indexes[i++] = indexListEntry->index;
+	}
+
+	qsort(indexes, count, sizeof(SourceIndex *), compareIndexesBySize);
+
+	for (i = 0; i < count; i++)
+	{
+		SourceIndex *index = indexes[i];
+
+		mesgs[i].type = QMSG_TYPE_INDEXOID;
+		mesgs[i].data.oid = index->indexOid;
 
 		log_trace("Queueing index \"%s\".\"%s\" [%u] for table %s [%u]",
 				  index->indexNamespace,
 				  index->indexRelname,
-				  mesg.data.oid,
+				  index->indexOid,
 				  tableSpecs->qname,
 				  tableSpecs->sourceTable->oid);
+	}
 
-		if (!queue_send(&(specs->indexQueue), &mesg))
-		{
-			/* errors have already been logged */
-			return false;
-		}
+	if (!queue_send_batch(&(specs->indexQueue), mesgs, count))
+	{
+		/* errors have already been logged */
+		free(indexes);
+		free(mesgs);
+		return false;
 	}
 
+	free(indexes);
+	free(mesgs);
+
 	return true;
 }
 
@@ -367,24 +609,223 @@ copydb_add_table_indexes(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 bool
 copydb_index_workers_send_stop(CopyDataSpec *specs)
 {
+	QMessage *stops =
+		(QMessage *) calloc(specs->indexJobs, sizeof(QMessage));
+
+	if (stops == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
 	for (int i = 0; i < specs->indexJobs; i++)
 	{
-		QMessage stop = { .type = QMSG_TYPE_STOP, .data.oid = 0 };
+		stops[i].type = QMSG_TYPE_STOP;
+	}
+
+	log_debug("Send %d STOP messages to CREATE INDEX queue %d",
+			  specs->indexJobs,
+			  specs->indexQueue.qId);
 
-		log_debug("Send STOP message to CREATE INDEX queue %d",
-				  specs->indexQueue.qId);
+	if (!queue_send_batch(&(specs->indexQueue), stops, specs->indexJobs))
+	{
+		/* errors have already been logged */
+		free(stops);
+		return false;
+	}
+
+	free(stops);
+
+	return true;
+}
 
-		if (!queue_send(&(specs->indexQueue), &stop))
+
+/*
+ * copydb_start_constraint_workers create as many sub-process as needed, per
+ * --index-jobs. The constraint workers pick entire tables from their queue,
+ * where a table is only added once all its indexes have been built.
+ */
+bool
+copydb_start_constraint_workers(CopyDataSpec *specs)
+{
+	log_info("STEP 7: starting %d constraint processes", specs->indexJobs);
+
+	for (int i = 0; i < specs->indexJobs; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork a worker process: %m");
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				if (!copydb_constraint_worker(specs))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_constraint_worker is a worker process that loops over messages
+ * received from a queue, each message being the Oid of a table which
+ * constraints are to be created on the target database.
+ */
+bool
+copydb_constraint_worker(CopyDataSpec *specs)
+{
+	int errors = 0;
+	bool stop = false;
+
+	log_notice("Started constraint worker %d [%d]", getpid(), getppid());
+
+	while (!stop)
+	{
+		QMessage mesg = { 0 };
+
+		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
+		{
+			return false;
+		}
+
+		if (!queue_receive(&(specs->constraintQueue), &mesg))
 		{
 			/* errors have already been logged */
-			continue;
+			break;
 		}
+
+		switch (mesg.type)
+		{
+			case QMSG_TYPE_STOP:
+			{
+				stop = true;
+				log_debug("Stop message received by constraint worker");
+				break;
+			}
+
+			case QMSG_TYPE_TABLEOID:
+			{
+				if (!copydb_create_constraints_by_oid(specs, mesg.data.oid))
+				{
+					++errors;
+				}
+				break;
+			}
+
+			default:
+			{
+				log_error("Received unknown message type %ld "
+						  "on constraint queue %d",
+						  mesg.type,
+						  specs->constraintQueue.qId);
+				break;
+			}
+		}
+	}
+
+	return stop == true && errors == 0;
+}
+
+
+/*
+ * copydb_create_constraints_by_oid finds the SourceTable entry by its OID and
+ * then creates the constraints attached to its indexes on the target
+ * database.
+ */
+bool
+copydb_create_constraints_by_oid(CopyDataSpec *specs, uint32_t tableOid)
+{
+	uint32_t oid = tableOid;
+	SourceTable *table = NULL;
+
+	HASH_FIND(hh, specs->sourceTableHashByOid, &oid, sizeof(oid), table);
+
+	if (table == NULL)
+	{
+		log_error("Failed to find table %u in sourceTableHashByOid", oid);
+		return false;
+	}
+
+	if (!copydb_create_constraints(specs, table))
+	{
+		log_error("Failed to create constraints for table \"%s\".\"%s\"",
+				  table->nspname,
+				  table->relname);
+		return false;
 	}
 
 	return true;
 }
 
 
+/*
+ * copydb_constraint_workers_send_stop sends the STOP message to the
+ * constraint workers.
+ *
+ * Each worker will consume one STOP message before stopping, so we need to
+ * send as many STOP messages as we have started worker processes.
+ */
+bool
+copydb_constraint_workers_send_stop(CopyDataSpec *specs)
+{
+	QMessage *stops =
+		(QMessage *) calloc(specs->indexJobs, sizeof(QMessage));
+
+	if (stops == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int i = 0; i < specs->indexJobs; i++)
+	{
+		stops[i].type = QMSG_TYPE_STOP;
+	}
+
+	log_debug("Send %d STOP messages to constraint queue %d",
+			  specs->indexJobs,
+			  specs->constraintQueue.qId);
+
+	if (!queue_send_batch(&(specs->constraintQueue), stops, specs->indexJobs))
+	{
+		/* errors have already been logged */
+		free(stops);
+		return false;
+	}
+
+	free(stops);
+
+	return true;
+}
+
+
 /*
  * copydb_init_index_paths prepares a given index (and constraint) file paths
  * to help orchestrate the concurrent operations.
@@ -598,7 +1039,7 @@ copydb_start_index_process(CopyDataSpec *specs,
 
 		bool ifNotExists = true;
 
-		if (!copydb_create_index(specs->target_pguri,
+		if (!copydb_create_index(specs,
 								 index,
 								 indexPaths,
 								 &(specs->indexSemaphore),
@@ -615,6 +1056,76 @@ copydb_start_index_process(CopyDataSpec *specs,
 }
 
 
+/*
+ * copydb_set_index_session_gucs tunes maintenance_work_mem and
+ * max_parallel_maintenance_workers for a CREATE INDEX session, given the
+ * number of concurrent CREATE INDEX workers.
+ *
+ * When the --index-memory budget has been set, it is divided evenly across
+ * the --index-jobs workers; otherwise the dstSettings default of 1 GB per
+ * session applies. Parallel maintenance workers are scaled down as the
+ * index concurrency goes up, dividing a budget of 8 backends total across
+ * the --index-jobs sessions, each running one leader and its parallel
+ * workers.
+ */
+static bool
+copydb_set_index_session_gucs(CopyDataSpec *specs, PGSQL *dst)
+{
+	GUC settings[3] = { 0 };
+	int count = 0;
+
+	char workMem[NAMEDATALEN] = { 0 };
+	char parallelWorkers[NAMEDATALEN] = { 0 };
+
+	if (specs->indexMemory > 0)
+	{
+		uint64_t perWorkerKB = specs->indexMemory / specs->indexJobs / 1024;
+
+		/* Postgres enforces a 64 kB minimum for maintenance_work_mem */
+		if (perWorkerKB < 64)
+		{
+			perWorkerKB = 64;
+		}
+
+		sformat(workMem, sizeof(workMem), "'%lld kB'",
+				(long long) perWorkerKB);
+
+		settings[count].name = "maintenance_work_mem";
+		settings[count].value = workMem;
+		++count;
+	}
+
+	int workers = 8 / specs->indexJobs - 1;
+
+	if (workers < 0)
+	{
+		workers = 0;
+	}
+
+	sformat(parallelWorkers, sizeof(parallelWorkers), "%d", workers);
+
+	settings[count].name = "max_parallel_maintenance_workers";
+	settings[count].value = parallelWorkers;
+	++count;
+
+	if (!pgsql_set_gucs(dst, settings))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* --target-session-gucs may then override the computed settings */
+	if (!IS_EMPTY_STRING_BUFFER(specs->targetSessionGucs) &&
+		!pgsql_set_session_gucs(dst, specs->targetSessionGucs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * copydb_create_indexes creates all the indexes for a given table in
  * parallel, using a sub-process to send each index command.
@@ -624,7 +1135,7 @@ copydb_start_index_process(CopyDataSpec *specs,
  * processed by only one worker: no same-index concurrency.
  */
 bool
-copydb_create_index(const char *pguri,
+copydb_create_index(CopyDataSpec *specs,
 					SourceIndex *index,
 					IndexFilePaths *indexPaths,
 					Semaphore *lockFileSemaphore,
@@ -725,7 +1236,7 @@ copydb_create_index(const char *pguri,
 
 	log_info("%s", summary->command);
 
-	if (!pgsql_init(&dst, (char *) pguri, PGSQL_CONN_TARGET))
+	if (!pgsql_init(&dst, (char *) specs->target_pguri, PGSQL_CONN_TARGET))
 	{
 		return false;
 	}
@@ -738,6 +1249,14 @@ copydb_create_index(const char *pguri,
 		return false;
 	}
 
+	/* then tune the session for the CREATE INDEX concurrency level */
+	if (!copydb_set_index_session_gucs(specs, &dst))
+	{
+		log_fatal("Failed to set our CREATE INDEX session settings on the "
+				  "target connection, see above for details");
+		return false;
+	}
+
 	if (!pgsql_execute(&dst, summary->command))
 	{
 		/* errors have already been logged */
@@ -756,6 +1275,35 @@ copydb_create_index(const char *pguri,
 		return false;
 	}
 
+	/* update the live progress counters */
+	if (specs->progress != NULL)
+	{
+		copydb_progress_add(constraint
+							? &(specs->progress->constraintDoneCount)
+							: &(specs->progress->indexDoneCount),
+							1);
+	}
+
+	/* append a record to the binary summary log, ignoring errors */
+	SummaryRecord record = {
+		.type = constraint ? SUMMARY_RECORD_CONSTRAINT : SUMMARY_RECORD_INDEX,
+		.oid = index->indexOid,
+		.partNumber = 0,
+		.pid = summary->pid,
+		.startTime = summary->startTime,
+		.doneTime = summary->doneTime,
+		.durationMs = summary->durationMs
+	};
+
+	(void) summary_append_record(specs->cfPaths.summarylog, &record);
+
+	/* and sample a metrics data point for `pgcopydb list metrics` */
+	(void) metrics_emit(specs->cfPaths.metricsfile,
+						constraint ? "create-constraint" : "create-index",
+						index->indexOid,
+						0,
+						summary->durationMs);
+
 	return true;
 }
 
@@ -1178,13 +1726,38 @@ copydb_create_constraints(CopyDataSpec *specs, SourceTable *table)
 			log_error("Failed to remove the lockFile \"%s\"", lockFile);
 			continue;
 		}
+
+		/* update the live progress counters */
+		if (specs->progress != NULL)
+		{
+			copydb_progress_add(&(specs->progress->constraintDoneCount), 1);
+		}
+
+		/* append a record to the binary summary log, ignoring errors */
+		SummaryRecord record = {
+			.type = SUMMARY_RECORD_CONSTRAINT,
+			.oid = index->indexOid,
+			.partNumber = 0,
+			.pid = summary.pid,
+			.startTime = summary.startTime,
+			.doneTime = summary.doneTime,
+			.durationMs = summary.durationMs
+		};
+
+		(void) summary_append_record(specs->cfPaths.summarylog, &record);
+
+		(void) metrics_emit(specs->cfPaths.metricsfile,
+							"create-constraint",
+							index->indexOid,
+							0,
+							summary.durationMs);
 	}
 
 	/* close connection to the target database now */
 	(void) pgsql_finish(&dst);
 
-	/* free malloc'ed memory area */
-	free(dstIndexArray.array);
+	/* release the index array arena in a single call */
+	arena_release(&(dstIndexArray.arena));
 
 	return errors == 0;
 }
@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -23,6 +24,7 @@
 #include "ld_stream.h"
 #include "lock_utils.h"
 #include "log.h"
+#include "metrics.h"
 #include "parsing_utils.h"
 #include "pidfile.h"
 #include "pg_utils.h"
@@ -31,6 +33,70 @@
 #include "string_utils.h"
 #include "summary.h"
 
+/*
+ * DML statements within a transaction are batched into a single
+ * multi-statement query string, so that apply throughput is bounded by the
+ * target server rather than by one network round trip per statement.
+ */
+#define STREAM_APPLY_BATCH_SIZE (512 * 1024)
+
+/*
+ * An OLTP source producing thousands of tiny transactions per second would
+ * have us pay one WAL flush on the target per source COMMIT. Group commit
+ * folds several consecutive source transactions into a single transaction on
+ * the target, committing when enough source transactions have been grouped
+ * or when the group has been open for long enough.
+ *
+ * The replication origin tracking is registered again at each source BEGIN,
+ * so that the target commit records the latest replayed LSN, and an
+ * interrupted apply process restarts from the batched flush position.
+ */
+#define STREAM_APPLY_GROUP_COMMIT_TXNS 64
+#define STREAM_APPLY_GROUP_COMMIT_TIMEOUT_MS 50
+
+/*
+ * SQL files are replayed in windows of that many lines, scanned
+ * incrementally: replay starts after scanning the first window rather than
+ * after splitting a whole multi-gigabyte catch-up segment into lines.
+ * Windows end at transaction boundaries, see stream_apply_file.
+ */
+#define STREAM_APPLY_WINDOW_LINES 4096
+
+static bool stream_apply_flush_batch(PGSQL *pgsql, PQExpBuffer batch);
+static bool stream_apply_prepared_statement(StreamApplyContext *context,
+											const char *sql);
+static void stream_apply_listen_wait(StreamApplyContext *context);
+
+static void stream_apply_track_lag(StreamApplyContext *context,
+								   LogicalMessageMetadata *metadata);
+static uint64_t stream_apply_lag_percentile(StreamApplyContext *context,
+											double fraction);
+
+static bool stream_apply_start_workers(StreamSpecs *specs);
+static bool stream_apply_worker(StreamSpecs *specs,
+								int slot,
+								StreamApplySharedLSN *sharedLSN);
+static bool stream_apply_ensure_worker_origin(StreamSpecs *specs,
+											  char *nodeName);
+static bool stream_apply_partitioned_line(StreamApplyContext *context,
+										  StreamContent *content,
+										  int pos,
+										  LogicalMessageMetadata *metadata,
+										  bool *done);
+static bool stream_apply_txn_partition(StreamApplyContext *context,
+									   StreamContent *content,
+									   int begin,
+									   int *partition,
+									   bool *crossPartition);
+static bool stream_apply_relation_hash(const char *sql,
+									   uint64_t *hash,
+									   bool *found);
+static bool stream_apply_wait_for_slot(StreamApplyContext *context,
+									   int slot,
+									   uint64_t lsn);
+static void stream_apply_publish_lsn(StreamApplyContext *context,
+									 uint64_t lsn);
+
 
 /*
  * stream_apply_catchup catches up with SQL files that have been prepared by
@@ -38,9 +104,126 @@
  */
 bool
 stream_apply_catchup(StreamSpecs *specs)
+{
+	/* the opt-in parallel apply mode partitions transactions by relation */
+	if (specs->applyJobs > 1)
+	{
+		return stream_apply_start_workers(specs);
+	}
+
+	return stream_apply_worker(specs, 0, NULL);
+}
+
+
+/*
+ * stream_apply_start_workers creates as many apply worker processes as
+ * --apply-jobs. The workers all scan the same SQL files: each one applies
+ * the transactions whose relations hash to its own partition and skips the
+ * other ones, so that all the changes to a given relation are replayed in
+ * their original order on the same target session.
+ */
+static bool
+stream_apply_start_workers(StreamSpecs *specs)
+{
+	SharedMemSegment segment = { 0 };
+
+	if (!shmseg_create(&segment, sizeof(StreamApplySharedLSN)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	StreamApplySharedLSN *sharedLSN = (StreamApplySharedLSN *) segment.ptr;
+
+	log_info("Starting %d parallel apply processes", specs->applyJobs);
+
+	for (int i = 0; i < specs->applyJobs; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork an apply worker process: %m");
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				if (!stream_apply_worker(specs, i, sharedLSN))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				break;
+			}
+		}
+	}
+
+	bool success = copydb_wait_for_subprocesses();
+
+	(void) shmseg_detach(&segment);
+
+	return success;
+}
+
+
+/*
+ * stream_apply_worker implements the main apply loop over the prepared SQL
+ * files, either as the single apply process or as one of the --apply-jobs
+ * parallel apply workers, each connected to the target database with its own
+ * session and replication origin.
+ */
+static bool
+stream_apply_worker(StreamSpecs *specs, int slot, StreamApplySharedLSN *sharedLSN)
 {
 	StreamApplyContext context = { 0 };
 
+	/* LISTEN to sentinel changes, polling only as a fallback */
+	context.listening = true;
+
+	strlcpy(context.targetSessionGucs,
+			specs->targetSessionGucs,
+			sizeof(context.targetSessionGucs));
+
+	context.applyJobs = specs->applyJobs;
+	context.applySlot = slot;
+	context.sharedLSN = sharedLSN;
+
+	/* each parallel apply worker tracks progress in its own origin */
+	char origin[BUFSIZE] = { 0 };
+
+	if (sharedLSN != NULL)
+	{
+		sformat(origin, sizeof(origin), "%s_p%d", specs->origin, slot);
+
+		if (!stream_apply_ensure_worker_origin(specs, origin))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else
+	{
+		strlcpy(origin, specs->origin, sizeof(origin));
+	}
+
 	/* in prefetch mode, wait until the sentinel enables the apply process */
 	if (specs->mode == STREAM_MODE_PREFETCH)
 	{
@@ -67,7 +250,7 @@ stream_apply_catchup(StreamSpecs *specs)
 								&(specs->paths),
 								specs->source_pguri,
 								specs->target_pguri,
-								specs->origin,
+								origin,
 								specs->endpos,
 								context.apply))
 	{
@@ -75,6 +258,9 @@ stream_apply_catchup(StreamSpecs *specs)
 		return false;
 	}
 
+	/* let the sibling workers know where we start from */
+	(void) stream_apply_publish_lsn(&context, context.previousLSN);
+
 	log_info("Catching up from LSN %X/%X in \"%s\"",
 			 LSN_FORMAT_ARGS(context.previousLSN),
 			 context.sqlFileName);
@@ -112,7 +298,7 @@ stream_apply_catchup(StreamSpecs *specs)
 					  context.sqlFileName,
 					  CATCHINGUP_SLEEP_MS);
 
-			pg_usleep(CATCHINGUP_SLEEP_MS * 1000);
+			(void) stream_apply_listen_wait(&context);
 			continue;
 		}
 
@@ -167,14 +353,17 @@ stream_apply_catchup(StreamSpecs *specs)
 
 			/*
 			 * Sleep for a while (10s typically) then try again, new data might
-			 * have been appended to the same file again.
+			 * have been appended to the same file again. A notification from
+			 * the pgcopydb sentinel (new endpos, apply changes) wakes us up
+			 * before that.
 			 */
-			pg_usleep(CATCHINGUP_SLEEP_MS * 1000);
+			(void) stream_apply_listen_wait(&context);
 		}
 	}
 
 	/* we might still have to disconnect now */
 	(void) pgsql_finish(&(context.pgsql));
+	(void) pgsql_finish(&(context.source));
 
 	return true;
 }
@@ -190,6 +379,7 @@ stream_apply_wait_for_sentinel(StreamSpecs *specs, StreamApplyContext *context)
 {
 	PGSQL src = { 0 };
 	bool firstLoop = true;
+	bool listening = true;
 	CopyDBSentinel sentinel = { 0 };
 
 	if (!pgsql_init(&src, specs->source_pguri, PGSQL_CONN_SOURCE))
@@ -198,6 +388,9 @@ stream_apply_wait_for_sentinel(StreamSpecs *specs, StreamApplyContext *context)
 		return false;
 	}
 
+	/* keep the connection around so that we can LISTEN on it */
+	src.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
 	while (!sentinel.apply)
 	{
 		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
@@ -208,7 +401,18 @@ stream_apply_wait_for_sentinel(StreamSpecs *specs, StreamApplyContext *context)
 			return false;
 		}
 
-		/* this reconnects on each loop iteration, every 10s by default */
+		/* (re)arm our LISTEN whenever (re)connecting to the source */
+		if (listening && src.connection == NULL)
+		{
+			if (!pgsql_listen(&src, PGCOPYDB_SENTINEL_CHANNEL))
+			{
+				log_warn("Failed to LISTEN to \"%s\", "
+						 "now polling the pgcopydb sentinel table",
+						 PGCOPYDB_SENTINEL_CHANNEL);
+				listening = false;
+			}
+		}
+
 		if (!pgsql_get_sentinel(&src, &sentinel))
 		{
 			log_warn("Retrying to fetch pgcopydb sentinel values in %ds",
@@ -239,16 +443,124 @@ stream_apply_wait_for_sentinel(StreamSpecs *specs, StreamApplyContext *context)
 			log_info("Waiting until the pgcopydb sentinel apply is enabled");
 		}
 
-		/* avoid buzy looping and avoid hammering the source database */
-		pg_usleep(CATCHINGUP_SLEEP_MS * 1000);
+		/*
+		 * Wait until the sentinel has been changed on the source database,
+		 * which we get notified about thanks to our LISTEN command; or poll
+		 * again after the usual timeout. Either way we avoid buzy looping and
+		 * avoid hammering the source database.
+		 */
+		if (listening && src.connection != NULL)
+		{
+			bool received = false;
+
+			if (!pgsql_wait_for_notification(&src,
+											 PGCOPYDB_SENTINEL_CHANNEL,
+											 CATCHINGUP_SLEEP_MS,
+											 &received))
+			{
+				/* errors have already been logged */
+				listening = false;
+			}
+		}
+		else
+		{
+			pg_usleep(CATCHINGUP_SLEEP_MS * 1000);
+		}
 	}
 
+	(void) pgsql_finish(&src);
+
 	log_info("The pgcopydb sentinel has enabled applying changes");
 
 	return true;
 }
 
 
+/*
+ * stream_apply_track_lag registers the end-to-end latency of a source
+ * transaction — from its commit timestamp on the source to the moment it has
+ * been applied on the target — in a histogram of power-of-two milliseconds
+ * buckets. Lag tracking is best-effort instrumentation and never fails the
+ * apply.
+ */
+static void
+stream_apply_track_lag(StreamApplyContext *context,
+					   LogicalMessageMetadata *metadata)
+{
+	if (IS_EMPTY_STRING_BUFFER(metadata->timestamp))
+	{
+		return;
+	}
+
+	uint64_t commitMs = 0;
+
+	if (!pgsql_timestamptz_from_string(metadata->timestamp, &commitMs))
+	{
+		/* errors have already been logged */
+		return;
+	}
+
+	struct timeval tv = { 0 };
+
+	if (gettimeofday(&tv, NULL) != 0)
+	{
+		return;
+	}
+
+	uint64_t nowMs =
+		((uint64_t) tv.tv_sec) * 1000 + ((uint64_t) tv.tv_usec) / 1000;
+
+	/* clock skew between source and target could produce a negative lag */
+	uint64_t lagMs = nowMs > commitMs ? nowMs - commitMs : 0;
+
+	int bucket = 0;
+
+	while (bucket < STREAM_APPLY_LAG_BUCKETS - 1 && (1ULL << bucket) <= lagMs)
+	{
+		++bucket;
+	}
+
+	++context->lagHistogram[bucket];
+	++context->lagTxnCount;
+}
+
+
+/*
+ * stream_apply_lag_percentile computes a percentile of the lag histogram,
+ * reported as the upper bound (in milliseconds) of the bucket where the
+ * percentile falls.
+ */
+static uint64_t
+stream_apply_lag_percentile(StreamApplyContext *context, double fraction)
+{
+	if (context->lagTxnCount == 0)
+	{
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t) (fraction * context->lagTxnCount + 0.5);
+
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+
+	for (int bucket = 0; bucket < STREAM_APPLY_LAG_BUCKETS; bucket++)
+	{
+		seen += context->lagHistogram[bucket];
+
+		if (seen >= rank)
+		{
+			return 1ULL << bucket;
+		}
+	}
+
+	return 1ULL << (STREAM_APPLY_LAG_BUCKETS - 1);
+}
+
+
 /*
  * stream_apply_sync_sentinel sync with the pgcopydb sentinel table, sending
  * the current replay LSN position and fetching the maybe new endpos and apply
@@ -266,9 +578,61 @@ stream_apply_sync_sentinel(StreamApplyContext *context)
 		return false;
 	}
 
-	if (!pgsql_sync_sentinel_apply(&src, context->previousLSN, &sentinel))
+	/*
+	 * In parallel apply mode only worker 0 reports the replay progress, as
+	 * the minimum of the per-worker replayed positions; the other workers
+	 * only fetch the current sentinel values.
+	 */
+	if (context->sharedLSN != NULL && context->applySlot > 0)
+	{
+		if (!pgsql_get_sentinel(&src, &sentinel))
+		{
+			log_warn("Failed to fetch the pgcopydb sentinel values");
+		}
+	}
+	else
 	{
-		log_warn("Failed to sync progress with the pgcopydb sentinel");
+		uint64_t replayLSN = context->previousLSN;
+
+		if (context->sharedLSN != NULL)
+		{
+			for (int s = 0; s < context->applyJobs; s++)
+			{
+				uint64_t lsn = context->sharedLSN->replayedLSN[s];
+
+				/* skip over workers that did not publish yet */
+				if (lsn != InvalidXLogRecPtr && lsn < replayLSN)
+				{
+					replayLSN = lsn;
+				}
+			}
+		}
+
+		/*
+		 * The lag percentiles are computed from this process' histogram; in
+		 * parallel apply mode that covers worker 0's own transactions.
+		 */
+		CopyDBApplyLag lag = {
+			.p50 = stream_apply_lag_percentile(context, 0.50),
+			.p95 = stream_apply_lag_percentile(context, 0.95),
+			.p99 = stream_apply_lag_percentile(context, 0.99),
+			.txns = context->lagTxnCount
+		};
+
+		if (!pgsql_sync_sentinel_apply(&src, replayLSN, &lag, &sentinel))
+		{
+			log_warn("Failed to sync progress with the pgcopydb sentinel");
+		}
+
+		if (lag.txns > 0)
+		{
+			(void) metrics_emit(context->paths.metricsfile,
+								"apply-lag-p50", 0, lag.txns, lag.p50);
+			(void) metrics_emit(context->paths.metricsfile,
+								"apply-lag-p95", 0, lag.txns, lag.p95);
+			(void) metrics_emit(context->paths.metricsfile,
+								"apply-lag-p99", 0, lag.txns, lag.p99);
+		}
 	}
 
 	context->apply = sentinel.apply;
@@ -279,6 +643,68 @@ stream_apply_sync_sentinel(StreamApplyContext *context)
 }
 
 
+/*
+ * stream_apply_listen_wait waits for up to CATCHINGUP_SLEEP_MS before the
+ * caller retries its main loop. Thanks to a LISTEN command registered on a
+ * connection to the source database, a change to the pgcopydb sentinel table
+ * (a new endpos, say) wakes us up immediately and is then fetched without
+ * waiting for the next polling interval.
+ */
+static void
+stream_apply_listen_wait(StreamApplyContext *context)
+{
+	PGSQL *src = &(context->source);
+
+	/* (re)arm our LISTEN whenever (re)connecting to the source */
+	if (context->listening && src->connection == NULL)
+	{
+		if (!pgsql_init(src, context->source_pguri, PGSQL_CONN_SOURCE))
+		{
+			/* errors have already been logged */
+			context->listening = false;
+		}
+		else
+		{
+			/* keep the connection around so that we can LISTEN on it */
+			src->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+			if (!pgsql_listen(src, PGCOPYDB_SENTINEL_CHANNEL))
+			{
+				log_warn("Failed to LISTEN to \"%s\", "
+						 "now polling the pgcopydb sentinel table",
+						 PGCOPYDB_SENTINEL_CHANNEL);
+				context->listening = false;
+			}
+		}
+	}
+
+	if (context->listening && src->connection != NULL)
+	{
+		bool received = false;
+
+		if (!pgsql_wait_for_notification(src,
+										 PGCOPYDB_SENTINEL_CHANNEL,
+										 CATCHINGUP_SLEEP_MS,
+										 &received))
+		{
+			/* errors have already been logged */
+			context->listening = false;
+			return;
+		}
+
+		if (received)
+		{
+			/* fetch the new sentinel values right away */
+			(void) stream_apply_sync_sentinel(context);
+		}
+	}
+	else
+	{
+		pg_usleep(CATCHINGUP_SLEEP_MS * 1000);
+	}
+}
+
+
 /*
  * stream_apply_file connects to the target database system and applies the
  * given SQL file as prepared by the stream_transform_file function.
@@ -287,19 +713,46 @@ bool
 stream_apply_file(StreamApplyContext *context)
 {
 	StreamContent content = { 0 };
-	long size = 0L;
 
 	strlcpy(content.filename, context->sqlFileName, sizeof(content.filename));
 
-	if (!read_file(content.filename, &(content.buffer), &size))
+	/* map large files, inflate compressed ones, plain read small ones */
+	if (!read_file_mmap(content.filename,
+						&(content.buffer),
+						&(content.size),
+						&(content.mapped)))
 	{
 		/* errors have already been logged */
 		return false;
 	}
 
-	content.count = countLines(content.buffer);
-	content.lines = (char **) calloc(content.count, sizeof(char *));
-	content.count = splitLines(content.buffer, content.lines, content.count);
+	log_info("Replaying changes from file \"%s\"", context->sqlFileName);
+
+	PGSQL *pgsql = &(context->pgsql);
+
+	/* batch DML statements and send them in a single round trip */
+	if (context->sqlBatch == NULL)
+	{
+		context->sqlBatch = createPQExpBuffer();
+
+		if (context->sqlBatch == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return false;
+		}
+	}
+
+	/*
+	 * Rather than splitting the whole file into lines before replaying
+	 * anything, scan it incrementally in windows of complete transactions:
+	 * the first transaction is replayed after scanning the first window
+	 * only, instead of after two full passes over a possibly multi-gigabyte
+	 * catch-up segment, and the lines array is bounded by the window size
+	 * instead of the line count of the whole file.
+	 */
+	int capacity = STREAM_APPLY_WINDOW_LINES;
+
+	content.lines = (char **) calloc(capacity, sizeof(char *));
 
 	if (content.lines == NULL)
 	{
@@ -307,295 +760,1168 @@ stream_apply_file(StreamApplyContext *context)
 		return false;
 	}
 
-	log_info("Replaying changes from file \"%s\"", context->sqlFileName);
-
-	log_debug("Read %d lines in file \"%s\"",
-			  content.count,
-			  content.filename);
-
-	PGSQL *pgsql = &(context->pgsql);
-	bool reachedStartingPosition = false;
+	char *position = content.buffer;
+	uint64_t totalLineCount = 0;
 
-	/* replay the SQL commands from the SQL file */
-	for (int i = 0; i < content.count && !context->reachedEndPos; i++)
+	while (position != NULL && *position != '\0' && !context->reachedEndPos)
 	{
-		const char *sql = content.lines[i];
-		LogicalMessageMetadata metadata = { 0 };
+		/*
+		 * Scan the next window of lines, stopping at a transaction boundary
+		 * so that the parallel apply partitioning can always look ahead to
+		 * the COMMIT of a BEGIN found in the window. A single transaction
+		 * larger than the window grows the lines array as needed.
+		 */
+		uint64_t firstLineNumber = totalLineCount + 1;
+		bool inTxn = false;
+		bool lastLine = false;
 
-		StreamAction action = parseSQLAction(sql, &metadata);
+		content.count = 0;
 
-		switch (action)
+		while (*position != '\0')
 		{
-			case STREAM_ACTION_SWITCH:
+			if (content.count == capacity)
 			{
-				/*
-				 * The SWITCH WAL command should always be the last line of the
-				 * file...
-				 */
-				if (i != (content.count - 1))
+				if (!inTxn)
 				{
-					log_error("SWITCH command found in line %d, "
-							  "before last line %d",
-							  i + 1,
-							  content.count);
-					return false;
+					break;
 				}
 
-				log_debug("apply: SWITCH from %X/%X to %X/%X",
-						  LSN_FORMAT_ARGS(context->previousLSN),
-						  LSN_FORMAT_ARGS(metadata.lsn));
+				capacity *= 2;
+				content.lines =
+					(char **) realloc(content.lines,
+									  capacity * sizeof(char *));
 
-				context->previousLSN = metadata.lsn;
-
-				break;
+				if (content.lines == NULL)
+				{
+					log_error(ALLOCATION_FAILED_ERROR);
+					return false;
+				}
 			}
 
-			case STREAM_ACTION_BEGIN:
+			content.lines[content.count++] = position;
+
+			if (strncmp(position, OUTPUT_BEGIN, strlen(OUTPUT_BEGIN)) == 0)
 			{
-				/* did we reach the starting LSN positions now? */
-				if (!reachedStartingPosition)
-				{
-					reachedStartingPosition =
-						context->previousLSN < metadata.lsn;
-				}
+				inTxn = true;
+			}
+			else if (strncmp(position,
+							 OUTPUT_COMMIT,
+							 strlen(OUTPUT_COMMIT)) == 0)
+			{
+				inTxn = false;
+			}
 
-				log_debug("BEGIN %lld LSN %X/%X @%s, previous LSN %X/%X %s",
-						  (long long) metadata.xid,
-						  LSN_FORMAT_ARGS(metadata.lsn),
-						  metadata.timestamp,
-						  LSN_FORMAT_ARGS(context->previousLSN),
-						  reachedStartingPosition ? "" : "[skipping]");
+			char *newLinePtr = strchr(position, '\n');
 
-				if (metadata.lsn == InvalidXLogRecPtr ||
-					IS_EMPTY_STRING_BUFFER(metadata.timestamp))
-				{
-					log_fatal("Failed to parse BEGIN message: %s", sql);
-					return false;
-				}
+			if (newLinePtr == NULL)
+			{
+				lastLine = true;
+				position += strlen(position);
+			}
+			else
+			{
+				*newLinePtr = '\0';
+				position = newLinePtr + 1;
 
-				/*
-				 * Check if we reached the endpos LSN already.
-				 */
-				if (context->endpos != InvalidXLogRecPtr &&
-					context->endpos <= metadata.lsn)
-				{
-					context->reachedEndPos = true;
+				lastLine = *position == '\0';
+			}
+		}
 
-					log_info("Apply reached end position %X/%X at %X/%X.",
-							 LSN_FORMAT_ARGS(context->endpos),
-							 LSN_FORMAT_ARGS(metadata.lsn));
-					break;
-				}
+		totalLineCount += content.count;
 
-				/* actually skip this one if we didn't reach start pos yet */
-				if (!reachedStartingPosition)
-				{
-					continue;
-				}
+		/* replay the SQL commands of the current window */
+		for (int i = 0; i < content.count && !context->reachedEndPos; i++)
+		{
+			const char *sql = content.lines[i];
+			LogicalMessageMetadata metadata = { 0 };
 
-				/*
-				 * We're all good to replay that transaction, let's BEGIN and
-				 * register our origin tracking on the target database.
-				 */
-				if (!pgsql_begin(pgsql))
-				{
-					/* errors have already been logged */
-					return false;
-				}
+			StreamAction action = parseSQLAction(sql, &metadata);
+
+			/*
+			 * The SWITCH WAL command should always be the last line of the
+			 * file...
+			 */
+			if (action == STREAM_ACTION_SWITCH &&
+				!(lastLine && i == (content.count - 1)))
+			{
+				log_error("SWITCH command found in line %lld, "
+						  "before the last line of file \"%s\"",
+						  (long long) (firstLineNumber + i),
+						  content.filename);
+				return false;
+			}
 
-				char lsn[PG_LSN_MAXLENGTH] = { 0 };
+			metadata.action = action;
 
-				sformat(lsn, sizeof(lsn), "%X/%X",
-						LSN_FORMAT_ARGS(metadata.lsn));
+			/* in parallel apply mode, most transactions belong to a sibling */
+			if (context->applyJobs > 1)
+			{
+				bool done = false;
 
-				if (!pgsql_replication_origin_xact_setup(pgsql,
-														 lsn,
-														 metadata.timestamp))
+				if (!stream_apply_partitioned_line(context, &content, i,
+												   &metadata, &done))
 				{
 					/* errors have already been logged */
 					return false;
 				}
 
+				if (done)
+				{
+					continue;
+				}
+			}
+
+			if (!stream_apply_sql(context, &metadata, sql))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+	}
+
+	log_debug("Replayed %lld lines from file \"%s\"",
+			  (long long) totalLineCount,
+			  content.filename);
+
+	/* a COMMIT or KEEPALIVE always flushes, but better safe than sorry */
+	if (!stream_apply_flush_batch(pgsql, context->sqlBatch))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* commit an open group of transactions before moving to the next file */
+	if (context->txnOpen)
+	{
+		if (!pgsql_execute(pgsql, "COMMIT"))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		context->txnOpen = false;
+		context->groupTxnCount = 0;
+	}
+
+	/* free dynamic memory that's not needed anymore */
+	if (content.mapped)
+	{
+		(void) unmap_file(content.buffer, content.size);
+	}
+	else
+	{
+		free(content.buffer);
+	}
+
+	free(content.lines);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_partitioned_line implements the parallel apply partitioning:
+ * each worker scans every line of the SQL files, and replays only the
+ * transactions whose relations hash to its own partition. Transactions that
+ * touch relations from several partitions are applied by worker 0 only,
+ * behind a synchronization barrier with the other workers, so that
+ * per-relation ordering is preserved.
+ *
+ * When the current line is entirely handled here (it belongs to a skipped
+ * transaction), done is set to true and the caller skips stream_apply_sql.
+ */
+static bool
+stream_apply_partitioned_line(StreamApplyContext *context,
+							  StreamContent *content,
+							  int pos,
+							  LogicalMessageMetadata *metadata,
+							  bool *done)
+{
+	*done = false;
+
+	switch (metadata->action)
+	{
+		case STREAM_ACTION_BEGIN:
+		{
+			/* reaching the endpos belongs to stream_apply_sql */
+			if (context->endpos != InvalidXLogRecPtr &&
+				context->endpos <= metadata->lsn)
+			{
+				return true;
+			}
+
+			/* transactions before the starting position are skipped anyway */
+			bool wouldApply = context->reachedStartingPosition ||
+							  context->previousLSN < metadata->lsn;
+
+			if (!wouldApply)
+			{
+				return true;
+			}
+
+			int partition = 0;
+			bool cross = false;
+
+			if (!stream_apply_txn_partition(context, content, pos,
+											&partition, &cross))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			if (!cross)
+			{
+				if (partition != context->applySlot)
+				{
+					/* the whole transaction belongs to a sibling worker */
+					context->txnSkip = true;
+					*done = true;
+				}
+
+				return true;
+			}
+
+			/*
+			 * Cross-partition transaction: every worker first commits its
+			 * open group of transactions, making its previous work visible,
+			 * then worker 0 applies the transaction on its own while the
+			 * other workers wait for it.
+			 */
+			PGSQL *pgsql = &(context->pgsql);
+
+			if (!stream_apply_flush_batch(pgsql, context->sqlBatch))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			if (context->txnOpen)
+			{
+				if (!pgsql_execute(pgsql, "COMMIT"))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+
+				context->txnOpen = false;
+				context->groupTxnCount = 0;
+			}
+
+			if (context->applySlot == 0)
+			{
+				/* wait until the siblings have replayed up to this BEGIN */
+				for (int s = 1; s < context->applyJobs; s++)
+				{
+					if (!stream_apply_wait_for_slot(context, s, metadata->lsn))
+					{
+						/* errors have already been logged */
+						return false;
+					}
+				}
+
+				/* apply the transaction, committing it on its own */
+				context->txnForceCommit = true;
+			}
+			else
+			{
+				/* signal worker 0 that we reached the BEGIN, then skip */
+				(void) stream_apply_publish_lsn(context, metadata->lsn);
+
+				context->txnSkip = true;
+				context->txnWaitForLeader = true;
+				*done = true;
+			}
+
+			return true;
+		}
+
+		case STREAM_ACTION_COMMIT:
+		{
+			if (!context->txnSkip)
+			{
+				return true;
+			}
+
+			/* wait until worker 0 has applied the cross-partition txn */
+			if (context->txnWaitForLeader)
+			{
+				if (!stream_apply_wait_for_slot(context, 0, metadata->lsn))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+
+				context->txnWaitForLeader = false;
+			}
+
+			context->previousLSN = metadata->lsn;
+			context->txnSkip = false;
+
+			(void) stream_apply_publish_lsn(context, context->previousLSN);
+
+			/* a skipped transaction might still be the endpos */
+			if (context->endpos != InvalidXLogRecPtr &&
+				context->endpos <= context->previousLSN)
+			{
+				context->reachedEndPos = true;
+
+				log_info("Applied reached end position %X/%X at %X/%X",
+						 LSN_FORMAT_ARGS(context->endpos),
+						 LSN_FORMAT_ARGS(context->previousLSN));
+			}
+
+			*done = true;
+			return true;
+		}
+
+		case STREAM_ACTION_PREPARE:
+		case STREAM_ACTION_INSERT:
+		case STREAM_ACTION_UPDATE:
+		case STREAM_ACTION_DELETE:
+		case STREAM_ACTION_TRUNCATE:
+		{
+			/* DML lines of a skipped transaction are skipped with it */
+			*done = context->txnSkip;
+			return true;
+		}
+
+		default:
+		{
+			/* SWITCH and KEEPALIVE lines are processed by every worker */
+			return true;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_txn_partition scans the transaction that begins at the given
+ * line and returns the partition number its relations hash to, or sets
+ * crossPartition when relations from several partitions are found. TRUNCATE
+ * statements and transactions with no COMMIT in the current file are played
+ * safe and also handled as cross-partition transactions.
+ */
+static bool
+stream_apply_txn_partition(StreamApplyContext *context,
+						   StreamContent *content,
+						   int begin,
+						   int *partition,
+						   bool *crossPartition)
+{
+	int part = -1;
+	bool cross = false;
+
+	for (int i = begin + 1; i < content->count; i++)
+	{
+		const char *sql = content->lines[i];
+		LogicalMessageMetadata metadata = { 0 };
+
+		StreamAction action = parseSQLAction(sql, &metadata);
+
+		switch (action)
+		{
+			case STREAM_ACTION_COMMIT:
+			{
+				*partition = part == -1 ? 0 : part;
+				*crossPartition = cross;
+
+				return true;
+			}
+
+			case STREAM_ACTION_PREPARE:
+			case STREAM_ACTION_INSERT:
+			case STREAM_ACTION_UPDATE:
+			case STREAM_ACTION_DELETE:
+			{
+				uint64_t hash = 0;
+				bool found = false;
+
+				if (!stream_apply_relation_hash(sql, &hash, &found))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+
+				if (!found)
+				{
+					/* play it safe with lines we fail to parse */
+					cross = true;
+					break;
+				}
+
+				int p = hash % context->applyJobs;
+
+				if (part == -1)
+				{
+					part = p;
+				}
+				else if (part != p)
+				{
+					cross = true;
+				}
+
+				break;
+			}
+
+			case STREAM_ACTION_TRUNCATE:
+			{
+				/* TRUNCATE lines are not quoted the way DML lines are */
+				cross = true;
+				break;
+			}
+
+			default:
+			{
+				/* keepalive or switch wal records, nothing to hash */
 				break;
 			}
+		}
+	}
+
+	/* no COMMIT found: the transaction continues in the next SQL file */
+	*partition = 0;
+	*crossPartition = true;
+
+	return true;
+}
+
+
+/*
+ * stream_apply_relation_hash computes a 64 bits FNV-1a hash of the quoted
+ * and schema-qualified relation name of a transformed DML line, as in
+ * INSERT INTO "nspname"."relname". UPDATE and DELETE lines are
+ * PREPARE/EXECUTE pairs where the DML keyword appears within the prepared
+ * statement definition.
+ */
+static bool
+stream_apply_relation_hash(const char *sql, uint64_t *hash, bool *found)
+{
+	const char *markers[] = {
+		"INSERT INTO \"",
+		"UPDATE \"",
+		"DELETE FROM \"",
+		NULL
+	};
+
+	const char *name = NULL;
+
+	for (int i = 0; markers[i] != NULL; i++)
+	{
+		const char *match = strstr(sql, markers[i]);
+
+		if (match != NULL && (name == NULL || match < name))
+		{
+			/* point to the opening quote of the qualified name */
+			name = match + strlen(markers[i]) - 1;
+		}
+	}
+
+	*found = false;
+
+	if (name == NULL)
+	{
+		return true;
+	}
+
+	uint64_t h = 0xcbf29ce484222325ULL;
+	const char *ptr = name;
+
+	while (*ptr == '"')
+	{
+		/* hash the identifier, skipping the opening quote */
+		for (++ptr; *ptr != '\0'; ptr++)
+		{
+			if (*ptr == '"')
+			{
+				if (*(ptr + 1) == '"')
+				{
+					/* doubled quotes escape a quote in the identifier */
+					++ptr;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			h ^= (uint64_t) (unsigned char) *ptr;
+			h *= 0x100000001b3ULL;
+		}
+
+		if (*ptr != '"')
+		{
+			/* missing closing quote, refuse to guess */
+			return true;
+		}
+
+		++ptr;
+
+		/* a dot continues with the relation name after the schema name */
+		if (*ptr == '.')
+		{
+			h ^= (uint64_t) (unsigned char) '.';
+			h *= 0x100000001b3ULL;
+			++ptr;
+			continue;
+		}
+
+		break;
+	}
+
+	*hash = h;
+	*found = true;
+
+	return true;
+}
+
+
+/*
+ * stream_apply_wait_for_slot waits until the given sibling worker has
+ * published a replayed LSN position that has reached the given lsn.
+ */
+static bool
+stream_apply_wait_for_slot(StreamApplyContext *context, int slot, uint64_t lsn)
+{
+	StreamApplySharedLSN *sharedLSN = context->sharedLSN;
+
+	while (sharedLSN->replayedLSN[slot] < lsn)
+	{
+		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
+		{
+			log_error("Parallel apply worker %d received a shutdown signal "
+					  "while waiting for worker %d to reach %X/%X",
+					  context->applySlot,
+					  slot,
+					  LSN_FORMAT_ARGS(lsn));
+			return false;
+		}
+
+		pg_usleep(10 * 1000); /* 10 ms */
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_publish_lsn publishes the given replayed LSN position to the
+ * shared memory segment, where the sibling workers and the sentinel syncing
+ * find it. A no-op in single process apply mode.
+ */
+static void
+stream_apply_publish_lsn(StreamApplyContext *context, uint64_t lsn)
+{
+	if (context->sharedLSN != NULL)
+	{
+		context->sharedLSN->replayedLSN[context->applySlot] = lsn;
+	}
+}
+
+
+/*
+ * stream_apply_ensure_worker_origin creates the replication origin for a
+ * parallel apply worker on the target database when it does not exist yet,
+ * positioned at the main origin current LSN. Each worker tracks its own
+ * replay progress, so that an interrupted parallel apply restarts every
+ * partition from its own position.
+ */
+static bool
+stream_apply_ensure_worker_origin(StreamSpecs *specs, char *nodeName)
+{
+	PGSQL dst = { 0 };
+
+	if (!pgsql_init(&dst, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* we're going to send several replication origin commands */
+	dst.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	uint32_t oid = 0;
+
+	if (!pgsql_replication_origin_oid(&dst, nodeName, &oid))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (oid == 0)
+	{
+		uint64_t lsn = InvalidXLogRecPtr;
+
+		if (!pgsql_replication_origin_progress(&dst,
+											   specs->origin,
+											   true,
+											   &lsn))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!pgsql_replication_origin_create(&dst, nodeName))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (lsn != InvalidXLogRecPtr)
+		{
+			char lsnStr[PG_LSN_MAXLENGTH] = { 0 };
+
+			sformat(lsnStr, sizeof(lsnStr), "%X/%X", LSN_FORMAT_ARGS(lsn));
+
+			if (!pgsql_replication_origin_advance(&dst, nodeName, lsnStr))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
+		log_notice("Created replication origin \"%s\" at %X/%X",
+				   nodeName,
+				   LSN_FORMAT_ARGS(lsn));
+	}
+
+	(void) pgsql_finish(&dst);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_sql replays a single SQL line as prepared by the transform
+ * stage, tracking transactions, group commit, and the replication origin
+ * position on the target database. It is called when replaying from an
+ * on-disk SQL file, and also when applying changes straight from the receive
+ * process in STREAM_MODE_DIRECT.
+ */
+bool
+stream_apply_sql(StreamApplyContext *context,
+				 LogicalMessageMetadata *mdata,
+				 const char *sql)
+{
+	PGSQL *pgsql = &(context->pgsql);
+	LogicalMessageMetadata metadata = *mdata;
+	StreamAction action = metadata.action;
+
+	switch (action)
+	{
+		case STREAM_ACTION_SWITCH:
+		{
+			log_debug("apply: SWITCH from %X/%X to %X/%X",
+					  LSN_FORMAT_ARGS(context->previousLSN),
+					  LSN_FORMAT_ARGS(metadata.lsn));
+
+			context->previousLSN = metadata.lsn;
+
+			break;
+		}
+
+		case STREAM_ACTION_BEGIN:
+		{
+			/* did we reach the starting LSN positions now? */
+			if (!context->reachedStartingPosition)
+			{
+				context->reachedStartingPosition =
+					context->previousLSN < metadata.lsn;
+			}
 
-			case STREAM_ACTION_COMMIT:
+			log_debug("BEGIN %lld LSN %X/%X @%s, previous LSN %X/%X %s",
+					  (long long) metadata.xid,
+					  LSN_FORMAT_ARGS(metadata.lsn),
+					  metadata.timestamp,
+					  LSN_FORMAT_ARGS(context->previousLSN),
+					  context->reachedStartingPosition ? "" : "[skipping]");
+
+			if (metadata.lsn == InvalidXLogRecPtr ||
+				IS_EMPTY_STRING_BUFFER(metadata.timestamp))
 			{
-				if (!reachedStartingPosition)
-				{
-					continue;
-				}
+				log_fatal("Failed to parse BEGIN message: %s", sql);
+				return false;
+			}
 
-				log_debug("COMMIT %lld LSN %X/%X",
-						  (long long) metadata.xid,
-						  LSN_FORMAT_ARGS(metadata.lsn));
+			/*
+			 * Check if we reached the endpos LSN already.
+			 */
+			if (context->endpos != InvalidXLogRecPtr &&
+				context->endpos <= metadata.lsn)
+			{
+				context->reachedEndPos = true;
 
+				log_info("Apply reached end position %X/%X at %X/%X.",
+						 LSN_FORMAT_ARGS(context->endpos),
+						 LSN_FORMAT_ARGS(metadata.lsn));
+				break;
+			}
 
-				/* calling pgsql_commit() would finish the connection, avoid */
-				if (!pgsql_execute(pgsql, "COMMIT"))
+			/* actually skip this one if we didn't reach start pos yet */
+			if (!context->reachedStartingPosition)
+			{
+				return true;
+			}
+
+			/*
+			 * We're all good to replay that transaction. Unless a group
+			 * of transactions is already open on the target, BEGIN now.
+			 */
+			if (!context->txnOpen)
+			{
+				if (!pgsql_begin(pgsql))
 				{
 					/* errors have already been logged */
 					return false;
 				}
 
-				context->previousLSN = metadata.lsn;
+				context->txnOpen = true;
+				context->groupTxnCount = 0;
+				INSTR_TIME_SET_CURRENT(context->groupStartTime);
+			}
 
-				/*
-				 * At COMMIT time we might have reached the endpos: we know
-				 * that already when endpos <= lsn. It's important to check
-				 * that at COMMIT record time, because that record might be the
-				 * last entry of the file we're applying.
-				 */
-				if (context->endpos != InvalidXLogRecPtr &&
-					context->endpos <= context->previousLSN)
-				{
-					context->reachedEndPos = true;
+			/*
+			 * Register our origin tracking at each source BEGIN: the
+			 * target commit then records the latest replayed LSN of the
+			 * whole group of transactions.
+			 */
+			char lsn[PG_LSN_MAXLENGTH] = { 0 };
 
-					log_info("Applied reached end position %X/%X at %X/%X",
-							 LSN_FORMAT_ARGS(context->endpos),
-							 LSN_FORMAT_ARGS(context->previousLSN));
-					break;
-				}
+			sformat(lsn, sizeof(lsn), "%X/%X",
+					LSN_FORMAT_ARGS(metadata.lsn));
 
-				break;
+			if (!pgsql_replication_origin_xact_setup(pgsql,
+													 lsn,
+													 metadata.timestamp))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			break;
+		}
+
+		case STREAM_ACTION_COMMIT:
+		{
+			if (!context->reachedStartingPosition)
+			{
+				return true;
+			}
+
+			log_debug("COMMIT %lld LSN %X/%X",
+					  (long long) metadata.xid,
+					  LSN_FORMAT_ARGS(metadata.lsn));
+
+			/* send the statements batched since BEGIN, if any */
+			if (!stream_apply_flush_batch(pgsql, context->sqlBatch))
+			{
+				/* errors have already been logged */
+				return false;
 			}
 
+			context->previousLSN = metadata.lsn;
+			++context->groupTxnCount;
+
+			/* the transaction is applied, register its end-to-end latency */
+			(void) stream_apply_track_lag(context, &metadata);
+
 			/*
-			 * A KEEPALIVE message is replayed as its own transaction where the
-			 * only thgin we do is call into the replication origin tracking
-			 * API to advance our position on the target database.
+			 * At COMMIT time we might have reached the endpos: we know
+			 * that already when endpos <= lsn. It's important to check
+			 * that at COMMIT record time, because that record might be the
+			 * last entry of the file we're applying.
 			 */
-			case STREAM_ACTION_KEEPALIVE:
+			if (context->endpos != InvalidXLogRecPtr &&
+				context->endpos <= context->previousLSN)
 			{
-				/* did we reach the starting LSN positions now? */
-				if (!reachedStartingPosition)
-				{
-					reachedStartingPosition =
-						context->previousLSN < metadata.lsn;
-				}
+				context->reachedEndPos = true;
+
+				log_info("Applied reached end position %X/%X at %X/%X",
+						 LSN_FORMAT_ARGS(context->endpos),
+						 LSN_FORMAT_ARGS(context->previousLSN));
+			}
 
-				log_debug("KEEPALIVE LSN %X/%X @%s, previous LSN %X/%X %s",
-						  LSN_FORMAT_ARGS(metadata.lsn),
-						  metadata.timestamp,
-						  LSN_FORMAT_ARGS(context->previousLSN),
-						  reachedStartingPosition ? "" : "[skipping]");
+			instr_time groupDuration;
 
-				if (metadata.lsn == InvalidXLogRecPtr ||
-					IS_EMPTY_STRING_BUFFER(metadata.timestamp))
+			INSTR_TIME_SET_CURRENT(groupDuration);
+			INSTR_TIME_SUBTRACT(groupDuration, context->groupStartTime);
+
+			/*
+			 * Commit on the target when we reached the endpos, when
+			 * enough source transactions have been grouped already, or
+			 * when the group has been open for long enough.
+			 */
+			if (context->reachedEndPos ||
+				context->txnForceCommit ||
+				context->groupTxnCount >= STREAM_APPLY_GROUP_COMMIT_TXNS ||
+				INSTR_TIME_GET_MILLISEC(groupDuration) >=
+				STREAM_APPLY_GROUP_COMMIT_TIMEOUT_MS)
+			{
+				/* calling pgsql_commit() would finish the connection */
+				if (!pgsql_execute(pgsql, "COMMIT"))
 				{
-					log_fatal("Failed to parse KEEPALIVE message: %s", sql);
+					/* errors have already been logged */
 					return false;
 				}
 
-				/*
-				 * Check if we reached the endpos LSN already. If the keepalive
-				 * message is the endpos, still apply it: its only purpose is
-				 * to maintain our replication origin tracking on the target
-				 * database.
-				 */
-				if (context->endpos != InvalidXLogRecPtr &&
-					context->endpos < metadata.lsn)
-				{
-					context->reachedEndPos = true;
+				context->txnOpen = false;
+				context->txnForceCommit = false;
+				context->groupTxnCount = 0;
+			}
 
-					log_info("Apply reached end position %X/%X at %X/%X.",
-							 LSN_FORMAT_ARGS(context->endpos),
-							 LSN_FORMAT_ARGS(metadata.lsn));
-					break;
-				}
+			/* once durable on the target, publish our replay position */
+			if (!context->txnOpen)
+			{
+				(void) stream_apply_publish_lsn(context, context->previousLSN);
+			}
 
-				/* actually skip this one if we didn't reach start pos yet */
-				if (!reachedStartingPosition)
-				{
-					continue;
-				}
+			break;
+		}
+
+		/*
+		 * A KEEPALIVE message is replayed as its own transaction where the
+		 * only thgin we do is call into the replication origin tracking
+		 * API to advance our position on the target database.
+		 */
+		case STREAM_ACTION_KEEPALIVE:
+		{
+			/* did we reach the starting LSN positions now? */
+			if (!context->reachedStartingPosition)
+			{
+				context->reachedStartingPosition =
+					context->previousLSN < metadata.lsn;
+			}
+
+			log_debug("KEEPALIVE LSN %X/%X @%s, previous LSN %X/%X %s",
+					  LSN_FORMAT_ARGS(metadata.lsn),
+					  metadata.timestamp,
+					  LSN_FORMAT_ARGS(context->previousLSN),
+					  context->reachedStartingPosition ? "" : "[skipping]");
+
+			if (metadata.lsn == InvalidXLogRecPtr ||
+				IS_EMPTY_STRING_BUFFER(metadata.timestamp))
+			{
+				log_fatal("Failed to parse KEEPALIVE message: %s", sql);
+				return false;
+			}
+
+			/*
+			 * Check if we reached the endpos LSN already. If the keepalive
+			 * message is the endpos, still apply it: its only purpose is
+			 * to maintain our replication origin tracking on the target
+			 * database.
+			 */
+			if (context->endpos != InvalidXLogRecPtr &&
+				context->endpos < metadata.lsn)
+			{
+				context->reachedEndPos = true;
+
+				log_info("Apply reached end position %X/%X at %X/%X.",
+						 LSN_FORMAT_ARGS(context->endpos),
+						 LSN_FORMAT_ARGS(metadata.lsn));
+				break;
+			}
+
+			/* actually skip this one if we didn't reach start pos yet */
+			if (!context->reachedStartingPosition)
+			{
+				return true;
+			}
+
+			/* keep statement ordering when found in a transaction */
+			if (!stream_apply_flush_batch(pgsql, context->sqlBatch))
+			{
+				/* errors have already been logged */
+				return false;
+			}
 
+			/* a keepalive might join an open group of transactions */
+			if (!context->txnOpen)
+			{
 				if (!pgsql_begin(pgsql))
 				{
 					/* errors have already been logged */
 					return false;
 				}
 
-				char lsn[PG_LSN_MAXLENGTH] = { 0 };
+				context->txnOpen = true;
+				context->groupTxnCount = 0;
+				INSTR_TIME_SET_CURRENT(context->groupStartTime);
+			}
 
-				sformat(lsn, sizeof(lsn), "%X/%X",
-						LSN_FORMAT_ARGS(metadata.lsn));
+			char lsn[PG_LSN_MAXLENGTH] = { 0 };
 
-				if (!pgsql_replication_origin_xact_setup(pgsql,
-														 lsn,
-														 metadata.timestamp))
-				{
-					/* errors have already been logged */
-					return false;
-				}
+			sformat(lsn, sizeof(lsn), "%X/%X",
+					LSN_FORMAT_ARGS(metadata.lsn));
+
+			if (!pgsql_replication_origin_xact_setup(pgsql,
+													 lsn,
+													 metadata.timestamp))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			context->previousLSN = metadata.lsn;
+
+			/*
+			 * At COMMIT time we might have reached the endpos: we know
+			 * that already when endpos <= lsn. It's important to check
+			 * that at COMMIT record time, because that record might be the
+			 * last entry of the file we're applying.
+			 */
+			if (context->endpos != InvalidXLogRecPtr &&
+				context->endpos <= context->previousLSN)
+			{
+				context->reachedEndPos = true;
+
+				log_info("Applied reached end position %X/%X at %X/%X",
+						 LSN_FORMAT_ARGS(context->endpos),
+						 LSN_FORMAT_ARGS(context->previousLSN));
+			}
+
+			instr_time groupDuration;
 
-				/* calling pgsql_commit() would finish the connection, avoid */
+			INSTR_TIME_SET_CURRENT(groupDuration);
+			INSTR_TIME_SUBTRACT(groupDuration, context->groupStartTime);
+
+			if (context->reachedEndPos ||
+				context->txnForceCommit ||
+				context->groupTxnCount >= STREAM_APPLY_GROUP_COMMIT_TXNS ||
+				INSTR_TIME_GET_MILLISEC(groupDuration) >=
+				STREAM_APPLY_GROUP_COMMIT_TIMEOUT_MS)
+			{
+				/* calling pgsql_commit() would finish the connection */
 				if (!pgsql_execute(pgsql, "COMMIT"))
 				{
 					/* errors have already been logged */
 					return false;
 				}
 
-				context->previousLSN = metadata.lsn;
+				context->txnOpen = false;
+				context->txnForceCommit = false;
+				context->groupTxnCount = 0;
+			}
 
-				/*
-				 * At COMMIT time we might have reached the endpos: we know
-				 * that already when endpos <= lsn. It's important to check
-				 * that at COMMIT record time, because that record might be the
-				 * last entry of the file we're applying.
-				 */
-				if (context->endpos != InvalidXLogRecPtr &&
-					context->endpos <= context->previousLSN)
-				{
-					context->reachedEndPos = true;
+			/* once durable on the target, publish our replay position */
+			if (!context->txnOpen)
+			{
+				(void) stream_apply_publish_lsn(context, context->previousLSN);
+			}
 
-					log_info("Applied reached end position %X/%X at %X/%X",
-							 LSN_FORMAT_ARGS(context->endpos),
-							 LSN_FORMAT_ARGS(context->previousLSN));
-					break;
-				}
+			break;
+		}
 
-				break;
+		case STREAM_ACTION_PREPARE:
+		{
+			if (!context->reachedStartingPosition)
+			{
+				return true;
 			}
 
-			case STREAM_ACTION_INSERT:
-			case STREAM_ACTION_UPDATE:
-			case STREAM_ACTION_DELETE:
-			case STREAM_ACTION_TRUNCATE:
+			/* batch the EXECUTE, and the PREPARE the first time around */
+			if (!stream_apply_prepared_statement(context, sql))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			if (context->sqlBatch->len >= STREAM_APPLY_BATCH_SIZE)
 			{
-				if (!reachedStartingPosition)
+				if (!stream_apply_flush_batch(pgsql, context->sqlBatch))
 				{
-					continue;
+					/* errors have already been logged */
+					return false;
 				}
+			}
+			break;
+		}
+
+		case STREAM_ACTION_INSERT:
+		case STREAM_ACTION_UPDATE:
+		case STREAM_ACTION_DELETE:
+		case STREAM_ACTION_TRUNCATE:
+		{
+			if (!context->reachedStartingPosition)
+			{
+				return true;
+			}
 
-				/* chomp the final semi-colon that we added */
-				int len = strlen(sql);
+			/* batch the statement, sent in one go at the next flush */
+			appendPQExpBufferStr(context->sqlBatch, sql);
+			appendPQExpBufferChar(context->sqlBatch, '\n');
 
-				if (sql[len - 1] == ';')
-				{
-					char *ptr = (char *) sql + len - 1;
-					*ptr = '\0';
-				}
+			if (PQExpBufferBroken(context->sqlBatch))
+			{
+				log_error(ALLOCATION_FAILED_ERROR);
+				return false;
+			}
 
-				if (!pgsql_execute(pgsql, sql))
+			if (context->sqlBatch->len >= STREAM_APPLY_BATCH_SIZE)
+			{
+				if (!stream_apply_flush_batch(pgsql, context->sqlBatch))
 				{
 					/* errors have already been logged */
 					return false;
 				}
-				break;
 			}
+			break;
+		}
 
-			default:
-			{
-				log_error("Failed to parse SQL query \"%s\"", sql);
-				return false;
-			}
+		default:
+		{
+			log_error("Failed to parse SQL query \"%s\"", sql);
+			return false;
 		}
 	}
 
-	/* free dynamic memory that's not needed anymore */
-	free(content.buffer);
-	free(content.lines);
+	return true;
+}
+
+
+/*
+ * stream_apply_setup prepares the apply side of the direct streaming
+ * pipeline (STREAM_MODE_DIRECT): it reads the streaming context information
+ * and registers the replication origin tracking on the target database, so
+ * that transactions can then be applied as soon as they have been received
+ * and transformed, without going through on-disk SQL files.
+ */
+bool
+stream_apply_setup(StreamSpecs *specs, StreamApplyContext *context)
+{
+	strlcpy(context->targetSessionGucs,
+			specs->targetSessionGucs,
+			sizeof(context->targetSessionGucs));
+
+	if (!stream_read_context(&(specs->paths),
+							 &(context->system),
+							 &(context->WalSegSz)))
+	{
+		log_error("Failed to read the streaming context information "
+				  "from the source database, see above for details");
+		return false;
+	}
+
+	if (!setupReplicationOrigin(context,
+								&(specs->paths),
+								specs->source_pguri,
+								specs->target_pguri,
+								specs->origin,
+								specs->endpos,
+								context->apply))
+	{
+		log_error("Failed to setup replication origin on the target database");
+		return false;
+	}
+
+	log_info("Direct streaming mode: applying changes from LSN %X/%X",
+			 LSN_FORMAT_ARGS(context->previousLSN));
+
+	if (context->endpos != InvalidXLogRecPtr)
+	{
+		log_info("Stopping at endpos LSN %X/%X",
+				 LSN_FORMAT_ARGS(context->endpos));
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_flush_batch sends the batched DML statements to the target
+ * database as a single multi-statement query, in a single network round
+ * trip, and resets the batch buffer.
+ */
+static bool
+stream_apply_flush_batch(PGSQL *pgsql, PQExpBuffer batch)
+{
+	if (batch->len == 0)
+	{
+		return true;
+	}
+
+	if (!pgsql_execute(pgsql, batch->data))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	resetPQExpBuffer(batch);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_prepared_statement batches a single-line PREPARE/EXECUTE pair
+ * as emitted by the transform stage for UPDATE and DELETE statements:
+ *
+ *   PREPARE p_<hash> AS <statement with $n parameters>;EXECUTE p_<hash>(...);
+ *
+ * The EXECUTE part is always added to the current batch; the PREPARE part is
+ * only added the first time its statement name is seen in the current target
+ * session, so that the target parses and plans each statement shape once
+ * instead of once per row.
+ */
+static bool
+stream_apply_prepared_statement(StreamApplyContext *context, const char *sql)
+{
+	char *execute = strstr(sql, ";EXECUTE ");
+
+	if (execute == NULL)
+	{
+		log_error("Failed to parse prepared statement line \"%s\"", sql);
+		return false;
+	}
+
+	/* the statement name sits in between "PREPARE " and " AS " */
+	const char *start = sql + strlen("PREPARE ");
+	const char *end = strchr(start, ' ');
+
+	char name[NAMEDATALEN] = { 0 };
+
+	if (end == NULL || (end - start) >= NAMEDATALEN)
+	{
+		log_error("Failed to parse prepared statement name in \"%s\"", sql);
+		return false;
+	}
+
+	sformat(name, sizeof(name), "%.*s", (int) (end - start), start);
+
+	PreparedStmtEntry *entry = NULL;
+
+	HASH_FIND_STR(context->preparedStmts, name, entry);
+
+	if (entry == NULL)
+	{
+		/* first use of that statement shape in this target session */
+		appendPQExpBuffer(context->sqlBatch, "%.*s;\n",
+						  (int) (execute - sql),
+						  sql);
+
+		entry = (PreparedStmtEntry *) calloc(1, sizeof(PreparedStmtEntry));
+
+		if (entry == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return false;
+		}
+
+		strlcpy(entry->name, name, sizeof(entry->name));
+
+		HASH_ADD_STR(context->preparedStmts, name, entry);
+	}
+
+	/* skip the ';' separator, the EXECUTE part ends with its own */
+	appendPQExpBufferStr(context->sqlBatch, execute + 1);
+	appendPQExpBufferChar(context->sqlBatch, '\n');
+
+	if (PQExpBufferBroken(context->sqlBatch))
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
 
 	return true;
 }
@@ -657,6 +1983,14 @@ setupReplicationOrigin(StreamApplyContext *context,
 	/* we're going to send several replication origin commands */
 	pgsql->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
 
+	/* apply the --target-session-gucs profile to the apply session */
+	if (!IS_EMPTY_STRING_BUFFER(context->targetSessionGucs) &&
+		!pgsql_set_session_gucs(pgsql, context->targetSessionGucs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	uint32_t oid = 0;
 
 	if (!pgsql_replication_origin_oid(pgsql, nodeName, &oid))
@@ -791,7 +2125,12 @@ parseSQLAction(const char *query, LogicalMessageMetadata *metadata)
 		json_value_free(json);
 	}
 
-	if (strstr(query, "INSERT INTO") != NULL)
+	if (strncmp(query, "PREPARE ", strlen("PREPARE ")) == 0)
+	{
+		/* UPDATE and DELETE lines are PREPARE/EXECUTE pairs */
+		action = STREAM_ACTION_PREPARE;
+	}
+	else if (strstr(query, "INSERT INTO") != NULL)
 	{
 		action = STREAM_ACTION_INSERT;
 	}
@@ -4,6 +4,7 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <sys/wait.h>
@@ -23,6 +24,7 @@
 #include "ld_stream.h"
 #include "lock_utils.h"
 #include "log.h"
+#include "metrics.h"
 #include "parsing_utils.h"
 #include "pidfile.h"
 #include "pg_utils.h"
@@ -35,6 +37,8 @@
 static bool updateStreamCounters(StreamContext *context,
 								 LogicalMessageMetadata *metadata);
 
+static bool streamFlushWriteBuffer(StreamContext *privateContext);
+
 
 /*
  * stream_init_specs initializes Change Data Capture streaming specifications
@@ -127,6 +131,170 @@ stream_init_specs(StreamSpecs *specs,
 }
 
 
+/*
+ * stream_init_plugin_filters pushes the source table filtering down to the
+ * logical decoding plugin options, so that rows for filtered-out tables are
+ * never decoded nor sent over the wire. The wal2json plugin implements the
+ * add-tables and filter-tables options for that; test_decoding has no such
+ * support and then filtering happens client-side only, as before.
+ *
+ * Client-side filtering is kept in place in any case, the plugin options are
+ * a network/CPU optimisation, not a replacement.
+ */
+bool
+stream_init_plugin_filters(StreamSpecs *specs, SourceFilters *filters)
+{
+	if (filters->type == SOURCE_FILTER_TYPE_NONE)
+	{
+		return true;
+	}
+
+	if (specs->plugin != STREAM_PLUGIN_WAL2JSON)
+	{
+		log_debug("Logical decoding plugin \"%s\" does not support "
+				  "server-side table filtering, filtering is applied "
+				  "client-side",
+				  OutputPluginToString(specs->plugin));
+		return true;
+	}
+
+	KeyVal *options = &(specs->pluginOptions);
+
+	/*
+	 * With an include-only filtering setup, use the wal2json add-tables
+	 * option: only the listed tables are decoded at all.
+	 */
+	if (filters->includeOnlyTableList.count > 0)
+	{
+		PQExpBuffer tables = createPQExpBuffer();
+
+		if (tables == NULL)
+		{
+			log_error("Failed to allocate memory to build the "
+					  "add-tables plugin option");
+			return false;
+		}
+
+		/* pgcopydb uses its own sentinel table on the source database */
+		appendPQExpBufferStr(tables, "pgcopydb.*");
+
+		for (int i = 0; i < filters->includeOnlyTableList.count; i++)
+		{
+			SourceFilterTable *table = &(filters->includeOnlyTableList.array[i]);
+
+			appendPQExpBuffer(tables, ",%s.%s",
+							  table->nspname,
+							  table->relname);
+		}
+
+		if (PQExpBufferBroken(tables))
+		{
+			log_error("Failed to build the add-tables plugin option: "
+					  "out of memory");
+			destroyPQExpBuffer(tables);
+			return false;
+		}
+
+		if (strlen(tables->data) >= MAXCONNINFO || options->count >= 64)
+		{
+			log_warn("Table filtering includes %d tables and does not fit "
+					 "in the logical decoding plugin options, filtering is "
+					 "applied client-side",
+					 filters->includeOnlyTableList.count);
+			destroyPQExpBuffer(tables);
+			return true;
+		}
+
+		strlcpy(options->keywords[options->count], "add-tables", MAXCONNINFO);
+		strlcpy(options->values[options->count], tables->data, MAXCONNINFO);
+		++options->count;
+
+		log_notice("Using wal2json option add-tables '%s'", tables->data);
+
+		destroyPQExpBuffer(tables);
+
+		return true;
+	}
+
+	/*
+	 * With an exclusion filtering setup, extend the filter-tables option that
+	 * stream_init_specs already uses for the pgcopydb sentinel table.
+	 */
+	if (filters->excludeSchemaList.count > 0 ||
+		filters->excludeTableList.count > 0)
+	{
+		int index = 0;
+
+		for (index = 0; index < options->count; index++)
+		{
+			if (streq(options->keywords[index], "filter-tables"))
+			{
+				break;
+			}
+		}
+
+		if (index == options->count)
+		{
+			log_error("BUG: filter-tables not found in wal2json options");
+			return false;
+		}
+
+		PQExpBuffer tables = createPQExpBuffer();
+
+		if (tables == NULL)
+		{
+			log_error("Failed to allocate memory to build the "
+					  "filter-tables plugin option");
+			return false;
+		}
+
+		appendPQExpBufferStr(tables, options->values[index]);
+
+		for (int i = 0; i < filters->excludeSchemaList.count; i++)
+		{
+			appendPQExpBuffer(tables, ",%s.*",
+							  filters->excludeSchemaList.array[i].nspname);
+		}
+
+		for (int i = 0; i < filters->excludeTableList.count; i++)
+		{
+			SourceFilterTable *table = &(filters->excludeTableList.array[i]);
+
+			appendPQExpBuffer(tables, ",%s.%s",
+							  table->nspname,
+							  table->relname);
+		}
+
+		if (PQExpBufferBroken(tables))
+		{
+			log_error("Failed to build the filter-tables plugin option: "
+					  "out of memory");
+			destroyPQExpBuffer(tables);
+			return false;
+		}
+
+		if (strlen(tables->data) >= MAXCONNINFO)
+		{
+			log_warn("Table filtering excludes %d schemas and %d tables "
+					 "and does not fit in the logical decoding plugin "
+					 "options, filtering is applied client-side",
+					 filters->excludeSchemaList.count,
+					 filters->excludeTableList.count);
+			destroyPQExpBuffer(tables);
+			return true;
+		}
+
+		strlcpy(options->values[index], tables->data, MAXCONNINFO);
+
+		log_notice("Using wal2json option filter-tables '%s'", tables->data);
+
+		destroyPQExpBuffer(tables);
+	}
+
+	return true;
+}
+
+
 /*
  * stream_init_context initializes a LogicalStreamContext.
  */
@@ -141,12 +309,52 @@ stream_init_context(StreamContext *privateContext, StreamSpecs *specs)
 			specs->source_pguri,
 			sizeof(privateContext->source_pguri));
 
-	if (!queue_create(&(privateContext->transformQueue)))
+	/* the transform queue only holds one message per WAL segment in flight */
+	int capacity = 1024;
+
+	if (!queue_create(&(privateContext->transformQueue), capacity))
 	{
 		log_error("Failed to create the Stream Transform process queue");
 		return false;
 	}
 
+	privateContext->writeBuffer = createPQExpBuffer();
+
+	if (privateContext->writeBuffer == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	/* wal2json text compresses really well, trade some CPU for NVMe room */
+	privateContext->compress = env_exists(PGCOPYDB_COMPRESSION);
+
+	if (privateContext->compress)
+	{
+		log_notice("Writing gzip compressed JSON files (%s)",
+				   PGCOPYDB_COMPRESSION);
+	}
+
+	if (specs->mode == STREAM_MODE_DIRECT)
+	{
+		privateContext->directTx =
+			(LogicalTransaction *) calloc(1, sizeof(LogicalTransaction));
+
+		privateContext->applyContext =
+			(StreamApplyContext *) calloc(1, sizeof(StreamApplyContext));
+
+		if (privateContext->directTx == NULL ||
+			privateContext->applyContext == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return false;
+		}
+
+		privateContext->applyContext->listening = true;
+
+		INSTR_TIME_SET_CURRENT(privateContext->lastSentinelSync);
+	}
+
 	return true;
 }
 
@@ -163,6 +371,24 @@ stream_close_context(StreamContext *privateContext)
 		return false;
 	}
 
+	destroyPQExpBuffer(privateContext->writeBuffer);
+	privateContext->writeBuffer = NULL;
+
+	if (privateContext->applyContext != NULL)
+	{
+		(void) pgsql_finish(&(privateContext->applyContext->pgsql));
+		(void) pgsql_finish(&(privateContext->applyContext->source));
+
+		free(privateContext->applyContext);
+		privateContext->applyContext = NULL;
+	}
+
+	if (privateContext->directTx != NULL)
+	{
+		free(privateContext->directTx);
+		privateContext->directTx = NULL;
+	}
+
 	return true;
 }
 
@@ -205,10 +431,36 @@ startLogicalStreaming(StreamSpecs *specs)
 
 	context.private = (void *) &(privateContext);
 
-	if (!stream_transform_start_worker(&context))
+	/* in direct mode the transform and apply stages run in this process */
+	if (specs->mode != STREAM_MODE_DIRECT)
 	{
-		/* errors have already been logged */
-		return false;
+		if (!stream_transform_start_worker(&context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		/*
+		 * When resuming operations, JSON segment files received in a previous
+		 * run might still be missing their SQL counterpart: queue them now so
+		 * that the transform happens concurrently to the streaming (and to
+		 * the initial copy in a clone --follow), rather than serially when
+		 * the apply process needs the SQL files.
+		 */
+		if (!stream_transform_backfill(&context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else
+	{
+		if (!stream_apply_wait_for_sentinel(specs, privateContext.applyContext))
+		{
+			/* errors have already been logged */
+			(void) stream_close_context(&privateContext);
+			return false;
+		}
 	}
 
 	/*
@@ -250,6 +502,19 @@ startLogicalStreaming(StreamSpecs *specs)
 			return false;
 		}
 
+		/* in direct mode, prepare the apply context (replication origin) */
+		if (specs->mode == STREAM_MODE_DIRECT && !privateContext.directApplyReady)
+		{
+			if (!stream_apply_setup(specs, privateContext.applyContext))
+			{
+				/* errors have already been logged */
+				(void) stream_close_context(&privateContext);
+				return false;
+			}
+
+			privateContext.directApplyReady = true;
+		}
+
 		/* ignore errors, try again unless asked to stop */
 		bool cleanExit = pgsql_stream_logical(&stream, &context);
 
@@ -440,8 +705,10 @@ streamWrite(LogicalStreamContext *context)
 	}
 
 	/*
-	 * Write the logical decoding message to disk, appending to the already
-	 * opened file we track in the privateContext.
+	 * Append the logical decoding message to our in-memory write buffer,
+	 * which is written to the already opened file we track in the
+	 * privateContext when it reaches STREAM_WRITE_BUFFER_SIZE, rather than
+	 * paying for one small write per decoded row.
 	 */
 	if (privateContext->jsonFile == NULL)
 	{
@@ -449,72 +716,59 @@ streamWrite(LogicalStreamContext *context)
 		return false;
 	}
 
-	/* first write our own metadata, formatted in JSON */
-	int ret =
-		fformat(privateContext->jsonFile,
-				"{\"action\":\"%c\","
-				"\"xid\":\"%lld\","
-				"\"lsn\":\"%X/%X\","
-				"\"timestamp\":\"%s\","
-				"\"message\":",
-				metadata->action,
-				(long long) metadata->xid,
-				LSN_FORMAT_ARGS(metadata->lsn),
-				metadata->timestamp);
+	PQExpBuffer buffer = privateContext->writeBuffer;
+
+	/* remember where this message starts, for direct mode hand-over */
+	size_t previousLen = buffer->len;
 
-	if (ret == -1)
+	/* first add our own metadata, formatted in JSON */
+	appendPQExpBuffer(buffer,
+					  "{\"action\":\"%c\","
+					  "\"xid\":\"%lld\","
+					  "\"lsn\":\"%X/%X\","
+					  "\"timestamp\":\"%s\","
+					  "\"message\":",
+					  metadata->action,
+					  (long long) metadata->xid,
+					  LSN_FORMAT_ARGS(metadata->lsn),
+					  metadata->timestamp);
+
+	/* then add the logical output plugin data, inside our own JSON format */
+	appendBinaryPQExpBuffer(buffer,
+							privateContext->jsonBuffer,
+							strlen(privateContext->jsonBuffer));
+
+	appendPQExpBufferStr(buffer, "}\n");
+
+	if (PQExpBufferBroken(buffer))
 	{
-		log_error("Failed to write message metadata for action %d at LSN %X/%X "
-				  "to file \"%s\": %m",
+		log_error("Failed to buffer message for action %d at LSN %X/%X: "
+				  "out of memory",
 				  metadata->action,
-				  LSN_FORMAT_ARGS(metadata->lsn),
-				  privateContext->walFileName);
+				  LSN_FORMAT_ARGS(metadata->lsn));
 		return false;
 	}
 
-	/* then add the logical output plugin data, inside our own JSON format */
-	long bytes_left = strlen(privateContext->jsonBuffer);
-	long bytes_written = 0;
-
-	while (bytes_left > 0)
+	/* in direct mode, transform and apply the message we just spooled */
+	if (privateContext->mode == STREAM_MODE_DIRECT &&
+		privateContext->directApplyReady)
 	{
-		int ret;
-
-		ret = fwrite(privateContext->jsonBuffer + bytes_written,
-					 sizeof(char),
-					 bytes_left,
-					 privateContext->jsonFile);
-
-		if (ret < 0)
+		if (!stream_direct_message(privateContext,
+								   buffer->data + previousLen))
 		{
-			log_error("Failed to write %ld bytes to file \"%s\": %m",
-					  bytes_left,
-					  privateContext->walFileName);
+			/* errors have already been logged */
 			return false;
 		}
-
-		/* Write was successful, advance our position */
-		bytes_written += ret;
-		bytes_left -= ret;
 	}
 
-	if (fwrite("}\n", sizeof(char), 2, privateContext->jsonFile) != 2)
+	/* time to hit the disk with a single multi-megabyte write? */
+	if (buffer->len >= STREAM_WRITE_BUFFER_SIZE)
 	{
-		log_error("Failed to write 2 bytes to file \"%s\": %m",
-				  privateContext->walFileName);
-
-		if (privateContext->jsonFile != NULL)
+		if (!streamFlushWriteBuffer(privateContext))
 		{
-			if (fclose(privateContext->jsonFile) != 0)
-			{
-				log_error("Failed to close file \"%s\": %m",
-						  privateContext->walFileName);
-			}
-
-			/* reset the jsonFile FILE * pointer to NULL, it's closed now */
-			privateContext->jsonFile = NULL;
+			/* errors have already been logged */
+			return false;
 		}
-		return false;
 	}
 
 	/*
@@ -595,14 +849,29 @@ streamRotateFile(LogicalStreamContext *context)
 		 * Add an extra empty transaction with the first lsn of the next file
 		 * to allow for the transform and apply process to follow along.
 		 */
-		fformat(privateContext->jsonFile,
-				"{\"action\":\"X\",\"lsn\":\"%X/%X\"}\n",
-				LSN_FORMAT_ARGS(context->cur_record_lsn));
+		size_t previousLen = privateContext->writeBuffer->len;
+
+		appendPQExpBuffer(privateContext->writeBuffer,
+						  "{\"action\":\"X\",\"lsn\":\"%X/%X\"}\n",
+						  LSN_FORMAT_ARGS(context->cur_record_lsn));
 
 		log_debug("Inserted action SWITCH for lsn %X/%X in \"%s\"",
 				  LSN_FORMAT_ARGS(context->cur_record_lsn),
 				  privateContext->walFileName);
 
+		/* in direct mode, apply the SWITCH message before rotating files */
+		if (privateContext->mode == STREAM_MODE_DIRECT &&
+			privateContext->directApplyReady)
+		{
+			if (!stream_direct_message(
+					privateContext,
+					privateContext->writeBuffer->data + previousLen))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
 		if (!streamCloseFile(context, time_to_abort))
 		{
 			/* errors have already been logged */
@@ -686,6 +955,35 @@ streamCloseFile(LogicalStreamContext *context, bool time_to_abort)
 	{
 		log_debug("Closing file \"%s\"", privateContext->walFileName);
 
+		/* write the buffered messages that belong to this file first */
+		if (!streamFlushWriteBuffer(privateContext))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		/*
+		 * Sync the file before closing it: a pending asynchronous writeback
+		 * from streamFlush can only be confirmed while the file descriptor is
+		 * still at hand, and the LSN tracking then covers this file.
+		 */
+		if (fflush(privateContext->jsonFile) != 0)
+		{
+			log_error("Failed to flush file \"%s\": %m",
+					  privateContext->walFileName);
+			return false;
+		}
+
+		if (fdatasync(fileno(privateContext->jsonFile)) != 0)
+		{
+			log_error("Failed to fdatasync file \"%s\": %m",
+					  privateContext->walFileName);
+			return false;
+		}
+
+		privateContext->pendingSyncLSN = context->tracking->written_lsn;
+		context->tracking->flushed_lsn = context->tracking->written_lsn;
+
 		if (fclose(privateContext->jsonFile) != 0)
 		{
 			log_error("Failed to close file \"%s\": %m",
@@ -752,6 +1050,12 @@ streamCloseFile(LogicalStreamContext *context, bool time_to_abort)
 			break;
 		}
 
+		case STREAM_MODE_DIRECT:
+		{
+			/* changes have already been applied as they were received */
+			break;
+		}
+
 		default:
 		{
 			log_error("BUG: unknown LogicalStreamMode %d", privateContext->mode);
@@ -767,9 +1071,17 @@ streamCloseFile(LogicalStreamContext *context, bool time_to_abort)
  * streamFlush is a callback function for our LogicalStreamClient.
  *
  * This function is called when it's time to flush the data that's currently
- * being written to disk, by calling fsync(). This is triggerred either on a
- * time basis from within the writeFunction callback, or when it's
- * time_to_abort in pgsql_stream_logical.
+ * being written to disk. This is triggerred either on a time basis from
+ * within the writeFunction callback, or when it's time_to_abort in
+ * pgsql_stream_logical.
+ *
+ * Rather than calling fsync() inline — which may stall the receive loop for
+ * as long as the storage needs, while the walsender backs up — the sync is
+ * split in two stages on Linux: the current call asks the kernel to start
+ * writing back dirty pages with sync_file_range(), and the next call
+ * confirms that writeback with a (then cheap) fdatasync() before reporting
+ * the LSN as flushed. The durability contract is unchanged: flushed_lsn only
+ * ever covers data that a sync call has confirmed on disk.
  */
 bool
 streamFlush(LogicalStreamContext *context)
@@ -786,11 +1098,60 @@ streamFlush(LogicalStreamContext *context)
 			  LSN_FORMAT_ARGS(context->tracking->written_lsn),
 			  LSN_FORMAT_ARGS(context->cur_record_lsn));
 
-	/* if needed, flush our current file now (fsync) */
-	if (context->tracking->flushed_lsn < context->tracking->written_lsn)
+	int fd = fileno(privateContext->jsonFile);
+
+	/* first, confirm the writeback that the previous call started */
+	if (context->tracking->flushed_lsn < privateContext->pendingSyncLSN)
 	{
-		int fd = fileno(privateContext->jsonFile);
+		if (fdatasync(fd) != 0)
+		{
+			log_error("Failed to fdatasync file \"%s\": %m",
+					  privateContext->walFileName);
+			return false;
+		}
+
+		context->tracking->flushed_lsn = privateContext->pendingSyncLSN;
 
+		log_debug("Flushed up to %X/%X in file \"%s\"",
+				  LSN_FORMAT_ARGS(context->tracking->flushed_lsn),
+				  privateContext->walFileName);
+	}
+
+	/* then start asynchronous writeback of the data received since */
+	if (privateContext->pendingSyncLSN < context->tracking->written_lsn)
+	{
+		/* first empty our in-memory write buffer to the file */
+		if (!streamFlushWriteBuffer(privateContext))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (fflush(privateContext->jsonFile) != 0)
+		{
+			log_error("Failed to flush file \"%s\": %m",
+					  privateContext->walFileName);
+			return false;
+		}
+
+#ifdef __linux__
+
+		/*
+		 * Hint the kernel to start writing back now; the call returns without
+		 * waiting for the I/O to complete, and the fdatasync() that the next
+		 * streamFlush call issues then finds the work already done.
+		 */
+		if (sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE) != 0)
+		{
+			log_error("Failed to sync_file_range file \"%s\": %m",
+					  privateContext->walFileName);
+			return false;
+		}
+
+		privateContext->pendingSyncLSN = context->tracking->written_lsn;
+#else
+
+		/* without sync_file_range, sync inline as before */
 		if (fsync(fd) != 0)
 		{
 			log_error("Failed to fsync file \"%s\": %m",
@@ -798,13 +1159,66 @@ streamFlush(LogicalStreamContext *context)
 			return false;
 		}
 
+		privateContext->pendingSyncLSN = context->tracking->written_lsn;
 		context->tracking->flushed_lsn = context->tracking->written_lsn;
 
 		log_debug("Flushed up to %X/%X in file \"%s\"",
 				  LSN_FORMAT_ARGS(context->tracking->flushed_lsn),
 				  privateContext->walFileName);
+#endif
+	}
+
+	return true;
+}
+
+
+/*
+ * streamFlushWriteBuffer writes the in-memory buffer of received messages to
+ * the currently opened JSON file, as a single large chunk rather than one
+ * small write per decoded row. It is called when the buffer has grown to
+ * STREAM_WRITE_BUFFER_SIZE, and also before any fsync or fclose of the file,
+ * so that the existing streamFlush durability points are honored.
+ */
+static bool
+streamFlushWriteBuffer(StreamContext *privateContext)
+{
+	PQExpBuffer buffer = privateContext->writeBuffer;
+
+	if (buffer == NULL || buffer->len == 0)
+	{
+		return true;
+	}
+
+	if (privateContext->jsonFile == NULL)
+	{
+		log_error("Failed to flush stream write buffer: jsonFile is NULL");
+		return false;
+	}
+
+	if (privateContext->compress)
+	{
+		/* each flushed chunk is a gzip member of its own, appended to file */
+		if (!write_file_gzip_chunk(privateContext->jsonFile,
+								   privateContext->walFileName,
+								   buffer->data,
+								   buffer->len))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else if (fwrite(buffer->data, sizeof(char), buffer->len,
+					privateContext->jsonFile) != (size_t) buffer->len)
+	{
+		log_error("Failed to write %zu bytes to file \"%s\": %m",
+				  (size_t) buffer->len,
+				  privateContext->walFileName);
+		return false;
 	}
 
+	/* the buffer's allocated memory is kept around and reused */
+	resetPQExpBuffer(buffer);
+
 	return true;
 }
 
@@ -847,15 +1261,31 @@ streamKeepalive(LogicalStreamContext *context)
 			return false;
 		}
 
-		fformat(privateContext->jsonFile,
-				"{\"action\":\"K\",\"lsn\":\"%X/%X\",\"timestamp\":\"%s\"}\n",
-				LSN_FORMAT_ARGS(context->cur_record_lsn),
-				sendTimeStr);
+		size_t previousLen = privateContext->writeBuffer->len;
+
+		appendPQExpBuffer(privateContext->writeBuffer,
+						  "{\"action\":\"K\",\"lsn\":\"%X/%X\","
+						  "\"timestamp\":\"%s\"}\n",
+						  LSN_FORMAT_ARGS(context->cur_record_lsn),
+						  sendTimeStr);
 
 		log_debug("Inserted action KEEPALIVE for lsn %X/%X @%s",
 				  LSN_FORMAT_ARGS(context->cur_record_lsn),
 				  sendTimeStr);
 
+		/* in direct mode, track progress on the target database too */
+		if (privateContext->mode == STREAM_MODE_DIRECT &&
+			privateContext->directApplyReady)
+		{
+			if (!stream_direct_message(
+					privateContext,
+					privateContext->writeBuffer->data + previousLen))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
 		/* update the LSN tracking that's reported in the feedback */
 		context->tracking->written_lsn = context->cur_record_lsn;
 	}
@@ -945,6 +1375,18 @@ streamFeedback(LogicalStreamContext *context)
 
 	context->lastFeedbackSync = context->now;
 
+	/* expose the effective flush lag (in bytes of WAL) as a metric */
+	uint64_t flushLag =
+		context->tracking->written_lsn > context->tracking->flushed_lsn
+		? context->tracking->written_lsn - context->tracking->flushed_lsn
+		: 0;
+
+	(void) metrics_emit(privateContext->paths.metricsfile,
+						"flush-lag",
+						0, /* oid */
+						flushLag,
+						0);
+
 	log_debug("streamFeedback: written %X/%X flushed %X/%X applied %X/%X "
 			  " endpos %X/%X apply %s",
 			  LSN_FORMAT_ARGS(context->tracking->written_lsn),
@@ -1082,6 +1524,170 @@ prepareMessageJSONbuffer(LogicalStreamContext *context)
 }
 
 
+/*
+ * parseMessageMetadataFast extracts the action, xid, lsn, and timestamp
+ * top-level keys of a JSON message with a single pass over the buffer,
+ * without building a JSON DOM tree that's thrown away immediately after.
+ *
+ * The messages we parse here have been written by streamWrite and
+ * streamKeepalive where the key order is fixed, so we know exactly what
+ * bytes to expect. When the buffer does not match that layout the function
+ * returns false, without logging any error: the caller then falls back to
+ * parseMessageMetadata and the full JSON parser.
+ */
+bool
+parseMessageMetadataFast(LogicalMessageMetadata *metadata, const char *buffer)
+{
+	const char *ptr = buffer;
+
+	/* {"action":"B" */
+	if (strncmp(ptr, "{\"action\":\"", 11) != 0)
+	{
+		return false;
+	}
+
+	ptr += 11;
+
+	char action = *ptr;
+
+	switch (action)
+	{
+		case STREAM_ACTION_BEGIN:
+		case STREAM_ACTION_COMMIT:
+		case STREAM_ACTION_INSERT:
+		case STREAM_ACTION_UPDATE:
+		case STREAM_ACTION_DELETE:
+		case STREAM_ACTION_TRUNCATE:
+		case STREAM_ACTION_SWITCH:
+		case STREAM_ACTION_KEEPALIVE:
+		{
+			break;
+		}
+
+		default:
+		{
+			/* includes MESSAGE entries, which have their own layout */
+			return false;
+		}
+	}
+
+	if (*(ptr + 1) != '"')
+	{
+		return false;
+	}
+
+	metadata->action = (StreamAction) action;
+	ptr += 2;
+
+	/* ,"xid":"1234" — or unquoted, ,"xid":1234 */
+	if (strncmp(ptr, ",\"xid\":", 7) == 0)
+	{
+		ptr += 7;
+
+		bool quoted = *ptr == '"';
+
+		if (quoted)
+		{
+			++ptr;
+		}
+
+		uint64_t xid = 0;
+		const char *start = ptr;
+
+		while ('0' <= *ptr && *ptr <= '9')
+		{
+			xid = xid * 10 + (*ptr - '0');
+			++ptr;
+		}
+
+		if (ptr == start || xid > UINT32_MAX)
+		{
+			return false;
+		}
+
+		if (quoted)
+		{
+			if (*ptr != '"')
+			{
+				return false;
+			}
+			++ptr;
+		}
+
+		metadata->xid = (uint32_t) xid;
+	}
+	else if (metadata->action == STREAM_ACTION_BEGIN ||
+			 metadata->action == STREAM_ACTION_COMMIT)
+	{
+		/* let the full parser report the missing xid */
+		return false;
+	}
+
+	/* ,"lsn":"0/24E3C48" */
+	if (strncmp(ptr, ",\"lsn\":\"", 8) == 0)
+	{
+		ptr += 8;
+
+		char lsn[PG_LSN_MAXLENGTH] = { 0 };
+		int len = 0;
+
+		while (*ptr != '"' && *ptr != '\0' && len < PG_LSN_MAXLENGTH - 1)
+		{
+			lsn[len++] = *ptr++;
+		}
+
+		if (*ptr != '"' || !parseLSN(lsn, &(metadata->lsn)))
+		{
+			return false;
+		}
+
+		++ptr;
+	}
+	else if (metadata->action == STREAM_ACTION_BEGIN ||
+			 metadata->action == STREAM_ACTION_COMMIT)
+	{
+		/* let the full parser report the missing lsn */
+		return false;
+	}
+
+	/* ,"timestamp":"2022-10-14 14:29:16.7838+00" */
+	if (strncmp(ptr, ",\"timestamp\":\"", 14) == 0)
+	{
+		ptr += 14;
+
+		size_t len = 0;
+		size_t max = sizeof(metadata->timestamp);
+
+		while (*ptr != '"' && *ptr != '\0')
+		{
+			/* escaped characters are unexpected here, use the full parser */
+			if (*ptr == '\\' || len >= max - 1)
+			{
+				return false;
+			}
+
+			metadata->timestamp[len++] = *ptr++;
+		}
+
+		if (*ptr != '"')
+		{
+			return false;
+		}
+
+		metadata->timestamp[len] = '\0';
+		++ptr;
+	}
+
+	/* the next key, if any, is the decoded message itself */
+	if (*ptr != ',' && *ptr != '}')
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * parseMessageMetadata parses just the metadata of the JSON replication
  * message we got from wal2json.
@@ -1215,9 +1821,11 @@ parseMessageMetadata(LogicalMessageMetadata *metadata,
 bool
 stream_read_file(StreamContent *content)
 {
-	long size = 0L;
-
-	if (!read_file(content->filename, &(content->buffer), &size))
+	/* map large files, inflate compressed ones, plain read small ones */
+	if (!read_file_mmap(content->filename,
+						&(content->buffer),
+						&(content->size),
+						&(content->mapped)))
 	{
 		/* errors have already been logged */
 		return false;
@@ -1248,6 +1856,12 @@ stream_read_file(StreamContent *content)
 		char *message = content->lines[i];
 		LogicalMessageMetadata *metadata = &(content->messages[i]);
 
+		/* we wrote those messages ourselves, scan the known byte layout */
+		if (parseMessageMetadataFast(metadata, message))
+		{
+			continue;
+		}
+
 		JSON_Value *json = json_parse_string(message);
 
 		if (!parseMessageMetadata(metadata, message, json, false))
@@ -1461,47 +2075,55 @@ StreamActionFromChar(char action)
 
 
 /*
- * streamWaitForSubprocess calls waitpid() and blocks until the current
- * subprocess is reported terminated by the Operating System.
+ * streamWaitForSubprocess calls waitpid() and blocks until all the transform
+ * worker subprocesses are reported terminated by the Operating System.
  */
 bool
 streamWaitForSubprocess(LogicalStreamContext *context)
 {
 	StreamContext *privateContext = (StreamContext *) context->private;
 
-	/* if a subprocess had been started before, wait until it's done. */
-	if (privateContext->subprocess <= 0)
-	{
-		return true;
-	}
-	int status = 0;
+	bool allReturnCodeAreZero = true;
 
-	if (waitpid(privateContext->subprocess, &status, 0) == -1)
+	for (int i = 0; i < STREAM_TRANSFORM_JOBS; i++)
 	{
-		log_error("Failed to wait for pid %d: %m",
-				  privateContext->subprocess);
-		return false;
-	}
+		/* if a subprocess had been started before, wait until it's done. */
+		if (privateContext->subprocess[i] <= 0)
+		{
+			continue;
+		}
 
-	int returnCode = WEXITSTATUS(status);
+		int status = 0;
 
-	if (returnCode != 0)
-	{
-		log_error("Stream Transform Worker %d exited with code %d, "
-				  "see above for details",
-				  privateContext->subprocess,
-				  returnCode);
-	}
-	else
-	{
-		log_debug("Transform subprocess %d exited successfully [%d]",
-				  privateContext->subprocess,
-				  returnCode);
-	}
+		if (waitpid(privateContext->subprocess[i], &status, 0) == -1)
+		{
+			log_error("Failed to wait for pid %d: %m",
+					  privateContext->subprocess[i]);
+			allReturnCodeAreZero = false;
+			continue;
+		}
+
+		int returnCode = WEXITSTATUS(status);
+
+		if (returnCode != 0)
+		{
+			log_error("Stream Transform Worker %d exited with code %d, "
+					  "see above for details",
+					  privateContext->subprocess[i],
+					  returnCode);
+			allReturnCodeAreZero = false;
+		}
+		else
+		{
+			log_debug("Transform subprocess %d exited successfully [%d]",
+					  privateContext->subprocess[i],
+					  returnCode);
+		}
 
-	privateContext->subprocess = 0;
+		privateContext->subprocess[i] = 0;
+	}
 
-	return returnCode == 0;
+	return allReturnCodeAreZero;
 }
 
 
@@ -1869,7 +2491,11 @@ stream_create_sentinel(CopyDataSpec *copySpecs,
 		"drop table if exists pgcopydb.sentinel",
 		"create table pgcopydb.sentinel"
 		"(startpos pg_lsn, endpos pg_lsn, apply bool, "
-		" write_lsn pg_lsn, flush_lsn pg_lsn, replay_lsn pg_lsn)",
+		" write_lsn pg_lsn, flush_lsn pg_lsn, replay_lsn pg_lsn, "
+		" apply_lag_p50 bigint default 0, "
+		" apply_lag_p95 bigint default 0, "
+		" apply_lag_p99 bigint default 0, "
+		" apply_lag_txns bigint default 0)",
 		NULL
 	};
 
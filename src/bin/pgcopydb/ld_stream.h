@@ -11,8 +11,40 @@
 #include "parson.h"
 
 #include "copydb.h"
+#include "mem_utils.h"
 #include "queue_utils.h"
 #include "pgsql.h"
+#include "pqexpbuffer.h"
+
+/* batch received messages in memory and write them in large chunks */
+#define STREAM_WRITE_BUFFER_SIZE (2 * 1024 * 1024)
+
+/*
+ * Closed WAL segment JSON files are independent from one another, so several
+ * transform workers can consume the transform queue concurrently: the apply
+ * process follows the LSN ordering of the SQL file names, not the order in
+ * which the files have been transformed.
+ */
+#define STREAM_TRANSFORM_JOBS 4
+
+/*
+ * Opt-in parallel apply partitions source transactions across up to
+ * --apply-jobs target sessions, hashing the relation names they touch so
+ * that all the changes to a given relation replay in their original order
+ * on the same target session. The per-worker replayed LSN positions are
+ * maintained in a shared memory segment, used both to report the overall
+ * (minimum) replay progress to the sentinel and to synchronize the workers
+ * around cross-partition transactions.
+ */
+#define STREAM_APPLY_MAX_JOBS 32
+
+/* power-of-two milliseconds buckets: <1ms up to 2^22 ms (about 70 minutes) */
+#define STREAM_APPLY_LAG_BUCKETS 24
+
+typedef struct StreamApplySharedLSN
+{
+	uint64_t replayedLSN[STREAM_APPLY_MAX_JOBS];
+} StreamApplySharedLSN;
 
 #define OUTPUT_BEGIN "BEGIN; -- "
 #define OUTPUT_COMMIT "COMMIT; -- "
@@ -28,6 +60,7 @@ typedef enum
 	STREAM_ACTION_UPDATE = 'U',
 	STREAM_ACTION_DELETE = 'D',
 	STREAM_ACTION_TRUNCATE = 'T',
+	STREAM_ACTION_PREPARE = 'P',
 	STREAM_ACTION_MESSAGE = 'M',
 	STREAM_ACTION_SWITCH = 'X',
 	STREAM_ACTION_KEEPALIVE = 'K'
@@ -67,6 +100,7 @@ typedef enum
 	STREAM_MODE_UNKNOW = 0,
 	STREAM_MODE_RECEIVE,        /* pgcopydb receive */
 	STREAM_MODE_PREFETCH,       /* pgcopydb fetch */
+	STREAM_MODE_DIRECT,         /* pgcopydb follow --direct */
 	STREAM_MODE_APPLY           /* pgcopydb replay */
 } LogicalStreamMode;
 
@@ -85,6 +119,11 @@ typedef struct StreamContext
 	char *jsonBuffer;           /* malloc'ed area */
 	LogicalMessageMetadata metadata;
 
+	PQExpBuffer writeBuffer;    /* batches messages before writing to disk */
+	bool compress;              /* gzip the JSON files (PGCOPYDB_COMPRESSION) */
+
+	uint64_t pendingSyncLSN;    /* written-back, waiting for sync confirm */
+
 	Queue transformQueue;
 	uint32_t WalSegSz;
 	uint32_t timeline;
@@ -94,12 +133,35 @@ typedef struct StreamContext
 	char sqlFileName[MAXPGPATH];
 	FILE *jsonFile;
 
-	pid_t subprocess;
+	pid_t subprocess[STREAM_TRANSFORM_JOBS];
+
+	/*
+	 * In STREAM_MODE_DIRECT the transform and apply stages run in-process in
+	 * the receive process, the JSON files then only act as a spool for
+	 * resuming operations. See stream_direct_message().
+	 */
+	struct LogicalTransaction *directTx;      /* malloc'ed area */
+	struct StreamApplyContext *applyContext;  /* malloc'ed area */
+	bool directApplyReady;
+	instr_time lastSentinelSync;
 
 	StreamCounters counters;
 } StreamContext;
 
 
+/*
+ * The transform stage emits UPDATE and DELETE statements as single-line
+ * PREPARE/EXECUTE pairs, where the statement name is a hash of the statement
+ * shape (relation, column lists, structure). The apply side only sends the
+ * PREPARE part the first time a name is seen in the current target session,
+ * and tracks the names already prepared in a hash table.
+ */
+typedef struct PreparedStmtEntry
+{
+	char name[NAMEDATALEN];
+	UT_hash_handle hh;
+} PreparedStmtEntry;
+
 typedef struct StreamApplyContext
 {
 	CDCPaths paths;
@@ -108,6 +170,10 @@ typedef struct StreamApplyContext
 	char source_pguri[MAXCONNINFO];
 	char target_pguri[MAXCONNINFO];
 	char origin[BUFSIZE];
+	char targetSessionGucs[BUFSIZE];
+
+	PGSQL source;               /* LISTEN connection to the source database */
+	bool listening;             /* LISTEN worked, polling is a fallback */
 
 	IdentifySystem system;      /* information about source database */
 	uint32_t WalSegSz;          /* information about source database */
@@ -119,6 +185,23 @@ typedef struct StreamApplyContext
 	uint64_t endpos;            /* finish applying when endpos is reached */
 
 	bool reachedEndPos;
+	bool reachedStartingPosition;
+
+	PQExpBuffer sqlBatch;       /* DML statements batched since BEGIN */
+	PreparedStmtEntry *preparedStmts;   /* names prepared in this session */
+	bool txnOpen;               /* a transaction is open on the target */
+	int groupTxnCount;          /* source transactions in the current group */
+	instr_time groupStartTime;  /* when the open group was started */
+
+	uint64_t lagHistogram[STREAM_APPLY_LAG_BUCKETS];    /* commit lag, in ms */
+	uint64_t lagTxnCount;       /* transactions counted in the histogram */
+
+	int applyJobs;              /* parallel apply workers, 1 disables */
+	int applySlot;              /* this worker's partition number */
+	StreamApplySharedLSN *sharedLSN;    /* per-worker replayed positions */
+	bool txnSkip;               /* current txn belongs to another worker */
+	bool txnWaitForLeader;      /* cross-partition txn, wait for worker 0 */
+	bool txnForceCommit;        /* commit the open group at next COMMIT */
 
 	char wal[MAXPGPATH];
 	char sqlFileName[MAXPGPATH];
@@ -239,6 +322,8 @@ typedef struct LogicalTransaction
 	uint32_t count;                     /* number of statements */
 	LogicalTransactionStatement *first;
 	LogicalTransactionStatement *last;
+
+	MemoryArena arena;                  /* statements are allocated here */
 } LogicalTransaction;
 
 typedef struct LogicalTransactionArray
@@ -261,6 +346,9 @@ typedef struct StreamSpecs
 
 	char slotName[NAMEDATALEN];
 	char origin[NAMEDATALEN];
+	char targetSessionGucs[BUFSIZE];
+
+	int applyJobs;              /* parallel apply processes, 1 disables */
 
 	uint64_t startpos;
 	uint64_t endpos;
@@ -276,6 +364,8 @@ typedef struct StreamContent
 	char filename[MAXPGPATH];
 	int count;
 	char *buffer;
+	long size;
+	bool mapped;                      /* unmap_file vs free for the buffer */
 	char **lines;                     /* malloc'ed area */
 	LogicalMessageMetadata *messages; /* malloc'ed area */
 } StreamContent;
@@ -291,6 +381,8 @@ bool stream_init_specs(StreamSpecs *specs,
 					   uint64_t endpos,
 					   LogicalStreamMode mode);
 
+bool stream_init_plugin_filters(StreamSpecs *specs, SourceFilters *filters);
+
 bool stream_init_context(StreamContext *privateContext, StreamSpecs *specs);
 bool stream_close_context(StreamContext *privateContext);
 
@@ -313,6 +405,9 @@ bool prepareMessageJSONbuffer(LogicalStreamContext *context);
 
 bool parseMessageActionAndXid(LogicalStreamContext *context);
 
+bool parseMessageMetadataFast(LogicalMessageMetadata *metadata,
+							  const char *buffer);
+
 bool parseMessageMetadata(LogicalMessageMetadata *metadata,
 						  const char *buffer,
 						  JSON_Value *json,
@@ -354,22 +449,25 @@ StreamAction StreamActionFromChar(char action);
 
 /* ld_transform.c */
 bool stream_transform_start_worker(LogicalStreamContext *context);
+bool stream_transform_backfill(LogicalStreamContext *context);
 bool stream_transform_worker(LogicalStreamContext *context);
 bool stream_transform_add_file(Queue *queue, uint64_t firstLSN);
 bool stream_transform_send_stop(Queue *queue);
 bool stream_compute_pathnames(LogicalStreamContext *context, uint64_t lsn);
 
 bool stream_transform_file(char *jsonfilename, char *sqlfilename);
+bool stream_direct_message(StreamContext *privateContext, char *line);
 bool stream_write_transaction(FILE *out, LogicalTransaction *tx);
-bool stream_write_begin(FILE *out, LogicalTransaction *tx);
-bool stream_write_commit(FILE *out, LogicalTransaction *tx);
-bool stream_write_switchwal(FILE *out, LogicalMessageSwitchWAL *switchwal);
-bool stream_write_keepalive(FILE *out, LogicalMessageKeepalive *keepalive);
-bool stream_write_insert(FILE *out, LogicalMessageInsert *insert);
-bool stream_write_truncate(FILE *out, LogicalMessageTruncate *truncate);
-bool stream_write_update(FILE *out, LogicalMessageUpdate *update);
-bool stream_write_delete(FILE * out, LogicalMessageDelete *delete);
-bool stream_write_value(FILE *out, LogicalMessageValue *value);
+bool stream_write_transaction_buffer(PQExpBuffer out, LogicalTransaction *tx);
+bool stream_write_begin(PQExpBuffer out, LogicalTransaction *tx);
+bool stream_write_commit(PQExpBuffer out, LogicalTransaction *tx);
+bool stream_write_switchwal(PQExpBuffer out, LogicalMessageSwitchWAL *switchwal);
+bool stream_write_keepalive(PQExpBuffer out, LogicalMessageKeepalive *keepalive);
+bool stream_write_insert(PQExpBuffer out, LogicalMessageInsert *insert);
+bool stream_write_truncate(PQExpBuffer out, LogicalMessageTruncate *truncate);
+bool stream_write_update(PQExpBuffer out, LogicalMessageUpdate *update);
+bool stream_write_delete(PQExpBuffer out, LogicalMessageDelete *delete);
+bool stream_write_value(PQExpBuffer out, LogicalMessageValue *value);
 
 bool parseMessage(LogicalTransaction *txn,
 				  LogicalMessageMetadata *metadata,
@@ -380,14 +478,14 @@ bool streamLogicalTransactionAppendStatement(LogicalTransaction *txn,
 											 LogicalTransactionStatement *stmt);
 
 void FreeLogicalTransaction(LogicalTransaction *tx);
-void FreeLogicalMessageTupleArray(LogicalMessageTupleArray *tupleArray);
 
 /* ld_test_decoding.c */
 bool prepareTestDecodingMessage(LogicalStreamContext *context);
 
 bool parseTestDecodingMessageActionAndXid(LogicalStreamContext *context);
 
-bool parseTestDecodingMessage(LogicalTransactionStatement *stmt,
+bool parseTestDecodingMessage(MemoryArena *arena,
+							  LogicalTransactionStatement *stmt,
 							  LogicalMessageMetadata *metadata,
 							  char *message,
 							  JSON_Value *json);
@@ -397,7 +495,8 @@ bool prepareWal2jsonMessage(LogicalStreamContext *context);
 
 bool parseWal2jsonMessageActionAndXid(LogicalStreamContext *context);
 
-bool parseWal2jsonMessage(LogicalTransactionStatement *stmt,
+bool parseWal2jsonMessage(MemoryArena *arena,
+						  LogicalTransactionStatement *stmt,
 						  LogicalMessageMetadata *metadata,
 						  char *message,
 						  JSON_Value *json);
@@ -412,6 +511,12 @@ bool stream_apply_sync_sentinel(StreamApplyContext *context);
 
 bool stream_apply_file(StreamApplyContext *context);
 
+bool stream_apply_sql(StreamApplyContext *context,
+					  LogicalMessageMetadata *metadata,
+					  const char *sql);
+
+bool stream_apply_setup(StreamSpecs *specs, StreamApplyContext *context);
+
 bool setupReplicationOrigin(StreamApplyContext *context,
 							CDCPaths *paths,
 							char *source_pguri,
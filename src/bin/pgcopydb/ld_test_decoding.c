@@ -49,15 +49,17 @@ typedef struct TestDecodingColumns
 	int colnameLen;
 	char *valueStart;
 	int valueLen;
-
-	struct TestDecodingColumns *next;
 } TestDecodingColumns;
 
+/* Postgres MaxTupleAttributeNumber, not exported to frontend code */
+#define TD_MAX_COLUMNS 1664
+
 
 static bool parseTestDecodingMessageHeader(TestDecodingHeader *header,
 										   const char *message);
 
-static bool SetColumnNamesAndValues(LogicalMessageTuple *tuple,
+static bool SetColumnNamesAndValues(MemoryArena *arena,
+									LogicalMessageTuple *tuple,
 									TestDecodingHeader *header,
 									const char *message);
 
@@ -65,9 +67,10 @@ static bool parseNextColumn(TestDecodingColumns *cols,
 							TestDecodingHeader *header,
 							const char *message);
 
-static bool listToTuple(LogicalMessageTuple *tuple,
-						TestDecodingColumns *cols,
-						int count);
+static bool columnsToTuple(MemoryArena *arena,
+						   LogicalMessageTuple *tuple,
+						   TestDecodingColumns *columns,
+						   int count);
 
 /*
  * prepareWal2jsonMessage prepares our internal JSON entry from a test_decoding
@@ -200,7 +203,8 @@ parseTestDecodingMessageActionAndXid(LogicalStreamContext *context)
  * OUTPUT: pgcopydb LogicalTransactionStatement structure
  */
 bool
-parseTestDecodingMessage(LogicalTransactionStatement *stmt,
+parseTestDecodingMessage(MemoryArena *arena,
+						 LogicalTransactionStatement *stmt,
 						 LogicalMessageMetadata *metadata,
 						 char *message,
 						 JSON_Value *json)
@@ -244,11 +248,12 @@ parseTestDecodingMessage(LogicalTransactionStatement *stmt,
 
 			stmt->stmt.insert.new.count = 1;
 			stmt->stmt.insert.new.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			if (stmt->stmt.insert.new.array == NULL)
 			{
-				log_error(ALLOCATION_FAILED_ERROR);
+				/* errors have already been logged */
 				return false;
 			}
 
@@ -256,7 +261,7 @@ parseTestDecodingMessage(LogicalTransactionStatement *stmt,
 
 			LogicalMessageTuple *tuple = &(stmt->stmt.insert.new.array[0]);
 
-			if (!SetColumnNamesAndValues(tuple, &header, td_message))
+			if (!SetColumnNamesAndValues(arena, tuple, &header, td_message))
 			{
 				log_error("Failed to parse INSERT columns for logical "
 						  "message %s",
@@ -276,15 +281,17 @@ parseTestDecodingMessage(LogicalTransactionStatement *stmt,
 			stmt->stmt.update.new.count = 1;
 
 			stmt->stmt.update.old.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			stmt->stmt.update.new.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			if (stmt->stmt.update.old.array == NULL ||
 				stmt->stmt.update.new.array == NULL)
 			{
-				log_error(ALLOCATION_FAILED_ERROR);
+				/* errors have already been logged */
 				return false;
 			}
 
@@ -302,7 +309,7 @@ parseTestDecodingMessage(LogicalTransactionStatement *stmt,
 
 			LogicalMessageTuple *old = &(stmt->stmt.update.old.array[0]);
 
-			if (!SetColumnNamesAndValues(old, &header, td_message))
+			if (!SetColumnNamesAndValues(arena, old, &header, td_message))
 			{
 				log_error("Failed to parse UPDATE old-key columns for logical "
 						  "message %s",
@@ -324,7 +331,7 @@ parseTestDecodingMessage(LogicalTransactionStatement *stmt,
 
 			LogicalMessageTuple *new = &(stmt->stmt.update.new.array[0]);
 
-			if (!SetColumnNamesAndValues(new, &header, td_message))
+			if (!SetColumnNamesAndValues(arena, new, &header, td_message))
 			{
 				log_error("Failed to parse UPDATE new-tuple columns for logical "
 						  "message %s",
@@ -342,11 +349,12 @@ parseTestDecodingMessage(LogicalTransactionStatement *stmt,
 
 			stmt->stmt.delete.old.count = 1;
 			stmt->stmt.delete.old.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			if (stmt->stmt.update.old.array == NULL)
 			{
-				log_error(ALLOCATION_FAILED_ERROR);
+				/* errors have already been logged */
 				return false;
 			}
 
@@ -354,7 +362,7 @@ parseTestDecodingMessage(LogicalTransactionStatement *stmt,
 
 			LogicalMessageTuple *tuple = &(stmt->stmt.delete.old.array[0]);
 
-			if (!SetColumnNamesAndValues(tuple, &header, td_message))
+			if (!SetColumnNamesAndValues(arena, tuple, &header, td_message))
 			{
 				log_error("Failed to parse DELETE columns for logical "
 						  "message %s",
@@ -392,23 +400,29 @@ parseTestDecodingMessageHeader(TestDecodingHeader *header, const char *message)
 	 *       ^     ^                ^ ^     ^
 	 *      idp   dot             sep acp   end
 	 */
-	char *idp = (char *) message + strlen("table ");
-	char *dot = strchr(idp, '.');
-	char *sep = strchr(idp, ':');
-	char *acp = sep + 2;    /* skip ": " */
-	char *end = strchr(acp, ':');
+	const char *idp = message + strlen("table ");
 
-	/* skip the last ":" of the header in the offset */
-	header->offset = (end - message + 1) + 1;
+	if (*idp == '"')
+	{
+		log_error("Failed to parse quoted qualified identifer in: %s", message);
+		return false;
+	}
 
-	bool quoted = *idp == '"';
+	/* scan the qualified table name once, for both the dot and the colon */
+	const char *dot = NULL;
+	const char *sep = idp;
 
-	if (quoted)
+	for (; *sep != '\0' && *sep != ':'; sep++)
 	{
-		char ident[BUFSIZE] = { 0 };
-		strlcpy(ident, idp, sep - idp);
+		if (*sep == '.' && dot == NULL)
+		{
+			dot = sep;
+		}
+	}
 
-		log_error("Failed to parse quoted qualified identifer %s", ident);
+	if (*sep == '\0' || dot == NULL)
+	{
+		log_error("Failed to parse test_decoding message header: %s", message);
 		return false;
 	}
 
@@ -416,31 +430,33 @@ parseTestDecodingMessageHeader(TestDecodingHeader *header, const char *message)
 	strlcpy(header->nspname, idp, dot - idp + 1);
 	strlcpy(header->relname, dot + 1, sep - dot);
 
-	/* now grab the action */
-	char action[BUFSIZE] = { 0 };
-	strlcpy(action, acp, end - acp + 1);
+	/* now grab the action, which follows the ": " separator */
+	const char *acp = sep + 2;
 
-	if (strcmp(action, "INSERT") == 0)
+	if (strncmp(acp, "INSERT:", 7) == 0)
 	{
 		header->action = STREAM_ACTION_INSERT;
+		header->offset = (acp - message) + 8;
 	}
-	else if (strcmp(action, "UPDATE") == 0)
+	else if (strncmp(acp, "UPDATE:", 7) == 0)
 	{
 		header->action = STREAM_ACTION_UPDATE;
+		header->offset = (acp - message) + 8;
 	}
-	else if (strcmp(action, "DELETE") == 0)
+	else if (strncmp(acp, "DELETE:", 7) == 0)
 	{
 		header->action = STREAM_ACTION_DELETE;
+		header->offset = (acp - message) + 8;
 	}
-	else if (strcmp(action, "TRUNCATE") == 0)
+	else if (strncmp(acp, "TRUNCATE:", 9) == 0)
 	{
 		header->action = STREAM_ACTION_TRUNCATE;
+		header->offset = (acp - message) + 10;
 	}
 	else
 	{
 		log_error("Failed to parse unknown test_decoding "
-				  "message action \"%s\" in: %s",
-				  action,
+				  "message action in: %s",
 				  message);
 		return false;
 	}
@@ -450,12 +466,16 @@ parseTestDecodingMessageHeader(TestDecodingHeader *header, const char *message)
 
 
 /*
- * SetColumnNames parses the "columns" (or "identity") JSON object from a
- * wal2json logical replication message and fills-in our internal
- * representation for a tuple.
+ * SetColumnNamesAndValues tokenizes the column names and values of a
+ * test_decoding message and fills-in our internal representation for a tuple.
+ *
+ * The tokenizer walks the message buffer exactly once, registering pointers
+ * into the buffer as it goes: nothing is copied until the tuple itself is
+ * allocated from the arena.
  */
 static bool
-SetColumnNamesAndValues(LogicalMessageTuple *tuple,
+SetColumnNamesAndValues(MemoryArena *arena,
+						LogicalMessageTuple *tuple,
 						TestDecodingHeader *header,
 						const char *message)
 {
@@ -463,22 +483,25 @@ SetColumnNamesAndValues(LogicalMessageTuple *tuple,
 			  header->action,
 			  message + header->pos);
 
-	TestDecodingColumns *cols =
-		(TestDecodingColumns *) calloc(1, sizeof(TestDecodingColumns));
+	TestDecodingColumns columns[TD_MAX_COLUMNS];
+	int count = 0;
 
-	if (cols == NULL)
+	while (!header->eom)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
-		return false;
-	}
+		if (count == TD_MAX_COLUMNS)
+		{
+			log_error("Failed to parse test_decoding message with more than "
+					  "%d columns: %s",
+					  TD_MAX_COLUMNS,
+					  message);
+			return false;
+		}
 
-	cols->next = NULL;
+		TestDecodingColumns empty = { 0 };
+		TestDecodingColumns *cur = &(columns[count]);
 
-	TestDecodingColumns *cur = cols;
-	int count = 0;
+		*cur = empty;
 
-	while (!header->eom)
-	{
 		if (!parseNextColumn(cur, header, message))
 		{
 			/* errors have already been logged */
@@ -486,59 +509,24 @@ SetColumnNamesAndValues(LogicalMessageTuple *tuple,
 		}
 
 		/* when we find "new-tuple: " */
-		if (!header->eom && cur->colnameStart == NULL)
+		if (cur->colnameStart == NULL)
 		{
 			break;
 		}
 
 		++count;
-
-		/* that might have been the last column */
-		if (header->eom)
-		{
-			break;
-		}
-
-		/* if that was not the last column, prepare the next one */
-		TestDecodingColumns *next =
-			(TestDecodingColumns *) calloc(1, sizeof(TestDecodingColumns));
-
-		if (next == NULL)
-		{
-			log_error(ALLOCATION_FAILED_ERROR);
-			return false;
-		}
-
-		next->next = NULL;
-		cur->next = next;
-		cur = next;
 	}
 
 	/*
-	 * Transform the internal TestDecodingColumns linked-list into our internal
-	 * representation for DML tuples, which is output plugin independant.
+	 * Transform the tokenized columns into our internal representation for
+	 * DML tuples, which is output plugin independant.
 	 */
-	if (!listToTuple(tuple, cols, count))
+	if (!columnsToTuple(arena, tuple, columns, count))
 	{
 		log_error("Failed to convert test_decoding column to tuple");
 		return false;
 	}
 
-	/*
-	 * Free the TestDecodingColumns memory that we allocated: only the
-	 * structure itself, the rest is just a bunch of pointers to parts of the
-	 * messages.
-	 */
-	TestDecodingColumns *c = cols;
-
-	for (; c != NULL;)
-	{
-		TestDecodingColumns *next = c->next;
-
-		free(c);
-		c = next;
-	}
-
 	return true;
 }
 
@@ -686,10 +674,12 @@ parseNextColumn(TestDecodingColumns *cols,
 		else
 		{
 			/* last column */
+			size_t len = strlen(cols->valueStart);
+
 			header->eom = true;
 
-			header->pos = strlen(message) - 1;
-			cols->valueLen = strlen(cols->valueStart);
+			header->pos = (ptr - message) + len - 1;
+			cols->valueLen = len;
 		}
 
 		/* advance to past the value, skip the next space */
@@ -710,18 +700,21 @@ parseNextColumn(TestDecodingColumns *cols,
 
 
 /*
- * listToTuple transforms the test_decoding linked-list output from the parser
- * into our internal data structure for a tuple.
+ * columnsToTuple transforms the tokenized columns output from the parser into
+ * our internal data structure for a tuple.
  */
 static bool
-listToTuple(LogicalMessageTuple *tuple, TestDecodingColumns *cols, int count)
+columnsToTuple(MemoryArena *arena,
+			   LogicalMessageTuple *tuple,
+			   TestDecodingColumns *columns,
+			   int count)
 {
 	tuple->cols = count;
-	tuple->columns = (char **) calloc(count, sizeof(char *));
+	tuple->columns = (char **) arena_alloc(arena, count * sizeof(char *));
 
 	if (tuple->columns == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		/* errors have already been logged */
 		return false;
 	}
 
@@ -738,11 +731,12 @@ listToTuple(LogicalMessageTuple *tuple, TestDecodingColumns *cols, int count)
 
 	valuesArray->count = 1;
 	valuesArray->array =
-		(LogicalMessageValues *) calloc(1, sizeof(LogicalMessageValues));
+		(LogicalMessageValues *)
+		arena_alloc(arena, sizeof(LogicalMessageValues));
 
 	if (valuesArray->array == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		/* errors have already been logged */
 		return false;
 	}
 
@@ -750,41 +744,42 @@ listToTuple(LogicalMessageTuple *tuple, TestDecodingColumns *cols, int count)
 	LogicalMessageValues *values = &(tuple->values.array[0]);
 	values->cols = count;
 	values->array =
-		(LogicalMessageValue *) calloc(count, sizeof(LogicalMessageValue));
+		(LogicalMessageValue *)
+		arena_alloc(arena, count * sizeof(LogicalMessageValue));
 
 	if (values->array == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		/* errors have already been logged */
 		return false;
 	}
 
 	/*
 	 * Now that our memory areas are allocated and initialized to zeroes, fill
-	 * them in with the values from the JSON message.
+	 * them in with the values tokenized from the message.
 	 */
-	int i = 0;
-	TestDecodingColumns *cur = cols;
-
-	for (; i < count && cur != NULL; cur = cur->next, i++)
+	for (int i = 0; i < count; i++)
 	{
+		TestDecodingColumns *cur = &(columns[i]);
 		LogicalMessageValue *valueColumn = &(values->array[i]);
 
-		tuple->columns[i] = strndup(cur->colnameStart, cur->colnameLen);
+		tuple->columns[i] =
+			arena_strndup(arena, cur->colnameStart, cur->colnameLen);
 		valueColumn->oid = TEXTOID;
 
 		if (cur->valueStart == NULL)
 		{
-			log_error("BUG: listToTuple current value is NULL for \"%s\"",
+			log_error("BUG: columnsToTuple current value is NULL for \"%s\"",
 					  tuple->columns[i]);
 			return false;
 		}
 
-		valueColumn->val.str = strndup(cur->valueStart, cur->valueLen);
+		valueColumn->val.str =
+			arena_strndup(arena, cur->valueStart, cur->valueLen);
 		valueColumn->isQuoted = true;
 
 		if (valueColumn->val.str == NULL)
 		{
-			log_error(ALLOCATION_FAILED_ERROR);
+			/* errors have already been logged */
 			return false;
 		}
 
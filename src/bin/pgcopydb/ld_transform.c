@@ -3,12 +3,17 @@
  *     Implementation of a CLI to copy a database between two Postgres instances
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "postgres.h"
 #include "postgres_fe.h"
 #include "access/xlog_internal.h"
@@ -31,50 +36,81 @@
 #include "string_utils.h"
 #include "summary.h"
 
+static bool stream_direct_apply_transaction(StreamContext *privateContext,
+											LogicalTransaction *txn);
+
+static bool stream_transform_write_transaction(FILE *sql,
+											   const char *sqlfilename,
+											   LogicalTransaction *txn,
+											   bool compress);
+
+static void stream_out_int64(PQExpBuffer out, int64_t value);
+static void stream_out_lsn(PQExpBuffer out, uint64_t lsn);
+
+static bool stream_write_escaped_string(PQExpBuffer out, const char *str);
+
+static bool streamCanCoalesceInsert(LogicalMessageInsert *a,
+									LogicalMessageInsert *b);
+
+static bool stream_write_insert_run(PQExpBuffer out,
+									LogicalTransactionStatement *first,
+									LogicalTransactionStatement *last);
+
+/* cap coalesced multi-row INSERT statements to a sensible row count */
+#define STREAM_INSERT_MAX_ROWS 1000
+
 
 /*
- * stream_transform_start_worker creates a sub-process that transform JSON
+ * stream_transform_start_worker creates sub-processes that transform JSON
  * files into SQL files as needed, consuming requests from a queue.
+ *
+ * Segment files are independent from one another, so the workers all consume
+ * the same queue: when falling behind, the backlog of closed JSON files is
+ * transformed concurrently rather than ground through serially.
  */
 bool
 stream_transform_start_worker(LogicalStreamContext *context)
 {
 	StreamContext *privateContext = (StreamContext *) context->private;
 
-	/*
-	 * Flush stdio channels just before fork, to avoid double-output
-	 * problems.
-	 */
-	fflush(stdout);
-	fflush(stderr);
-
-	int fpid = fork();
-
-	switch (fpid)
+	for (int i = 0; i < STREAM_TRANSFORM_JOBS; i++)
 	{
-		case -1:
-		{
-			log_error("Failed to fork a stream transform worker process: %m");
-			return false;
-		}
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
 
-		case 0:
+		int fpid = fork();
+
+		switch (fpid)
 		{
-			/* child process runs the command */
-			if (!stream_transform_worker(context))
+			case -1:
 			{
-				/* errors have already been logged */
-				exit(EXIT_CODE_INTERNAL_ERROR);
+				log_error("Failed to fork a stream transform worker "
+						  "process: %m");
+				return false;
 			}
 
-			exit(EXIT_CODE_QUIT);
-		}
+			case 0:
+			{
+				/* child process runs the command */
+				if (!stream_transform_worker(context))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
 
-		default:
-		{
-			/* fork succeeded, in parent */
-			privateContext->subprocess = fpid;
-			break;
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				privateContext->subprocess[i] = fpid;
+				break;
+			}
 		}
 	}
 
@@ -214,6 +250,126 @@ stream_compute_pathnames(LogicalStreamContext *context, uint64_t lsn)
 }
 
 
+/*
+ * stream_transform_backfill scans the CDC directory for JSON segment files
+ * that are missing their SQL counterpart, and adds them to the transform
+ * queue. The most recent JSON file is skipped: that's the segment the
+ * streaming client re-opens and queues at rotation time.
+ *
+ * While the initial copy phase of a clone --follow runs, received JSON
+ * segments accumulate; transforming them as soon as they are closed means
+ * catchup starts with the SQL files ready instead of first grinding through
+ * the whole transform backlog.
+ */
+bool
+stream_transform_backfill(LogicalStreamContext *context)
+{
+	StreamContext *privateContext = (StreamContext *) context->private;
+	CDCPaths *paths = &(privateContext->paths);
+
+	struct dirent **namelist = NULL;
+	int entries = scandir(paths->dir, &namelist, NULL, alphasort);
+
+	if (entries == -1)
+	{
+		log_error("Failed to scan directory \"%s\": %m", paths->dir);
+		return false;
+	}
+
+	/*
+	 * Find the latest JSON segment file first, as we want to skip it: the
+	 * streaming client resumes in that segment and sends it to the transform
+	 * queue when rotating to the next one.
+	 */
+	int lastIndex = -1;
+
+	for (int i = 0; i < entries; i++)
+	{
+		char *name = namelist[i]->d_name;
+		int len = strlen(name);
+
+		if (len == XLOG_FNAME_LEN + 5 &&
+			streq(name + XLOG_FNAME_LEN, ".json"))
+		{
+			lastIndex = i;
+		}
+	}
+
+	bool success = true;
+
+	for (int i = 0; i < entries; i++)
+	{
+		char *name = namelist[i]->d_name;
+		int len = strlen(name);
+
+		if (len != XLOG_FNAME_LEN + 5 ||
+			!streq(name + XLOG_FNAME_LEN, ".json") ||
+			i == lastIndex)
+		{
+			continue;
+		}
+
+		char sqlFileName[MAXPGPATH] = { 0 };
+
+		sformat(sqlFileName, sizeof(sqlFileName), "%s/%.*s.sql",
+				paths->dir,
+				XLOG_FNAME_LEN,
+				name);
+
+		if (file_exists(sqlFileName))
+		{
+			continue;
+		}
+
+		/* the timeline and WAL segment size have been stored at startup */
+		if (context->timeline == 0)
+		{
+			uint32_t WalSegSz;
+			IdentifySystem system = { 0 };
+
+			if (!stream_read_context(paths, &system, &WalSegSz))
+			{
+				/* errors have already been logged */
+				success = false;
+				break;
+			}
+
+			context->timeline = system.timeline;
+			context->WalSegSz = WalSegSz;
+		}
+
+		TimeLineID tli;
+		XLogSegNo segno;
+
+		XLogFromFileName(name, &tli, &segno, context->WalSegSz);
+
+		uint64_t firstLSN;
+
+		XLogSegNoOffsetToRecPtr(segno, 0, context->WalSegSz, firstLSN);
+
+		log_notice("Transforming backlog segment file \"%s/%s\"",
+				   paths->dir,
+				   name);
+
+		if (!stream_transform_add_file(&(privateContext->transformQueue),
+									   firstLSN))
+		{
+			/* errors have already been logged */
+			success = false;
+			break;
+		}
+	}
+
+	for (int i = 0; i < entries; i++)
+	{
+		free(namelist[i]);
+	}
+	free(namelist);
+
+	return success;
+}
+
+
 /*
  * vacuum_add_table sends a message to the VACUUM process queue to process
  * given table.
@@ -241,16 +397,27 @@ stream_transform_add_file(Queue *queue, uint64_t firstLSN)
 
 
 /*
- * vacuum_send_stop sends the STOP message to the Stream Transform worker.
+ * stream_transform_send_stop sends the STOP messages to the Stream Transform
+ * workers.
+ *
+ * Each worker will consume one STOP message before stopping, so we need to
+ * send as many STOP messages as we have started worker processes.
  */
 bool
 stream_transform_send_stop(Queue *queue)
 {
-	QMessage stop = { .type = QMSG_TYPE_STOP };
+	QMessage stops[STREAM_TRANSFORM_JOBS] = { 0 };
 
-	log_debug("Send STOP message to Transform Queue %d", queue->qId);
+	for (int i = 0; i < STREAM_TRANSFORM_JOBS; i++)
+	{
+		stops[i].type = QMSG_TYPE_STOP;
+	}
 
-	if (!queue_send(queue, &stop))
+	log_debug("Send %d STOP messages to Transform Queue %d",
+			  STREAM_TRANSFORM_JOBS,
+			  queue->qId);
+
+	if (!queue_send_batch(queue, stops, STREAM_TRANSFORM_JOBS))
 	{
 		/* errors have already been logged */
 		return false;
@@ -268,124 +435,158 @@ stream_transform_send_stop(Queue *queue)
 bool
 stream_transform_file(char *jsonfilename, char *sqlfilename)
 {
-	StreamContent content = { 0 };
-	long size = 0L;
-
 	log_notice("Transforming JSON file \"%s\" into SQL file \"%s\"",
 			   jsonfilename,
 			   sqlfilename);
 
-	strlcpy(content.filename, jsonfilename, sizeof(content.filename));
+	/* the JSON file might have been written gzip compressed, or not */
+	FILE *jsonFile = fopen_read_gzip(jsonfilename);
 
-	if (!read_file(content.filename, &(content.buffer), &size))
+	if (jsonFile == NULL)
 	{
-		/* errors have already been logged */
+		log_error("Failed to open file \"%s\": %m", jsonfilename);
 		return false;
 	}
 
-	content.count = countLines(content.buffer);
-	content.lines = (char **) calloc(content.count, sizeof(char *));
-	content.count = splitLines(content.buffer, content.lines, content.count);
+	FILE *sql = fopen_with_umask(sqlfilename, "w", FOPEN_FLAGS_W, 0644);
 
-	if (content.lines == NULL)
+	if (sql == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		log_error("Failed to create and open file \"%s\"", sqlfilename);
 		return false;
 	}
 
-	log_debug("stream_transform_file: read %d lines from \"%s\"",
-			  content.count,
-			  content.filename);
+	/* when compressing JSON files, compress the SQL files too */
+	bool compress = env_exists(PGCOPYDB_COMPRESSION);
 
-	content.messages =
-		(LogicalMessageMetadata *) calloc(content.count,
-										  sizeof(LogicalMessageMetadata));
+	/*
+	 * Read the JSON-lines file that we received from streaming logical
+	 * decoding messages one line at a time, parse the JSON messages into our
+	 * internal representation structure, and write each transaction out in
+	 * the SQL format as soon as its COMMIT message has been read.
+	 *
+	 * Only a single transaction is kept in memory at any time, so that both
+	 * the transform latency and the memory footprint stay flat regardless of
+	 * the size of the JSON file.
+	 */
+	int lineno = 0;
+	int txCount = 0;
 
-	if (content.messages == NULL)
-	{
-		log_error(ALLOCATION_FAILED_ERROR);
-		return false;
-	}
+	LogicalTransaction transaction = { 0 };
+	LogicalTransaction *currentTx = &transaction;
 
-	/* {action: B} {action: C} {action: X} */
-	int maxTxnsCount = (content.count / 2) + 1;
-	LogicalTransactionArray txns = { 0 };
+	/* we might need to access to the last message metadata after the loop */
+	LogicalMessageMetadata lastMetadata = { 0 };
 
-	/* the actual count is maintained in the for loop below */
-	txns.count = 0;
-	txns.array =
-		(LogicalTransaction *) calloc(maxTxnsCount, sizeof(LogicalTransaction));
+	char *line = NULL;
+	size_t lineSize = 0;
+	ssize_t bytes;
 
-	if (txns.array == NULL)
+	while ((bytes = getline(&line, &lineSize, jsonFile)) != -1)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
-		return false;
-	}
+		char *message = line;
 
-	/*
-	 * Read the JSON-lines file that we received from streaming logical
-	 * decoding messages with wal2json, and parse the JSON messages into our
-	 * internal representation structure.
-	 */
-	int currentTxIndex = 0;
-	LogicalTransaction *currentTx = &(txns.array[currentTxIndex]);
+		/* strip the trailing newline, one message per physical line */
+		if (bytes > 0 && message[bytes - 1] == '\n')
+		{
+			message[bytes - 1] = '\0';
+		}
 
-	/* we might need to access to the last message metadata after the loop */
-	LogicalMessageMetadata *metadata = NULL;
+		if (message[0] == '\0')
+		{
+			continue;
+		}
 
-	for (int i = 0; i < content.count; i++)
-	{
-		char *message = content.lines[i];
-		metadata = &(content.messages[i]);
+		LogicalMessageMetadata metadata = { 0 };
 
-		log_trace("stream_transform_file[%2d]: %s", i, message);
+		log_trace("stream_transform_file[%2d]: %s", lineno, message);
 
-		JSON_Value *json = json_parse_string(message);
+		/* we wrote those messages ourselves, scan the known byte layout */
+		JSON_Value *json = NULL;
 
-		if (!parseMessageMetadata(metadata, message, json, false))
+		if (!parseMessageMetadataFast(&metadata, message))
 		{
-			/* errors have already been logged */
-			json_value_free(json);
-			return false;
+			json = json_parse_string(message);
+
+			if (!parseMessageMetadata(&metadata, message, json, false))
+			{
+				/* errors have already been logged */
+				json_value_free(json);
+				return false;
+			}
+		}
+
+		/* only DML messages need the full JSON DOM tree to be parsed */
+		if (json == NULL &&
+			metadata.action != STREAM_ACTION_BEGIN &&
+			metadata.action != STREAM_ACTION_COMMIT &&
+			metadata.action != STREAM_ACTION_SWITCH &&
+			metadata.action != STREAM_ACTION_KEEPALIVE)
+		{
+			json = json_parse_string(message);
 		}
 
-		if (!parseMessage(currentTx, metadata, message, json))
+		if (!parseMessage(currentTx, &metadata, message, json))
 		{
 			log_error("Failed to parse JSON message: %s", message);
-			json_value_free(json);
+
+			if (json != NULL)
+			{
+				json_value_free(json);
+			}
 			return false;
 		}
 
-		json_value_free(json);
+		if (json != NULL)
+		{
+			json_value_free(json);
+		}
 
 		log_trace("stream_transform_file[%2d]: %c %3d %X/%X [%2d]: %3d %X/%X",
-				  i,
-				  metadata->action,
-				  metadata->xid,
-				  LSN_FORMAT_ARGS(metadata->lsn),
-				  currentTxIndex,
+				  lineno,
+				  metadata.action,
+				  metadata.xid,
+				  LSN_FORMAT_ARGS(metadata.lsn),
+				  txCount,
 				  currentTx->xid,
 				  LSN_FORMAT_ARGS(currentTx->beginLSN));
 
-		/* it is time to close the current transaction and prepare a new one? */
-		if (metadata->action == STREAM_ACTION_COMMIT)
-		{
-			++txns.count;
-			++currentTxIndex;
+		lastMetadata = metadata;
+		++lineno;
 
-			if ((maxTxnsCount - 1) < currentTxIndex)
+		/* it is time to write the current transaction and prepare a new one? */
+		if (metadata.action == STREAM_ACTION_COMMIT)
+		{
+			if (!stream_transform_write_transaction(sql, sqlfilename,
+													currentTx, compress))
 			{
-				log_error("Parsing transaction %d, which is more than the "
-						  "maximum allocated transaction count %d",
-						  currentTxIndex + 1,
-						  maxTxnsCount);
+				/* errors have already been logged */
 				return false;
 			}
 
-			currentTx = &(txns.array[currentTxIndex]);
+			(void) FreeLogicalTransaction(currentTx);
+
+			LogicalTransaction empty = { 0 };
+			*currentTx = empty;
+
+			++txCount;
 		}
 	}
 
+	free(line);
+
+	if (ferror(jsonFile))
+	{
+		log_error("Failed to read from file \"%s\": %m", jsonfilename);
+		return false;
+	}
+
+	if (fclose(jsonFile) != 0)
+	{
+		log_error("Failed to close file \"%s\": %m", jsonfilename);
+		return false;
+	}
+
 	/*
 	 * We might have a last pending transaction with a COMMIT message to be
 	 * found in a a later file. In that case though, the last message read was
@@ -395,68 +596,55 @@ stream_transform_file(char *jsonfilename, char *sqlfilename)
 	 * of a transaction, in that case we ignore the transaction and insert a
 	 * KEEPALIVE message with the LSN we have reached.
 	 */
-	if (currentTx->count > 0 && metadata->action == STREAM_ACTION_SWITCH)
+	if (currentTx->count > 0 && lastMetadata.action == STREAM_ACTION_SWITCH)
 	{
-		++txns.count;
+		if (!stream_transform_write_transaction(sql, sqlfilename,
+												currentTx, compress))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		(void) FreeLogicalTransaction(currentTx);
+
+		++txCount;
 	}
-	else if (currentTx->count > 0 && metadata->action != STREAM_ACTION_COMMIT)
+	else if (currentTx->count > 0 &&
+			 lastMetadata.action != STREAM_ACTION_COMMIT)
 	{
 		/* replace the currentTx content with a single keepalive message */
 		(void) FreeLogicalTransaction(currentTx);
 
 		LogicalTransactionStatement *stmt =
 			(LogicalTransactionStatement *)
-			calloc(1,
-				   sizeof(LogicalTransactionStatement));
+			arena_alloc(&(currentTx->arena),
+						sizeof(LogicalTransactionStatement));
 
 		if (stmt == NULL)
 		{
-			log_error(ALLOCATION_FAILED_ERROR);
+			/* errors have already been logged */
 			return false;
 		}
 
 		stmt->action = STREAM_ACTION_KEEPALIVE;
-		stmt->stmt.keepalive.lsn = metadata->lsn;
+		stmt->stmt.keepalive.lsn = lastMetadata.lsn;
 
 		strlcpy(stmt->stmt.keepalive.timestamp,
-				metadata->timestamp,
+				lastMetadata.timestamp,
 				sizeof(stmt->stmt.keepalive.timestamp));
 
 		(void) streamLogicalTransactionAppendStatement(currentTx, stmt);
 
-		++txns.count;
-	}
-
-	/* free dynamic memory that's not needed anymore */
-	free(content.lines);
-	free(content.messages);
-
-	log_debug("stream_transform_file read %d transactions", txns.count);
-
-	/*
-	 * Now that we have read and parsed the JSON file into our internal
-	 * structure that represents SQL transactions with statements, output the
-	 * content in the SQL format.
-	 */
-	FILE *sql = fopen_with_umask(sqlfilename, "w", FOPEN_FLAGS_W, 0644);
-
-	if (sql == NULL)
-	{
-		log_error("Failed to create and open file \"%s\"", sqlfilename);
-		return false;
-	}
-
-	for (int i = 0; i < txns.count; i++)
-	{
-		LogicalTransaction *currentTx = &(txns.array[i]);
-
-		if (!stream_write_transaction(sql, currentTx))
+		if (!stream_transform_write_transaction(sql, sqlfilename,
+												currentTx, compress))
 		{
 			/* errors have already been logged */
 			return false;
 		}
 
 		(void) FreeLogicalTransaction(currentTx);
+
+		++txCount;
 	}
 
 	if (fclose(sql) == EOF)
@@ -465,6 +653,8 @@ stream_transform_file(char *jsonfilename, char *sqlfilename)
 		return false;
 	}
 
+	log_debug("stream_transform_file read %d transactions", txCount);
+
 	log_info("Transformed JSON messages into SQL file \"%s\"",
 			 sqlfilename);
 
@@ -473,89 +663,291 @@ stream_transform_file(char *jsonfilename, char *sqlfilename)
 
 
 /*
- * parseMessage parses a JSON message as emitted by the logical decoding output
- * plugin (either test_decoding or wal2json) into our own internal
- * representation, that can be later output as SQL text.
+ * stream_transform_write_transaction writes the given transaction to the SQL
+ * file, either directly or gzip compressed when PGCOPYDB_COMPRESSION is set.
+ * Each transaction is then a gzip member of its own, and a SQL file made of
+ * concatenated gzip members is read back as a single stream.
  */
-bool
-parseMessage(LogicalTransaction *txn,
-			 LogicalMessageMetadata *metadata,
-			 char *message,
-			 JSON_Value *json)
+static bool
+stream_transform_write_transaction(FILE *sql,
+								   const char *sqlfilename,
+								   LogicalTransaction *txn,
+								   bool compress)
 {
-	if (txn == NULL)
+	if (!compress)
 	{
-		log_error("BUG: parseMessage called with a NULL LogicalTransaction");
-		return false;
+		return stream_write_transaction(sql, txn);
 	}
 
-	if (metadata == NULL)
+	PQExpBuffer buffer = createPQExpBuffer();
+
+	if (buffer == NULL)
 	{
-		log_error("BUG: parseMessage called with a NULL LogicalMessageMetadata");
+		log_error(ALLOCATION_FAILED_ERROR);
 		return false;
 	}
 
-	if (message == NULL)
+	if (!stream_write_transaction_buffer(buffer, txn))
 	{
-		log_error("BUG: parseMessage called with a NULL message");
+		/* errors have already been logged */
+		destroyPQExpBuffer(buffer);
 		return false;
 	}
 
-	if (json == NULL)
+	if (!write_file_gzip_chunk(sql, sqlfilename, buffer->data, buffer->len))
 	{
-		log_error("BUG: parseMessage called with a NULL JSON_Value");
+		/* errors have already been logged */
+		destroyPQExpBuffer(buffer);
 		return false;
 	}
 
-	/*
-	 * Check that XID make sense, except for SWITCH messages, which don't have
-	 * XID information, only have LSN information.
-	 */
-	if (metadata->action != STREAM_ACTION_SWITCH &&
-		metadata->action != STREAM_ACTION_KEEPALIVE)
+	destroyPQExpBuffer(buffer);
+
+	return true;
+}
+
+
+/*
+ * stream_direct_message implements the in-process pipeline that's used in
+ * STREAM_MODE_DIRECT: the receive process hands over each message right after
+ * having spooled it to the current JSON file, we transform it in-memory, and
+ * complete transactions are applied to the target database as soon as their
+ * COMMIT message has been received, without going through on-disk SQL files.
+ */
+bool
+stream_direct_message(StreamContext *privateContext, char *line)
+{
+	LogicalTransaction *txn = privateContext->directTx;
+	LogicalMessageMetadata metadata = { 0 };
+
+	/* we wrote those messages ourselves, scan the known byte layout */
+	JSON_Value *json = NULL;
+
+	if (!parseMessageMetadataFast(&metadata, line))
 	{
-		if (txn->xid > 0 && metadata->xid > 0 && txn->xid != metadata->xid)
-		{
-			log_debug("%s", message);
-			log_error("BUG: logical message xid is %lld, which is different "
-					  "from the current transaction xid %lld",
-					  (long long) metadata->xid,
-					  (long long) txn->xid);
+		json = json_parse_string(line);
 
+		if (!parseMessageMetadata(&metadata, line, json, false))
+		{
+			/* errors have already been logged */
+			json_value_free(json);
 			return false;
 		}
 	}
 
-	/*
-	 * All messages except for BEGIN/COMMIT need a LogicalTransactionStatement
-	 * to represent them within the current transaction.
-	 */
-	LogicalTransactionStatement *stmt = NULL;
+	/* only DML messages need the full JSON DOM tree to be parsed */
+	if (json == NULL &&
+		metadata.action != STREAM_ACTION_BEGIN &&
+		metadata.action != STREAM_ACTION_COMMIT &&
+		metadata.action != STREAM_ACTION_SWITCH &&
+		metadata.action != STREAM_ACTION_KEEPALIVE)
+	{
+		json = json_parse_string(line);
+	}
 
-	if (metadata->action != STREAM_ACTION_BEGIN &&
-		metadata->action != STREAM_ACTION_COMMIT)
+	if (!parseMessage(txn, &metadata, line, json))
 	{
-		stmt = (LogicalTransactionStatement *)
-			   calloc(1, sizeof(LogicalTransactionStatement));
+		log_error("Failed to parse JSON message: %s", line);
 
-		if (stmt == NULL)
+		if (json != NULL)
 		{
-			log_error(ALLOCATION_FAILED_ERROR);
-			return false;
+			json_value_free(json);
 		}
+		return false;
+	}
 
-		stmt->action = metadata->action;
+	if (json != NULL)
+	{
+		json_value_free(json);
 	}
 
-	switch (metadata->action)
+	/*
+	 * Apply the transaction as soon as its COMMIT message has been received.
+	 * KEEPALIVE and SWITCH messages seen in-between transactions are applied
+	 * immediately too, so that the replication origin tracking on the target
+	 * database keeps moving forward.
+	 */
+	if (metadata.action == STREAM_ACTION_COMMIT ||
+		(txn->xid == 0 &&
+		 (metadata.action == STREAM_ACTION_KEEPALIVE ||
+		  metadata.action == STREAM_ACTION_SWITCH)))
 	{
-		/* begin messages only use pgcopydb internal metadata */
-		case STREAM_ACTION_BEGIN:
+		if (!stream_direct_apply_transaction(privateContext, txn))
 		{
-			txn->xid = metadata->xid;
-			txn->beginLSN = metadata->lsn;
-			strlcpy(txn->timestamp, metadata->timestamp, sizeof(txn->timestamp));
-			txn->first = NULL;
+			/* errors have already been logged */
+			return false;
+		}
+
+		(void) FreeLogicalTransaction(txn);
+
+		LogicalTransaction empty = { 0 };
+		*txn = empty;
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_direct_apply_transaction writes the given transaction in its SQL
+ * representation to an in-memory stream and replays it on the target
+ * database, reusing the same code path as when applying an on-disk SQL file.
+ */
+static bool
+stream_direct_apply_transaction(StreamContext *privateContext,
+								LogicalTransaction *txn)
+{
+	StreamApplyContext *applyContext = privateContext->applyContext;
+
+	PQExpBuffer buffer = createPQExpBuffer();
+
+	if (buffer == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	if (!stream_write_transaction_buffer(buffer, txn))
+	{
+		/* errors have already been logged */
+		destroyPQExpBuffer(buffer);
+		return false;
+	}
+
+	int count = countLines(buffer->data);
+
+	if (count > 0)
+	{
+		char **lines = (char **) calloc(count, sizeof(char *));
+
+		if (lines == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			destroyPQExpBuffer(buffer);
+			return false;
+		}
+
+		count = splitLines(buffer->data, lines, count);
+
+		for (int i = 0; i < count && !applyContext->reachedEndPos; i++)
+		{
+			LogicalMessageMetadata sqlMetadata = { 0 };
+
+			sqlMetadata.action = parseSQLAction(lines[i], &sqlMetadata);
+
+			if (!stream_apply_sql(applyContext, &sqlMetadata, lines[i]))
+			{
+				/* errors have already been logged */
+				free(lines);
+				destroyPQExpBuffer(buffer);
+				return false;
+			}
+		}
+
+		free(lines);
+	}
+
+	destroyPQExpBuffer(buffer);
+
+	/* once in a while, sync our replay_lsn with the pgcopydb sentinel */
+	instr_time now;
+
+	INSTR_TIME_SET_CURRENT(now);
+
+	instr_time duration = now;
+
+	INSTR_TIME_SUBTRACT(duration, privateContext->lastSentinelSync);
+
+	if (INSTR_TIME_GET_MILLISEC(duration) >= CATCHINGUP_SLEEP_MS)
+	{
+		(void) stream_apply_sync_sentinel(applyContext);
+
+		privateContext->lastSentinelSync = now;
+	}
+
+	return true;
+}
+
+
+/*
+ * parseMessage parses a JSON message as emitted by the logical decoding output
+ * plugin (either test_decoding or wal2json) into our own internal
+ * representation, that can be later output as SQL text.
+ */
+bool
+parseMessage(LogicalTransaction *txn,
+			 LogicalMessageMetadata *metadata,
+			 char *message,
+			 JSON_Value *json)
+{
+	if (txn == NULL)
+	{
+		log_error("BUG: parseMessage called with a NULL LogicalTransaction");
+		return false;
+	}
+
+	if (metadata == NULL)
+	{
+		log_error("BUG: parseMessage called with a NULL LogicalMessageMetadata");
+		return false;
+	}
+
+	if (message == NULL)
+	{
+		log_error("BUG: parseMessage called with a NULL message");
+		return false;
+	}
+
+	/*
+	 * Check that XID make sense, except for SWITCH messages, which don't have
+	 * XID information, only have LSN information.
+	 */
+	if (metadata->action != STREAM_ACTION_SWITCH &&
+		metadata->action != STREAM_ACTION_KEEPALIVE)
+	{
+		if (txn->xid > 0 && metadata->xid > 0 && txn->xid != metadata->xid)
+		{
+			log_debug("%s", message);
+			log_error("BUG: logical message xid is %lld, which is different "
+					  "from the current transaction xid %lld",
+					  (long long) metadata->xid,
+					  (long long) txn->xid);
+
+			return false;
+		}
+	}
+
+	/*
+	 * All messages except for BEGIN/COMMIT need a LogicalTransactionStatement
+	 * to represent them within the current transaction.
+	 */
+	LogicalTransactionStatement *stmt = NULL;
+
+	if (metadata->action != STREAM_ACTION_BEGIN &&
+		metadata->action != STREAM_ACTION_COMMIT)
+	{
+		stmt = (LogicalTransactionStatement *)
+			   arena_alloc(&(txn->arena),
+						   sizeof(LogicalTransactionStatement));
+
+		if (stmt == NULL)
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		stmt->action = metadata->action;
+	}
+
+	switch (metadata->action)
+	{
+		/* begin messages only use pgcopydb internal metadata */
+		case STREAM_ACTION_BEGIN:
+		{
+			txn->xid = metadata->xid;
+			txn->beginLSN = metadata->lsn;
+			strlcpy(txn->timestamp, metadata->timestamp, sizeof(txn->timestamp));
+			txn->first = NULL;
 
 			if (metadata->lsn == InvalidXLogRecPtr ||
 				IS_EMPTY_STRING_BUFFER(txn->timestamp))
@@ -602,6 +994,14 @@ parseMessage(LogicalTransaction *txn,
 		/* now handle DML messages from the output plugin */
 		default:
 		{
+			if (json == NULL)
+			{
+				log_error("BUG: parseMessage called with a NULL JSON_Value "
+						  "for action %c",
+						  metadata->action);
+				return false;
+			}
+
 			/*
 			 * When using test_decoding, we append the received message as a
 			 * JSON string in the "message" object key. When using wal2json, we
@@ -618,7 +1018,11 @@ parseMessage(LogicalTransaction *txn,
 			{
 				case JSONString:
 				{
-					if (!parseTestDecodingMessage(stmt, metadata, message, json))
+					if (!parseTestDecodingMessage(&(txn->arena),
+												  stmt,
+												  metadata,
+												  message,
+												  json))
 					{
 						log_error("Failed to parse test_decoding message, "
 								  "see above for details");
@@ -630,7 +1034,11 @@ parseMessage(LogicalTransaction *txn,
 
 				case JSONObject:
 				{
-					if (!parseWal2jsonMessage(stmt, metadata, message, json))
+					if (!parseWal2jsonMessage(&(txn->arena),
+											  stmt,
+											  metadata,
+											  message,
+											  json))
 					{
 						log_error("Failed to parse wal2json message, "
 								  "see above for details");
@@ -722,88 +1130,70 @@ streamLogicalTransactionAppendStatement(LogicalTransaction *txn,
 
 
 /*
- * FreeLogicalTransaction frees the malloc'ated memory areas of a
- * LogicalTransaction.
+ * FreeLogicalTransaction releases the memory areas of a LogicalTransaction.
+ *
+ * The statements, tuples, column names and values all have been allocated
+ * from the transaction's arena, so a single arena release reclaims the whole
+ * transaction without walking the lists.
  */
 void
 FreeLogicalTransaction(LogicalTransaction *tx)
 {
-	LogicalTransactionStatement *currentStmt = tx->first;
-
-	for (; currentStmt != NULL; currentStmt = currentStmt->next)
-	{
-		switch (currentStmt->action)
-		{
-			case STREAM_ACTION_INSERT:
-			{
-				FreeLogicalMessageTupleArray(&(currentStmt->stmt.insert.new));
-				break;
-			}
-
-			case STREAM_ACTION_UPDATE:
-			{
-				FreeLogicalMessageTupleArray(&(currentStmt->stmt.update.old));
-				FreeLogicalMessageTupleArray(&(currentStmt->stmt.update.new));
-				break;
-			}
-
-			case STREAM_ACTION_DELETE:
-			{
-				FreeLogicalMessageTupleArray(&(currentStmt->stmt.delete.old));
-				break;
-			}
-
-			/* no malloc'ated area in a BEGIN, COMMIT, or TRUNCATE statement */
-			default:
-			{
-				break;
-			}
-		}
-	}
+	arena_release(&(tx->arena));
 
 	tx->first = NULL;
+	tx->last = NULL;
 }
 
 
 /*
- * FreeLogicalMessageTupleArray frees the malloc'ated memory areas of a
- * LogicalMessageTupleArray.
+ * stream_write_transaction writes the LogicalTransaction statements as SQL to
+ * the already open out stream.
+ *
+ * The SQL text is built in an in-memory buffer first and written to the
+ * stream with a single fwrite call: at millions of column values per segment
+ * file, paying the stdio format-string parsing and FILE locking once per
+ * value dominates the transform CPU profile.
  */
-void
-FreeLogicalMessageTupleArray(LogicalMessageTupleArray *tupleArray)
+bool
+stream_write_transaction(FILE *out, LogicalTransaction *txn)
 {
-	for (int s = 0; s < tupleArray->count; s++)
-	{
-		LogicalMessageTuple *stmt = &(tupleArray->array[s]);
+	PQExpBuffer buffer = createPQExpBuffer();
 
-		free(stmt->columns);
+	if (buffer == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
 
-		for (int r = 0; r < stmt->values.count; r++)
-		{
-			LogicalMessageValues *values = &(stmt->values.array[r]);
+	if (!stream_write_transaction_buffer(buffer, txn))
+	{
+		/* errors have already been logged */
+		destroyPQExpBuffer(buffer);
+		return false;
+	}
 
-			for (int v = 0; v < values->cols; v++)
-			{
-				LogicalMessageValue *value = &(values->array[v]);
+	if (buffer->len > 0 &&
+		fwrite(buffer->data, sizeof(char), buffer->len, out) !=
+		(size_t) buffer->len)
+	{
+		log_error("Failed to write %zu bytes: %m", (size_t) buffer->len);
+		destroyPQExpBuffer(buffer);
+		return false;
+	}
 
-				if (value->oid == TEXTOID)
-				{
-					free(value->val.str);
-				}
-			}
+	destroyPQExpBuffer(buffer);
 
-			free(stmt->values.array);
-		}
-	}
+	return true;
 }
 
 
 /*
- * stream_write_transaction writes the LogicalTransaction statements as SQL to
- * the already open out stream.
+ * stream_write_transaction_buffer appends the LogicalTransaction statements
+ * as SQL to the given buffer.
  */
 bool
-stream_write_transaction(FILE *out, LogicalTransaction *txn)
+stream_write_transaction_buffer(PQExpBuffer out, LogicalTransaction *txn)
 {
 	/*
 	 * SWITCH WAL commands might appear eigher in the middle of a transaction
@@ -838,6 +1228,19 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 
 			case STREAM_ACTION_KEEPALIVE:
 			{
+				/*
+				 * Coalesce a run of consecutive KEEPALIVE statements into a
+				 * single record carrying the latest LSN and timestamp: quiet
+				 * periods would otherwise fill the SQL files with keepalive
+				 * records that the apply process then has to parse and
+				 * process one by one.
+				 */
+				while (currentStmt->next != NULL &&
+					   currentStmt->next->action == STREAM_ACTION_KEEPALIVE)
+				{
+					currentStmt = currentStmt->next;
+				}
+
 				if (!stream_write_keepalive(out, &(currentStmt->stmt.keepalive)))
 				{
 					return false;
@@ -856,9 +1259,42 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 					sentBEGIN = true;
 				}
 
-				if (!stream_write_insert(out, &(currentStmt->stmt.insert)))
+				/*
+				 * Coalesce a run of consecutive INSERT statements targeting
+				 * the same relation with the same column list into a single
+				 * multi-row VALUES statement, so that bulk loads on the
+				 * source are not replayed as millions of single-row INSERTs
+				 * that the target parses and plans individually.
+				 */
+				LogicalTransactionStatement *last = currentStmt;
+				int rows = 1;
+
+				while (last->next != NULL &&
+					   last->next->action == STREAM_ACTION_INSERT &&
+					   rows < STREAM_INSERT_MAX_ROWS &&
+					   streamCanCoalesceInsert(&(currentStmt->stmt.insert),
+											   &(last->next->stmt.insert)))
 				{
-					return false;
+					last = last->next;
+					++rows;
+				}
+
+				if (currentStmt == last)
+				{
+					if (!stream_write_insert(out, &(currentStmt->stmt.insert)))
+					{
+						return false;
+					}
+				}
+				else
+				{
+					if (!stream_write_insert_run(out, currentStmt, last))
+					{
+						return false;
+					}
+
+					/* skip over the statements folded into the run */
+					currentStmt = last;
 				}
 
 				break;
@@ -935,23 +1371,99 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 		}
 	}
 
+	if (PQExpBufferBroken(out))
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
 	return true;
 }
 
 
+/*
+ * stream_out_int64 appends the decimal representation of the given value to
+ * the buffer, skipping the printf format-string machinery on the hottest of
+ * the value output paths.
+ */
+static void
+stream_out_int64(PQExpBuffer out, int64_t value)
+{
+	char digits[INTSTRING_MAX_DIGITS] = { 0 };
+	int pos = sizeof(digits);
+
+	/* careful: -INT64_MIN overflows, compute with unsigned magnitude */
+	uint64_t u = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+
+	do {
+		digits[--pos] = '0' + (u % 10);
+		u /= 10;
+	} while (u > 0);
+
+	if (value < 0)
+	{
+		digits[--pos] = '-';
+	}
+
+	appendBinaryPQExpBuffer(out, digits + pos, sizeof(digits) - pos);
+}
+
+
+/*
+ * stream_out_lsn appends the %X/%X representation of the given LSN to the
+ * buffer.
+ */
+static void
+stream_out_lsn(PQExpBuffer out, uint64_t lsn)
+{
+	const char *hex = "0123456789ABCDEF";
+	char str[PG_LSN_MAXLENGTH] = { 0 };
+	int len = 0;
+
+	uint32_t parts[2] = { (uint32_t) (lsn >> 32), (uint32_t) lsn };
+
+	for (int p = 0; p < 2; p++)
+	{
+		if (p > 0)
+		{
+			str[len++] = '/';
+		}
+
+		int shift = 32;
+		bool seen = false;
+
+		while (shift > 0)
+		{
+			shift -= 4;
+
+			int digit = (parts[p] >> shift) & 0xf;
+
+			if (digit != 0 || seen || shift == 0)
+			{
+				str[len++] = hex[digit];
+				seen = true;
+			}
+		}
+	}
+
+	appendBinaryPQExpBuffer(out, str, len);
+}
+
+
 /*
  * stream_write_switchwal writes a SWITCH statement to the already open out
  * stream.
  */
 bool
-stream_write_begin(FILE *out, LogicalTransaction *txn)
+stream_write_begin(PQExpBuffer out, LogicalTransaction *txn)
 {
-	fformat(out,
-			"%s{\"xid\":%lld,\"lsn\":\"%X/%X\",\"timestamp\":\"%s\"}\n",
-			OUTPUT_BEGIN,
-			(long long) txn->xid,
-			LSN_FORMAT_ARGS(txn->beginLSN),
-			txn->timestamp);
+	appendPQExpBufferStr(out, OUTPUT_BEGIN "{\"xid\":");
+	stream_out_int64(out, txn->xid);
+	appendPQExpBufferStr(out, ",\"lsn\":\"");
+	stream_out_lsn(out, txn->beginLSN);
+	appendPQExpBufferStr(out, "\",\"timestamp\":\"");
+	appendPQExpBufferStr(out, txn->timestamp);
+	appendPQExpBufferStr(out, "\"}\n");
 
 	return true;
 }
@@ -962,14 +1474,15 @@ stream_write_begin(FILE *out, LogicalTransaction *txn)
  * stream.
  */
 bool
-stream_write_commit(FILE *out, LogicalTransaction *txn)
+stream_write_commit(PQExpBuffer out, LogicalTransaction *txn)
 {
-	fformat(out,
-			"%s{\"xid\":%lld,\"lsn\":\"%X/%X\",\"timestamp\":\"%s\"}\n",
-			OUTPUT_COMMIT,
-			(long long) txn->xid,
-			LSN_FORMAT_ARGS(txn->commitLSN),
-			txn->timestamp);
+	appendPQExpBufferStr(out, OUTPUT_COMMIT "{\"xid\":");
+	stream_out_int64(out, txn->xid);
+	appendPQExpBufferStr(out, ",\"lsn\":\"");
+	stream_out_lsn(out, txn->commitLSN);
+	appendPQExpBufferStr(out, "\",\"timestamp\":\"");
+	appendPQExpBufferStr(out, txn->timestamp);
+	appendPQExpBufferStr(out, "\"}\n");
 
 	return true;
 }
@@ -980,11 +1493,11 @@ stream_write_commit(FILE *out, LogicalTransaction *txn)
  * stream.
  */
 bool
-stream_write_switchwal(FILE *out, LogicalMessageSwitchWAL *switchwal)
+stream_write_switchwal(PQExpBuffer out, LogicalMessageSwitchWAL *switchwal)
 {
-	fformat(out, "%s{\"lsn\":\"%X/%X\"}\n",
-			OUTPUT_SWITCHWAL,
-			LSN_FORMAT_ARGS(switchwal->lsn));
+	appendPQExpBufferStr(out, OUTPUT_SWITCHWAL "{\"lsn\":\"");
+	stream_out_lsn(out, switchwal->lsn);
+	appendPQExpBufferStr(out, "\"}\n");
 
 	return true;
 }
@@ -995,12 +1508,13 @@ stream_write_switchwal(FILE *out, LogicalMessageSwitchWAL *switchwal)
  * stream.
  */
 bool
-stream_write_keepalive(FILE *out, LogicalMessageKeepalive *keepalive)
+stream_write_keepalive(PQExpBuffer out, LogicalMessageKeepalive *keepalive)
 {
-	fformat(out, "%s{\"lsn\":\"%X/%X\",\"timestamp\":\"%s\"}\n",
-			OUTPUT_KEEPALIVE,
-			LSN_FORMAT_ARGS(keepalive->lsn),
-			keepalive->timestamp);
+	appendPQExpBufferStr(out, OUTPUT_KEEPALIVE "{\"lsn\":\"");
+	stream_out_lsn(out, keepalive->lsn);
+	appendPQExpBufferStr(out, "\",\"timestamp\":\"");
+	appendPQExpBufferStr(out, keepalive->timestamp);
+	appendPQExpBufferStr(out, "\"}\n");
 
 	return true;
 }
@@ -1011,39 +1525,161 @@ stream_write_keepalive(FILE *out, LogicalMessageKeepalive *keepalive)
  * stream.
  */
 bool
-stream_write_insert(FILE *out, LogicalMessageInsert *insert)
+stream_write_insert(PQExpBuffer out, LogicalMessageInsert *insert)
 {
 	/* loop over INSERT statements targeting the same table */
 	for (int s = 0; s < insert->new.count; s++)
 	{
 		LogicalMessageTuple *stmt = &(insert->new.array[s]);
 
-		fformat(out, "INSERT INTO \"%s\".\"%s\" ",
-				insert->nspname,
-				insert->relname);
+		appendPQExpBuffer(out, "INSERT INTO \"%s\".\"%s\" ",
+						  insert->nspname,
+						  insert->relname);
 
 		/* loop over column names and add them to the out stream */
-		fformat(out, "(");
+		appendPQExpBufferChar(out, '(');
 		for (int c = 0; c < stmt->cols; c++)
 		{
-			fformat(out, "%s\"%s\"", c > 0 ? ", " : "", stmt->columns[c]);
+			if (c > 0)
+			{
+				appendPQExpBufferStr(out, ", ");
+			}
+
+			appendPQExpBufferChar(out, '"');
+			appendPQExpBufferStr(out, stmt->columns[c]);
+			appendPQExpBufferChar(out, '"');
 		}
-		fformat(out, ")");
+		appendPQExpBufferChar(out, ')');
 
 		/* now loop over VALUES rows */
-		fformat(out, " VALUES ");
+		appendPQExpBufferStr(out, " VALUES ");
 
 		for (int r = 0; r < stmt->values.count; r++)
 		{
 			LogicalMessageValues *values = &(stmt->values.array[r]);
 
 			/* now loop over column values for this VALUES row */
-			fformat(out, "%s(", r > 0 ? ", " : "");
+			appendPQExpBufferStr(out, r > 0 ? ", (" : "(");
+			for (int v = 0; v < values->cols; v++)
+			{
+				LogicalMessageValue *value = &(values->array[v]);
+
+				if (v > 0)
+				{
+					appendPQExpBufferStr(out, ", ");
+				}
+
+				if (!stream_write_value(out, value))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+			}
+
+			appendPQExpBufferChar(out, ')');
+		}
+
+		appendPQExpBufferStr(out, ";\n");
+	}
+
+	return true;
+}
+
+
+/*
+ * streamCanCoalesceInsert returns true when the INSERT statement b can be
+ * folded into the same multi-row VALUES statement as a: both target the same
+ * relation with the same column list, and both carry a single tuple.
+ */
+static bool
+streamCanCoalesceInsert(LogicalMessageInsert *a, LogicalMessageInsert *b)
+{
+	if (streq(a->nspname, b->nspname) == false ||
+		streq(a->relname, b->relname) == false)
+	{
+		return false;
+	}
+
+	if (a->new.count != 1 || b->new.count != 1)
+	{
+		return false;
+	}
+
+	LogicalMessageTuple *ta = &(a->new.array[0]);
+	LogicalMessageTuple *tb = &(b->new.array[0]);
+
+	if (ta->cols != tb->cols)
+	{
+		return false;
+	}
+
+	for (int c = 0; c < ta->cols; c++)
+	{
+		if (!streq(ta->columns[c], tb->columns[c]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_insert_run writes a run of INSERT statements that all target
+ * the same relation with the same column list as a single multi-row VALUES
+ * statement to the already open out stream.
+ */
+static bool
+stream_write_insert_run(PQExpBuffer out,
+						LogicalTransactionStatement *first,
+						LogicalTransactionStatement *last)
+{
+	LogicalMessageInsert *insert = &(first->stmt.insert);
+	LogicalMessageTuple *stmt = &(insert->new.array[0]);
+
+	appendPQExpBuffer(out, "INSERT INTO \"%s\".\"%s\" ",
+					  insert->nspname,
+					  insert->relname);
+
+	/* loop over column names and add them to the out stream */
+	appendPQExpBufferChar(out, '(');
+	for (int c = 0; c < stmt->cols; c++)
+	{
+		if (c > 0)
+		{
+			appendPQExpBufferStr(out, ", ");
+		}
+
+		appendPQExpBufferChar(out, '"');
+		appendPQExpBufferStr(out, stmt->columns[c]);
+		appendPQExpBufferChar(out, '"');
+	}
+	appendPQExpBufferChar(out, ')');
+
+	appendPQExpBufferStr(out, " VALUES ");
+
+	int rows = 0;
+	LogicalTransactionStatement *currentStmt = first;
+
+	for (;; currentStmt = currentStmt->next)
+	{
+		LogicalMessageTuple *tuple = &(currentStmt->stmt.insert.new.array[0]);
+
+		for (int r = 0; r < tuple->values.count; r++)
+		{
+			LogicalMessageValues *values = &(tuple->values.array[r]);
+
+			/* now loop over column values for this VALUES row */
+			appendPQExpBufferStr(out, rows++ > 0 ? ", (" : "(");
 			for (int v = 0; v < values->cols; v++)
 			{
 				LogicalMessageValue *value = &(values->array[v]);
 
-				fformat(out, "%s", v > 0 ? ", " : "");
+				if (v > 0)
+				{
+					appendPQExpBufferStr(out, ", ");
+				}
 
 				if (!stream_write_value(out, value))
 				{
@@ -1052,22 +1688,54 @@ stream_write_insert(FILE *out, LogicalMessageInsert *insert)
 				}
 			}
 
-			fformat(out, ")");
+			appendPQExpBufferChar(out, ')');
 		}
 
-		fformat(out, ";\n");
+		if (currentStmt == last)
+		{
+			break;
+		}
 	}
 
+	appendPQExpBufferStr(out, ";\n");
+
 	return true;
 }
 
 
+/*
+ * stream_statement_hash computes a 64 bits FNV-1a hash of the given
+ * parameterized statement text, used to name the server-side prepared
+ * statement after its shape (relation, column lists, structure).
+ */
+static uint64_t
+stream_statement_hash(const char *text)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (const char *p = text; *p != '\0'; p++)
+	{
+		hash ^= (uint64_t) (unsigned char) *p;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+
 /*
  * stream_write_update writes an UPDATE statement to the already open out
- * stream.
+ * stream, as a single-line PREPARE/EXECUTE pair: millions of UPDATE
+ * statements usually share a handful of statement shapes, and the apply side
+ * only sends the PREPARE part once per shape and session, sparing the target
+ * the per-row parsing and planning of the full statement.
+ *
+ * NULL values are passed as EXECUTE arguments, so a "col" = $n qualifier
+ * with a NULL argument matches no row, same as the "col" = NULL text we used
+ * to emit.
  */
 bool
-stream_write_update(FILE *out, LogicalMessageUpdate *update)
+stream_write_update(PQExpBuffer out, LogicalMessageUpdate *update)
 {
 	if (update->old.count != update->new.count)
 	{
@@ -1084,8 +1752,6 @@ stream_write_update(FILE *out, LogicalMessageUpdate *update)
 		LogicalMessageTuple *old = &(update->old.array[s]);
 		LogicalMessageTuple *new = &(update->new.array[s]);
 
-		fformat(out, "UPDATE \"%s\".\"%s\" ", update->nspname, update->relname);
-
 		if (old->values.count != new->values.count ||
 			old->values.count != 1 ||
 			new->values.count != 1)
@@ -1097,69 +1763,111 @@ stream_write_update(FILE *out, LogicalMessageUpdate *update)
 			return false;
 		}
 
-		fformat(out, "SET ");
+		/* first, prepare the statement shape with $n parameters */
+		PQExpBuffer shape = createPQExpBuffer();
 
-		for (int r = 0; r < new->values.count; r++)
+		if (shape == NULL)
 		{
-			LogicalMessageValues *values = &(new->values.array[r]);
+			log_error(ALLOCATION_FAILED_ERROR);
+			return false;
+		}
 
-			/* now loop over column values for this VALUES row */
-			for (int v = 0; v < values->cols; v++)
+		appendPQExpBuffer(shape, "UPDATE \"%s\".\"%s\" SET ",
+						  update->nspname,
+						  update->relname);
+
+		int paramno = 0;
+
+		for (int v = 0; v < new->values.array[0].cols; v++)
+		{
+			if (new->cols <= v)
 			{
-				LogicalMessageValue *value = &(values->array[v]);
+				log_error("Failed to write UPDATE statement with more "
+						  "VALUES (%d) than COLUMNS (%d)",
+						  new->values.array[0].cols,
+						  new->cols);
+				destroyPQExpBuffer(shape);
+				return false;
+			}
 
-				if (new->cols <= v)
-				{
-					log_error("Failed to write UPDATE statement with more "
-							  "VALUES (%d) than COLUMNS (%d)",
-							  values->cols,
-							  new->cols);
-					return false;
-				}
+			appendPQExpBuffer(shape, "%s\"%s\" = $%d",
+							  v > 0 ? ", " : "",
+							  new->columns[v],
+							  ++paramno);
+		}
 
-				fformat(out, "%s", v > 0 ? ", " : "");
-				fformat(out, "\"%s\" = ", new->columns[v]);
+		appendPQExpBufferStr(shape, " WHERE ");
 
-				if (!stream_write_value(out, value))
-				{
-					/* errors have already been logged */
-					return false;
-				}
+		for (int v = 0; v < old->values.array[0].cols; v++)
+		{
+			if (old->cols <= v)
+			{
+				log_error("Failed to write UPDATE statement with more "
+						  "VALUES (%d) than COLUMNS (%d)",
+						  old->values.array[0].cols,
+						  old->cols);
+				destroyPQExpBuffer(shape);
+				return false;
 			}
+
+			appendPQExpBuffer(shape, "%s\"%s\" = $%d",
+							  v > 0 ? " and " : "",
+							  old->columns[v],
+							  ++paramno);
+		}
+
+		if (PQExpBufferBroken(shape))
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			destroyPQExpBuffer(shape);
+			return false;
 		}
 
-		fformat(out, " WHERE ");
+		uint64_t hash = stream_statement_hash(shape->data);
 
-		for (int r = 0; r < old->values.count; r++)
+		appendPQExpBuffer(out, "PREPARE p_%016llx AS %s;EXECUTE p_%016llx(",
+						  (long long) hash,
+						  shape->data,
+						  (long long) hash);
+
+		destroyPQExpBuffer(shape);
+
+		/* then write the EXECUTE arguments: SET values, then WHERE values */
+		int argno = 0;
+
+		for (int v = 0; v < new->values.array[0].cols; v++)
 		{
-			LogicalMessageValues *values = &(old->values.array[r]);
+			LogicalMessageValue *value = &(new->values.array[0].array[v]);
 
-			/* now loop over column values for this VALUES row */
-			for (int v = 0; v < values->cols; v++)
+			if (argno++ > 0)
 			{
-				LogicalMessageValue *value = &(values->array[v]);
+				appendPQExpBufferStr(out, ", ");
+			}
 
-				if (old->cols <= v)
-				{
-					log_error("Failed to write UPDATE statement with more "
-							  "VALUES (%d) than COLUMNS (%d)",
-							  values->cols,
-							  old->cols);
-					return false;
-				}
+			if (!stream_write_value(out, value))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
 
-				fformat(out, "%s", v > 0 ? " and " : "");
-				fformat(out, "\"%s\" = ", old->columns[v]);
+		for (int v = 0; v < old->values.array[0].cols; v++)
+		{
+			LogicalMessageValue *value = &(old->values.array[0].array[v]);
 
-				if (!stream_write_value(out, value))
-				{
-					/* errors have already been logged */
-					return false;
-				}
+			if (argno++ > 0)
+			{
+				appendPQExpBufferStr(out, ", ");
+			}
+
+			if (!stream_write_value(out, value))
+			{
+				/* errors have already been logged */
+				return false;
 			}
 		}
 
-		fformat(out, ";\n");
+		appendPQExpBufferStr(out, ");\n");
 	}
 
 	return true;
@@ -1168,43 +1876,76 @@ stream_write_update(FILE *out, LogicalMessageUpdate *update)
 
 /*
  * stream_write_delete writes an DELETE statement to the already open out
- * stream.
+ * stream, as a single-line PREPARE/EXECUTE pair keyed by the statement
+ * shape, see stream_write_update for the details.
  */
 bool
-stream_write_delete(FILE *out, LogicalMessageDelete *delete)
+stream_write_delete(PQExpBuffer out, LogicalMessageDelete *delete)
 {
 	/* loop over DELETE statements targeting the same table */
 	for (int s = 0; s < delete->old.count; s++)
 	{
 		LogicalMessageTuple *old = &(delete->old.array[s]);
 
-		fformat(out,
-				"DELETE FROM \"%s\".\"%s\"",
-				delete->nspname,
-				delete->relname);
-
-		fformat(out, " WHERE ");
-
 		for (int r = 0; r < old->values.count; r++)
 		{
 			LogicalMessageValues *values = &(old->values.array[r]);
 
-			/* now loop over column values for this VALUES row */
-			for (int v = 0; v < values->cols; v++)
+			/* first, prepare the statement shape with $n parameters */
+			PQExpBuffer shape = createPQExpBuffer();
+
+			if (shape == NULL)
 			{
-				LogicalMessageValue *value = &(values->array[v]);
+				log_error(ALLOCATION_FAILED_ERROR);
+				return false;
+			}
 
+			appendPQExpBuffer(shape, "DELETE FROM \"%s\".\"%s\" WHERE ",
+							  delete->nspname,
+							  delete->relname);
+
+			for (int v = 0; v < values->cols; v++)
+			{
 				if (old->cols <= v)
 				{
 					log_error("Failed to write DELETE statement with more "
 							  "VALUES (%d) than COLUMNS (%d)",
 							  values->cols,
 							  old->cols);
+					destroyPQExpBuffer(shape);
 					return false;
 				}
 
-				fformat(out, "%s", v > 0 ? " and " : "");
-				fformat(out, "\"%s\" = ", old->columns[v]);
+				appendPQExpBuffer(shape, "%s\"%s\" = $%d",
+								  v > 0 ? " and " : "",
+								  old->columns[v],
+								  v + 1);
+			}
+
+			if (PQExpBufferBroken(shape))
+			{
+				log_error(ALLOCATION_FAILED_ERROR);
+				destroyPQExpBuffer(shape);
+				return false;
+			}
+
+			uint64_t hash = stream_statement_hash(shape->data);
+
+			appendPQExpBuffer(out, "PREPARE p_%016llx AS %s;EXECUTE p_%016llx(",
+							  (long long) hash,
+							  shape->data,
+							  (long long) hash);
+
+			destroyPQExpBuffer(shape);
+
+			for (int v = 0; v < values->cols; v++)
+			{
+				LogicalMessageValue *value = &(values->array[v]);
+
+				if (v > 0)
+				{
+					appendPQExpBufferStr(out, ", ");
+				}
 
 				if (!stream_write_value(out, value))
 				{
@@ -1212,9 +1953,9 @@ stream_write_delete(FILE *out, LogicalMessageDelete *delete)
 					return false;
 				}
 			}
-		}
 
-		fformat(out, ";\n");
+			appendPQExpBufferStr(out, ");\n");
+		}
 	}
 
 	return true;
@@ -1226,19 +1967,23 @@ stream_write_delete(FILE *out, LogicalMessageDelete *delete)
  * stream.
  */
 bool
-stream_write_truncate(FILE *out, LogicalMessageTruncate *truncate)
+stream_write_truncate(PQExpBuffer out, LogicalMessageTruncate *truncate)
 {
-	fformat(out, "TRUNCATE ONLY %s.%s\n", truncate->nspname, truncate->relname);
+	appendPQExpBuffer(out, "TRUNCATE ONLY %s.%s\n",
+					  truncate->nspname,
+					  truncate->relname);
 
 	return true;
 }
 
 
 /*
- * stream_write_value writes the given LogicalMessageValue to the out stream.
+ * stream_write_value writes the given LogicalMessageValue to the out stream,
+ * using dedicated fast paths for the common value types rather than printf
+ * format strings.
  */
 bool
-stream_write_value(FILE *out, LogicalMessageValue *value)
+stream_write_value(PQExpBuffer out, LogicalMessageValue *value)
 {
 	if (value == NULL)
 	{
@@ -1248,7 +1993,7 @@ stream_write_value(FILE *out, LogicalMessageValue *value)
 
 	if (value->isNull)
 	{
-		fformat(out, "NULL");
+		appendPQExpBufferStr(out, "NULL");
 	}
 	else
 	{
@@ -1256,19 +2001,22 @@ stream_write_value(FILE *out, LogicalMessageValue *value)
 		{
 			case BOOLOID:
 			{
-				fformat(out, "'%s' ", value->val.boolean ? "t" : "f");
+				appendPQExpBufferStr(out, value->val.boolean ? "'t' " : "'f' ");
 				break;
 			}
 
 			case INT8OID:
 			{
-				fformat(out, "%lld", (long long) value->val.int8);
+				stream_out_int64(out, value->val.int8);
 				break;
 			}
 
 			case FLOAT8OID:
 			{
-				fformat(out, "%g", value->val.float8);
+				char str[32] = { 0 };
+				int len = sformat(str, sizeof(str), "%g", value->val.float8);
+
+				appendBinaryPQExpBuffer(out, str, len);
 				break;
 			}
 
@@ -1276,11 +2024,12 @@ stream_write_value(FILE *out, LogicalMessageValue *value)
 			{
 				if (value->isQuoted)
 				{
-					fformat(out, "%s", value->val.str);
+					appendPQExpBufferStr(out, value->val.str);
 				}
-				else
+				else if (!stream_write_escaped_string(out, value->val.str))
 				{
-					fformat(out, "'%s'", value->val.str);
+					/* errors have already been logged */
+					return false;
 				}
 				break;
 			}
@@ -1296,3 +2045,138 @@ stream_write_value(FILE *out, LogicalMessageValue *value)
 
 	return true;
 }
+
+
+/*
+ * streamEscapeCleanSpan returns how many leading bytes of the given buffer
+ * can be copied to the SQL output as-is, stopping at the first single quote,
+ * backslash, or control byte that needs escaping.
+ *
+ * On SSE2 platforms the buffer is scanned sixteen bytes at a time; high-bit
+ * bytes (UTF-8 multi-byte sequences) never need escaping and are part of the
+ * clean span.
+ */
+static size_t
+streamEscapeCleanSpan(const char *str, size_t len)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i quote = _mm_set1_epi8('\'');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i ctrlMax = _mm_set1_epi8(0x1f);
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i *) (str + i));
+
+		/* min(b, 0x1f) == b is an unsigned b <= 0x1f comparison */
+		__m128i isCtrl = _mm_cmpeq_epi8(_mm_min_epu8(chunk, ctrlMax), chunk);
+		__m128i isQuote = _mm_cmpeq_epi8(chunk, quote);
+		__m128i isBackslash = _mm_cmpeq_epi8(chunk, backslash);
+
+		__m128i needsEscape = _mm_or_si128(isCtrl,
+										   _mm_or_si128(isQuote, isBackslash));
+
+		int mask = _mm_movemask_epi8(needsEscape);
+
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < len; i++)
+	{
+		unsigned char b = (unsigned char) str[i];
+
+		if (b == '\'' || b == '\\' || b < 0x20)
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+
+/*
+ * stream_write_escaped_string writes the given string value to the out stream
+ * as a Postgres escaped string literal (E'...'). The apply process reads one
+ * SQL statement per physical line, so embedded quotes, backslashes, and
+ * control bytes (newlines in particular) all need escaping.
+ *
+ * Most bytes of a text value never need escaping, so the string is scanned
+ * for the next byte that does and the clean spans in between are written in
+ * bulk, rather than looking at every byte individually.
+ */
+static bool
+stream_write_escaped_string(PQExpBuffer out, const char *str)
+{
+	size_t len = strlen(str);
+	size_t i = 0;
+
+	appendPQExpBufferStr(out, "E'");
+
+	while (i < len)
+	{
+		size_t span = streamEscapeCleanSpan(str + i, len - i);
+
+		if (span > 0)
+		{
+			appendBinaryPQExpBuffer(out, str + i, span);
+
+			i += span;
+			continue;
+		}
+
+		unsigned char b = (unsigned char) str[i++];
+
+		switch (b)
+		{
+			case '\'':
+			{
+				appendPQExpBufferStr(out, "''");
+				break;
+			}
+
+			case '\\':
+			{
+				appendPQExpBufferStr(out, "\\\\");
+				break;
+			}
+
+			case '\n':
+			{
+				appendPQExpBufferStr(out, "\\n");
+				break;
+			}
+
+			case '\r':
+			{
+				appendPQExpBufferStr(out, "\\r");
+				break;
+			}
+
+			case '\t':
+			{
+				appendPQExpBufferStr(out, "\\t");
+				break;
+			}
+
+			default:
+			{
+				const char *hex = "0123456789abcdef";
+				char esc[4] = { '\\', 'x', hex[b >> 4], hex[b & 0xf] };
+
+				appendBinaryPQExpBuffer(out, esc, sizeof(esc));
+				break;
+			}
+		}
+	}
+
+	appendPQExpBufferChar(out, '\'');
+
+	return true;
+}
@@ -32,10 +32,14 @@
 #include "summary.h"
 
 
-static bool SetColumnNamesAndValues(LogicalMessageTuple *tuple,
+static bool SetColumnNamesAndValues(MemoryArena *arena,
+									LogicalMessageTuple *tuple,
 									const char *message,
 									JSON_Array *jscols);
 
+static bool parseWal2jsonActionAndXidFast(LogicalMessageMetadata *metadata,
+										  const char *buffer);
+
 
 /*
  * prepareWal2jsonMessage prepares our internal JSON entry from a wal2json
@@ -69,6 +73,12 @@ parseWal2jsonMessageActionAndXid(LogicalStreamContext *context)
 	StreamContext *privateContext = (StreamContext *) context->private;
 	LogicalMessageMetadata *metadata = &(privateContext->metadata);
 
+	/* wal2json writes a fixed key ordering, scan it without a JSON parser */
+	if (parseWal2jsonActionAndXidFast(metadata, context->buffer))
+	{
+		return true;
+	}
+
 	JSON_Value *json = json_parse_string(context->buffer);
 	JSON_Object *jsobj = json_value_get_object(json);
 
@@ -102,6 +112,90 @@ parseWal2jsonMessageActionAndXid(LogicalStreamContext *context)
 }
 
 
+/*
+ * parseWal2jsonActionAndXidFast scans the fixed prefix of a wal2json
+ * format-version 2 message for the action and xid keys, with a single pass
+ * over the buffer instead of building a JSON DOM tree per message. wal2json
+ * always emits the action key first, and the xid key right after it when
+ * include-xids is enabled; when the buffer does not match that layout the
+ * function returns false, without logging any error: the caller then falls
+ * back to the full JSON parser.
+ */
+static bool
+parseWal2jsonActionAndXidFast(LogicalMessageMetadata *metadata,
+							  const char *buffer)
+{
+	const char *ptr = buffer;
+
+	/* {"action":"B" */
+	if (strncmp(ptr, "{\"action\":\"", 11) != 0)
+	{
+		return false;
+	}
+
+	ptr += 11;
+
+	char action = *ptr;
+
+	switch (action)
+	{
+		case STREAM_ACTION_BEGIN:
+		case STREAM_ACTION_COMMIT:
+		case STREAM_ACTION_INSERT:
+		case STREAM_ACTION_UPDATE:
+		case STREAM_ACTION_DELETE:
+		case STREAM_ACTION_TRUNCATE:
+		case STREAM_ACTION_MESSAGE:
+		{
+			break;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+
+	if (*(ptr + 1) != '"')
+	{
+		return false;
+	}
+
+	metadata->action = (StreamAction) action;
+	ptr += 2;
+
+	/* ,"xid":1234 — wal2json emits numbers unquoted */
+	if (strncmp(ptr, ",\"xid\":", 7) == 0)
+	{
+		ptr += 7;
+
+		uint64_t xid = 0;
+		const char *start = ptr;
+
+		while ('0' <= *ptr && *ptr <= '9')
+		{
+			xid = xid * 10 + (*ptr - '0');
+			++ptr;
+		}
+
+		if (ptr == start || xid > UINT32_MAX)
+		{
+			return false;
+		}
+
+		metadata->xid = (uint32_t) xid;
+	}
+
+	/* the next key, if any, belongs to the decoded change itself */
+	if (*ptr != ',' && *ptr != '}')
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * parseWal2jsonMessage parses a JSON message as emitted by wal2json into our
  * own internal representation, that can be later output as SQL text.
@@ -110,7 +204,8 @@ parseWal2jsonMessageActionAndXid(LogicalStreamContext *context)
  * OUTPUT: pgcopydb LogicalTransactionStatement structure
  */
 bool
-parseWal2jsonMessage(LogicalTransactionStatement *stmt,
+parseWal2jsonMessage(MemoryArena *arena,
+					 LogicalTransactionStatement *stmt,
 					 LogicalMessageMetadata *metadata,
 					 char *message,
 					 JSON_Value *json)
@@ -162,17 +257,18 @@ parseWal2jsonMessage(LogicalTransactionStatement *stmt,
 
 			stmt->stmt.insert.new.count = 1;
 			stmt->stmt.insert.new.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			if (stmt->stmt.insert.new.array == NULL)
 			{
-				log_error(ALLOCATION_FAILED_ERROR);
+				/* errors have already been logged */
 				return false;
 			}
 
 			LogicalMessageTuple *tuple = &(stmt->stmt.insert.new.array[0]);
 
-			if (!SetColumnNamesAndValues(tuple, message, jscols))
+			if (!SetColumnNamesAndValues(arena, tuple, message, jscols))
 			{
 				log_error("Failed to parse INSERT columns for logical "
 						  "message %s",
@@ -192,15 +288,17 @@ parseWal2jsonMessage(LogicalTransactionStatement *stmt,
 			stmt->stmt.update.new.count = 1;
 
 			stmt->stmt.update.old.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			stmt->stmt.update.new.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			if (stmt->stmt.update.old.array == NULL ||
 				stmt->stmt.update.new.array == NULL)
 			{
-				log_error(ALLOCATION_FAILED_ERROR);
+				/* errors have already been logged */
 				return false;
 			}
 
@@ -208,7 +306,7 @@ parseWal2jsonMessage(LogicalTransactionStatement *stmt,
 			JSON_Array *jsids =
 				json_object_dotget_array(jsobj, "message.identity");
 
-			if (!SetColumnNamesAndValues(old, message, jsids))
+			if (!SetColumnNamesAndValues(arena, old, message, jsids))
 			{
 				log_error("Failed to parse UPDATE identity (old) for logical "
 						  "message %s",
@@ -220,7 +318,7 @@ parseWal2jsonMessage(LogicalTransactionStatement *stmt,
 			JSON_Array *jscols =
 				json_object_dotget_array(jsobj, "message.columns");
 
-			if (!SetColumnNamesAndValues(new, message, jscols))
+			if (!SetColumnNamesAndValues(arena, new, message, jscols))
 			{
 				log_error("Failed to parse UPDATE columns (new) for logical "
 						  "message %s",
@@ -238,11 +336,12 @@ parseWal2jsonMessage(LogicalTransactionStatement *stmt,
 
 			stmt->stmt.delete.old.count = 1;
 			stmt->stmt.delete.old.array =
-				(LogicalMessageTuple *) calloc(1, sizeof(LogicalMessageTuple));
+				(LogicalMessageTuple *)
+				arena_alloc(arena, sizeof(LogicalMessageTuple));
 
 			if (stmt->stmt.update.old.array == NULL)
 			{
-				log_error(ALLOCATION_FAILED_ERROR);
+				/* errors have already been logged */
 				return false;
 			}
 
@@ -250,7 +349,7 @@ parseWal2jsonMessage(LogicalTransactionStatement *stmt,
 			JSON_Array *jsids =
 				json_object_dotget_array(jsobj, "message.identity");
 
-			if (!SetColumnNamesAndValues(old, message, jsids))
+			if (!SetColumnNamesAndValues(arena, old, message, jsids))
 			{
 				log_error("Failed to parse DELETE identity (old) for logical "
 						  "message %s",
@@ -279,18 +378,19 @@ parseWal2jsonMessage(LogicalTransactionStatement *stmt,
  * representation for a tuple.
  */
 static bool
-SetColumnNamesAndValues(LogicalMessageTuple *tuple,
+SetColumnNamesAndValues(MemoryArena *arena,
+						LogicalMessageTuple *tuple,
 						const char *message,
 						JSON_Array *jscols)
 {
 	int count = json_array_get_count(jscols);
 
 	tuple->cols = count;
-	tuple->columns = (char **) calloc(count, sizeof(char *));
+	tuple->columns = (char **) arena_alloc(arena, count * sizeof(char *));
 
 	if (tuple->columns == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		/* errors have already been logged */
 		return false;
 	}
 
@@ -307,11 +407,12 @@ SetColumnNamesAndValues(LogicalMessageTuple *tuple,
 
 	valuesArray->count = 1;
 	valuesArray->array =
-		(LogicalMessageValues *) calloc(1, sizeof(LogicalMessageValues));
+		(LogicalMessageValues *)
+		arena_alloc(arena, sizeof(LogicalMessageValues));
 
 	if (valuesArray->array == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		/* errors have already been logged */
 		return false;
 	}
 
@@ -319,11 +420,12 @@ SetColumnNamesAndValues(LogicalMessageTuple *tuple,
 	LogicalMessageValues *values = &(tuple->values.array[0]);
 	values->cols = count;
 	values->array =
-		(LogicalMessageValue *) calloc(count, sizeof(LogicalMessageValue));
+		(LogicalMessageValue *)
+		arena_alloc(arena, count * sizeof(LogicalMessageValue));
 
 	if (values->array == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		/* errors have already been logged */
 		return false;
 	}
 
@@ -351,11 +453,11 @@ SetColumnNamesAndValues(LogicalMessageTuple *tuple,
 			return false;
 		}
 
-		tuple->columns[i] = strndup(colname, NAMEDATALEN);
+		tuple->columns[i] = arena_strndup(arena, colname, NAMEDATALEN);
 
 		if (tuple->columns[i] == NULL)
 		{
-			log_error(ALLOCATION_FAILED_ERROR);
+			/* errors have already been logged */
 			return false;
 		}
 
@@ -396,7 +498,7 @@ SetColumnNamesAndValues(LogicalMessageTuple *tuple,
 				const char *x = json_value_get_string(jsval);
 
 				valueColumn->oid = TEXTOID;
-				valueColumn->val.str = strdup(x);
+				valueColumn->val.str = arena_strdup(arena, x);
 				valueColumn->isNull = false;
 				valueColumn->isQuoted = false;
 				break;
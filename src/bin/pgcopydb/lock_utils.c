@@ -9,6 +9,8 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
+#include <sys/shm.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "defaults.h"
@@ -380,3 +382,185 @@ semaphore_log_lock_function(void *udata, int mode)
 		}
 	}
 }
+
+
+/*
+ * shmseg_create creates a new private shared memory segment of the given size,
+ * attaches it, and zeroes its content. The segment is marked for removal
+ * right away, so that the kernel reclaims it as soon as the last attached
+ * process has detached (or exited), even in case of a crash.
+ *
+ * A process that attaches a shared memory segment and then forks shares the
+ * segment with its children, which is the only access pattern we need.
+ */
+bool
+shmseg_create(SharedMemSegment *segment, size_t size)
+{
+	segment->size = size;
+	segment->shmId = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+
+	if (segment->shmId < 0)
+	{
+		log_fatal("Failed to create shared memory segment of %lld bytes: %m",
+				  (long long) size);
+		return false;
+	}
+
+	segment->ptr = shmat(segment->shmId, NULL, 0);
+
+	if (segment->ptr == (void *) -1)
+	{
+		log_fatal("Failed to attach shared memory segment %d: %m",
+				  segment->shmId);
+		return false;
+	}
+
+	/* have the segment disappear when the last process detaches */
+	if (shmctl(segment->shmId, IPC_RMID, NULL) != 0)
+	{
+		log_error("Failed to mark shared memory segment %d for removal: %m",
+				  segment->shmId);
+
+		(void) shmdt(segment->ptr);
+		return false;
+	}
+
+	memset(segment->ptr, 0, size);
+
+	return true;
+}
+
+
+/*
+ * shmseg_create_keyed creates (or re-uses) a shared memory segment keyed to
+ * the given on-disk path, so that unrelated processes can find and attach
+ * the same segment later, knowing only the path. The segment content is
+ * zeroed when the segment is first created.
+ *
+ * Contrary to shmseg_create, the segment is not marked for removal: it has
+ * to survive the creating process so that inspection commands can still
+ * attach it. A new run re-using the same work directory re-uses (and resets)
+ * the same segment, and the kernel reclaims it at reboot time.
+ */
+bool
+shmseg_create_keyed(SharedMemSegment *segment, const char *path, size_t size)
+{
+	key_t key = ftok(path, PGCOPYDB_SHM_PROJ_ID);
+
+	if (key == (key_t) -1)
+	{
+		log_fatal("Failed to compute a shared memory key for \"%s\": %m",
+				  path);
+		return false;
+	}
+
+	bool created = true;
+
+	segment->size = size;
+	segment->shmId = shmget(key, size, IPC_CREAT | IPC_EXCL | 0600);
+
+	if (segment->shmId < 0)
+	{
+		if (errno != EEXIST)
+		{
+			log_fatal("Failed to create shared memory segment of %lld bytes "
+					  "for \"%s\": %m",
+					  (long long) size,
+					  path);
+			return false;
+		}
+
+		/* the segment already exists, re-use it without zeroing it */
+		created = false;
+		segment->shmId = shmget(key, size, 0600);
+
+		if (segment->shmId < 0)
+		{
+			log_fatal("Failed to open shared memory segment for \"%s\": %m",
+					  path);
+			return false;
+		}
+	}
+
+	segment->ptr = shmat(segment->shmId, NULL, 0);
+
+	if (segment->ptr == (void *) -1)
+	{
+		log_fatal("Failed to attach shared memory segment %d: %m",
+				  segment->shmId);
+		return false;
+	}
+
+	if (created)
+	{
+		memset(segment->ptr, 0, size);
+	}
+
+	return true;
+}
+
+
+/*
+ * shmseg_attach_keyed attaches an existing shared memory segment keyed to
+ * the given on-disk path, as created by another process calling
+ * shmseg_create_keyed. Failing to find the segment is not an error here,
+ * callers are expected to have a fallback.
+ */
+bool
+shmseg_attach_keyed(SharedMemSegment *segment, const char *path, size_t size)
+{
+	key_t key = ftok(path, PGCOPYDB_SHM_PROJ_ID);
+
+	if (key == (key_t) -1)
+	{
+		log_debug("Failed to compute a shared memory key for \"%s\": %m",
+				  path);
+		return false;
+	}
+
+	segment->size = size;
+	segment->shmId = shmget(key, size, 0600);
+
+	if (segment->shmId < 0)
+	{
+		log_debug("Failed to find a shared memory segment for \"%s\": %m",
+				  path);
+		return false;
+	}
+
+	segment->ptr = shmat(segment->shmId, NULL, 0);
+
+	if (segment->ptr == (void *) -1)
+	{
+		log_debug("Failed to attach shared memory segment %d: %m",
+				  segment->shmId);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * shmseg_detach detaches the given shared memory segment from the current
+ * process address space.
+ */
+bool
+shmseg_detach(SharedMemSegment *segment)
+{
+	if (segment->ptr == NULL)
+	{
+		return true;
+	}
+
+	if (shmdt(segment->ptr) != 0)
+	{
+		log_error("Failed to detach shared memory segment %d: %m",
+				  segment->shmId);
+		return false;
+	}
+
+	segment->ptr = NULL;
+
+	return true;
+}
@@ -20,6 +20,18 @@ typedef struct Semaphore
 } Semaphore;
 
 
+/*
+ * A SysV shared memory segment, attached by a parent process before forking
+ * its worker processes, which then all share the same memory.
+ */
+typedef struct SharedMemSegment
+{
+	int shmId;
+	size_t size;
+	void *ptr;
+} SharedMemSegment;
+
+
 bool semaphore_init(Semaphore *semaphore);
 bool semaphore_finish(Semaphore *semaphore);
 
@@ -34,4 +46,16 @@ bool semaphore_unlock(Semaphore *semaphore);
 
 void semaphore_log_lock_function(void *udata, int mode);
 
+/* project id used with ftok(3) to name segments after the work directory */
+#define PGCOPYDB_SHM_PROJ_ID 'p'
+
+bool shmseg_create(SharedMemSegment *segment, size_t size);
+bool shmseg_create_keyed(SharedMemSegment *segment,
+						 const char *path,
+						 size_t size);
+bool shmseg_attach_keyed(SharedMemSegment *segment,
+						 const char *path,
+						 size_t size);
+bool shmseg_detach(SharedMemSegment *segment);
+
 #endif /* LOCK_UTILS_H */
@@ -176,15 +176,21 @@ set_logger()
 	 */
 	log_use_colors(isatty(fileno(stderr)));
 
-	/* initialize the semaphore used for locking log output */
+	/*
+	 * Initialize the semaphore that used to serialize log output: it is
+	 * still created (and advertised to sub-processes in the environment and
+	 * in the pidfile) so that stale-pidfile cleanup keeps working across
+	 * pgcopydb versions.
+	 *
+	 * The logging facility itself does not take the semaphore anymore: each
+	 * log line is now emitted with a single line-atomic write, and at high
+	 * --table-jobs counts the per-line semop() calls used to dominate the
+	 * copy loop when debug logging was enabled.
+	 */
 	if (!semaphore_init(&log_semaphore))
 	{
 		exit(EXIT_CODE_INTERNAL_ERROR);
 	}
-
-	/* set our logging facility to use our semaphore as a lock mechanism */
-	(void) log_set_udata(&log_semaphore);
-	(void) log_set_lock(&semaphore_log_lock_function);
 }
 
 
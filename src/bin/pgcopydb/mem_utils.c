@@ -0,0 +1,108 @@
+/*
+ * src/bin/pgcopydb/mem_utils.c
+ *   Utility functions for arena based memory allocation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "defaults.h"
+#include "log.h"
+#include "mem_utils.h"
+
+/* keep every allocation aligned for any scalar or pointer type */
+#define ARENA_ALIGN(size) (((size) + 15) & ~((size_t) 15))
+
+
+/*
+ * arena_alloc allocates size bytes out of the given arena, zero-initialized,
+ * growing the arena with a new block when the current one is full. Returns
+ * NULL when out of memory, after having logged an error.
+ */
+void *
+arena_alloc(MemoryArena *arena, size_t size)
+{
+	size = ARENA_ALIGN(size);
+
+	MemoryArenaBlock *block = arena->blocks;
+
+	if (block == NULL || (block->size - block->used) < size)
+	{
+		size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+
+		block = (MemoryArenaBlock *)
+				malloc(sizeof(MemoryArenaBlock) + blockSize);
+
+		if (block == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return NULL;
+		}
+
+		block->size = blockSize;
+		block->used = 0;
+		block->next = arena->blocks;
+
+		arena->blocks = block;
+	}
+
+	void *ptr = block->data + block->used;
+	block->used += size;
+
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+
+/*
+ * arena_strndup copies at most n characters of the given string into memory
+ * allocated from the arena, and terminates the copy with a zero byte.
+ */
+char *
+arena_strndup(MemoryArena *arena, const char *str, size_t n)
+{
+	size_t len = strnlen(str, n);
+	char *copy = (char *) arena_alloc(arena, len + 1);
+
+	if (copy == NULL)
+	{
+		/* errors have already been logged */
+		return NULL;
+	}
+
+	memcpy(copy, str, len);
+
+	return copy;
+}
+
+
+/*
+ * arena_strdup copies the given string into memory allocated from the arena.
+ */
+char *
+arena_strdup(MemoryArena *arena, const char *str)
+{
+	return arena_strndup(arena, str, strlen(str));
+}
+
+
+/*
+ * arena_release frees all the blocks of the given arena at once, releasing
+ * every allocation that was made from it.
+ */
+void
+arena_release(MemoryArena *arena)
+{
+	MemoryArenaBlock *block = arena->blocks;
+
+	while (block != NULL)
+	{
+		MemoryArenaBlock *next = block->next;
+
+		free(block);
+		block = next;
+	}
+
+	arena->blocks = NULL;
+}
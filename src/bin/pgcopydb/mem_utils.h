@@ -0,0 +1,37 @@
+/*
+ * src/bin/pgcopydb/mem_utils.h
+ *   Utility functions for arena based memory allocation
+ */
+
+#ifndef MEM_UTILS_H
+#define MEM_UTILS_H
+
+#include <stddef.h>
+
+/*
+ * A MemoryArena is a linked-list of large memory blocks that individual
+ * allocations are carved out of, so that the whole arena can be released in
+ * a single operation rather than walking data structures and free-ing every
+ * node one by one.
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct MemoryArenaBlock
+{
+	struct MemoryArenaBlock *next;
+	size_t size;
+	size_t used;
+	char data[];
+} MemoryArenaBlock;
+
+typedef struct MemoryArena
+{
+	MemoryArenaBlock *blocks;
+} MemoryArena;
+
+void * arena_alloc(MemoryArena *arena, size_t size);
+char * arena_strdup(MemoryArena *arena, const char *str);
+char * arena_strndup(MemoryArena *arena, const char *str, size_t n);
+void arena_release(MemoryArena *arena);
+
+#endif /* MEM_UTILS_H */
@@ -0,0 +1,87 @@
+/*
+ * src/bin/pgcopydb/metrics.c
+ *     Implementation of a CLI to copy a database between two Postgres instances
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "defaults.h"
+#include "file_utils.h"
+#include "log.h"
+#include "metrics.h"
+#include "string_utils.h"
+
+
+/*
+ * metrics_emit appends a single JSON line to the metrics file in the work
+ * directory, time-stamped in milliseconds, such as:
+ *
+ *   {"timestamp":1693465200042,"pid":4242,"event":"table-copy",
+ *    "oid":16384,"value":8912896,"duration-ms":1534}
+ *
+ * The value field carries bytes for COPY events and the current depth for
+ * queue depth samples. The whole line is written with a single write(2) call
+ * on a file descriptor opened with O_APPEND, so that samples from concurrent
+ * worker processes do not interleave.
+ *
+ * Emitting a metrics sample is best-effort instrumentation and the callers
+ * are expected to ignore errors.
+ */
+bool
+metrics_emit(const char *filename, const char *event,
+			 uint32_t oid, uint64_t value, uint64_t durationMs)
+{
+	struct timeval tv = { 0 };
+
+	if (gettimeofday(&tv, NULL) != 0)
+	{
+		tv.tv_sec = time(NULL);
+		tv.tv_usec = 0;
+	}
+
+	uint64_t timestampMs =
+		((uint64_t) tv.tv_sec) * 1000 + ((uint64_t) tv.tv_usec) / 1000;
+
+	char line[BUFSIZE] = { 0 };
+
+	sformat(line, sizeof(line),
+			"{\"timestamp\":%lld,\"pid\":%d,\"event\":\"%s\","
+			"\"oid\":%u,\"value\":%lld,\"duration-ms\":%lld}\n",
+			(long long) timestampMs,
+			getpid(),
+			event,
+			oid,
+			(long long) value,
+			(long long) durationMs);
+
+	int fd = open(filename, O_WRONLY | O_APPEND | O_CREAT, 0644);
+
+	if (fd < 0)
+	{
+		log_debug("Failed to open metrics file \"%s\": %m", filename);
+		return false;
+	}
+
+	size_t len = strlen(line);
+
+	if (write(fd, line, len) != (ssize_t) len)
+	{
+		log_debug("Failed to write %lld bytes to metrics file \"%s\": %m",
+				  (long long) len,
+				  filename);
+		(void) close(fd);
+		return false;
+	}
+
+	if (close(fd) != 0)
+	{
+		log_debug("Failed to close metrics file \"%s\": %m", filename);
+		return false;
+	}
+
+	return true;
+}
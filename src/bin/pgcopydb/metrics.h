@@ -0,0 +1,15 @@
+/*
+ * src/bin/pgcopydb/metrics.h
+ *     Implementation of a CLI to copy a database between two Postgres instances
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool metrics_emit(const char *filename, const char *event,
+				  uint32_t oid, uint64_t value, uint64_t durationMs);
+
+#endif /* METRICS_H */
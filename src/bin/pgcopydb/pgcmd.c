@@ -724,6 +724,7 @@ pg_restore_db(PostgresPaths *pgPaths,
 	int argsIndex = 0;
 
 	char command[BUFSIZE] = { 0 };
+	char jobs[INTSTRING_MAX_DIGITS] = { 0 };
 
 	SafeURI safeURI = { 0 };
 	bool pgpassword_found_in_env = env_exists("PGPASSWORD");
@@ -752,7 +753,19 @@ pg_restore_db(PostgresPaths *pgPaths,
 	args[argsIndex++] = (char *) pgPaths->pg_restore;
 	args[argsIndex++] = "--dbname";
 	args[argsIndex++] = (char *) safeURI.pguri;
-	args[argsIndex++] = "--single-transaction";
+
+	/* pg_restore --jobs and --single-transaction are mutually exclusive */
+	if (options.jobs > 1)
+	{
+		sformat(jobs, sizeof(jobs), "%d", options.jobs);
+
+		args[argsIndex++] = "--jobs";
+		args[argsIndex++] = jobs;
+	}
+	else
+	{
+		args[argsIndex++] = "--single-transaction";
+	}
 
 	if (options.dropIfExists)
 	{
@@ -828,15 +841,20 @@ pg_restore_db(PostgresPaths *pgPaths,
 
 
 /*
- * pg_restore_list runs the command pg_restore -f- -l on the given custom
- * format dump file and returns an array of pg_dump archive objects.
+ * pg_restore_list runs the command pg_restore -l on the given custom format
+ * dump file, and has pg_restore write the archive table of contents directly
+ * to the given file: the TOC of a large database is hundreds of MB large, we
+ * don't want to hold it in memory.
  */
 bool
-pg_restore_list(PostgresPaths *pgPaths, const char *filename,
-				ArchiveContentArray *archive)
+pg_restore_list(PostgresPaths *pgPaths,
+				const char *dumpFilename,
+				const char *tocFilename)
 {
-	Program prog =
-		run_program(pgPaths->pg_restore, "-f-", "-l", filename, NULL);
+	Program prog = run_program(pgPaths->pg_restore,
+							   "-f", tocFilename,
+							   "-l", dumpFilename,
+							   NULL);
 
 	char command[BUFSIZE] = { 0 };
 	(void) snprintf_program_command_line(&prog, command, BUFSIZE);
@@ -851,21 +869,14 @@ pg_restore_list(PostgresPaths *pgPaths, const char *filename,
 		return false;
 	}
 
-	if (!parse_archive_list(prog.stdOut, archive))
-	{
-		/* errors have already been logged */
-		free_program(&prog);
-		return false;
-	}
-
 	free_program(&prog);
 	return true;
 }
 
 
 /*
- * parse_archive_list parses a archive content list as obtained with the
- * pg_restore --list option.
+ * parse_archive_list_entry parses a single line of an archive content list as
+ * obtained with the pg_restore --list option.
  *
  * We are parsing the following format, plus a preamble that contains lines
  * that all start with a semi-colon, the comment separator for this format.
@@ -951,126 +962,112 @@ struct StringWithLength pgRestoreDescriptionArray[] = {
 
 
 bool
-parse_archive_list(char *list, ArchiveContentArray *contents)
+parse_archive_list_entry(char *line, ArchiveContentItem *item, bool *isEntry)
 {
-	/* only parse the first 128 * 1024 lines */
-	char *lines[128 * BUFSIZE];
-	int lineCount = splitLines(list, lines, 128 * BUFSIZE);
-
-	/* the pg_restore --list preamble is 15 lines long */
-	int objectCount = lineCount - 15;
+	*isEntry = false;
 
-	contents->count = 0;
-	contents->array =
-		(ArchiveContentItem *) malloc(objectCount * sizeof(ArchiveContentItem));
+	char *ptr = line;
+	char *sep = strchr(ptr, ';');
 
-	for (int lineNumber = 0; lineNumber < lineCount; lineNumber++)
+	/* skip lines that start with a separator (comments and the preamble) */
+	if (sep == NULL || sep == ptr)
 	{
-		ArchiveContentItem *item = &(contents->array[contents->count]);
-
-		char *ptr = lines[lineNumber];
-		char *sep = strchr(ptr, ';');
-
-		/* skip lines that start with a separator */
-		if (sep == NULL || sep == ptr)
-		{
-			continue;
-		}
+		return true;
+	}
 
-		/* parse the archive dumpId before the separator */
-		*sep = '\0';
+	/* parse the archive dumpId before the separator */
+	*sep = '\0';
 
-		if (!stringToInt(ptr, &(item->dumpId)))
-		{
-			log_error("Failed to parse dumpId \"%s\" from pg_restore --list",
-					  ptr);
-			return false;
-		}
+	if (!stringToInt(ptr, &(item->dumpId)))
+	{
+		log_error("Failed to parse dumpId \"%s\" from pg_restore --list",
+				  ptr);
+		return false;
+	}
 
-		/* skip "; " */
-		ptr = sep + 2;
-		sep = strchr(ptr, ' ');
+	/* skip "; " */
+	ptr = sep + 2;
+	sep = strchr(ptr, ' ');
 
-		if (sep == NULL)
-		{
-			log_error("Failed to parse pg_restore --list output");
-			return false;
-		}
+	if (sep == NULL)
+	{
+		log_error("Failed to parse pg_restore --list output");
+		return false;
+	}
 
-		*sep = '\0';
+	*sep = '\0';
 
-		if (!stringToUInt32(ptr, &(item->catalogOid)))
-		{
-			log_error("Failed to parse catalog OID \"%s\" from pg_restore --list",
-					  ptr);
-			return false;
-		}
+	if (!stringToUInt32(ptr, &(item->catalogOid)))
+	{
+		log_error("Failed to parse catalog OID \"%s\" from pg_restore --list",
+				  ptr);
+		return false;
+	}
 
-		/* skip " " */
-		ptr = sep + 1;
-		sep = strchr(ptr, ' ');
+	/* skip " " */
+	ptr = sep + 1;
+	sep = strchr(ptr, ' ');
 
-		if (sep == NULL)
-		{
-			log_error("Failed to parse pg_restore --list output");
-			return false;
-		}
+	if (sep == NULL)
+	{
+		log_error("Failed to parse pg_restore --list output");
+		return false;
+	}
 
-		*sep = '\0';
+	*sep = '\0';
 
-		if (!stringToUInt32(ptr, &(item->objectOid)))
-		{
-			log_error("Failed to parse OID \"%s\" from pg_restore --list",
-					  ptr);
-			return false;
-		}
+	if (!stringToUInt32(ptr, &(item->objectOid)))
+	{
+		log_error("Failed to parse OID \"%s\" from pg_restore --list",
+				  ptr);
+		return false;
+	}
 
-		/* skip " " */
-		ptr = sep + 1;
+	/* skip " " */
+	ptr = sep + 1;
 
-		for (int i = 0; pgRestoreDescriptionArray[i].len != 0; i++)
+	for (int i = 0; pgRestoreDescriptionArray[i].len != 0; i++)
+	{
+		if (strncmp(ptr,
+					pgRestoreDescriptionArray[i].str,
+					pgRestoreDescriptionArray[i].len) == 0)
 		{
-			if (strncmp(ptr,
-						pgRestoreDescriptionArray[i].str,
-						pgRestoreDescriptionArray[i].len) == 0)
+			/*
+			 * Some pg_restore archive catalog TOC entries have a quite a
+			 * special restoreListName, that needs some tweaking to be able
+			 * to match it to the normal one we have in our hash tables.
+			 *
+			 */
+			if (strcmp(pgRestoreDescriptionArray[i].str, "ACL") == 0 ||
+				strcmp(pgRestoreDescriptionArray[i].str, "COMMENT") == 0)
 			{
-				/*
-				 * Some pg_restore archive catalog TOC entries have a quite a
-				 * special restoreListName, that needs some tweaking to be able
-				 * to match it to the normal one we have in our hash tables.
-				 *
-				 */
-				if (strcmp(pgRestoreDescriptionArray[i].str, "ACL") == 0 ||
-					strcmp(pgRestoreDescriptionArray[i].str, "COMMENT") == 0)
-				{
-					/* ignore errors */
-					if (!parse_archive_acl_or_comment(ptr, item))
-					{
-						log_debug("Failed to parse ACL or COMMENT: %s", ptr);
-					}
-				}
-				else
+				/* ignore errors */
+				if (!parse_archive_acl_or_comment(ptr, item))
 				{
-					strlcpy(item->desc,
-							pgRestoreDescriptionArray[i].str,
-							sizeof(item->desc));
-
-					strlcpy(item->restoreListName,
-							ptr + pgRestoreDescriptionArray[i].len + 1,
-							sizeof(item->restoreListName));
+					log_debug("Failed to parse ACL or COMMENT: %s", ptr);
 				}
-				break;
 			}
-		}
+			else
+			{
+				strlcpy(item->desc,
+						pgRestoreDescriptionArray[i].str,
+						sizeof(item->desc));
 
-		if (IS_EMPTY_STRING_BUFFER(item->desc))
-		{
-			log_warn("Failed to parse desc \"%s\"", ptr);
+				strlcpy(item->restoreListName,
+						ptr + pgRestoreDescriptionArray[i].len + 1,
+						sizeof(item->restoreListName));
+			}
+			break;
 		}
+	}
 
-		++contents->count;
+	if (IS_EMPTY_STRING_BUFFER(item->desc))
+	{
+		log_warn("Failed to parse desc \"%s\"", ptr);
 	}
 
+	*isEntry = true;
+
 	return true;
 }
 
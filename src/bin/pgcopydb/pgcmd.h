@@ -57,12 +57,6 @@ typedef struct ArchiveContentItem
 } ArchiveContentItem;
 
 
-typedef struct ArchiveContentArray
-{
-	int count;
-	ArchiveContentItem *array;  /* malloc'ed area */
-} ArchiveContentArray;
-
 
 typedef struct RestoreOptions
 {
@@ -70,6 +64,7 @@ typedef struct RestoreOptions
 	bool noOwner;
 	bool noComments;
 	bool noACL;
+	int jobs;                   /* pg_restore --jobs, when greater than 1 */
 } RestoreOptions;
 
 bool psql_version(PostgresPaths *pgPaths);
@@ -105,10 +100,13 @@ bool pg_restore_db(PostgresPaths *pgPaths,
 				   const char *listFilename,
 				   RestoreOptions options);
 
-bool pg_restore_list(PostgresPaths *pgPaths, const char *filename,
-					 ArchiveContentArray *archive);
+bool pg_restore_list(PostgresPaths *pgPaths,
+					 const char *dumpFilename,
+					 const char *tocFilename);
 
-bool parse_archive_list(char *list, ArchiveContentArray *archive);
+bool parse_archive_list_entry(char *line,
+							  ArchiveContentItem *item,
+							  bool *isEntry);
 
 bool parse_archive_acl_or_comment(char *ptr, ArchiveContentItem *item);
 
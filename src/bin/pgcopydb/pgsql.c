@@ -2,7 +2,11 @@
  * src/bin/pg_autoctl/pgsql.c
  *	 API for sending SQL commands to a PostgreSQL server
  */
+#include <ctype.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -34,6 +38,8 @@ static char * ConnectionTypeToString(ConnectionType connectionType);
 static void log_connection_error(PGconn *connection, int logLevel);
 static void pgAutoCtlDefaultNoticeProcessor(void *arg, const char *message);
 static PGconn * pgsql_open_connection(PGSQL *pgsql);
+static void pgsql_tune_socket(PGSQL *pgsql);
+static void pgsql_set_socket_buffer(int sock, const char *envname, int option);
 static bool pgsql_retry_open_connection(PGSQL *pgsql);
 static bool is_response_ok(PGresult *result);
 static bool clear_results(PGSQL *pgsql);
@@ -42,13 +48,17 @@ static void pgsql_handle_notifications(PGSQL *pgsql);
 static void parseIdentifySystemResult(void *ctx, PGresult *result);
 static void parseTimelineHistoryResult(void *ctx, PGresult *result);
 
+static bool pg_copy_data(PGSQL *src, PGSQL *dst,
+						 bool *failedOnSrc, bool *failedOnDst,
+						 uint64_t *bytesTransmitted,
+						 uint64_t *rowsTransmitted);
 static bool pg_copy_send_query(PGSQL *pgsql,
 							   const char *qname,
 							   ExecStatusType status,
-							   bool freeze);
+							   bool freeze,
+							   bool binary);
 static void pgcopy_log_error(PGSQL *pgsql, PGresult *res, const char *context);
 
-static void getSequenceValue(void *ctx, PGresult *result);
 
 static void pgsql_stream_log_error(PGSQL *pgsql,
 								   PGresult *res, const char *message);
@@ -559,10 +569,93 @@ pgsql_open_connection(PGSQL *pgsql)
 						 &pgAutoCtlDefaultNoticeProcessor,
 						 NULL);
 
+	/* apply the TCP socket tuning knobs from the environment, if any */
+	(void) pgsql_tune_socket(pgsql);
+
 	return pgsql->connection;
 }
 
 
+/*
+ * pgsql_tune_socket applies the socket tuning knobs found in the environment
+ * to a freshly opened connection: PGCOPYDB_TCP_RCVBUF and PGCOPYDB_TCP_SNDBUF
+ * size the kernel socket buffers, and PGCOPYDB_TCP_NODELAY disables the Nagle
+ * algorithm.
+ *
+ * On high bandwidth-delay product network paths (cross-region copies) the
+ * default socket buffer sizes cap the throughput of each COPY stream, and
+ * sizing the buffers per-connection avoids kernel-wide sysctl changes. The
+ * tuning is best-effort: a connection that could not be tuned works all the
+ * same, only slower.
+ */
+static void
+pgsql_tune_socket(PGSQL *pgsql)
+{
+	int sock = PQsocket(pgsql->connection);
+
+	if (sock < 0)
+	{
+		return;
+	}
+
+	(void) pgsql_set_socket_buffer(sock, PGCOPYDB_TCP_RCVBUF, SO_RCVBUF);
+	(void) pgsql_set_socket_buffer(sock, PGCOPYDB_TCP_SNDBUF, SO_SNDBUF);
+
+	if (env_exists(PGCOPYDB_TCP_NODELAY))
+	{
+		int enable = 1;
+
+		if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
+					   &enable, sizeof(enable)) == -1)
+		{
+			/* Unix domain sockets do not implement TCP_NODELAY */
+			log_debug("Failed to set TCP_NODELAY: %m");
+		}
+	}
+}
+
+
+/*
+ * pgsql_set_socket_buffer sizes a kernel socket buffer (SO_RCVBUF or
+ * SO_SNDBUF) from the given environment variable, which accepts a
+ * pretty-printed bytes value such as "16 MB".
+ */
+static void
+pgsql_set_socket_buffer(int sock, const char *envname, int option)
+{
+	if (!env_exists(envname))
+	{
+		return;
+	}
+
+	char byteString[BUFSIZE] = { 0 };
+
+	if (!get_env_copy(envname, byteString, sizeof(byteString)))
+	{
+		/* errors have already been logged */
+		return;
+	}
+
+	uint64_t bytes = 0;
+
+	if (!parse_pretty_printed_bytes(byteString, &bytes) || bytes == 0)
+	{
+		log_warn("Failed to parse %s value \"%s\"", envname, byteString);
+		return;
+	}
+
+	int size = bytes > INT_MAX ? INT_MAX : (int) bytes;
+
+	if (setsockopt(sock, SOL_SOCKET, option, &size, sizeof(size)) == -1)
+	{
+		log_warn("Failed to set %s to %d bytes: %m", envname, size);
+		return;
+	}
+
+	log_debug("%s: socket buffer set to %d bytes", envname, size);
+}
+
+
 /*
  * Refrain from warning too often. The user certainly wants to know that we are
  * still trying to connect, though warning several times a second is not going
@@ -1294,6 +1387,133 @@ pgsql_execute_with_params(PGSQL *pgsql, const char *sql, int paramCount,
 }
 
 
+/*
+ * pgsql_execute_pipeline runs a batch of queries on the same connection using
+ * the libpq pipeline mode: all the queries are sent without waiting for their
+ * results, and the results are then parsed in order as they stream back, so
+ * that the whole batch costs about a single network round trip.
+ */
+bool
+pgsql_execute_pipeline(PGSQL *pgsql, PipelineQuery *queries, int count)
+{
+	PGconn *connection = pgsql_open_connection(pgsql);
+
+	if (connection == NULL)
+	{
+		return false;
+	}
+
+	char *endpoint =
+		pgsql->connectionType == PGSQL_CONN_SOURCE ? "SOURCE" : "TARGET";
+
+	if (PQenterPipelineMode(connection) != 1)
+	{
+		log_error("Failed to enter libpq pipeline mode: %s",
+				  PQerrorMessage(connection));
+		(void) pgsql_finish(pgsql);
+		return false;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		log_notice("[%s] %s;", endpoint, queries[i].sql);
+
+		if (PQsendQueryParams(connection, queries[i].sql,
+							  0, NULL, NULL, NULL, NULL, 0) != 1)
+		{
+			log_error("Failed to send query in pipeline mode: %s",
+					  PQerrorMessage(connection));
+			(void) pgsql_finish(pgsql);
+			return false;
+		}
+	}
+
+	if (PQpipelineSync(connection) != 1)
+	{
+		log_error("Failed to sync the libpq pipeline: %s",
+				  PQerrorMessage(connection));
+		(void) pgsql_finish(pgsql);
+		return false;
+	}
+
+	bool allParsedOk = true;
+
+	for (int i = 0; i < count; i++)
+	{
+		PGresult *result = PQgetResult(connection);
+
+		if (!is_response_ok(result))
+		{
+			/*
+			 * Results of queries sent after a failed one come back as
+			 * PGRES_PIPELINE_ABORTED, and are drained by this same loop.
+			 */
+			char *message = PQerrorMessage(connection);
+			char *errorLines[BUFSIZE];
+			int lineCount = splitLines(message, errorLines, BUFSIZE);
+
+			for (int lineNumber = 0; lineNumber < lineCount; lineNumber++)
+			{
+				log_error("[%s] %s", endpoint, errorLines[lineNumber]);
+			}
+
+			log_error("SQL query: %s", queries[i].sql);
+
+			allParsedOk = false;
+			PQclear(result);
+		}
+		else
+		{
+			if (queries[i].parseFun != NULL)
+			{
+				(*queries[i].parseFun)(queries[i].parseContext, result);
+			}
+
+			PQclear(result);
+		}
+
+		/* in-between two queries results, libpq returns a NULL result */
+		PGresult *nullResult = PQgetResult(connection);
+
+		if (nullResult != NULL)
+		{
+			log_error("BUG: unexpected extra result in pipeline mode");
+			PQclear(nullResult);
+			allParsedOk = false;
+		}
+	}
+
+	/* after the last result, the pipeline sync point must be consumed */
+	PGresult *sync = PQgetResult(connection);
+
+	if (sync == NULL || PQresultStatus(sync) != PGRES_PIPELINE_SYNC)
+	{
+		log_error("Failed to read the libpq pipeline sync result: %s",
+				  PQerrorMessage(connection));
+		PQclear(sync);
+		(void) pgsql_finish(pgsql);
+		return false;
+	}
+
+	PQclear(sync);
+
+	if (PQexitPipelineMode(connection) != 1)
+	{
+		log_error("Failed to exit libpq pipeline mode: %s",
+				  PQerrorMessage(connection));
+		(void) pgsql_finish(pgsql);
+		return false;
+	}
+
+	if (pgsql->connectionStatementType == PGSQL_CONNECTION_SINGLE_STATEMENT)
+	{
+		(void) pgsql_finish(pgsql);
+	}
+
+	return allParsedOk;
+}
+
+
 /*
  * is_response_ok returns whether the query result is a correct response
  * (not an error or failure).
@@ -1431,6 +1651,117 @@ pgsql_handle_notifications(PGSQL *pgsql)
 }
 
 
+/*
+ * pgsql_listen registers our interest in the given NOTIFY channel. The
+ * connection is expected to be a PGSQL_CONNECTION_MULTI_STATEMENT one, so
+ * that it stays open and notifications can then be waited for by calling
+ * pgsql_wait_for_notification.
+ */
+bool
+pgsql_listen(PGSQL *pgsql, char *channel)
+{
+	char sql[BUFSIZE] = { 0 };
+
+	sformat(sql, sizeof(sql), "LISTEN %s", channel);
+
+	return pgsql_execute(pgsql, sql);
+}
+
+
+/*
+ * pgsql_wait_for_notification waits until a notification has been received on
+ * the given channel, or until timeoutMs milliseconds have elapsed, whichever
+ * happens first. The received boolean is set to true when a notification sent
+ * to the channel has been consumed.
+ *
+ * Getting a timeout is not an error: callers are expected to poll for the
+ * information they are interested in as a fallback.
+ */
+bool
+pgsql_wait_for_notification(PGSQL *pgsql,
+							char *channel,
+							int timeoutMs,
+							bool *received)
+{
+	PGconn *connection = pgsql->connection;
+	PGnotify *notify;
+
+	*received = false;
+
+	if (connection == NULL)
+	{
+		log_error("BUG: pgsql_wait_for_notification called "
+				  "without a connection");
+		return false;
+	}
+
+	/* first consume notifications that might have arrived already */
+	PQconsumeInput(connection);
+
+	while ((notify = PQnotifies(connection)) != NULL)
+	{
+		if (strcmp(notify->relname, channel) == 0)
+		{
+			*received = true;
+		}
+		PQfreemem(notify);
+	}
+
+	if (*received)
+	{
+		return true;
+	}
+
+	if (PQsocket(connection) < 0)
+	{
+		log_error("Failed to wait for notifications: invalid socket");
+		return false;
+	}
+
+	fd_set input_mask;
+	struct timeval timeout;
+
+	FD_ZERO(&input_mask);
+	FD_SET(PQsocket(connection), &input_mask);
+
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+
+	int r = select(PQsocket(connection) + 1, &input_mask, NULL, NULL, &timeout);
+
+	if (r == 0 || (r < 0 && errno == EINTR))
+	{
+		/* got a timeout or a signal: the caller polls as a fallback */
+		return true;
+	}
+	else if (r < 0)
+	{
+		log_error("Failed to wait for notifications: select failed: %m");
+		return false;
+	}
+
+	/* there is actually data on the socket */
+	if (PQconsumeInput(connection) == 0)
+	{
+		log_error("Failed to consume input from Postgres: %s",
+				  PQerrorMessage(connection));
+		pgsql_finish(pgsql);
+		return false;
+	}
+
+	while ((notify = PQnotifies(connection)) != NULL)
+	{
+		if (strcmp(notify->relname, channel) == 0)
+		{
+			*received = true;
+		}
+		PQfreemem(notify);
+	}
+
+	return true;
+}
+
+
 /*
  * hostname_from_uri parses a PostgreSQL connection string URI and returns
  * whether the URL was successfully parsed.
@@ -1558,10 +1889,15 @@ pgsql_truncate(PGSQL *pgsql, const char *qname)
  * a target Postgres instance (dst), for the data found in the table referenced
  * by the qualified identifier name srcQname on the source, into the table
  * referenced by the qualified identifier name dstQname on the target.
+ *
+ * The bytes and rows seen on the wire are added to *bytesTransmitted and
+ * *rowsTransmitted when those pointers are not NULL, allowing callers to
+ * accumulate transfer statistics over retries and checkpoint ranges.
  */
 bool
 pg_copy(PGSQL *src, PGSQL *dst, const char *srcQname, const char *dstQname,
-		bool truncate)
+		bool truncate, bool binary,
+		uint64_t *bytesTransmitted, uint64_t *rowsTransmitted)
 {
 	bool srcConnIsOurs = src->connection == NULL;
 	PGconn *srcConn = pgsql_open_connection(src);
@@ -1571,6 +1907,7 @@ pg_copy(PGSQL *src, PGSQL *dst, const char *srcQname, const char *dstQname,
 		return false;
 	}
 
+	bool dstConnIsOurs = dst->connection == NULL;
 	PGconn *dstConn = pgsql_open_connection(dst);
 
 	if (dstConn == NULL)
@@ -1610,7 +1947,7 @@ pg_copy(PGSQL *src, PGSQL *dst, const char *srcQname, const char *dstQname,
 	}
 
 	/* SRC: COPY schema.table TO STDOUT */
-	if (!pg_copy_send_query(src, srcQname, PGRES_COPY_OUT, false))
+	if (!pg_copy_send_query(src, srcQname, PGRES_COPY_OUT, false, binary))
 	{
 		if (srcConnIsOurs)
 		{
@@ -1622,7 +1959,7 @@ pg_copy(PGSQL *src, PGSQL *dst, const char *srcQname, const char *dstQname,
 	}
 
 	/* DST: COPY schema.table FROM STDIN WITH (FREEZE) */
-	if (!pg_copy_send_query(dst, dstQname, PGRES_COPY_IN, truncate))
+	if (!pg_copy_send_query(dst, dstQname, PGRES_COPY_IN, truncate, binary))
 	{
 		if (srcConnIsOurs)
 		{
@@ -1634,119 +1971,424 @@ pg_copy(PGSQL *src, PGSQL *dst, const char *srcQname, const char *dstQname,
 	}
 
 	/* now implement the copy loop */
-	char *copybuf;
 	bool failedOnSrc = false;
 	bool failedOnDst = false;
 
-	for (;;)
+	(void) pg_copy_data(src, dst, &failedOnSrc, &failedOnDst,
+						bytesTransmitted, rowsTransmitted);
+
+	if (failedOnSrc || failedOnDst)
 	{
-		int bufsize = PQgetCopyData(srcConn, &copybuf, 0);
+		clear_results(src);
+	}
 
-		/*
-		 * A result of -2 indicates that an error occurred.
-		 */
-		if (bufsize == -2)
+	if (srcConnIsOurs)
+	{
+		pgsql_finish(src);
+	}
+
+	/*
+	 * The COPY loop is over now.
+	 *
+	 * Time to send end-of-data indication to the server during COPY_IN state.
+	 */
+	if (!failedOnDst)
+	{
+		char *errormsg =
+			failedOnSrc ? "Failed to get data from source" : NULL;
+
+		int res = PQputCopyEnd(dstConn, errormsg);
+
+		if (res > 0)
 		{
-			failedOnSrc = true;
+			PGresult *res = PQgetResult(dstConn);
 
-			pgcopy_log_error(src, NULL, "Failed to fetch data from source");
-			break;
+			if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			{
+				pgcopy_log_error(dst, res, "Failed to copy data to target");
+			}
 		}
 
+		clear_results(dst);
+
+		if (!pgsql_commit(dst))
+		{
+			failedOnDst = true;
+		}
+	}
+
+	/*
+	 * Close the target connection when we opened it in this function, the
+	 * caller may also have given us an already established connection to
+	 * re-use across several COPY operations. On errors, always close the
+	 * connection: its state is unknown, re-connect before a retry.
+	 */
+	if (dstConnIsOurs || failedOnSrc || failedOnDst)
+	{
+		(void) pgsql_finish(dst);
+	}
+
+	return !failedOnSrc && !failedOnDst;
+}
+
+
+/*
+ * pg_copy_data implements the data pump loop of a COPY operation, reading COPY
+ * buffers from the source connection and sending them over to the target
+ * connection.
+ *
+ * Both connections are used in non-blocking mode and the loop select(2)s on
+ * both sockets at the same time, so that we keep reading from the source while
+ * the target is busy draining our previous buffers, rather than ping-ponging
+ * between the two round-trips.
+ *
+ * Each PQgetCopyData buffer is one data row of the COPY stream, so the bytes
+ * and rows transmitted are counted here, where they are already in hand.
+ */
+static bool
+pg_copy_data(PGSQL *src, PGSQL *dst, bool *failedOnSrc, bool *failedOnDst,
+			 uint64_t *bytesTransmitted, uint64_t *rowsTransmitted)
+{
+	PGconn *srcConn = src->connection;
+	PGconn *dstConn = dst->connection;
+
+	/*
+	 * Switch the target connection to non-blocking mode: PQputCopyData then
+	 * queues data in libpq buffers and PQflush pushes it to the socket only
+	 * when it's ready to accept more, leaving us free to fetch the next
+	 * buffer from the source in the meantime.
+	 */
+	if (PQsetnonblocking(dstConn, 1) == -1)
+	{
+		*failedOnDst = true;
+
+		pgcopy_log_error(dst, NULL, "Failed to set target non-blocking mode");
+		return false;
+	}
+
+	/*
+	 * Rows fetched from the source are accumulated into a pair of large
+	 * reusable chunk buffers, allocated once per COPY operation: one chunk is
+	 * being filled from the source while the previous one is draining to the
+	 * target. The per-row libpq buffers are copied and freed immediately, and
+	 * the target only sees one PQputCopyData call per chunk.
+	 */
+	char *fillBuf = (char *) malloc(COPY_CHUNK_SIZE);
+	char *sendBuf = (char *) malloc(COPY_CHUNK_SIZE);
+
+	if (fillBuf == NULL || sendBuf == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+
+		free(fillBuf);
+		free(sendBuf);
+
+		*failedOnDst = true;
+		return false;
+	}
+
+	size_t fillSize = COPY_CHUNK_SIZE;
+	size_t sendSize = COPY_CHUNK_SIZE;
+
+	size_t fillLen = 0;         /* bytes accumulated in the fill chunk */
+	size_t sendLen = 0;         /* chunk bytes not yet accepted by libpq */
+
+	char *pendingRow = NULL;    /* row that did not fit in the fill chunk */
+	int pendingRowSize = 0;
+
+	bool doneOnSrc = false;
+	int flushStatus = 0;
+
+	for (;;)
+	{
+		bool waitForSrc = false;
+		bool waitForDst = false;
+
 		/*
-		 * PQgetCopyData returns -1 to indicate that the COPY is done. Call
-		 * PQgetResult to obtain the final result status of the COPY command.
+		 * First, drain COPY buffers from the source into the fill chunk, in
+		 * async mode, until the chunk is full or the source has no more data
+		 * ready.
 		 */
-		else if (bufsize == -1)
+		while (!doneOnSrc && pendingRow == NULL)
 		{
-			PGresult *res = PQgetResult(srcConn);
+			char *copybuf = NULL;
+			int bufsize = PQgetCopyData(srcConn, &copybuf, 1);
 
-			if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			/*
+			 * A result of -2 indicates that an error occurred.
+			 */
+			if (bufsize == -2)
 			{
-				failedOnSrc = true;
+				*failedOnSrc = true;
 
-				pgcopy_log_error(src, res, "Failed to fetch data from source");
+				pgcopy_log_error(src, NULL, "Failed to fetch data from source");
 				break;
 			}
 
-			/* we're done here */
-			clear_results(src);
+			/*
+			 * PQgetCopyData returns -1 to indicate that the COPY is done.
+			 * Call PQgetResult to obtain the final result status of the COPY
+			 * command.
+			 */
+			else if (bufsize == -1)
+			{
+				PGresult *res = PQgetResult(srcConn);
 
-			if (srcConnIsOurs)
+				if (PQresultStatus(res) != PGRES_COMMAND_OK)
+				{
+					*failedOnSrc = true;
+
+					pgcopy_log_error(src, res,
+									 "Failed to fetch data from source");
+					break;
+				}
+
+				/* we're done here */
+				clear_results(src);
+
+				doneOnSrc = true;
+			}
+
+			/*
+			 * A result of zero means the COPY is still in progress and no
+			 * buffer is available yet: wait for the source socket.
+			 */
+			else if (bufsize == 0)
 			{
-				pgsql_finish(src);
+				waitForSrc = true;
+				break;
 			}
 
-			/* make sure to pass through and send this last COPY buffer */
+			/*
+			 * We got a row: append it to the fill chunk when it fits, or keep
+			 * it around until the chunk has been swapped out.
+			 */
+			else
+			{
+				if (bytesTransmitted != NULL)
+				{
+					*bytesTransmitted += bufsize;
+				}
+
+				if (rowsTransmitted != NULL)
+				{
+					++(*rowsTransmitted);
+				}
+
+				if (fillLen + bufsize <= fillSize)
+				{
+					memcpy(fillBuf + fillLen, copybuf, bufsize);
+					fillLen += bufsize;
+
+					PQfreemem(copybuf);
+				}
+				else
+				{
+					pendingRow = copybuf;
+					pendingRowSize = bufsize;
+				}
+			}
+		}
+
+		if (*failedOnSrc)
+		{
+			break;
 		}
 
 		/*
-		 * We got a COPY buffer from the source database, send it over as-is to
-		 * the target database, which speaks the same COPY protocol, after all.
+		 * When the previous chunk has been fully accepted by libpq and the
+		 * fill chunk is ready (full, or the source has nothing more for now),
+		 * swap the two chunks.
 		 */
-		if (copybuf)
+		if (sendLen == 0 && fillLen > 0 &&
+			(doneOnSrc || pendingRow != NULL || waitForSrc))
 		{
-			int ret = PQputCopyData(dstConn, copybuf, bufsize);
-			PQfreemem(copybuf);
+			char *tmp = sendBuf;
+			size_t tmpSize = sendSize;
 
-			if (ret == -1)
+			sendBuf = fillBuf;
+			sendSize = fillSize;
+			sendLen = fillLen;
+
+			fillBuf = tmp;
+			fillSize = tmpSize;
+			fillLen = 0;
+
+			/* now move the row that did not fit into the new fill chunk */
+			if (pendingRow != NULL)
 			{
-				failedOnDst = true;
+				if ((size_t) pendingRowSize > fillSize)
+				{
+					char *newBuf = (char *) realloc(fillBuf, pendingRowSize);
 
-				pgcopy_log_error(dst, NULL, "Failed to copy data to target");
+					if (newBuf == NULL)
+					{
+						log_fatal(ALLOCATION_FAILED_ERROR);
 
-				clear_results(src);
+						*failedOnDst = true;
+						break;
+					}
 
-				if (srcConnIsOurs)
-				{
-					pgsql_finish(src);
+					fillBuf = newBuf;
+					fillSize = pendingRowSize;
 				}
 
+				memcpy(fillBuf, pendingRow, pendingRowSize);
+				fillLen = pendingRowSize;
+
+				PQfreemem(pendingRow);
+				pendingRow = NULL;
+			}
+		}
+
+		/*
+		 * Send the current chunk over to the target database, which speaks
+		 * the same COPY protocol, after all.
+		 */
+		if (sendLen > 0)
+		{
+			int ret = PQputCopyData(dstConn, sendBuf, sendLen);
+
+			if (ret == -1)
+			{
+				*failedOnDst = true;
+
+				pgcopy_log_error(dst, NULL, "Failed to copy data to target");
 				break;
 			}
+			else if (ret == 0)
+			{
+				/* libpq buffers are full, wait until the target is ready */
+				waitForDst = true;
+			}
+			else
+			{
+				sendLen = 0;
+			}
 		}
 
-		/* when we've reached the end of COPY from the source, stop here */
-		if (bufsize == -1)
+		/*
+		 * Now push the data we have queued in libpq buffers to the target
+		 * socket: PQflush returns 1 when it could not send everything yet.
+		 */
+		flushStatus = PQflush(dstConn);
+
+		if (flushStatus == -1)
 		{
+			*failedOnDst = true;
+
+			pgcopy_log_error(dst, NULL, "Failed to copy data to target");
 			break;
 		}
-	}
-
-	/*
-	 * The COPY loop is over now.
-	 *
-	 * Time to send end-of-data indication to the server during COPY_IN state.
-	 */
-	if (!failedOnDst)
-	{
-		char *errormsg =
-			failedOnSrc ? "Failed to get data from source" : NULL;
 
-		int res = PQputCopyEnd(dstConn, errormsg);
+		/* we're done when the source is drained and the target flushed */
+		if (doneOnSrc && fillLen == 0 && sendLen == 0 && flushStatus == 0)
+		{
+			break;
+		}
 
-		if (res > 0)
+		/*
+		 * Wait only when no progress can be made right now: either the source
+		 * has no data ready, or the target cannot accept more data.
+		 */
+		if (waitForSrc || waitForDst || (doneOnSrc && flushStatus == 1))
 		{
-			PGresult *res = PQgetResult(dstConn);
+			fd_set input_mask;
+			fd_set output_mask;
 
-			if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			int srcSock = PQsocket(srcConn);
+			int dstSock = PQsocket(dstConn);
+
+			if (srcSock < 0 || dstSock < 0)
 			{
-				pgcopy_log_error(dst, res, "Failed to copy data to target");
+				*failedOnDst = true;
+
+				pgcopy_log_error(dst, NULL, "invalid socket");
+				break;
+			}
+
+			FD_ZERO(&input_mask);
+			FD_ZERO(&output_mask);
+
+			if (waitForSrc)
+			{
+				FD_SET(srcSock, &input_mask);
+			}
+
+			if (waitForDst || flushStatus == 1)
+			{
+				/*
+				 * Per the libpq documentation, after sending any pending data
+				 * also wait for the target socket to become read-ready, then
+				 * consume its input and call PQflush again.
+				 */
+				FD_SET(dstSock, &output_mask);
+				FD_SET(dstSock, &input_mask);
+			}
+
+			int maxSock = srcSock > dstSock ? srcSock : dstSock;
+
+			int r = select(maxSock + 1, &input_mask, &output_mask, NULL, NULL);
+
+			if (r < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else if (r < 0)
+			{
+				*failedOnDst = true;
+
+				pgcopy_log_error(dst, NULL, "select failed: %m");
+				break;
+			}
+
+			if (waitForSrc && FD_ISSET(srcSock, &input_mask))
+			{
+				if (PQconsumeInput(srcConn) == 0)
+				{
+					*failedOnSrc = true;
+
+					pgcopy_log_error(src, NULL,
+									 "Failed to fetch data from source");
+					break;
+				}
+			}
+
+			if (FD_ISSET(dstSock, &input_mask))
+			{
+				if (PQconsumeInput(dstConn) == 0)
+				{
+					*failedOnDst = true;
+
+					pgcopy_log_error(dst, NULL,
+									 "Failed to copy data to target");
+					break;
+				}
 			}
 		}
+	}
 
-		clear_results(dst);
+	if (pendingRow != NULL)
+	{
+		PQfreemem(pendingRow);
+		pendingRow = NULL;
+	}
+
+	free(fillBuf);
+	free(sendBuf);
+
+	/*
+	 * Switch the target connection back to blocking mode, which the rest of
+	 * the COPY termination logic expects (PQputCopyEnd, then commit).
+	 */
+	if (PQsetnonblocking(dstConn, 0) == -1)
+	{
+		*failedOnDst = true;
 
-		if (!pgsql_commit(dst))
-		{
-			failedOnDst = true;
-		}
+		pgcopy_log_error(dst, NULL, "Failed to reset target blocking mode");
 	}
 
-	/* always close the target connection, that we opened in this function */
-	(void) pgsql_finish(dst);
-
-	return !failedOnSrc && !failedOnDst;
+	return !(*failedOnSrc) && !(*failedOnDst);
 }
 
 
@@ -1884,14 +2526,19 @@ pg_copy_end(PGSQL *pgsql)
  */
 static bool
 pg_copy_send_query(PGSQL *pgsql,
-				   const char *qname, ExecStatusType status, bool freeze)
+				   const char *qname, ExecStatusType status,
+				   bool freeze, bool binary)
 {
 	char *sql = NULL;
 
 	if (status == PGRES_COPY_OUT)
 	{
 		/* There is no COPY TO with FREEZE */
-		char *template = "copy %s to stdout";
+		char *template =
+			binary
+			? "copy %s to stdout with (format binary)"
+			: "copy %s to stdout";
+
 		size_t len = strlen(template) + strlen(qname) + 1;
 
 		sql = (char *) calloc(len, sizeof(char));
@@ -1900,10 +2547,22 @@ pg_copy_send_query(PGSQL *pgsql,
 	}
 	else if (status == PGRES_COPY_IN)
 	{
-		char *template =
-			freeze
-			? "copy %s from stdin with (freeze)"
-			: "copy %s from stdin";
+		char *template = NULL;
+
+		if (binary)
+		{
+			template =
+				freeze
+				? "copy %s from stdin with (freeze, format binary)"
+				: "copy %s from stdin with (format binary)";
+		}
+		else
+		{
+			template =
+				freeze
+				? "copy %s from stdin with (freeze)"
+				: "copy %s from stdin";
+		}
 
 		size_t len = strlen(template) + strlen(qname) + 1;
 
@@ -1983,140 +2642,6 @@ pgcopy_log_error(PGSQL *pgsql, PGresult *res, const char *context)
 }
 
 
-/* Context used when fetching metadata for a given sequence */
-typedef struct SourceSequenceContext
-{
-	char sqlstate[SQLSTATE_LENGTH];
-	int64_t lastValue;
-	bool isCalled;
-	bool parsedOk;
-} SourceSequenceContext;
-
-
-/*
- * pgsql_get_sequence queries the Postgres catalog object for the sequence to
- * get the last_value and is_called columns.
- *
- * The connection is expected to be opened and closed from the caller.
- */
-bool
-pgsql_get_sequence(PGSQL *pgsql, const char *nspname, const char *relname,
-				   int64_t *lastValue,
-				   bool *isCalled)
-{
-	SourceSequenceContext context = { 0 };
-
-	char *escapedNspname, *escapedRelname;
-
-	char sql[BUFSIZE] = { 0 };
-
-	PGconn *connection = pgsql->connection;
-
-	/* escape identifiers */
-	escapedNspname = PQescapeIdentifier(connection, nspname, strlen(nspname));
-	if (escapedNspname == NULL)
-	{
-		log_error("Failed to get values from sequence \"%s\".\"%s\": %s",
-				  nspname,
-				  relname,
-				  PQerrorMessage(connection));
-		return false;
-	}
-
-	escapedRelname = PQescapeIdentifier(connection, relname, strlen(relname));
-	if (escapedRelname == NULL)
-	{
-		log_error("Failed to get values from sequence \"%s\".\"%s\": %s",
-				  nspname,
-				  relname,
-				  PQerrorMessage(connection));
-		PQfreemem(escapedNspname);
-		return false;
-	}
-
-	sformat(sql, sizeof(sql), "select last_value, is_called from %s.%s",
-			escapedNspname,
-			escapedRelname);
-
-	if (!pgsql_execute_with_params(pgsql, sql, 0, NULL, NULL,
-								   &context, &getSequenceValue))
-	{
-		log_error("Failed to retrieve current state from the monitor");
-		return false;
-	}
-
-	if (!context.parsedOk)
-	{
-		log_error("Failed to parse current state from the monitor");
-		return false;
-	}
-
-	/* publish values */
-	*lastValue = context.lastValue;
-	*isCalled = context.isCalled;
-
-	return true;
-}
-
-
-/*
- * getSequenceValue parses a single row of the table listing query
- * result.
- */
-static void
-getSequenceValue(void *ctx, PGresult *result)
-{
-	SourceSequenceContext *context = (SourceSequenceContext *) ctx;
-
-	if (PQntuples(result) != 1)
-	{
-		log_error("Query returned %d rows, expected 1", PQntuples(result));
-		context->parsedOk = false;
-		return;
-	}
-
-	if (PQnfields(result) != 2)
-	{
-		log_error("Query returned %d columns, expected 2", PQnfields(result));
-		context->parsedOk = false;
-		return;
-	}
-
-	int errors = 0;
-
-	/* 1. last_value */
-	char *value = PQgetvalue(result, 0, 0);
-
-	if (!stringToInt64(value, &(context->lastValue)))
-	{
-		log_error("Invalid sequence last_value \"%s\"", value);
-		++errors;
-	}
-
-	/* 2. is_called */
-	value = PQgetvalue(result, 0, 1);
-
-	if (value == NULL || ((*value != 't') && (*value != 'f')))
-	{
-		log_error("Invalid is_called value \"%s\"", value);
-		++errors;
-	}
-	else
-	{
-		context->isCalled = (*value) == 't';
-	}
-
-	if (errors > 0)
-	{
-		context->parsedOk = false;
-		return;
-	}
-
-	/* if we reach this line, then we're good. */
-	context->parsedOk = true;
-}
-
-
 typedef struct IdentifySystemResult
 {
 	char sqlstate[6];
@@ -2522,6 +3047,90 @@ pgsql_set_gucs(PGSQL *pgsql, GUC *settings)
 }
 
 
+/*
+ * pgsql_set_session_gucs parses a user-given session settings string in the
+ * form "name=value;name=value" and applies each setting to the current
+ * session with a SET command. The value part is used verbatim in the SET
+ * command, so values that need quoting must be quoted by the caller, as in
+ * "work_mem='512MB';synchronous_commit=off".
+ */
+bool
+pgsql_set_session_gucs(PGSQL *pgsql, const char *gucs)
+{
+	/*
+	 * This only works for already opened connections set-up for multiple
+	 * statements, otherwise after the SET command is done, the setting changes
+	 * would be lost already.
+	 */
+	if (pgsql->connection == NULL)
+	{
+		/* open a multi-statements connection then */
+		pgsql->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+	}
+	else if (pgsql->connectionStatementType != PGSQL_CONNECTION_MULTI_STATEMENT)
+	{
+		log_error("BUG: calling pgsql_set_session_gucs with a "
+				  "non PGSQL_CONNECTION_MULTI_STATEMENT connection");
+		pgsql_finish(pgsql);
+		return false;
+	}
+
+	char buffer[BUFSIZE] = { 0 };
+
+	strlcpy(buffer, gucs, sizeof(buffer));
+
+	char *ptr = buffer;
+
+	while (ptr != NULL && *ptr != '\0')
+	{
+		char *next = strchr(ptr, ';');
+
+		if (next != NULL)
+		{
+			*next++ = '\0';
+		}
+
+		/* skip leading whitespace, and allow a trailing semi-colon */
+		while (*ptr == ' ')
+		{
+			++ptr;
+		}
+
+		if (*ptr == '\0')
+		{
+			ptr = next;
+			continue;
+		}
+
+		char *eq = strchr(ptr, '=');
+
+		if (eq == NULL)
+		{
+			log_error("Failed to parse session GUC setting \"%s\": "
+					  "expected name=value",
+					  ptr);
+			return false;
+		}
+
+		*eq = '\0';
+
+		char sql[BUFSIZE] = { 0 };
+
+		sformat(sql, sizeof(sql), "SET %s TO %s", ptr, eq + 1);
+
+		if (!pgsql_execute(pgsql, sql))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		ptr = next;
+	}
+
+	return true;
+}
+
+
 #define MAX_BLOB_PER_FETCH 1000
 
 typedef struct BlobMetadataArray
@@ -2544,10 +3153,20 @@ void parseBlobMetadataArray(void *ctx, PGresult *result);
  * pg_copy_large_objects copies all large objects found on the src database
  * into the dst database. The copy includes re-using the same OID for the large
  * objects on both sides.
+ *
+ * When blobJobs is more than one, several workers are copying the large
+ * objects concurrently, and each of them only processes its own partition of
+ * pg_largeobject_metadata: the large objects with an OID such that
+ * oid % blobJobs is the given workerIndex.
  */
 bool
 pg_copy_large_objects(PGSQL *src, PGSQL *dst,
-					  bool dropIfExists, uint32_t *count)
+					  bool dropIfExists,
+					  int blobJobs, int workerIndex,
+					  uint32_t startAfterOid,
+					  BlobsCheckpointFun *checkpointFun,
+					  void *checkpointContext,
+					  uint32_t *count)
 {
 	/*
 	 * We need to keep the same connection throughout the operations here.
@@ -2566,9 +3185,30 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 	}
 
 	BlobMetadataArrayContext context = { 0 };
-	char *sql =
-		"DECLARE bloboid CURSOR FOR "
-		"SELECT oid FROM pg_largeobject_metadata ORDER BY 1";
+	char sql[BUFSIZE] = { 0 };
+
+	/*
+	 * The cursor scans the large objects in OID order, and skips the objects
+	 * up to (and including) the checkpointed OID when resuming.
+	 */
+	if (blobJobs > 1)
+	{
+		sformat(sql, sizeof(sql),
+				"DECLARE bloboid CURSOR FOR "
+				"SELECT oid FROM pg_largeobject_metadata "
+				"WHERE oid::bigint %% %d = %d AND oid > %u ORDER BY 1",
+				blobJobs,
+				workerIndex,
+				startAfterOid);
+	}
+	else
+	{
+		sformat(sql, sizeof(sql),
+				"DECLARE bloboid CURSOR FOR "
+				"SELECT oid FROM pg_largeobject_metadata "
+				"WHERE oid > %u ORDER BY 1",
+				startAfterOid);
+	}
 
 	if (!pgsql_execute(src, sql))
 	{
@@ -2770,6 +3410,18 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 			pgsql_finish(src);
 			return false;
 		}
+
+		/*
+		 * The batch is durable on the target database now, checkpoint the
+		 * highest OID of the batch (the cursor is in OID order). A failure
+		 * to checkpoint only loses resume granularity, not data.
+		 */
+		if (checkpointFun != NULL)
+		{
+			uint32_t lastOid = context.array.oids[context.array.count - 1];
+
+			(void) (*checkpointFun)(checkpointContext, lastOid);
+		}
 	}
 
 	*count = totalCount;
@@ -2844,6 +3496,16 @@ pgsql_init_stream(LogicalStreamClient *client,
 	client->fsync_interval = 10 * 1000;          /* 10 sec = default */
 	client->standby_message_timeout = 10 * 1000; /* 10 sec = default */
 
+	/*
+	 * When the stream is idle nothing advances confirmed_flush_lsn on the
+	 * source server but our feedback messages, and a lazy cadence means the
+	 * replication slot retains WAL for longer than necessary. Tighten the
+	 * interval when idle; when busy, feedback piggybacks on flush events
+	 * anyway.
+	 */
+	client->standby_message_timeout_idle = 1 * 1000; /* 1 sec */
+	client->idle = false;
+
 	client->current.written_lsn = InvalidXLogRecPtr;
 	client->current.flushed_lsn = InvalidXLogRecPtr;
 	client->current.applied_lsn = InvalidXLogRecPtr;
@@ -3113,6 +3775,100 @@ pgsql_timestamptz_to_string(TimestampTz ts, char *str, size_t size)
 }
 
 
+/*
+ * pgsql_timestamptz_from_string parses the text representation of a
+ * timestamptz value, such as "2022-02-02 10:00:00.123456+00", into the
+ * number of milliseconds since the Unix epoch. Both the Postgres output
+ * format for the timezone offset ("+00", "+05:30") and the strftime %z
+ * format ("+0000") are supported.
+ */
+bool
+pgsql_timestamptz_from_string(const char *str, uint64_t *epochMs)
+{
+	struct tm tm = { 0 };
+
+	char *ptr = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+
+	if (ptr == NULL)
+	{
+		log_error("Failed to parse timestamp \"%s\"", str);
+		return false;
+	}
+
+	/* the fraction of a second uses anywhere from 0 to 6 digits */
+	uint64_t fraction = 0;
+
+	if (*ptr == '.')
+	{
+		int digits = 0;
+
+		for (++ptr; isdigit((unsigned char) *ptr); ptr++)
+		{
+			if (digits < 6)
+			{
+				fraction = fraction * 10 + (*ptr - '0');
+				++digits;
+			}
+		}
+
+		for (; digits < 6; digits++)
+		{
+			fraction *= 10;
+		}
+	}
+
+	/* then the timezone offset: +HH, +HHMM, or +HH:MM */
+	long offsetSecs = 0;
+
+	if (*ptr == '+' || *ptr == '-')
+	{
+		int sign = *ptr == '-' ? -1 : 1;
+		int hours = 0;
+		int minutes = 0;
+
+		++ptr;
+
+		for (; isdigit((unsigned char) *ptr); ptr++)
+		{
+			hours = hours * 10 + (*ptr - '0');
+		}
+
+		if (*ptr == ':')
+		{
+			++ptr;
+		}
+		else if (hours >= 100)
+		{
+			/* the %z format packs hours and minutes together, as in +0230 */
+			minutes = hours % 100;
+			hours = hours / 100;
+		}
+
+		for (; isdigit((unsigned char) *ptr); ptr++)
+		{
+			minutes = minutes * 10 + (*ptr - '0');
+		}
+
+		offsetSecs = sign * (hours * 3600L + minutes * 60L);
+	}
+
+	/* interpret the broken-down time in UTC, then apply the offset */
+	time_t utc = timegm(&tm);
+
+	if (utc == (time_t) -1)
+	{
+		log_error("Failed to compute epoch for timestamp \"%s\": %m", str);
+		return false;
+	}
+
+	utc -= offsetSecs;
+
+	*epochMs = ((uint64_t) utc) * 1000 + fraction / 1000;
+
+	return true;
+}
+
+
 /*
  * Send the START_REPLICATION logical replication command.
  */
@@ -3277,17 +4033,41 @@ pgsql_stream_logical(LogicalStreamClient *client, LogicalStreamContext *context)
 			}
 
 			client->last_fsync = client->now;
+
+			/*
+			 * Piggyback a feedback message on the flush event when it moved
+			 * the flushed LSN forward, rather than waiting for the status
+			 * interval to expire to report our progress.
+			 */
+			if (client->feedback.flushed_lsn != client->current.flushed_lsn)
+			{
+				client->now = feGetCurrentTimestamp();
+
+				if (!pgsqlSendFeedback(client, context, false, false))
+				{
+					goto error;
+				}
+
+				client->last_status = client->now;
+			}
 		}
 
 		/*
-		 * Potentially send a status message to the primary.
+		 * Potentially send a status message to the primary. When the stream
+		 * is idle, use the tightened interval so that confirmed_flush_lsn
+		 * advances on the source and the slot does not retain WAL.
 		 */
+		int statusInterval =
+			client->idle
+			? client->standby_message_timeout_idle
+			: client->standby_message_timeout;
+
 		client->now = feGetCurrentTimestamp();
 
-		if (client->standby_message_timeout > 0 &&
+		if (statusInterval > 0 &&
 			feTimestampDifferenceExceeds(client->last_status,
 										 client->now,
-										 client->standby_message_timeout))
+										 statusInterval))
 		{
 			/* Time to send feedback! */
 			if (!pgsqlSendFeedback(client, context, true, false))
@@ -3332,11 +4112,11 @@ pgsql_stream_logical(LogicalStreamClient *client, LogicalStreamContext *context)
 			FD_SET(PQsocket(conn), &input_mask);
 
 			/* Compute when we need to wakeup to send a keepalive message. */
-			if (client->standby_message_timeout)
+			if (statusInterval)
 			{
 				message_target =
 					client->last_status +
-					(client->standby_message_timeout - 1) * ((int64) 1000);
+					(statusInterval - 1) * ((int64) 1000);
 			}
 
 			/* Now compute when to wakeup. */
@@ -3370,8 +4150,9 @@ pgsql_stream_logical(LogicalStreamClient *client, LogicalStreamContext *context)
 				/*
 				 * Got a timeout or signal. Continue the loop and either
 				 * deliver a status packet to the server or just go back into
-				 * blocking.
+				 * blocking. A timeout here means the stream is idle.
 				 */
+				client->idle = (r == 0);
 				continue;
 			}
 			else if (r < 0)
@@ -3408,6 +4189,8 @@ pgsql_stream_logical(LogicalStreamClient *client, LogicalStreamContext *context)
 		/* Check the message type. */
 		if (copybuf[0] == 'k')
 		{
+			/* server keepalives only flow when there's no data to send */
+			client->idle = true;
 			int pos;
 			bool replyRequested;
 			XLogRecPtr walEnd;
@@ -3504,6 +4287,9 @@ pgsql_stream_logical(LogicalStreamClient *client, LogicalStreamContext *context)
 			goto error;
 		}
 
+		/* receiving XLogData means the stream is busy again */
+		client->idle = false;
+
 		/* Extract WAL location for this block */
 		cur_record_lsn = fe_recvint64(&copybuf[1]);
 
@@ -4343,7 +5129,9 @@ pgsql_role_exists(PGSQL *pgsql, const char *roleName, bool *exists)
 bool
 pgsql_update_sentinel_startpos(PGSQL *pgsql, uint64_t startpos)
 {
-	char *update = "update pgcopydb.sentinel set startpos = $1";
+	char *update =
+		"update pgcopydb.sentinel set startpos = $1 "
+		"returning pg_notify('" PGCOPYDB_SENTINEL_CHANNEL "', 'startpos')";
 
 	char startLSN[PG_LSN_MAXLENGTH] = { 0 };
 
@@ -4374,7 +5162,9 @@ pgsql_update_sentinel_endpos(PGSQL *pgsql, bool current, uint64_t endpos)
 {
 	if (current)
 	{
-		char *updateTmpl = "update pgcopydb.sentinel set endpos = %s()";
+		char *updateTmpl =
+			"update pgcopydb.sentinel set endpos = %s() "
+			"returning pg_notify('" PGCOPYDB_SENTINEL_CHANNEL "', 'endpos')";
 		char update[BUFSIZE] = { 0 };
 		char *fn = "pg_current_wal_flush_lsn";
 
@@ -4401,7 +5191,9 @@ pgsql_update_sentinel_endpos(PGSQL *pgsql, bool current, uint64_t endpos)
 	else
 	{
 		/* use endpos parameter */
-		char *update = "update pgcopydb.sentinel set endpos = $1";
+		char *update =
+			"update pgcopydb.sentinel set endpos = $1 "
+			"returning pg_notify('" PGCOPYDB_SENTINEL_CHANNEL "', 'endpos')";
 
 		char endLSN[PG_LSN_MAXLENGTH] = { 0 };
 
@@ -4431,7 +5223,9 @@ pgsql_update_sentinel_endpos(PGSQL *pgsql, bool current, uint64_t endpos)
 bool
 pgsql_update_sentinel_apply(PGSQL *pgsql, bool apply)
 {
-	char *update = "update pgcopydb.sentinel set apply = $1";
+	char *update =
+		"update pgcopydb.sentinel set apply = $1 "
+		"returning pg_notify('" PGCOPYDB_SENTINEL_CHANNEL "', 'apply')";
 
 	int paramCount = 1;
 	Oid paramTypes[1] = { BOOLOID };
@@ -4468,6 +5262,8 @@ typedef struct SentinelContext
 	uint64_t startpos;
 	uint64_t endpos;
 
+	CopyDBApplyLag lag;
+
 	uint64_t write_lsn;
 	uint64_t flush_lsn;
 	uint64_t replay_lsn;
@@ -4486,7 +5282,8 @@ pgsql_get_sentinel(PGSQL *pgsql, CopyDBSentinel *sentinel)
 	SentinelContext context = { 0 };
 
 	char *sql =
-		"select startpos, endpos, apply, write_lsn, flush_lsn, replay_lsn "
+		"select startpos, endpos, apply, write_lsn, flush_lsn, replay_lsn, "
+		"       apply_lag_p50, apply_lag_p95, apply_lag_p99, apply_lag_txns "
 		"  from pgcopydb.sentinel";
 
 	if (!pgsql_execute_with_params(pgsql, sql, 0, NULL, NULL,
@@ -4510,6 +5307,8 @@ pgsql_get_sentinel(PGSQL *pgsql, CopyDBSentinel *sentinel)
 	sentinel->flush_lsn = context.flush_lsn;
 	sentinel->replay_lsn = context.replay_lsn;
 
+	sentinel->lag = context.lag;
+
 	return true;
 }
 
@@ -4529,7 +5328,8 @@ pgsql_sync_sentinel_recv(PGSQL *pgsql,
 	char *sql =
 		"update pgcopydb.sentinel "
 		"set write_lsn = $1, flush_lsn = $2 "
-		"returning startpos, endpos, apply, write_lsn, flush_lsn, replay_lsn";
+		"returning startpos, endpos, apply, write_lsn, flush_lsn, replay_lsn, "
+		"          apply_lag_p50, apply_lag_p95, apply_lag_p99, apply_lag_txns";
 
 	char writeLSN[PG_LSN_MAXLENGTH] = { 0 };
 	char flushLSN[PG_LSN_MAXLENGTH] = { 0 };
@@ -4563,33 +5363,48 @@ pgsql_sync_sentinel_recv(PGSQL *pgsql,
 	sentinel->flush_lsn = context.flush_lsn;
 	sentinel->replay_lsn = context.replay_lsn;
 
+	sentinel->lag = context.lag;
+
 	return true;
 }
 
 
 /*
  * pgsql_sync_sentinel_apply updates the current sentinel values for
- * replay_lsn, and fetches the current value for endpos and apply.
+ * replay_lsn and the end-to-end apply lag percentiles, and fetches the
+ * current value for endpos and apply.
  */
 bool
 pgsql_sync_sentinel_apply(PGSQL *pgsql,
 						  uint64_t replay_lsn,
+						  CopyDBApplyLag *lag,
 						  CopyDBSentinel *sentinel)
 {
 	SentinelContext context = { 0 };
 
 	char *sql =
 		"update pgcopydb.sentinel "
-		"set replay_lsn = $1 "
-		"returning startpos, endpos, apply, write_lsn, flush_lsn, replay_lsn";
+		"set replay_lsn = $1, "
+		"    apply_lag_p50 = $2, apply_lag_p95 = $3, "
+		"    apply_lag_p99 = $4, apply_lag_txns = $5 "
+		"returning startpos, endpos, apply, write_lsn, flush_lsn, replay_lsn, "
+		"          apply_lag_p50, apply_lag_p95, apply_lag_p99, apply_lag_txns";
 
 	char replayLSN[PG_LSN_MAXLENGTH] = { 0 };
+	char lagP50[INTSTRING_MAX_DIGITS] = { 0 };
+	char lagP95[INTSTRING_MAX_DIGITS] = { 0 };
+	char lagP99[INTSTRING_MAX_DIGITS] = { 0 };
+	char lagTxns[INTSTRING_MAX_DIGITS] = { 0 };
 
 	sformat(replayLSN, sizeof(replayLSN), "%X/%X", LSN_FORMAT_ARGS(replay_lsn));
+	sformat(lagP50, sizeof(lagP50), "%lld", (long long) lag->p50);
+	sformat(lagP95, sizeof(lagP95), "%lld", (long long) lag->p95);
+	sformat(lagP99, sizeof(lagP99), "%lld", (long long) lag->p99);
+	sformat(lagTxns, sizeof(lagTxns), "%lld", (long long) lag->txns);
 
-	int paramCount = 1;
-	Oid paramTypes[1] = { LSNOID };
-	const char *paramValues[1] = { replayLSN };
+	int paramCount = 5;
+	Oid paramTypes[5] = { LSNOID, INT8OID, INT8OID, INT8OID, INT8OID };
+	const char *paramValues[5] = { replayLSN, lagP50, lagP95, lagP99, lagTxns };
 
 	if (!pgsql_execute_with_params(pgsql, sql,
 								   paramCount, paramTypes, paramValues,
@@ -4613,6 +5428,8 @@ pgsql_sync_sentinel_apply(PGSQL *pgsql,
 	sentinel->flush_lsn = context.flush_lsn;
 	sentinel->replay_lsn = context.replay_lsn;
 
+	sentinel->lag = context.lag;
+
 	return true;
 }
 
@@ -4626,9 +5443,9 @@ parseSentinel(void *ctx, PGresult *result)
 {
 	SentinelContext *context = (SentinelContext *) ctx;
 
-	if (PQnfields(result) != 6)
+	if (PQnfields(result) != 10)
 	{
-		log_error("Query returned %d columns, expected 6", PQnfields(result));
+		log_error("Query returned %d columns, expected 10", PQnfields(result));
 		context->parsedOK = false;
 		return;
 	}
@@ -4688,5 +5505,23 @@ parseSentinel(void *ctx, PGresult *result)
 		context->parsedOK = false;
 	}
 
+	uint64_t *lagValues[4] = {
+		&(context->lag.p50),
+		&(context->lag.p95),
+		&(context->lag.p99),
+		&(context->lag.txns)
+	};
+
+	for (int i = 0; i < 4; i++)
+	{
+		value = PQgetvalue(result, 0, 6 + i);
+
+		if (!stringToUInt64(value, lagValues[i]))
+		{
+			log_error("Failed to parse sentinel apply lag value \"%s\"", value);
+			context->parsedOK = false;
+		}
+	}
+
 	context->parsedOK = true;
 }
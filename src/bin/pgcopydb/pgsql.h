@@ -33,8 +33,13 @@
 #define INT4OID 23
 #define INT8OID 20
 #define TEXTOID 25
+#define OIDOID 26
 #define LSNOID 3220
 
+#define BOOLARRAYOID 1000
+#define NAMEARRAYOID 1003
+#define INT8ARRAYOID 1016
+
 #define FLOAT4OID 700
 #define FLOAT8OID 701
 
@@ -261,6 +266,20 @@ bool pgsql_execute_with_params(PGSQL *pgsql, const char *sql, int paramCount,
 							   const Oid *paramTypes, const char **paramValues,
 							   void *parseContext, ParsePostgresResultCB *parseFun);
 
+/*
+ * To batch several queries in a single network round trip thanks to the
+ * libpq pipeline mode, prepare an array of PipelineQuery entries, each with
+ * its own parse context and callback, same as pgsql_execute_with_params.
+ */
+typedef struct PipelineQuery
+{
+	const char *sql;
+	void *parseContext;
+	ParsePostgresResultCB *parseFun;
+} PipelineQuery;
+
+bool pgsql_execute_pipeline(PGSQL *pgsql, PipelineQuery *queries, int count);
+
 void pgAutoCtlDebugNoticeProcessor(void *arg, const char *message);
 
 bool hostname_from_uri(const char *pguri,
@@ -270,20 +289,32 @@ bool validate_connection_string(const char *connectionString);
 bool pgsql_truncate(PGSQL *pgsql, const char *qname);
 
 bool pg_copy(PGSQL *src, PGSQL *dst,
-			 const char *srcQname, const char *dstQname, bool truncate);
+			 const char *srcQname, const char *dstQname,
+			 bool truncate, bool binary,
+			 uint64_t *bytesTransmitted, uint64_t *rowsTransmitted);
 
 bool pg_copy_from_stdin(PGSQL *pgsql, const char *qname);
 bool pg_copy_row_from_stdin(PGSQL *pgsql, char *fmt, ...);
 bool pg_copy_end(PGSQL *pgsql);
 
-bool pgsql_get_sequence(PGSQL *pgsql, const char *nspname, const char *relname,
-						int64_t *lastValue,
-						bool *isCalled);
 
 bool pgsql_set_gucs(PGSQL *pgsql, GUC *settings);
+bool pgsql_set_session_gucs(PGSQL *pgsql, const char *gucs);
+
+/*
+ * pg_copy_large_objects calls the checkpoint function after each committed
+ * batch of large objects, with the highest OID of the batch, so that the
+ * caller can persist its progress and resume from there after a crash.
+ */
+typedef bool (BlobsCheckpointFun)(void *context, uint32_t lastOid);
 
 bool pg_copy_large_objects(PGSQL *src, PGSQL *dst,
-						   bool dropIfExists, uint32_t *count);
+						   bool dropIfExists,
+						   int blobJobs, int workerIndex,
+						   uint32_t startAfterOid,
+						   BlobsCheckpointFun *checkpointFun,
+						   void *checkpointContext,
+						   uint32_t *count);
 
 /*
  * Maximum length of serialized pg_lsn value
@@ -414,6 +445,8 @@ typedef struct LogicalStreamClient
 
 	int fsync_interval;
 	int standby_message_timeout;
+	int standby_message_timeout_idle;
+	bool idle;                  /* no XLogData received since last wakeup */
 } LogicalStreamClient;
 
 
@@ -434,6 +467,7 @@ bool pgsql_create_logical_replication_slot(LogicalStreamClient *client,
 										   size_t size);
 
 bool pgsql_timestamptz_to_string(TimestampTz ts, char *str, size_t size);
+bool pgsql_timestamptz_from_string(const char *str, uint64_t *epochMs);
 
 bool pgsql_start_replication(LogicalStreamClient *client);
 bool pgsql_stream_logical(LogicalStreamClient *client,
@@ -475,11 +509,37 @@ bool pgsql_drop_replication_slot(PGSQL *pgsql, const char *slotName);
 bool pgsql_role_exists(PGSQL *pgsql, const char *roleName, bool *exists);
 
 
+bool pgsql_listen(PGSQL *pgsql, char *channel);
+
+bool pgsql_wait_for_notification(PGSQL *pgsql,
+								 char *channel,
+								 int timeoutMs,
+								 bool *received);
+
 /*
  * pgcopydb sentinel is a table that's created on the source database and
  * allows communicating elements from the outside, and in between the receive
  * and apply processes.
+ *
+ * Changes made to the sentinel table are also broadcast on the following
+ * NOTIFY channel, so that processes waiting on the sentinel can react as soon
+ * as a new value has been committed, rather than at their next polling
+ * interval.
+ */
+#define PGCOPYDB_SENTINEL_CHANNEL "pgcopydb_sentinel"
+
+/*
+ * End-to-end apply lag (source commit to target commit) percentiles, in
+ * milliseconds, as measured by the apply process.
  */
+typedef struct CopyDBApplyLag
+{
+	uint64_t p50;
+	uint64_t p95;
+	uint64_t p99;
+	uint64_t txns;
+} CopyDBApplyLag;
+
 typedef struct CopyDBSentinel
 {
 	bool apply;
@@ -488,6 +548,7 @@ typedef struct CopyDBSentinel
 	uint64_t write_lsn;
 	uint64_t flush_lsn;
 	uint64_t replay_lsn;
+	CopyDBApplyLag lag;
 } CopyDBSentinel;
 
 bool pgsql_update_sentinel_startpos(PGSQL *pgsql, uint64_t startpos);
@@ -503,6 +564,7 @@ bool pgsql_sync_sentinel_recv(PGSQL *pgsql,
 
 bool pgsql_sync_sentinel_apply(PGSQL *pgsql,
 							   uint64_t replay_lsn,
+							   CopyDBApplyLag *lag,
 							   CopyDBSentinel *sentinel);
 
 #endif /* PGSQL_H */
@@ -14,6 +14,7 @@
 #include "copydb.h"
 #include "env_utils.h"
 #include "log.h"
+#include "mem_utils.h"
 #include "parsing_utils.h"
 #include "pidfile.h"
 #include "progress.h"
@@ -30,17 +31,6 @@ static bool copydb_filtering_as_json(CopyDataSpec *copySpecs,
 									 JSON_Object *jsobj,
 									 const char *key);
 
-static bool copydb_table_array_as_json(SourceTableArray *tableArray,
-									   JSON_Object *jsobj,
-									   const char *key);
-
-static bool copydb_index_array_as_json(SourceIndexArray *indexArray,
-									   JSON_Object *jsobj,
-									   const char *key);
-
-static bool copydb_seq_array_as_json(SourceSequenceArray *sequenceArray,
-									 JSON_Object *jsobj,
-									 const char *key);
 
 /*
  * copydb_prepare_schema_json_file prepares a JSON formatted file that contains
@@ -269,7 +259,7 @@ copydb_filtering_as_json(CopyDataSpec *copySpecs,
  * copydb_table_array_as_json prepares the given tableArray as a JSON array of
  * objects within the given JSON_Value.
  */
-static bool
+bool
 copydb_table_array_as_json(SourceTableArray *tableArray,
 						   JSON_Object *jsobj,
 						   const char *key)
@@ -353,7 +343,7 @@ copydb_table_array_as_json(SourceTableArray *tableArray,
  * copydb_index_array_as_json prepares the given indexArray as a JSON array of
  * objects within the given JSON_Value.
  */
-static bool
+bool
 copydb_index_array_as_json(SourceIndexArray *indexArray,
 						   JSON_Object *jsobj,
 						   const char *key)
@@ -432,7 +422,7 @@ copydb_index_array_as_json(SourceIndexArray *indexArray,
  * copydb_seq_array_as_json prepares the given sequencesArray as a JSON array
  * of objects within the given JSON_Value.
  */
-static bool
+bool
 copydb_seq_array_as_json(SourceSequenceArray *sequenceArray,
 						 JSON_Object *jsobj,
 						 const char *key)
@@ -468,6 +458,44 @@ copydb_seq_array_as_json(SourceSequenceArray *sequenceArray,
 }
 
 
+/*
+ * copydb_depend_array_as_json prepares the given dependArray as a JSON array
+ * of objects within the given JSON_Value.
+ */
+bool
+copydb_depend_array_as_json(SourceDependArray *dependArray,
+							JSON_Object *jsobj,
+							const char *key)
+{
+	JSON_Value *jsDepends = json_value_init_array();
+	JSON_Array *jsDependArray = json_value_get_array(jsDepends);
+
+	for (int dependIndex = 0; dependIndex < dependArray->count; dependIndex++)
+	{
+		SourceDepend *depend = &(dependArray->array[dependIndex]);
+
+		JSON_Value *jsDepend = json_value_init_object();
+		JSON_Object *jsDependObj = json_value_get_object(jsDepend);
+
+		json_object_set_string(jsDependObj, "schema", depend->nspname);
+		json_object_set_string(jsDependObj, "name", depend->relname);
+
+		json_object_set_number(jsDependObj, "classid", (double) depend->classid);
+		json_object_set_number(jsDependObj, "objid", (double) depend->objid);
+
+		json_object_set_string(jsDependObj, "type", depend->type);
+		json_object_set_string(jsDependObj, "identity", depend->identity);
+
+		json_array_append_value(jsDependArray, jsDepend);
+	}
+
+	/* attach the JSON array to the main JSON object under the provided key */
+	json_object_set_value(jsobj, key, jsDepends);
+
+	return true;
+}
+
+
 /*
  * copydb_parse_schema_json_file parses the JSON file prepared with
  * copydb_prepare_schema_json_file and fills-in the given CopyDataSpec
@@ -509,7 +537,8 @@ copydb_parse_schema_json_file(CopyDataSpec *copySpecs)
 
 	copySpecs->sourceTableArray.count = tableCount;
 	copySpecs->sourceTableArray.array =
-		(SourceTable *) calloc(tableCount, sizeof(SourceTable));
+		(SourceTable *) arena_alloc(&(copySpecs->sourceTableArray.arena),
+									tableCount * sizeof(SourceTable));
 
 	if (copySpecs->sourceTableArray.array == NULL)
 	{
@@ -586,7 +615,8 @@ copydb_parse_schema_json_file(CopyDataSpec *copySpecs)
 
 	copySpecs->sourceIndexArray.count = indexCount;
 	copySpecs->sourceIndexArray.array =
-		(SourceIndex *) calloc(indexCount, sizeof(SourceIndex));
+		(SourceIndex *) arena_alloc(&(copySpecs->sourceIndexArray.arena),
+									indexCount * sizeof(SourceIndex));
 
 	if (copySpecs->sourceIndexArray.array == NULL)
 	{
@@ -677,13 +707,32 @@ copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress)
 			  progress->tableCount,
 			  progress->indexCount);
 
+	/*
+	 * When the live progress counters shared memory segment is around (the
+	 * main pgcopydb command is running, or has just finished), read the
+	 * counters directly rather than scanning the work directory files, which
+	 * gets expensive with lots of tables.
+	 */
+	if (copySpecs->progress != NULL)
+	{
+		CopyProgressCounters *counters = copySpecs->progress;
+
+		progress->tableDoneCount = counters->tableDoneCount;
+		progress->tableBytesDone = counters->tableBytesDone;
+		progress->indexDoneCount = counters->indexDoneCount;
+
+		return true;
+	}
+
 	/* count table in progress, table done */
 	progress->tableDoneCount = 0;
 	progress->tableInProgress.count = 0;
 
 	/* we can't have more table in progress than tableJobs */
 	progress->tableInProgress.array =
-		(SourceTable *) calloc(copySpecs->tableJobs, sizeof(SourceTable));
+		(SourceTable *) arena_alloc(&(progress->tableInProgress.arena),
+									copySpecs->tableJobs *
+									sizeof(SourceTable));
 
 	progress->tableSummaryArray.count = 0;
 	progress->tableSummaryArray.array =
@@ -797,7 +846,9 @@ copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress)
 
 	/* we can't have more index in progress than indexJobs */
 	progress->indexInProgress.array =
-		(SourceIndex *) calloc(copySpecs->indexJobs, sizeof(SourceIndex));
+		(SourceIndex *) arena_alloc(&(progress->indexInProgress.arena),
+									copySpecs->indexJobs *
+									sizeof(SourceIndex));
 
 	progress->indexSummaryArray.count = 0;
 	progress->indexSummaryArray.array =
@@ -850,6 +901,9 @@ copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress)
 		}
 	}
 
+	/* the index file paths are local to this scan */
+	free(indexPathsArray.array);
+
 	return true;
 }
 
@@ -874,6 +928,7 @@ copydb_progress_as_json(CopyDataSpec *copySpecs,
 
 	json_object_set_number(jsTableObj, "total", progress->tableCount);
 	json_object_set_number(jsTableObj, "done", progress->tableDoneCount);
+	json_object_set_number(jsTableObj, "bytes-done", progress->tableBytesDone);
 
 	/* in-progress */
 	SourceTableArray *tableArray = &(progress->tableInProgress);
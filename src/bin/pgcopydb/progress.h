@@ -31,6 +31,7 @@ typedef struct CopyProgress
 {
 	int tableCount;
 	int tableDoneCount;
+	uint64_t tableBytesDone;
 	SourceTableArray tableInProgress;
 	CopyTableSummaryArray tableSummaryArray;
 
@@ -41,6 +42,22 @@ typedef struct CopyProgress
 } CopyProgress;
 
 
+bool copydb_table_array_as_json(SourceTableArray *tableArray,
+								JSON_Object *jsobj,
+								const char *key);
+
+bool copydb_index_array_as_json(SourceIndexArray *indexArray,
+								JSON_Object *jsobj,
+								const char *key);
+
+bool copydb_seq_array_as_json(SourceSequenceArray *sequenceArray,
+							  JSON_Object *jsobj,
+							  const char *key);
+
+bool copydb_depend_array_as_json(SourceDependArray *dependArray,
+								 JSON_Object *jsobj,
+								 const char *key);
+
 bool copydb_prepare_schema_json_file(CopyDataSpec *copySpecs);
 bool copydb_parse_schema_json_file(CopyDataSpec *copySpecs);
 bool copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress);
@@ -1,6 +1,13 @@
 /*
  * src/bin/pgcopydb/queue_utils.c
  *   Utility functions for inter-process queueing
+ *
+ * Queues used to be SysV message queues. Those impose small system-wide
+ * depth limits, and the IPC_NOWAIT plus sleep-retry loops needed to check
+ * our signal flags added syscall overhead and sleep latency to every
+ * table/index/vacuum handoff. Queues are now ring buffers hosted in shared
+ * memory, with a SysV semaphore set for mutual exclusion and for blocking
+ * on an empty (or full) queue directly in the kernel.
  */
 
 #include <errno.h>
@@ -9,7 +16,7 @@
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
-#include <sys/msg.h>
+#include <sys/sem.h>
 #include <unistd.h>
 
 #include "defaults.h"
@@ -17,23 +24,88 @@
 #include "queue_utils.h"
 #include "signals.h"
 
+/*
+ * See man semctl(2)
+ */
+#if defined(__linux__)
+union semun
+{
+	int val;
+	struct semid_ds *buf;
+	unsigned short *array;
+};
+#endif
+
+/* semaphore numbers in a queue semaphore set */
+#define QUEUE_SEM_MUTEX 0
+#define QUEUE_SEM_ITEMS 1
+#define QUEUE_SEM_SLOTS 2
+
+/* SysV semaphore values are limited to SEMVMX, typically 32767 */
+#define QUEUE_MAX_CAPACITY 32767
+
+static bool queue_sem_wait(Queue *queue, int semNum);
+static bool queue_sem_trywait(Queue *queue, int semNum);
+static bool queue_sem_post_n(Queue *queue, int semNum, int count);
+
 
 /*
- * queue_create creates a new message queue.
+ * queue_create creates a new message queue with room for the given number of
+ * messages. A capacity of zero (or more than the SysV semaphore value limit)
+ * asks for the maximum capacity; senders block when the queue is full, so
+ * the capacity is only a buffering knob, not a correctness limit.
  */
 bool
-queue_create(Queue *queue)
+queue_create(Queue *queue, int capacity)
 {
+	if (capacity <= 0 || capacity > QUEUE_MAX_CAPACITY)
+	{
+		capacity = QUEUE_MAX_CAPACITY;
+	}
+
 	queue->owner = getpid();
-	queue->qId = msgget(IPC_PRIVATE, 0600);
 
-	if (queue->qId < 0)
+	size_t size = sizeof(QueueRing) + capacity * sizeof(QMessage);
+
+	if (!shmseg_create(&(queue->segment), size))
 	{
-		log_fatal("Failed to create message queue: %m");
+		log_fatal("Failed to create message queue shared memory segment");
 		return false;
 	}
 
-	log_trace("Created message queue %d", queue->qId);
+	queue->ring = (QueueRing *) queue->segment.ptr;
+	queue->ring->capacity = capacity;
+
+	queue->qId = queue->segment.shmId;
+
+	queue->semId = semget(IPC_PRIVATE, 3, 0600);
+
+	if (queue->semId < 0)
+	{
+		log_fatal("Failed to create message queue semaphores: %m");
+		return false;
+	}
+
+	unsigned short values[3] = { 0 };
+
+	values[QUEUE_SEM_MUTEX] = 1;
+	values[QUEUE_SEM_ITEMS] = 0;
+	values[QUEUE_SEM_SLOTS] = capacity;
+
+	union semun semun;
+
+	semun.array = values;
+
+	if (semctl(queue->semId, 0, SETALL, semun) < 0)
+	{
+		log_fatal("Failed to initialize message queue semaphores %d: %m",
+				  queue->semId);
+		return false;
+	}
+
+	log_trace("Created message queue %d (capacity %d)",
+			  queue->qId,
+			  capacity);
 
 	return true;
 }
@@ -45,52 +117,171 @@ queue_create(Queue *queue)
 bool
 queue_unlink(Queue *queue)
 {
-	log_trace("iprm -q %d", queue->qId);
+	union semun semun;
 
-	if (msgctl(queue->qId, IPC_RMID, NULL) != 0)
+	semun.val = 0;              /* unused, but keep compiler quiet */
+
+	log_trace("ipcrm -s %d", queue->semId);
+
+	if (semctl(queue->semId, 0, IPC_RMID, semun) != 0)
 	{
-		log_error("Failed to delete message queue %d: %m", queue->qId);
+		log_error("Failed to delete message queue semaphores %d: %m",
+				  queue->semId);
 		return false;
 	}
 
-	return true;
+	/* the shared memory segment is already marked for removal */
+	return shmseg_detach(&(queue->segment));
 }
 
 
 /*
- * queue_send sends a message on the queue.
+ * queue_send sends a message on the queue, blocking when the queue is full.
  */
 bool
 queue_send(Queue *queue, QMessage *msg)
 {
-	int errStatus;
-	bool firstLoop = true;
+	/* wait for an empty slot in the ring */
+	if (!queue_sem_wait(queue, QUEUE_SEM_SLOTS))
+	{
+		return false;
+	}
 
-	do {
-		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
+	if (!queue_sem_wait(queue, QUEUE_SEM_MUTEX))
+	{
+		/* give the slot back, we did not use it */
+		(void) queue_sem_post_n(queue, QUEUE_SEM_SLOTS, 1);
+		return false;
+	}
+
+	QueueRing *ring = queue->ring;
+
+	ring->messages[ring->tail] = *msg;
+	ring->tail = (ring->tail + 1) % ring->capacity;
+
+	(void) queue_sem_post_n(queue, QUEUE_SEM_MUTEX, 1);
+
+	return queue_sem_post_n(queue, QUEUE_SEM_ITEMS, 1);
+}
+
+
+/*
+ * queue_receive receives a message from the queue, blocking when the queue
+ * is empty.
+ */
+bool
+queue_receive(Queue *queue, QMessage *msg)
+{
+	/* wait for a message to be available in the ring */
+	if (!queue_sem_wait(queue, QUEUE_SEM_ITEMS))
+	{
+		return false;
+	}
+
+	if (!queue_sem_wait(queue, QUEUE_SEM_MUTEX))
+	{
+		/* leave the message in place for another consumer */
+		(void) queue_sem_post_n(queue, QUEUE_SEM_ITEMS, 1);
+		return false;
+	}
+
+	QueueRing *ring = queue->ring;
+
+	*msg = ring->messages[ring->head];
+	ring->head = (ring->head + 1) % ring->capacity;
+
+	(void) queue_sem_post_n(queue, QUEUE_SEM_MUTEX, 1);
+
+	return queue_sem_post_n(queue, QUEUE_SEM_SLOTS, 1);
+}
+
+
+/*
+ * queue_receive_nowait receives a message from the queue when one is
+ * immediately available, and sets *received to false rather than blocking
+ * when the queue is empty.
+ */
+bool
+queue_receive_nowait(Queue *queue, QMessage *msg, bool *received)
+{
+	*received = false;
+
+	/* grab a message when one is available, don't wait for one */
+	if (!queue_sem_trywait(queue, QUEUE_SEM_ITEMS))
+	{
+		return true;
+	}
+
+	if (!queue_sem_wait(queue, QUEUE_SEM_MUTEX))
+	{
+		/* leave the message in place for another consumer */
+		(void) queue_sem_post_n(queue, QUEUE_SEM_ITEMS, 1);
+		return false;
+	}
+
+	QueueRing *ring = queue->ring;
+
+	*msg = ring->messages[ring->head];
+	ring->head = (ring->head + 1) % ring->capacity;
+
+	(void) queue_sem_post_n(queue, QUEUE_SEM_MUTEX, 1);
+
+	*received = true;
+
+	return queue_sem_post_n(queue, QUEUE_SEM_SLOTS, 1);
+}
+
+
+/*
+ * queue_send_batch sends count messages on the queue, blocking as needed
+ * when the queue is full, and grabbing as many slots as possible in one go
+ * to amortize the per-message system calls.
+ */
+bool
+queue_send_batch(Queue *queue, QMessage *msgs, int count)
+{
+	int sent = 0;
+
+	while (sent < count)
+	{
+		/* wait for at least one empty slot in the ring */
+		if (!queue_sem_wait(queue, QUEUE_SEM_SLOTS))
 		{
 			return false;
 		}
 
-		if (firstLoop)
+		int taken = 1;
+
+		/* then opportunistically grab more slots, without blocking */
+		while (sent + taken < count &&
+			   queue_sem_trywait(queue, QUEUE_SEM_SLOTS))
 		{
-			firstLoop = false;
+			++taken;
 		}
-		else
+
+		if (!queue_sem_wait(queue, QUEUE_SEM_MUTEX))
 		{
-			pg_usleep(10 * 1000); /* 10 ms */
+			/* give the slots back, we did not use them */
+			(void) queue_sem_post_n(queue, QUEUE_SEM_SLOTS, taken);
+			return false;
 		}
 
-		errStatus = msgsnd(queue->qId, msg, sizeof(QMessage), IPC_NOWAIT);
-	} while (errStatus < 0 && (errno == EINTR || errno == EAGAIN));
+		QueueRing *ring = queue->ring;
 
-	if (errStatus < 0)
-	{
-		log_error("Failed to send a message to queue %d "
-				  "with type %ld: %m",
-				  queue->qId,
-				  msg->type);
-		return false;
+		for (int i = 0; i < taken; i++)
+		{
+			ring->messages[ring->tail] = msgs[sent + i];
+			ring->tail = (ring->tail + 1) % ring->capacity;
+		}
+
+		(void) queue_sem_post_n(queue, QUEUE_SEM_MUTEX, 1);
+
+		if (!queue_sem_post_n(queue, QUEUE_SEM_ITEMS, taken))
+		{
+			return false;
+		}
+
+		sent += taken;
 	}
 
 	return true;
@@ -98,13 +289,78 @@ queue_send(Queue *queue, QMessage *msg)
 
 
 /*
- * queue_receive receives a message from the queue.
+ * queue_receive_batch receives up to *count messages from the queue, in a
+ * single critical section. The call blocks until at least one message is
+ * available, then drains as many messages as possible without blocking, and
+ * sets *count to the number of messages received.
  */
 bool
-queue_receive(Queue *queue, QMessage *msg)
+queue_receive_batch(Queue *queue, QMessage *msgs, int *count)
+{
+	int max = *count;
+
+	*count = 0;
+
+	if (max <= 0)
+	{
+		return true;
+	}
+
+	/* wait for a message to be available in the ring */
+	if (!queue_sem_wait(queue, QUEUE_SEM_ITEMS))
+	{
+		return false;
+	}
+
+	int taken = 1;
+
+	/* then opportunistically drain more messages, without blocking */
+	while (taken < max && queue_sem_trywait(queue, QUEUE_SEM_ITEMS))
+	{
+		++taken;
+	}
+
+	if (!queue_sem_wait(queue, QUEUE_SEM_MUTEX))
+	{
+		/* leave the messages in place for another consumer */
+		(void) queue_sem_post_n(queue, QUEUE_SEM_ITEMS, taken);
+		return false;
+	}
+
+	QueueRing *ring = queue->ring;
+
+	for (int i = 0; i < taken; i++)
+	{
+		msgs[i] = ring->messages[ring->head];
+		ring->head = (ring->head + 1) % ring->capacity;
+	}
+
+	(void) queue_sem_post_n(queue, QUEUE_SEM_MUTEX, 1);
+
+	*count = taken;
+
+	return queue_sem_post_n(queue, QUEUE_SEM_SLOTS, taken);
+}
+
+
+/*
+ * queue_sem_wait decrements the given semaphore of the queue semaphore set,
+ * blocking in the kernel until the operation is possible.
+ *
+ * semop(2) is never automatically restarted after being interrupted by a
+ * signal handler, so our signal flags are checked when a signal is
+ * delivered, and we stop waiting then, same as the previous message queue
+ * implementation.
+ */
+static bool
+queue_sem_wait(Queue *queue, int semNum)
 {
 	int errStatus;
-	bool firstLoop = true;
+	struct sembuf sops;
+
+	sops.sem_op = -1;           /* decrement */
+	sops.sem_flg = 0;
+	sops.sem_num = semNum;
 
 	do {
 		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
@@ -112,23 +368,89 @@ queue_receive(Queue *queue, QMessage *msg)
 			return false;
 		}
 
-		if (firstLoop)
-		{
-			firstLoop = false;
-		}
-		else
-		{
-			pg_usleep(10 * 1000); /* 10 ms */
-		}
+		errStatus = semop(queue->semId, &sops, 1);
+	} while (errStatus < 0 && errno == EINTR);
+
+	if (errStatus < 0)
+	{
+		log_error("Failed to wait on message queue semaphore %d: %m",
+				  queue->semId);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * queue_sem_trywait decrements the given semaphore of the queue semaphore
+ * set when that is possible without blocking, and returns false otherwise.
+ */
+static bool
+queue_sem_trywait(Queue *queue, int semNum)
+{
+	int errStatus;
+	struct sembuf sops;
+
+	sops.sem_op = -1;           /* decrement */
+	sops.sem_flg = IPC_NOWAIT;
+	sops.sem_num = semNum;
+
+	do {
+		errStatus = semop(queue->semId, &sops, 1);
+	} while (errStatus < 0 && errno == EINTR);
+
+	return errStatus == 0;
+}
 
-		errStatus = msgrcv(queue->qId, msg, sizeof(QMessage), 0, IPC_NOWAIT);
-	} while (errStatus < 0 && (errno == EINTR || errno == ENOMSG));
+
+/*
+ * queue_sem_post_n increments the given semaphore of the queue semaphore set
+ * by the given count, in a single system call.
+ */
+static bool
+queue_sem_post_n(Queue *queue, int semNum, int count)
+{
+	int errStatus;
+	struct sembuf sops;
+
+	sops.sem_op = count;        /* increment */
+	sops.sem_flg = 0;
+	sops.sem_num = semNum;
+
+	do {
+		errStatus = semop(queue->semId, &sops, 1);
+	} while (errStatus < 0 && errno == EINTR);
 
 	if (errStatus < 0)
 	{
-		log_error("Failed to receive a message from queue %d: %m", queue->qId);
+		log_error("Failed to post on message queue semaphore %d: %m",
+				  queue->semId);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * queue_depth reports the current number of messages waiting in the queue,
+ * as tracked by the items semaphore. The value is a sample: it may be stale
+ * by the time the caller reads it, which is fine for instrumentation.
+ */
+bool
+queue_depth(Queue *queue, int *depth)
+{
+	int value = semctl(queue->semId, QUEUE_SEM_ITEMS, GETVAL);
+
+	if (value < 0)
+	{
+		log_debug("Failed to read message queue semaphore %d: %m",
+				  queue->semId);
 		return false;
 	}
 
+	*depth = value;
+
 	return true;
 }
@@ -10,16 +10,10 @@
 
 #include <sys/types.h>
 #include <sys/ipc.h>
-#include <sys/msg.h>
 
 #include "postgres.h"
 
-typedef struct Queue
-{
-	int qId;
-	pid_t owner;
-} Queue;
-
+#include "lock_utils.h"
 
 /*
  * Message types that we send on the queue. The only messages we send are Oid
@@ -45,10 +39,46 @@ typedef struct QMessage
 	} data;
 } QMessage;
 
-bool queue_create(Queue *queue);
+
+/*
+ * A Queue is a ring buffer of QMessage entries hosted in a shared memory
+ * segment, attached by the process that creates the queue before it forks
+ * the producer and consumer processes.
+ *
+ * Blocking on an empty (or full) queue uses a SysV semaphore set counting
+ * the filled and the empty slots, so that consumers sleep in the kernel
+ * rather than polling.
+ */
+typedef struct QueueRing
+{
+	int capacity;
+	int head;                   /* next slot to receive from */
+	int tail;                   /* next slot to send to */
+	QMessage messages[];
+} QueueRing;
+
+typedef struct Queue
+{
+	int qId;                    /* shared memory segment identifier */
+	pid_t owner;
+	int semId;                  /* mutex, items, and slots semaphores */
+	SharedMemSegment segment;
+	QueueRing *ring;
+} Queue;
+
+bool queue_create(Queue *queue, int capacity);
 bool queue_unlink(Queue *queue);
 
+/* how many messages a worker drains from its queue in one go */
+#define QUEUE_RECEIVE_BATCH_SIZE 32
+
 bool queue_send(Queue *queue, QMessage *msg);
 bool queue_receive(Queue *queue, QMessage *msg);
+bool queue_receive_nowait(Queue *queue, QMessage *msg, bool *received);
+
+bool queue_send_batch(Queue *queue, QMessage *msgs, int count);
+bool queue_receive_batch(Queue *queue, QMessage *msgs, int *count);
+
+bool queue_depth(Queue *queue, int *depth);
 
 #endif /* QUEUE_UTILS_H */
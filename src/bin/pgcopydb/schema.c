@@ -14,9 +14,11 @@
 #include "file_utils.h"
 #include "filtering.h"
 #include "log.h"
+#include "mem_utils.h"
 #include "parsing_utils.h"
 #include "pg_depend_sql.h"
 #include "pgsql.h"
+#include "pqexpbuffer.h"
 #include "schema.h"
 #include "signals.h"
 #include "string_utils.h"
@@ -62,6 +64,14 @@ typedef struct SourceTableArrayContext
 	bool parsedOk;
 } SourceTableArrayContext;
 
+/* Context used when fetching the per-table modification evidence */
+typedef struct SourceTableActivityContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	SourceTableArray *tableArray;
+	bool parsedOk;
+} SourceTableActivityContext;
+
 /* Context used when fetching all the sequence definitions */
 typedef struct SourceSequenceArrayContext
 {
@@ -70,6 +80,26 @@ typedef struct SourceSequenceArrayContext
 	bool parsedOk;
 } SourceSequenceArrayContext;
 
+/*
+ * When evaluating the sequence filters client-side we also need to know the
+ * table whose column default (serial, bigserial) uses each sequence, if any.
+ */
+typedef struct SourceSequenceOwner
+{
+	SourceSequence sequence;
+	bool hasOwnerTable;
+	char ownerNspname[NAMEDATALEN];
+	char ownerRelname[NAMEDATALEN];
+} SourceSequenceOwner;
+
+typedef struct SourceSequenceOwnerArrayContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	int count;
+	SourceSequenceOwner *array;     /* malloc'ed area */
+	bool parsedOk;
+} SourceSequenceOwnerArrayContext;
+
 /* Context used when fetching all the indexes definitions */
 typedef struct SourceIndexArrayContext
 {
@@ -115,8 +145,24 @@ static bool parseCurrentSourceTable(PGresult *result,
 									int rowNumber,
 									SourceTable *table);
 
+static void filterTableArray(SourceFilters *filters,
+							 SourceTableArray *tableArray);
+
+static void filterIndexArray(SourceFilters *filters,
+							 SourceIndexArray *indexArray);
+
+static bool listFilteredSequences(PGSQL *pgsql,
+								  SourceFilters *filters,
+								  SourceSequenceArray *seqArray);
+
+static void getSequenceOwnerArray(void *ctx, PGresult *result);
+
 static void getSequenceArray(void *ctx, PGresult *result);
 
+static void getSequenceValuesArray(void *ctx, PGresult *result);
+
+static void appendSqlArrayElement(PQExpBuffer buffer, const char *value);
+
 static bool parseCurrentSourceSequence(PGresult *result,
 									   int rowNumber,
 									   SourceSequence *table);
@@ -135,6 +181,8 @@ static bool parseCurrentSourceDepend(PGresult *result,
 
 static void getPartitionList(void *ctx, PGresult *result);
 
+static void getTableActivityArray(void *ctx, PGresult *result);
+
 static bool parseCurrentPartition(PGresult *result,
 								  int rowNumber,
 								  SourceTableParts *parts);
@@ -485,6 +533,21 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
 };
 
 
+/*
+ * The --estimate-sizes option skips the expensive pg_table_size() calls and
+ * computes the sizes from the pg_class.relpages estimates instead, a catalog
+ * only query. The estimates are only a join source for per-oid lookups, so a
+ * single query covers all the filtering variants: extra rows are harmless.
+ */
+static char *listEstimatedTableSizeSQL =
+	"create table if not exists pgcopydb.table_size as "
+
+	"  select c.oid, (c.relpages::bigint * 8192) as bytes "
+	"    from pg_catalog.pg_class c"
+
+	"   where relkind in ('r', 'p') and c.relpersistence in ('p', 'u') ";
+
+
 /*
  * schema_prepare_pgcopydb_table_size creates a table named pgcopydb.table_size
  * on the given connection (typically, the source database). The creation is
@@ -493,11 +556,22 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
 bool
 schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 								   SourceFilters *filters,
+								   bool estimateSizes,
 								   bool force,
 								   bool *createdTableSizeTable)
 {
 	log_trace("schema_prepare_pgcopydb_table_size");
 
+	/*
+	 * The pgcopydb.table_size relation is only a per-oid join source for the
+	 * table listing queries: extra rows for filtered-out tables are harmless.
+	 * The filtering variants of the query are only used for the complement
+	 * listing types, where the temp filter tables have been prepared already;
+	 * the main filtering types use the unfiltered variant and skip the temp
+	 * table DDL on the source.
+	 */
+	SourceFilterType sizeQueryType = filters->type;
+
 	switch (filters->type)
 	{
 		case SOURCE_FILTER_TYPE_NONE:
@@ -508,6 +582,11 @@ schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 
 		case SOURCE_FILTER_TYPE_INCL:
 		case SOURCE_FILTER_TYPE_EXCL:
+		{
+			sizeQueryType = SOURCE_FILTER_TYPE_NONE;
+			break;
+		}
+
 		case SOURCE_FILTER_TYPE_LIST_NOT_INCL:
 		case SOURCE_FILTER_TYPE_LIST_EXCL:
 		{
@@ -591,7 +670,10 @@ schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 
 	if (createTable || force)
 	{
-		char *sql = listSourceTableSizeSQL[filters->type].sql;
+		char *sql =
+			estimateSizes
+			? listEstimatedTableSizeSQL
+			: listSourceTableSizeSQL[sizeQueryType].sql;
 
 		if (!pgsql_execute(pgsql, sql))
 		{
@@ -653,7 +735,23 @@ struct FilteringQueries listSourceTablesSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(c.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')), "
-		"         pkeys.attname as partkey"
+		"         pkeys.attname as partkey, "
+
+		/*
+		 * COPY BINARY is safe only when all the attribute types are built-in
+		 * base types: binary representations of user-defined types (enums,
+		 * composites, extension types) are not portable across versions.
+		 */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = c.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_catalog.pg_class c"
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid"
@@ -710,7 +808,23 @@ struct FilteringQueries listSourceTablesSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(c.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')), "
-		"         pkeys.attname as partkey"
+		"         pkeys.attname as partkey, "
+
+		/*
+		 * COPY BINARY is safe only when all the attribute types are built-in
+		 * base types: binary representations of user-defined types (enums,
+		 * composites, extension types) are not portable across versions.
+		 */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = c.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_catalog.pg_class c "
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid "
@@ -769,7 +883,23 @@ struct FilteringQueries listSourceTablesSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(c.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')), "
-		"         pkeys.attname as partkey"
+		"         pkeys.attname as partkey, "
+
+		/*
+		 * COPY BINARY is safe only when all the attribute types are built-in
+		 * base types: binary representations of user-defined types (enums,
+		 * composites, extension types) are not portable across versions.
+		 */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = c.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_catalog.pg_class c "
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid "
@@ -842,7 +972,23 @@ struct FilteringQueries listSourceTablesSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(c.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')), "
-		"         pkeys.attname as partkey"
+		"         pkeys.attname as partkey, "
+
+		/*
+		 * COPY BINARY is safe only when all the attribute types are built-in
+		 * base types: binary representations of user-defined types (enums,
+		 * composites, extension types) are not portable across versions.
+		 */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = c.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_catalog.pg_class c "
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid "
@@ -904,7 +1050,23 @@ struct FilteringQueries listSourceTablesSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(c.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')), "
-		"         pkeys.attname as partkey"
+		"         pkeys.attname as partkey, "
+
+		/*
+		 * COPY BINARY is safe only when all the attribute types are built-in
+		 * base types: binary representations of user-defined types (enums,
+		 * composites, extension types) are not portable across versions.
+		 */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = c.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_catalog.pg_class c "
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid "
@@ -976,6 +1138,8 @@ schema_list_ordinary_tables(PGSQL *pgsql,
 
 	log_trace("schema_list_ordinary_tables");
 
+	bool clientSideFiltering = false;
+
 	switch (filters->type)
 	{
 		case SOURCE_FILTER_TYPE_NONE:
@@ -986,6 +1150,21 @@ schema_list_ordinary_tables(PGSQL *pgsql,
 
 		case SOURCE_FILTER_TYPE_INCL:
 		case SOURCE_FILTER_TYPE_EXCL:
+		{
+			/*
+			 * The main filters are evaluated client-side against the complete
+			 * table listing, avoiding the temp table DDL on the source.
+			 */
+			if (!filters_prepare_hash_tables(filters))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			clientSideFiltering = true;
+			break;
+		}
+
 		case SOURCE_FILTER_TYPE_LIST_NOT_INCL:
 		case SOURCE_FILTER_TYPE_LIST_EXCL:
 		{
@@ -1010,7 +1189,10 @@ schema_list_ordinary_tables(PGSQL *pgsql,
 
 	log_debug("listSourceTablesSQL[%s]", filterTypeToString(filters->type));
 
-	char *sql = listSourceTablesSQL[filters->type].sql;
+	char *sql =
+		clientSideFiltering
+		? listSourceTablesSQL[SOURCE_FILTER_TYPE_NONE].sql
+		: listSourceTablesSQL[filters->type].sql;
 
 	if (!pgsql_execute_with_params(pgsql, sql, 0, NULL, NULL,
 								   &context, &getTableArray))
@@ -1025,10 +1207,57 @@ schema_list_ordinary_tables(PGSQL *pgsql,
 		return false;
 	}
 
+	if (clientSideFiltering)
+	{
+		(void) filterTableArray(filters, tableArray);
+	}
+
 	return true;
 }
 
 
+/*
+ * filterTableArray compacts the given table array in-place, removing the
+ * entries that are filtered-out and computing the excludeData attribute of the
+ * entries that are kept.
+ */
+static void
+filterTableArray(SourceFilters *filters, SourceTableArray *tableArray)
+{
+	int keptCount = 0;
+
+	for (int i = 0; i < tableArray->count; i++)
+	{
+		SourceTable *table = &(tableArray->array[i]);
+
+		if (filters_table_excluded(filters, table->nspname, table->relname))
+		{
+			continue;
+		}
+
+		table->excludeData =
+			filters->type == SOURCE_FILTER_TYPE_INCL &&
+			filters_table_data_excluded(filters,
+										table->nspname,
+										table->relname);
+
+		if (keptCount != i)
+		{
+			tableArray->array[keptCount] = *table;
+		}
+
+		++keptCount;
+	}
+
+	log_debug("filterTableArray: filters [%s] keep %d tables out of %d",
+			  filterTypeToString(filters->type),
+			  keptCount,
+			  tableArray->count);
+
+	tableArray->count = keptCount;
+}
+
+
 /*
  * For code simplicity the index array is also the SourceFilterType enum value.
  */
@@ -1044,7 +1273,19 @@ struct FilteringQueries listSourceTablesNoPKSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(r.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')),"
-		"         NULL as partkey"
+		"         NULL as partkey, "
+
+		/* see listSourceTablesSQL for COPY BINARY safety considerations */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = r.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_class r "
 		"         join pg_namespace n ON n.oid = r.relnamespace "
@@ -1085,7 +1326,19 @@ struct FilteringQueries listSourceTablesNoPKSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(r.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')),"
-		"         NULL as partkey"
+		"         NULL as partkey, "
+
+		/* see listSourceTablesSQL for COPY BINARY safety considerations */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = r.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_class r "
 		"         join pg_namespace n ON n.oid = r.relnamespace "
@@ -1131,7 +1384,19 @@ struct FilteringQueries listSourceTablesNoPKSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(r.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')),"
-		"         NULL as partkey"
+		"         NULL as partkey, "
+
+		/* see listSourceTablesSQL for COPY BINARY safety considerations */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = r.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_class r "
 		"         join pg_namespace n ON n.oid = r.relnamespace "
@@ -1191,7 +1456,19 @@ struct FilteringQueries listSourceTablesNoPKSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(r.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')),"
-		"         NULL as partkey"
+		"         NULL as partkey, "
+
+		/* see listSourceTablesSQL for COPY BINARY safety considerations */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = r.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_class r "
 		"         join pg_namespace n ON n.oid = r.relnamespace "
@@ -1240,7 +1517,19 @@ struct FilteringQueries listSourceTablesNoPKSQL[] = {
 		"                regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                regexp_replace(r.relname, '[\n\r]', ' '), "
 		"                regexp_replace(auth.rolname, '[\n\r]', ' ')),"
-		"         NULL as partkey"
+		"         NULL as partkey, "
+
+		/* see listSourceTablesSQL for COPY BINARY safety considerations */
+		"         not exists "
+		"           ( "
+		"             select 1 "
+		"               from pg_attribute a "
+		"                    join pg_type t on t.oid = a.atttypid "
+		"              where a.attrelid = r.oid and a.attnum > 0 "
+		"                and not a.attisdropped "
+		"                and (t.typtype <> 'b' or "
+		"                     t.typnamespace <> 'pg_catalog'::regnamespace) "
+		"           ) as copybinsafe"
 
 		"    from pg_class r "
 		"         join pg_namespace n ON n.oid = r.relnamespace "
@@ -1656,6 +1945,15 @@ schema_list_sequences(PGSQL *pgsql,
 
 		case SOURCE_FILTER_TYPE_INCL:
 		case SOURCE_FILTER_TYPE_EXCL:
+		{
+			/*
+			 * The main filtering types are evaluated client-side against the
+			 * complete sequence listing, avoiding the temp table DDL on the
+			 * source.
+			 */
+			return listFilteredSequences(pgsql, filters, seqArray);
+		}
+
 		case SOURCE_FILTER_TYPE_LIST_NOT_INCL:
 		case SOURCE_FILTER_TYPE_LIST_EXCL:
 		{
@@ -1700,51 +1998,482 @@ schema_list_sequences(PGSQL *pgsql,
 
 
 /*
- * schema_get_sequence_value fetches sequence metadata last_value and
- * is_called for the given sequence.
+ * The complete sequence listing used for the client-side filter evaluation
+ * also resolves the table whose column default uses each sequence (serial and
+ * bigserial columns), when there is one: the filters are edited in terms of
+ * the main relations.
+ */
+static char *listSourceSequencesWithOwnerSQL =
+	"  select c.oid, n.nspname, c.relname, "
+	"         format('%s %s %s', "
+	"                regexp_replace(n.nspname, '[\n\r]', ' '), "
+	"                regexp_replace(c.relname, '[\n\r]', ' '), "
+	"                regexp_replace(auth.rolname, '[\n\r]', ' ')), "
+	"         rn.nspname, r.relname "
+
+	"    from pg_catalog.pg_class c "
+	"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid "
+	"         join pg_roles auth ON auth.oid = c.relowner "
+
+	/* find the table whose column default uses this sequence, if any */
+	"         left join lateral "
+	"         ( "
+	"           select a.adrelid "
+	"             from pg_depend d "
+	"                  join pg_attrdef a on a.oid = d.objid "
+	"            where d.refobjid = c.oid "
+	"              and d.classid = 'pg_attrdef'::regclass "
+	"              and d.refclassid = 'pg_class'::regclass "
+	"            limit 1 "
+	"         ) as owner on true "
+	"         left join pg_class r on r.oid = owner.adrelid "
+	"         left join pg_namespace rn on rn.oid = r.relnamespace "
+
+	"   where c.relkind = 'S' and c.relpersistence in ('p', 'u') "
+	"     and n.nspname !~ '^pg_' and n.nspname <> 'information_schema' "
+	"     and n.nspname !~ 'pgcopydb' "
+
+	/* avoid pg_class entries which belong to extensions */
+	"     and not exists "
+	"       ( "
+	"         select 1 "
+	"           from pg_depend d "
+	"          where d.classid = 'pg_class'::regclass "
+	"            and d.objid = c.oid "
+	"            and d.deptype = 'e' "
+	"       ) "
+
+	"order by n.nspname, c.relname";
+
+
+/*
+ * listFilteredSequences fetches the complete sequence listing, with the table
+ * that owns each sequence, and evaluates the filters client-side: only the
+ * sequences attached to a column default of a selected table are kept, same
+ * as with the SQL joins through the temp filter tables.
+ */
+static bool
+listFilteredSequences(PGSQL *pgsql,
+					  SourceFilters *filters,
+					  SourceSequenceArray *seqArray)
+{
+	SourceSequenceOwnerArrayContext context = { { 0 }, 0, NULL, false };
+
+	if (!filters_prepare_hash_tables(filters))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!pgsql_execute_with_params(pgsql, listSourceSequencesWithOwnerSQL,
+								   0, NULL, NULL,
+								   &context, &getSequenceOwnerArray))
+	{
+		log_error("Failed to list sequences");
+		return false;
+	}
+
+	if (!context.parsedOk)
+	{
+		log_error("Failed to list sequences");
+		return false;
+	}
+
+	int keptCount = 0;
+
+	for (int i = 0; i < context.count; i++)
+	{
+		SourceSequenceOwner *seqOwner = &(context.array[i]);
+
+		if (!filters_sequence_excluded(filters,
+									   seqOwner->hasOwnerTable,
+									   seqOwner->ownerNspname,
+									   seqOwner->ownerRelname))
+		{
+			++keptCount;
+		}
+	}
+
+	log_debug("listFilteredSequences: filters [%s] keep %d sequences out of %d",
+			  filterTypeToString(filters->type),
+			  keptCount,
+			  context.count);
+
+	seqArray->count = keptCount;
+	seqArray->array =
+		(SourceSequence *) arena_alloc(&(seqArray->arena),
+									   keptCount * sizeof(SourceSequence));
+
+	if (keptCount > 0 && seqArray->array == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(context.array);
+		return false;
+	}
+
+	int seqIndex = 0;
+
+	for (int i = 0; i < context.count; i++)
+	{
+		SourceSequenceOwner *seqOwner = &(context.array[i]);
+
+		if (!filters_sequence_excluded(filters,
+									   seqOwner->hasOwnerTable,
+									   seqOwner->ownerNspname,
+									   seqOwner->ownerRelname))
+		{
+			seqArray->array[seqIndex++] = seqOwner->sequence;
+		}
+	}
+
+	free(context.array);
+
+	return true;
+}
+
+
+/*
+ * getSequenceOwnerArray loops over the SQL result for the sequence listing
+ * query with owner table resolution, and allocates an array of sequences with
+ * their owner then populates it with the query result.
+ */
+static void
+getSequenceOwnerArray(void *ctx, PGresult *result)
+{
+	SourceSequenceOwnerArrayContext *context =
+		(SourceSequenceOwnerArrayContext *) ctx;
+
+	int nTuples = PQntuples(result);
+
+	log_debug("getSequenceOwnerArray: %d", nTuples);
+
+	if (PQnfields(result) != 6)
+	{
+		log_error("Query returned %d columns, expected 6", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	context->count = nTuples;
+	context->array =
+		(SourceSequenceOwner *) calloc(nTuples, sizeof(SourceSequenceOwner));
+
+	if (context->array == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return;
+	}
+
+	bool parsedOk = true;
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		SourceSequenceOwner *seqOwner = &(context->array[rowNumber]);
+
+		/* the first 4 columns are the same as the plain sequence listing */
+		parsedOk = parsedOk &&
+				   parseCurrentSourceSequence(result,
+											  rowNumber,
+											  &(seqOwner->sequence));
+
+		/* 5. rn.nspname, 6. r.relname, both null for free-standing sequences */
+		seqOwner->hasOwnerTable =
+			!PQgetisnull(result, rowNumber, 4) &&
+			!PQgetisnull(result, rowNumber, 5);
+
+		if (seqOwner->hasOwnerTable)
+		{
+			char *value = PQgetvalue(result, rowNumber, 4);
+			int length = strlcpy(seqOwner->ownerNspname, value, NAMEDATALEN);
+
+			if (length >= NAMEDATALEN)
+			{
+				log_error("Schema name \"%s\" is %d bytes long, "
+						  "the maximum expected is %d (NAMEDATALEN - 1)",
+						  value, length, NAMEDATALEN - 1);
+				parsedOk = false;
+			}
+
+			value = PQgetvalue(result, rowNumber, 5);
+			length = strlcpy(seqOwner->ownerRelname, value, NAMEDATALEN);
+
+			if (length >= NAMEDATALEN)
+			{
+				log_error("Table name \"%s\" is %d bytes long, "
+						  "the maximum expected is %d (NAMEDATALEN - 1)",
+						  value, length, NAMEDATALEN - 1);
+				parsedOk = false;
+			}
+		}
+	}
+
+	if (!parsedOk)
+	{
+		free(context->array);
+		context->array = NULL;
+	}
+
+	context->parsedOk = parsedOk;
+}
+
+
+/*
+ * Sequence values (last_value, is_called) are not found in a catalog, they
+ * have to be read from each sequence relation itself. To avoid paying a full
+ * client/server round trip per sequence, read them in batches of UNION ALL
+ * sub-queries.
+ */
+#define SEQUENCE_VALUES_BATCH_SIZE 512
+
+/*
+ * schema_get_sequence_values fetches sequence metadata last_value and
+ * is_called for all the sequences in the given array.
  */
 bool
-schema_get_sequence_value(PGSQL *pgsql, SourceSequence *seq)
+schema_get_sequence_values(PGSQL *pgsql, SourceSequenceArray *sequenceArray)
+{
+	PGconn *connection = pgsql->connection;
+
+	for (int batchStart = 0;
+		 batchStart < sequenceArray->count;
+		 batchStart += SEQUENCE_VALUES_BATCH_SIZE)
+	{
+		int batchEnd = batchStart + SEQUENCE_VALUES_BATCH_SIZE;
+
+		if (sequenceArray->count < batchEnd)
+		{
+			batchEnd = sequenceArray->count;
+		}
+
+		PQExpBuffer sql = createPQExpBuffer();
+
+		appendPQExpBufferStr(sql,
+							 "select seqidx, last_value, is_called from (");
+
+		for (int seqIndex = batchStart; seqIndex < batchEnd; seqIndex++)
+		{
+			SourceSequence *seq = &(sequenceArray->array[seqIndex]);
+
+			char *escapedNspname =
+				PQescapeIdentifier(connection,
+								   seq->nspname,
+								   strlen(seq->nspname));
+
+			char *escapedRelname =
+				PQescapeIdentifier(connection,
+								   seq->relname,
+								   strlen(seq->relname));
+
+			if (escapedNspname == NULL || escapedRelname == NULL)
+			{
+				log_error("Failed to get values from sequence \"%s\".\"%s\": %s",
+						  seq->nspname,
+						  seq->relname,
+						  PQerrorMessage(connection));
+
+				PQfreemem(escapedNspname);
+				PQfreemem(escapedRelname);
+				destroyPQExpBuffer(sql);
+				return false;
+			}
+
+			appendPQExpBuffer(sql,
+							  "%s select %d as seqidx, last_value, is_called "
+							  "from %s.%s",
+							  seqIndex == batchStart ? "" : " union all",
+							  seqIndex,
+							  escapedNspname,
+							  escapedRelname);
+
+			PQfreemem(escapedNspname);
+			PQfreemem(escapedRelname);
+		}
+
+		appendPQExpBufferStr(sql, ") as seqs order by seqidx");
+
+		if (PQExpBufferBroken(sql))
+		{
+			log_error("Failed to build sequence values query: out of memory");
+			destroyPQExpBuffer(sql);
+			return false;
+		}
+
+		SourceSequenceArrayContext context = { { 0 }, sequenceArray, false };
+
+		bool done =
+			pgsql_execute_with_params(pgsql, sql->data, 0, NULL, NULL,
+									  &context, &getSequenceValuesArray);
+
+		destroyPQExpBuffer(sql);
+
+		if (!done || !context.parsedOk)
+		{
+			log_error("Failed to get values for %d sequences, "
+					  "see above for details",
+					  batchEnd - batchStart);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * getSequenceValuesArray parses the result of a batched sequence values
+ * query, and fills-in the lastValue and isCalled fields of the sequence
+ * array entries designated by the seqidx column.
+ */
+static void
+getSequenceValuesArray(void *ctx, PGresult *result)
 {
-	return pgsql_get_sequence(pgsql,
-							  seq->nspname,
-							  seq->relname,
-							  &(seq->lastValue),
-							  &(seq->isCalled));
+	SourceSequenceArrayContext *context = (SourceSequenceArrayContext *) ctx;
+
+	if (PQnfields(result) != 3)
+	{
+		log_error("Query returned %d columns, expected 3", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	int errors = 0;
+	int nTuples = PQntuples(result);
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		/* 1. seqidx, the position of the sequence in our array */
+		char *value = PQgetvalue(result, rowNumber, 0);
+		int seqIndex = 0;
+
+		if (!stringToInt(value, &seqIndex) ||
+			seqIndex < 0 ||
+			context->sequenceArray->count <= seqIndex)
+		{
+			log_error("Invalid sequence index \"%s\"", value);
+			++errors;
+			continue;
+		}
+
+		SourceSequence *seq = &(context->sequenceArray->array[seqIndex]);
+
+		/* 2. last_value */
+		value = PQgetvalue(result, rowNumber, 1);
+
+		if (!stringToInt64(value, &(seq->lastValue)))
+		{
+			log_error("Invalid sequence last_value \"%s\"", value);
+			++errors;
+		}
+
+		/* 3. is_called */
+		value = PQgetvalue(result, rowNumber, 2);
+
+		if (value == NULL || ((*value != 't') && (*value != 'f')))
+		{
+			log_error("Invalid is_called value \"%s\"", value);
+			++errors;
+		}
+		else
+		{
+			seq->isCalled = (*value) == 't';
+		}
+	}
+
+	context->parsedOk = errors == 0;
 }
 
 
 /*
- * schema_set_sequence_value calls pg_catalog.setval() on the given sequence.
+ * schema_set_sequence_values calls pg_catalog.setval() for all the sequences
+ * in the given array, in a single batched statement rather than one query
+ * per sequence.
  */
 bool
-schema_set_sequence_value(PGSQL *pgsql, SourceSequence *seq)
+schema_set_sequence_values(PGSQL *pgsql, SourceSequenceArray *sequenceArray)
 {
-	SingleValueResultContext parseContext = { { 0 }, PGSQL_RESULT_BIGINT, false };
-	char *sql = "select pg_catalog.setval(format('%I.%I', $1, $2), $3, $4)";
+	if (sequenceArray->count == 0)
+	{
+		return true;
+	}
 
-	int paramCount = 4;
-	Oid paramTypes[4] = { TEXTOID, TEXTOID, INT8OID, BOOLOID };
-	const char *paramValues[4];
+	char *sql =
+		"select pg_catalog.setval(format('%I.%I', n, r), v, c) "
+		"  from unnest($1, $2, $3, $4) as seqs(n, r, v, c)";
 
-	paramValues[0] = seq->nspname;
-	paramValues[1] = seq->relname;
-	paramValues[2] = intToString(seq->lastValue).strValue;
-	paramValues[3] = seq->isCalled ? "true" : "false";
+	PQExpBuffer nspnames = createPQExpBuffer();
+	PQExpBuffer relnames = createPQExpBuffer();
+	PQExpBuffer lastValues = createPQExpBuffer();
+	PQExpBuffer isCalled = createPQExpBuffer();
 
-	if (!pgsql_execute_with_params(pgsql, sql,
-								   paramCount, paramTypes, paramValues,
-								   &parseContext, &parseSingleValueResult))
+	appendPQExpBufferChar(nspnames, '{');
+	appendPQExpBufferChar(relnames, '{');
+	appendPQExpBufferChar(lastValues, '{');
+	appendPQExpBufferChar(isCalled, '{');
+
+	for (int seqIndex = 0; seqIndex < sequenceArray->count; seqIndex++)
 	{
-		log_error("Failed to set sequence \"%s\".\"%s\" last value to %lld",
-				  seq->nspname, seq->relname, (long long) seq->lastValue);
+		SourceSequence *seq = &(sequenceArray->array[seqIndex]);
+
+		if (seqIndex > 0)
+		{
+			appendPQExpBufferChar(nspnames, ',');
+			appendPQExpBufferChar(relnames, ',');
+			appendPQExpBufferChar(lastValues, ',');
+			appendPQExpBufferChar(isCalled, ',');
+		}
+
+		appendSqlArrayElement(nspnames, seq->nspname);
+		appendSqlArrayElement(relnames, seq->relname);
+
+		appendPQExpBuffer(lastValues, "%lld", (long long) seq->lastValue);
+		appendPQExpBufferChar(isCalled, seq->isCalled ? 't' : 'f');
+	}
+
+	appendPQExpBufferChar(nspnames, '}');
+	appendPQExpBufferChar(relnames, '}');
+	appendPQExpBufferChar(lastValues, '}');
+	appendPQExpBufferChar(isCalled, '}');
+
+	if (PQExpBufferBroken(nspnames) ||
+		PQExpBufferBroken(relnames) ||
+		PQExpBufferBroken(lastValues) ||
+		PQExpBufferBroken(isCalled))
+	{
+		log_error("Failed to build setval() parameters: out of memory");
+
+		destroyPQExpBuffer(nspnames);
+		destroyPQExpBuffer(relnames);
+		destroyPQExpBuffer(lastValues);
+		destroyPQExpBuffer(isCalled);
 		return false;
 	}
 
-	if (!parseContext.parsedOk)
+	int paramCount = 4;
+	Oid paramTypes[4] = {
+		NAMEARRAYOID, NAMEARRAYOID, INT8ARRAYOID, BOOLARRAYOID
+	};
+	const char *paramValues[4];
+
+	paramValues[0] = nspnames->data;
+	paramValues[1] = relnames->data;
+	paramValues[2] = lastValues->data;
+	paramValues[3] = isCalled->data;
+
+	bool done =
+		pgsql_execute_with_params(pgsql, sql,
+								  paramCount, paramTypes, paramValues,
+								  NULL, NULL);
+
+	destroyPQExpBuffer(nspnames);
+	destroyPQExpBuffer(relnames);
+	destroyPQExpBuffer(lastValues);
+	destroyPQExpBuffer(isCalled);
+
+	if (!done)
 	{
-		log_error("Failed to set sequence \"%s\".\"%s\" last value to %lld",
-				  seq->nspname, seq->relname, (long long) seq->lastValue);
+		log_error("Failed to set values for %d sequences, "
+				  "see above for details",
+				  sequenceArray->count);
 		return false;
 	}
 
@@ -1752,6 +2481,30 @@ schema_set_sequence_value(PGSQL *pgsql, SourceSequence *seq)
 }
 
 
+/*
+ * appendSqlArrayElement appends given text value to a Postgres array literal
+ * being built in the given buffer, with the double-quoting and escaping
+ * rules that the array input syntax requires.
+ */
+static void
+appendSqlArrayElement(PQExpBuffer buffer, const char *value)
+{
+	appendPQExpBufferChar(buffer, '"');
+
+	for (const char *ptr = value; *ptr != '\0'; ptr++)
+	{
+		if (*ptr == '"' || *ptr == '\\')
+		{
+			appendPQExpBufferChar(buffer, '\\');
+		}
+
+		appendPQExpBufferChar(buffer, *ptr);
+	}
+
+	appendPQExpBufferChar(buffer, '"');
+}
+
+
 /*
  * For code simplicity the index array is also the SourceFilterType enum value.
  */
@@ -1776,6 +2529,7 @@ struct FilteringQueries listSourceIndexesSQL[] = {
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
@@ -1827,6 +2581,7 @@ struct FilteringQueries listSourceIndexesSQL[] = {
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
 		"          join pg_class r ON r.oid = x.indrelid"
@@ -1882,6 +2637,7 @@ struct FilteringQueries listSourceIndexesSQL[] = {
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
 		"          join pg_class r ON r.oid = x.indrelid"
@@ -1951,6 +2707,7 @@ struct FilteringQueries listSourceIndexesSQL[] = {
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
 		"          join pg_class r ON r.oid = x.indrelid"
@@ -2009,6 +2766,7 @@ struct FilteringQueries listSourceIndexesSQL[] = {
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
 		"          join pg_class r ON r.oid = x.indrelid"
@@ -2072,6 +2830,7 @@ struct FilteringQueries listSourceIndexesSQL[] = {
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
 		"          join pg_class r ON r.oid = x.indrelid"
@@ -2130,6 +2889,7 @@ struct FilteringQueries listSourceIndexesSQL[] = {
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
 		"          join pg_class r ON r.oid = x.indrelid"
@@ -2181,7 +2941,25 @@ schema_list_all_indexes(PGSQL *pgsql,
 
 	log_trace("schema_list_all_indexes");
 
-	if (filters->type != SOURCE_FILTER_TYPE_NONE)
+	/*
+	 * The main filtering types are evaluated client-side against the complete
+	 * index listing, which carries both the index and the table names. Only
+	 * the complement listing types still need the temp filter tables.
+	 */
+	bool clientSideFiltering =
+		filters->type == SOURCE_FILTER_TYPE_INCL ||
+		filters->type == SOURCE_FILTER_TYPE_EXCL ||
+		filters->type == SOURCE_FILTER_TYPE_EXCL_INDEX;
+
+	if (clientSideFiltering)
+	{
+		if (!filters_prepare_hash_tables(filters))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else if (filters->type != SOURCE_FILTER_TYPE_NONE)
 	{
 		if (!prepareFilters(pgsql, filters))
 		{
@@ -2193,7 +2971,10 @@ schema_list_all_indexes(PGSQL *pgsql,
 
 	log_debug("listSourceIndexesSQL[%s]", filterTypeToString(filters->type));
 
-	char *sql = listSourceIndexesSQL[filters->type].sql;
+	char *sql =
+		clientSideFiltering
+		? listSourceIndexesSQL[SOURCE_FILTER_TYPE_NONE].sql
+		: listSourceIndexesSQL[filters->type].sql;
 
 	if (!pgsql_execute_with_params(pgsql, sql, 0, NULL, NULL,
 								   &context, &getIndexArray))
@@ -2208,10 +2989,55 @@ schema_list_all_indexes(PGSQL *pgsql,
 		return false;
 	}
 
+	if (clientSideFiltering)
+	{
+		(void) filterIndexArray(filters, indexArray);
+	}
+
 	return true;
 }
 
 
+/*
+ * filterIndexArray compacts the given index array in-place, removing the
+ * entries that are filtered-out, either directly (exclude-index) or through
+ * their table.
+ */
+static void
+filterIndexArray(SourceFilters *filters, SourceIndexArray *indexArray)
+{
+	int keptCount = 0;
+
+	for (int i = 0; i < indexArray->count; i++)
+	{
+		SourceIndex *index = &(indexArray->array[i]);
+
+		if (filters_index_excluded(filters,
+								   index->tableNamespace,
+								   index->tableRelname,
+								   index->indexNamespace,
+								   index->indexRelname))
+		{
+			continue;
+		}
+
+		if (keptCount != i)
+		{
+			indexArray->array[keptCount] = *index;
+		}
+
+		++keptCount;
+	}
+
+	log_debug("filterIndexArray: filters [%s] keep %d indexes out of %d",
+			  filterTypeToString(filters->type),
+			  keptCount,
+			  indexArray->count);
+
+	indexArray->count = keptCount;
+}
+
+
 /*
  * schema_list_all_indexes grabs the list of indexes from the given source
  * Postgres instance and allocates a SourceIndex array with the result of the
@@ -2243,6 +3069,7 @@ schema_list_table_indexes(PGSQL *pgsql,
 		"                 regexp_replace(n.nspname, '[\n\r]', ' '), "
 		"                 regexp_replace(i.relname, '[\n\r]', ' '), "
 		"                 regexp_replace(auth.rolname, '[\n\r]', ' '))"
+		",         pg_relation_size(i.oid) as bytes"
 		"     from pg_index x"
 		"          join pg_class i ON i.oid = x.indexrelid"
 		"          join pg_class r ON r.oid = x.indrelid"
@@ -2603,6 +3430,101 @@ schema_list_pg_depend(PGSQL *pgsql,
 }
 
 
+/*
+ * schema_list_filtered_objects fetches the lists of tables, indexes,
+ * sequences, and dependencies matching the given filters, batching the four
+ * catalog queries in a single libpq pipeline so that the whole introspection
+ * costs about one network round trip, which matters a lot when the source
+ * database is on the other side of a high-latency connection.
+ */
+bool
+schema_list_filtered_objects(PGSQL *pgsql,
+							 SourceFilters *filters,
+							 SourceTableArray *tableArray,
+							 SourceIndexArray *indexArray,
+							 SourceSequenceArray *sequenceArray,
+							 SourceDependArray *dependArray)
+{
+	SourceTableArrayContext tableContext = { { 0 }, tableArray, false };
+	SourceIndexArrayContext indexContext = { { 0 }, indexArray, false };
+	SourceSequenceArrayContext seqContext = { { 0 }, sequenceArray, false };
+	SourceDependArrayContext dependContext = { { 0 }, dependArray, false };
+
+	log_trace("schema_list_filtered_objects");
+
+	switch (filters->type)
+	{
+		case SOURCE_FILTER_TYPE_INCL:
+		case SOURCE_FILTER_TYPE_EXCL:
+		case SOURCE_FILTER_TYPE_LIST_NOT_INCL:
+		case SOURCE_FILTER_TYPE_LIST_EXCL:
+		{
+			if (!prepareFilters(pgsql, filters))
+			{
+				log_error("Failed to prepare pgcopydb filters, "
+						  "see above for details");
+				return false;
+			}
+			break;
+		}
+
+		/* SOURCE_FILTER_TYPE_EXCL_INDEX etc */
+		default:
+		{
+			log_error("BUG: schema_list_filtered_objects called with "
+					  "filtering type %d",
+					  filters->type);
+			return false;
+		}
+	}
+
+	log_debug("schema_list_filtered_objects[%s]",
+			  filterTypeToString(filters->type));
+
+	PipelineQuery queries[] = {
+		{
+			listSourceTablesSQL[filters->type].sql,
+			&tableContext,
+			&getTableArray
+		},
+		{
+			listSourceIndexesSQL[filters->type].sql,
+			&indexContext,
+			&getIndexArray
+		},
+		{
+			listSourceSequencesSQL[filters->type].sql,
+			&seqContext,
+			&getSequenceArray
+		},
+		{
+			listSourceDependSQL[filters->type].sql,
+			&dependContext,
+			&getDependArray
+		}
+	};
+
+	int count = sizeof(queries) / sizeof(queries[0]);
+
+	if (!pgsql_execute_pipeline(pgsql, queries, count))
+	{
+		log_error("Failed to list filtered-out objects");
+		return false;
+	}
+
+	if (!tableContext.parsedOk ||
+		!indexContext.parsedOk ||
+		!seqContext.parsedOk ||
+		!dependContext.parsedOk)
+	{
+		log_error("Failed to list filtered-out objects");
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * schema_list_partitions prepares the list of partitions that we can drive
  * from our parameters: table size, --split-tables-larger-than.
@@ -2681,6 +3603,152 @@ schema_list_partitions(PGSQL *pgsql, SourceTable *table, uint64_t partSize)
 }
 
 
+/*
+ * schema_list_table_activity fetches per-table modification evidence for the
+ * tables of the given array: the relfilenode, which changes whenever a table
+ * is rewritten or truncated, and the cumulative tuple-change counters from
+ * pg_stat_all_tables. See `pgcopydb clone --incremental`.
+ */
+bool
+schema_list_table_activity(PGSQL *pgsql, SourceTableArray *tableArray)
+{
+	if (tableArray->count == 0)
+	{
+		return true;
+	}
+
+	PQExpBuffer oids = createPQExpBuffer();
+
+	appendPQExpBufferChar(oids, '{');
+
+	for (int i = 0; i < tableArray->count; i++)
+	{
+		appendPQExpBuffer(oids, "%s%u",
+						  i == 0 ? "" : ",",
+						  tableArray->array[i].oid);
+	}
+
+	appendPQExpBufferChar(oids, '}');
+
+	if (PQExpBufferBroken(oids))
+	{
+		log_error("Failed to build table activity query: out of memory");
+		destroyPQExpBuffer(oids);
+		return false;
+	}
+
+	char *sql =
+		"  select t.idx, c.relfilenode, "
+		"         coalesce(s.n_tup_ins, 0), "
+		"         coalesce(s.n_tup_upd, 0), "
+		"         coalesce(s.n_tup_del, 0) "
+		"    from unnest($1::oid[]) with ordinality as t(oid, idx) "
+		"         join pg_class c on c.oid = t.oid "
+		"         left join pg_stat_all_tables s on s.relid = t.oid";
+
+	int paramCount = 1;
+	Oid paramTypes[1] = { TEXTOID };
+	const char *paramValues[1] = { oids->data };
+
+	SourceTableActivityContext context = { { 0 }, tableArray, false };
+
+	bool done =
+		pgsql_execute_with_params(pgsql, sql,
+								  paramCount, paramTypes, paramValues,
+								  &context, &getTableActivityArray);
+
+	destroyPQExpBuffer(oids);
+
+	if (!done || !context.parsedOk)
+	{
+		log_error("Failed to fetch the modification evidence for %d tables, "
+				  "see above for details",
+				  tableArray->count);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * getTableActivityArray parses the result of the table activity query, and
+ * fills-in the modification evidence fields of the table array entries
+ * designated by the idx column.
+ */
+static void
+getTableActivityArray(void *ctx, PGresult *result)
+{
+	SourceTableActivityContext *context = (SourceTableActivityContext *) ctx;
+
+	if (PQnfields(result) != 5)
+	{
+		log_error("Query returned %d columns, expected 5", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	int errors = 0;
+	int nTuples = PQntuples(result);
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		/* 1. idx, the 1-based position of the table in our array */
+		char *value = PQgetvalue(result, rowNumber, 0);
+		int tableIndex = 0;
+
+		if (!stringToInt(value, &tableIndex) ||
+			tableIndex < 1 ||
+			context->tableArray->count < tableIndex)
+		{
+			log_error("Invalid table activity index \"%s\"", value);
+			++errors;
+			continue;
+		}
+
+		SourceTable *table = &(context->tableArray->array[tableIndex - 1]);
+
+		/* 2. relfilenode */
+		value = PQgetvalue(result, rowNumber, 1);
+
+		if (!stringToInt64(value, &(table->relfilenode)))
+		{
+			log_error("Invalid relfilenode \"%s\"", value);
+			++errors;
+		}
+
+		/* 3. n_tup_ins */
+		value = PQgetvalue(result, rowNumber, 2);
+
+		if (!stringToInt64(value, &(table->nTupIns)))
+		{
+			log_error("Invalid n_tup_ins \"%s\"", value);
+			++errors;
+		}
+
+		/* 4. n_tup_upd */
+		value = PQgetvalue(result, rowNumber, 3);
+
+		if (!stringToInt64(value, &(table->nTupUpd)))
+		{
+			log_error("Invalid n_tup_upd \"%s\"", value);
+			++errors;
+		}
+
+		/* 5. n_tup_del */
+		value = PQgetvalue(result, rowNumber, 4);
+
+		if (!stringToInt64(value, &(table->nTupDel)))
+		{
+			log_error("Invalid n_tup_del \"%s\"", value);
+			++errors;
+		}
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
 /*
  * prepareFilters prepares the temporary tables that are needed on the Postgres
  * session where we want to implement a catalog query with filtering. The
@@ -3315,9 +4383,9 @@ getTableArray(void *ctx, PGresult *result)
 
 	log_debug("getTableArray: %d", nTuples);
 
-	if (PQnfields(result) != 9)
+	if (PQnfields(result) != 10)
 	{
-		log_error("Query returned %d columns, expected 9", PQnfields(result));
+		log_error("Query returned %d columns, expected 10", PQnfields(result));
 		context->parsedOk = false;
 		return;
 	}
@@ -3328,13 +4396,14 @@ getTableArray(void *ctx, PGresult *result)
 		/* issue a warning but let's try anyway */
 		log_warn("BUG? context's array is not null in getTableArray");
 
-		free(context->tableArray->array);
+		arena_release(&(context->tableArray->arena));
 		context->tableArray->array = NULL;
 	}
 
 	context->tableArray->count = nTuples;
 	context->tableArray->array =
-		(SourceTable *) calloc(nTuples, sizeof(SourceTable));
+		(SourceTable *) arena_alloc(&(context->tableArray->arena),
+									nTuples * sizeof(SourceTable));
 
 	if (context->tableArray->array == NULL)
 	{
@@ -3354,7 +4423,7 @@ getTableArray(void *ctx, PGresult *result)
 
 	if (!parsedOk)
 	{
-		free(context->tableArray->array);
+		arena_release(&(context->tableArray->arena));
 		context->tableArray->array = NULL;
 	}
 
@@ -3494,6 +4563,10 @@ parseCurrentSourceTable(PGresult *result, int rowNumber, SourceTable *table)
 		}
 	}
 
+	/* 10. copybinsafe */
+	value = PQgetvalue(result, rowNumber, 9);
+	table->copyBinarySafe = (*value) == 't';
+
 	log_trace("parseCurrentSourceTable: %s.%s", table->nspname, table->relname);
 
 	return errors == 0;
@@ -3525,13 +4598,14 @@ getSequenceArray(void *ctx, PGresult *result)
 		/* issue a warning but let's try anyway */
 		log_warn("BUG? context's array is not null in getSequenceArray");
 
-		free(context->sequenceArray->array);
+		arena_release(&(context->sequenceArray->arena));
 		context->sequenceArray->array = NULL;
 	}
 
 	context->sequenceArray->count = nTuples;
 	context->sequenceArray->array =
-		(SourceSequence *) calloc(nTuples, sizeof(SourceSequence));
+		(SourceSequence *) arena_alloc(&(context->sequenceArray->arena),
+									   nTuples * sizeof(SourceSequence));
 
 	if (context->sequenceArray->array == NULL)
 	{
@@ -3551,7 +4625,7 @@ getSequenceArray(void *ctx, PGresult *result)
 
 	if (!parsedOk)
 	{
-		free(context->sequenceArray->array);
+		arena_release(&(context->sequenceArray->arena));
 		context->sequenceArray->array = NULL;
 	}
 
@@ -3629,9 +4703,9 @@ getIndexArray(void *ctx, PGresult *result)
 
 	log_debug("getIndexArray: %d", nTuples);
 
-	if (PQnfields(result) != 14)
+	if (PQnfields(result) != 15)
 	{
-		log_error("Query returned %d columns, expected 14", PQnfields(result));
+		log_error("Query returned %d columns, expected 15", PQnfields(result));
 		context->parsedOk = false;
 		return;
 	}
@@ -3642,13 +4716,14 @@ getIndexArray(void *ctx, PGresult *result)
 		/* issue a warning but let's try anyway */
 		log_warn("BUG? context's array is not null in getIndexArray");
 
-		free(context->indexArray->array);
+		arena_release(&(context->indexArray->arena));
 		context->indexArray->array = NULL;
 	}
 
 	context->indexArray->count = nTuples;
 	context->indexArray->array =
-		(SourceIndex *) calloc(nTuples, sizeof(SourceIndex));
+		(SourceIndex *) arena_alloc(&(context->indexArray->arena),
+									nTuples * sizeof(SourceIndex));
 
 	if (context->indexArray->array == NULL)
 	{
@@ -3668,7 +4743,7 @@ getIndexArray(void *ctx, PGresult *result)
 
 	if (!parsedOk)
 	{
-		free(context->indexArray->array);
+		arena_release(&(context->indexArray->arena));
 		context->indexArray->array = NULL;
 	}
 
@@ -3859,6 +4934,15 @@ parseCurrentSourceIndex(PGresult *result, int rowNumber, SourceIndex *index)
 		++errors;
 	}
 
+	/* 15. pg_relation_size(i.oid) as bytes */
+	value = PQgetvalue(result, rowNumber, 14);
+
+	if (!stringToInt64(value, &(index->bytes)))
+	{
+		log_error("Invalid index size \"%s\"", value);
+		++errors;
+	}
+
 	return errors == 0;
 }
 
@@ -8,9 +8,21 @@
 
 #include <stdbool.h>
 
+/*
+ * Enable uthash's built-in bloom filter (2^16 bits, 8kB per hash table): the
+ * filtering hash tables are mostly consulted for objects that are NOT
+ * filtered out, and the bloom filter answers that common miss case without
+ * walking a hash bucket. The define must be the same in every compilation
+ * unit, see also filtering.h which repeats it.
+ */
+#ifndef HASH_BLOOM
+#define HASH_BLOOM 16
+#endif
+
 #include "uthash.h"
 
 #include "filtering.h"
+#include "mem_utils.h"
 #include "pgsql.h"
 
 /* the pg_restore -l output uses "schema name owner" */
@@ -117,6 +129,13 @@ typedef struct SourceTable
 	int64_t bytes;
 	char bytesPretty[NAMEDATALEN]; /* pg_size_pretty */
 	bool excludeData;
+	bool copyBinarySafe;        /* all column types safe for COPY BINARY */
+
+	/* per-table modification evidence, see clone --incremental */
+	int64_t relfilenode;
+	int64_t nTupIns;
+	int64_t nTupUpd;
+	int64_t nTupDel;
 
 	char restoreListName[RESTORE_LIST_NAMEDATALEN];
 	char partKey[NAMEDATALEN];
@@ -129,10 +148,17 @@ typedef struct SourceTable
 } SourceTable;
 
 
+/*
+ * The catalog arrays are carved out of a per-array memory arena: the array
+ * itself and the per-table allocations that share its lifetime (such as the
+ * SourceIndexList entries) can then be released in a single arena_release
+ * call instead of being walked and free'd one by one.
+ */
 typedef struct SourceTableArray
 {
 	int count;
-	SourceTable *array;         /* malloc'ed area */
+	SourceTable *array;         /* arena allocated */
+	MemoryArena arena;
 } SourceTableArray;
 
 
@@ -155,7 +181,8 @@ typedef struct SourceSequence
 typedef struct SourceSequenceArray
 {
 	int count;
-	SourceSequence *array;         /* malloc'ed area */
+	SourceSequence *array;         /* arena allocated */
+	MemoryArena arena;
 } SourceSequenceArray;
 
 /*
@@ -179,6 +206,7 @@ typedef struct SourceIndex
 	char constraintDef[BUFSIZE];
 	char indexRestoreListName[RESTORE_LIST_NAMEDATALEN];
 	char constraintRestoreListName[RESTORE_LIST_NAMEDATALEN];
+	int64_t bytes;              /* pg_relation_size, build cost estimate */
 
 	UT_hash_handle hh;          /* makes this structure hashable */
 } SourceIndex;
@@ -187,7 +215,8 @@ typedef struct SourceIndex
 typedef struct SourceIndexArray
 {
 	int count;
-	SourceIndex *array;         /* malloc'ed area */
+	SourceIndex *array;         /* arena allocated */
+	MemoryArena arena;
 } SourceIndexArray;
 
 
@@ -232,6 +261,7 @@ bool schema_list_collations(PGSQL *pgsql, SourceCollationArray *array);
 
 bool schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 										SourceFilters *filters,
+										bool estimateSizes,
 										bool force,
 										bool *createdTableSizeTable);
 
@@ -247,12 +277,16 @@ bool schema_list_ordinary_tables_without_pk(PGSQL *pgsql,
 
 bool schema_list_partitions(PGSQL *pgsql, SourceTable *table, uint64_t partSize);
 
+bool schema_list_table_activity(PGSQL *pgsql, SourceTableArray *tableArray);
+
 bool schema_list_sequences(PGSQL *pgsql,
 						   SourceFilters *filters,
 						   SourceSequenceArray *seqArray);
 
-bool schema_get_sequence_value(PGSQL *pgsql, SourceSequence *seq);
-bool schema_set_sequence_value(PGSQL *pgsql, SourceSequence *seq);
+bool schema_get_sequence_values(PGSQL *pgsql,
+								SourceSequenceArray *sequenceArray);
+bool schema_set_sequence_values(PGSQL *pgsql,
+								SourceSequenceArray *sequenceArray);
 
 bool schema_list_all_indexes(PGSQL *pgsql,
 							 SourceFilters *filters,
@@ -267,4 +301,11 @@ bool schema_list_pg_depend(PGSQL *pgsql,
 						   SourceFilters *filters,
 						   SourceDependArray *dependArray);
 
+bool schema_list_filtered_objects(PGSQL *pgsql,
+								  SourceFilters *filters,
+								  SourceTableArray *tableArray,
+								  SourceIndexArray *indexArray,
+								  SourceSequenceArray *sequenceArray,
+								  SourceDependArray *dependArray);
+
 #endif /* SCHEMA_H */
@@ -30,6 +30,18 @@ copydb_prepare_sequence_specs(CopyDataSpec *specs, PGSQL *pgsql)
 {
 	SourceSequenceArray *sequenceArray = &(specs->sequenceArray);
 
+	/*
+	 * The schema cache file includes the sequence values, as fetched under the
+	 * same snapshot that we are re-using now.
+	 */
+	if (specs->schemaCacheLoaded)
+	{
+		log_info("Re-using %d sequences from schema cache file \"%s\"",
+				 sequenceArray->count,
+				 specs->cfPaths.schemacachefile);
+		return true;
+	}
+
 	if (!schema_list_sequences(pgsql, &(specs->filters), sequenceArray))
 	{
 		/* errors have already been logged */
@@ -38,28 +50,14 @@ copydb_prepare_sequence_specs(CopyDataSpec *specs, PGSQL *pgsql)
 
 	log_info("Fetching information for %d sequences", sequenceArray->count);
 
-	int errors = 0;
-
-	for (int seqIndex = 0; seqIndex < sequenceArray->count; seqIndex++)
+	/* fetch the values of all the sequences in batched queries */
+	if (!schema_get_sequence_values(pgsql, sequenceArray))
 	{
-		SourceSequence *seq = &(sequenceArray->array[seqIndex]);
-
-		char qname[BUFSIZE] = { 0 };
-
-		sformat(qname, sizeof(qname), "\"%s\".\"%s\"",
-				seq->nspname,
-				seq->relname);
-
-		if (!schema_get_sequence_value(pgsql, seq))
-		{
-			/* just skip this one */
-			log_warn("Failed to get sequence values for %s", qname);
-			++errors;
-			continue;
-		}
+		/* errors have already been logged */
+		return false;
 	}
 
-	return errors == 0;
+	return true;
 }
 
 
@@ -156,23 +154,11 @@ copydb_copy_all_sequences(CopyDataSpec *specs)
 
 	SourceSequenceArray *sequenceArray = &(specs->sequenceArray);
 
-	for (int seqIndex = 0; seqIndex < sequenceArray->count; seqIndex++)
+	/* a single batched statement resets all the sequences */
+	if (!schema_set_sequence_values(&dst, sequenceArray))
 	{
-		SourceSequence *seq = &(sequenceArray->array[seqIndex]);
-
-		char qname[BUFSIZE] = { 0 };
-
-		sformat(qname, sizeof(qname), "\"%s\".\"%s\"",
-				seq->nspname,
-				seq->relname);
-
-		if (!schema_set_sequence_value(&dst, seq))
-		{
-			/* just skip this one */
-			log_warn("Failed to set sequence values for %s", qname);
-			++errors;
-			continue;
-		}
+		/* errors have already been logged */
+		++errors;
 	}
 
 	if (!pgsql_commit(&dst))
@@ -190,9 +176,7 @@ copydb_copy_all_sequences(CopyDataSpec *specs)
 
 	if (errors > 0)
 	{
-		log_warn("Failed to set values for %d sequences, "
-				 "see above for details",
-				 errors);
+		log_warn("Failed to reset sequences values, see above for details");
 		return false;
 	}
 
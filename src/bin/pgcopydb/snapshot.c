@@ -8,6 +8,7 @@
 
 #include "copydb.h"
 #include "log.h"
+#include "pidfile.h"
 
 /*
  * copydb_copy_snapshot initializes a new TransactionSnapshot from another
@@ -273,6 +274,20 @@ copydb_prepare_snapshot(CopyDataSpec *copySpecs)
 	 */
 	TransactionSnapshot *sourceSnapshot = &(copySpecs->sourceSnapshot);
 
+	/*
+	 * When a `pgcopydb snapshot` service is running in this work directory,
+	 * attach to the snapshot it holds rather than exporting a new one, so
+	 * that a whole pipeline of pgcopydb commands shares a single snapshot.
+	 */
+	if (IS_EMPTY_STRING_BUFFER(sourceSnapshot->snapshot))
+	{
+		if (!copydb_attach_snapshot_service(copySpecs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	if (IS_EMPTY_STRING_BUFFER(sourceSnapshot->snapshot))
 	{
 		if (!copydb_export_snapshot(sourceSnapshot))
@@ -309,6 +324,81 @@ copydb_prepare_snapshot(CopyDataSpec *copySpecs)
 }
 
 
+/*
+ * copydb_attach_snapshot_service checks if a `pgcopydb snapshot` process is
+ * currently running in our work directory, holding an exported snapshot open
+ * on the source database. When that's the case, fill-in our source snapshot
+ * from the snapshot file it maintains, so that this command re-uses the
+ * snapshot without exporting a new one.
+ *
+ * Finding no service to attach to is not an error: the snapshot buffer is
+ * then left empty and the caller exports its own snapshot as usual.
+ */
+bool
+copydb_attach_snapshot_service(CopyDataSpec *copySpecs)
+{
+	TransactionSnapshot *sourceSnapshot = &(copySpecs->sourceSnapshot);
+
+	char auxPidfile[MAXPGPATH] = { 0 };
+
+	sformat(auxPidfile, sizeof(auxPidfile), "%s/pgcopydb.aux.pid",
+			copySpecs->cfPaths.topdir);
+
+	if (!file_exists(auxPidfile) || !file_exists(copySpecs->cfPaths.snfile))
+	{
+		return true;
+	}
+
+	pid_t servicePid = 0;
+
+	if (!read_pidfile(auxPidfile, &servicePid))
+	{
+		/* a stale pidfile means there is no service to attach to */
+		return true;
+	}
+
+	/* `pgcopydb snapshot` itself must not attach to its own previous run */
+	if (servicePid == getpid())
+	{
+		return true;
+	}
+
+	char *contents = NULL;
+	long size = 0L;
+
+	if (!read_file(copySpecs->cfPaths.snfile, &contents, &size))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* make sure to use only the first line of the file, without \n */
+	char *lines[BUFSIZE] = { 0 };
+	int lineCount = splitLines(contents, lines, BUFSIZE);
+
+	if (lineCount != 1)
+	{
+		log_error("Failed to parse the snapshot file \"%s\"",
+				  copySpecs->cfPaths.snfile);
+		free(contents);
+		return false;
+	}
+
+	strlcpy(sourceSnapshot->snapshot,
+			lines[0],
+			sizeof(sourceSnapshot->snapshot));
+
+	free(contents);
+
+	log_info("[SNAPSHOT] Attaching to snapshot \"%s\" held by the "
+			 "pgcopydb snapshot service with pid %d",
+			 sourceSnapshot->snapshot,
+			 servicePid);
+
+	return true;
+}
+
+
 /*
  * copydb_create_logical_replication_slot uses Postgres logical replication
  * protocol command CREATE_REPLICATION_SLOT to create a replication slot on the
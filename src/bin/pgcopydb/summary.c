@@ -4,14 +4,18 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <stddef.h>
+#include <unistd.h>
 
 #include "parson.h"
 
 #include "copydb.h"
 #include "env_utils.h"
 #include "log.h"
+#include "mem_utils.h"
 #include "pidfile.h"
 #include "schema.h"
 #include "signals.h"
@@ -21,6 +25,9 @@
 
 static void prepareLineSeparator(char dashes[], int size);
 
+static uint32_t summary_record_checksum(SummaryRecord *record);
+static int compareSummaryRecords(const void *a, const void *b);
+
 
 /*
  * create_table_summary creates a summary file for the copy operation of a
@@ -34,7 +41,7 @@ write_table_summary(CopyTableSummary *summary, char *filename)
 	char contents[BUFSIZE] = { 0 };
 
 	sformat(contents, BUFSIZE,
-			"%d\n%u\n%s\n%s\n%lld\n%lld\n%lld\n%s\n",
+			"%d\n%u\n%s\n%s\n%lld\n%lld\n%lld\n%lld\n%lld\n%s\n",
 			summary->pid,
 			summary->table->oid,
 			summary->table->nspname,
@@ -42,6 +49,8 @@ write_table_summary(CopyTableSummary *summary, char *filename)
 			(long long) summary->startTime,
 			(long long) summary->doneTime,
 			(long long) summary->durationMs,
+			(long long) summary->bytesTransmitted,
+			(long long) summary->rowsTransmitted,
 			summary->command);
 
 	/* write the summary to the doneFile */
@@ -91,6 +100,24 @@ prepare_table_summary_as_json(CopyTableSummary *summary,
 						   "start-time-string",
 						   startTimeStr);
 
+	json_object_set_number(jsSummaryObj,
+						   "bytes",
+						   (double) summary->bytesTransmitted);
+
+	json_object_set_number(jsSummaryObj,
+						   "rows",
+						   (double) summary->rowsTransmitted);
+
+	/* effective transfer speed, only known when the COPY is done */
+	if (summary->durationMs > 0)
+	{
+		double mbps =
+			(summary->bytesTransmitted / (1024.0 * 1024.0)) /
+			(summary->durationMs / 1000.0);
+
+		json_object_set_number(jsSummaryObj, "transfer-mbps", mbps);
+	}
+
 	json_object_set_string(jsSummaryObj, "command", summary->command);
 
 	/* attach the JSON array to the main JSON object under the provided key */
@@ -126,13 +153,14 @@ read_table_summary(CopyTableSummary *summary, const char *filename)
 	char *fileLines[BUFSIZE] = { 0 };
 	int lineCount = splitLines(fileContents, fileLines, BUFSIZE);
 
-	if (lineCount < COPY_TABLE_SUMMARY_LINES)
+	/* summary files written before bytes/rows were tracked have 2 lines less */
+	if (lineCount < COPY_TABLE_SUMMARY_LINES - 2)
 	{
 		log_error("Failed to parse summary file \"%s\" which contains only "
 				  "%d lines, at least %d lines are expected",
 				  filename,
 				  lineCount,
-				  COPY_TABLE_SUMMARY_LINES);
+				  COPY_TABLE_SUMMARY_LINES - 2);
 
 		free(fileContents);
 
@@ -181,8 +209,27 @@ read_table_summary(CopyTableSummary *summary, const char *filename)
 		return false;
 	}
 
+	summary->bytesTransmitted = 0;
+	summary->rowsTransmitted = 0;
+
+	int commandLineNo = 7;
+
+	if (lineCount >= COPY_TABLE_SUMMARY_LINES)
+	{
+		if (!stringToUInt64(fileLines[7], &(summary->bytesTransmitted)) ||
+			!stringToUInt64(fileLines[8], &(summary->rowsTransmitted)))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		commandLineNo = 9;
+	}
+
 	/* last summary line in the file is the SQL command */
-	strlcpy(summary->command, fileLines[7], sizeof(summary->command));
+	strlcpy(summary->command,
+			fileLines[commandLineNo],
+			sizeof(summary->command));
 
 	/* we can't provide instr_time readers */
 	summary->startTimeInstr = (instr_time) {
@@ -198,7 +245,9 @@ read_table_summary(CopyTableSummary *summary, const char *filename)
 
 /*
  * open_table_summary initializes the time elements of a table summary and
- * writes the summary in the given filename. Typically, the lockFile.
+ * writes the summary in the given filename. Typically, the lockFile. When the
+ * filename is NULL only the time elements are initialized, the shared-memory
+ * state table replaces the lockFile then.
  */
 bool
 open_table_summary(CopyTableSummary *summary, char *filename)
@@ -206,6 +255,8 @@ open_table_summary(CopyTableSummary *summary, char *filename)
 	summary->startTime = time(NULL);
 	summary->doneTime = 0;
 	summary->durationMs = 0;
+	summary->bytesTransmitted = 0;
+	summary->rowsTransmitted = 0;
 	summary->startTimeInstr = (instr_time) {
 		0
 	};
@@ -215,6 +266,12 @@ open_table_summary(CopyTableSummary *summary, char *filename)
 
 	INSTR_TIME_SET_CURRENT(summary->startTimeInstr);
 
+	if (filename == NULL)
+	{
+		/* time tracking only, the summary is not written to disk */
+		return true;
+	}
+
 	return write_table_summary(summary, filename);
 }
 
@@ -315,7 +372,9 @@ read_table_index_file(SourceIndexArray *indexArray, char *filename)
 	 * constraintOid (which could be zero). No comments, etc.
 	 */
 	indexArray->count = lineCount / 2;
-	indexArray->array = (SourceIndex *) calloc(lineCount, sizeof(SourceIndex));
+	indexArray->array = (SourceIndex *)
+						arena_alloc(&(indexArray->arena),
+									lineCount * sizeof(SourceIndex));
 
 	int pos = 0;
 
@@ -401,13 +460,13 @@ read_index_summary(CopyIndexSummary *summary, const char *filename)
 	char *fileLines[BUFSIZE] = { 0 };
 	int lineCount = splitLines(fileContents, fileLines, BUFSIZE);
 
-	if (lineCount < COPY_TABLE_SUMMARY_LINES)
+	if (lineCount < COPY_INDEX_SUMMARY_LINES)
 	{
 		log_error("Failed to parse summary file \"%s\" which contains only "
 				  "%d lines, at least %d lines are expected",
 				  filename,
 				  lineCount,
-				  COPY_TABLE_SUMMARY_LINES);
+				  COPY_INDEX_SUMMARY_LINES);
 
 		free(fileContents);
 
@@ -631,6 +690,212 @@ read_blobs_summary(CopyBlobsSummary *summary, char *filename)
 }
 
 
+/*
+ * summary_record_checksum computes an FNV-1a checksum of the fields of the
+ * given summary record, up to (and excluding) the checksum field itself.
+ */
+static uint32_t
+summary_record_checksum(SummaryRecord *record)
+{
+	uint32_t hash = 0x811c9dc5;
+	unsigned char *bytes = (unsigned char *) record;
+	size_t size = offsetof(SummaryRecord, checksum);
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x01000193;
+	}
+
+	return hash;
+}
+
+
+/*
+ * summary_append_record appends the given fixed-size record to the binary
+ * summary log file, creating the file first if needed. A record is written
+ * with a single write(2) call on a file opened with O_APPEND, so that
+ * concurrent workers appending to the same log do not interleave.
+ */
+bool
+summary_append_record(const char *filename, SummaryRecord *record)
+{
+	SummaryRecord rec;
+
+	/* zero the padding bytes so that the checksum is deterministic */
+	memset(&rec, 0, sizeof(SummaryRecord));
+
+	rec.magic = SUMMARY_RECORD_MAGIC;
+	rec.type = record->type;
+	rec.oid = record->oid;
+	rec.partNumber = record->partNumber;
+	rec.pid = record->pid;
+	rec.startTime = record->startTime;
+	rec.doneTime = record->doneTime;
+	rec.durationMs = record->durationMs;
+
+	rec.checksum = summary_record_checksum(&rec);
+
+	int fd = open(filename, O_WRONLY | O_APPEND | O_CREAT, 0644);
+
+	if (fd < 0)
+	{
+		log_error("Failed to open summary log file \"%s\": %m", filename);
+		return false;
+	}
+
+	if (write(fd, &rec, sizeof(SummaryRecord)) != sizeof(SummaryRecord))
+	{
+		log_error("Failed to write %lld bytes to summary log file \"%s\": %m",
+				  (long long) sizeof(SummaryRecord),
+				  filename);
+		(void) close(fd);
+		return false;
+	}
+
+	if (close(fd) != 0)
+	{
+		log_error("Failed to close summary log file \"%s\": %m", filename);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * compareSummaryRecords is a qsort/bsearch comparator for summary records,
+ * ordering them by type, oid, and partNumber.
+ */
+static int
+compareSummaryRecords(const void *a, const void *b)
+{
+	SummaryRecord *lhs = (SummaryRecord *) a;
+	SummaryRecord *rhs = (SummaryRecord *) b;
+
+	if (lhs->type != rhs->type)
+	{
+		return lhs->type < rhs->type ? -1 : 1;
+	}
+
+	if (lhs->oid != rhs->oid)
+	{
+		return lhs->oid < rhs->oid ? -1 : 1;
+	}
+
+	if (lhs->partNumber != rhs->partNumber)
+	{
+		return lhs->partNumber < rhs->partNumber ? -1 : 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * summary_read_records reads the binary summary log file in a single pass and
+ * fills-in the given array, sorted for bsearch lookups. Torn or corrupted
+ * records are skipped. A missing log file is not an error, the array is then
+ * just empty and callers fall back to the per-object summary files.
+ */
+bool
+summary_read_records(const char *filename, SummaryRecordArray *records)
+{
+	records->count = 0;
+	records->array = NULL;
+
+	if (!file_exists(filename))
+	{
+		return true;
+	}
+
+	char *contents = NULL;
+	long fileSize = 0L;
+
+	if (!read_file(filename, &contents, &fileSize))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	int maxCount = fileSize / sizeof(SummaryRecord);
+
+	if (maxCount == 0)
+	{
+		free(contents);
+		return true;
+	}
+
+	records->array =
+		(SummaryRecord *) malloc(maxCount * sizeof(SummaryRecord));
+
+	if (records->array == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(contents);
+		return false;
+	}
+
+	int count = 0;
+
+	for (long offset = 0;
+		 offset + (long) sizeof(SummaryRecord) <= fileSize;
+		 offset += sizeof(SummaryRecord))
+	{
+		SummaryRecord *record = (SummaryRecord *) (contents + offset);
+
+		if (record->magic != SUMMARY_RECORD_MAGIC ||
+			record->checksum != summary_record_checksum(record))
+		{
+			log_debug("Skipping invalid summary record at offset %ld "
+					  "in \"%s\"",
+					  offset,
+					  filename);
+			continue;
+		}
+
+		records->array[count++] = *record;
+	}
+
+	free(contents);
+
+	records->count = count;
+
+	qsort(records->array, count, sizeof(SummaryRecord),
+		  &compareSummaryRecords);
+
+	return true;
+}
+
+
+/*
+ * summary_lookup_record searches a sorted summary record array for the record
+ * of the given type, oid, and partNumber. Returns NULL when not found.
+ */
+SummaryRecord *
+summary_lookup_record(SummaryRecordArray *records,
+					  SummaryRecordType type,
+					  uint32_t oid,
+					  uint32_t partNumber)
+{
+	if (records->count == 0)
+	{
+		return NULL;
+	}
+
+	SummaryRecord key = {
+		.type = type,
+		.oid = oid,
+		.partNumber = partNumber
+	};
+
+	return (SummaryRecord *) bsearch(&key,
+									 records->array,
+									 records->count,
+									 sizeof(SummaryRecord),
+									 &compareSummaryRecords);
+}
+
+
 /*
  * summary_set_current_time sets the current timing to the appropriate
  * TopLevelTimings entry given the step we're at.
@@ -1043,9 +1308,32 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 		return false;
 	}
 
+	/*
+	 * Read the binary summary log in a single pass: most of the time it
+	 * contains all the records we need, and we then avoid opening one summary
+	 * file per table and per index here.
+	 */
+	SummaryRecordArray records = { 0 };
+
+	if (!summary_read_records(specs->cfPaths.summarylog, &records))
+	{
+		/* errors have already been logged, fall back to summary files */
+		records.count = 0;
+	}
+
 	for (int tableIndex = 0; tableIndex < tableSpecsArray->count; tableIndex++)
 	{
-		CopyTableDataSpec *tableSpecs = &(tableSpecsArray->array[tableIndex]);
+		/* build the full table specs on-demand from the compact entry */
+		CopyTableDataSpec tableSpecsData = { 0 };
+		CopyTableDataSpec *tableSpecs = &tableSpecsData;
+
+		if (!copydb_init_table_specs_for_item(tableSpecs, specs, tableIndex))
+		{
+			/* errors have already been logged */
+			free(records.array);
+			return false;
+		}
+
 		SourceTable *table = tableSpecs->sourceTable;
 
 		SummaryTableEntry *entry = &(summaryTable->array[tableIndex]);
@@ -1058,17 +1346,36 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 		strlcpy(entry->relname, table->relname, sizeof(entry->relname));
 
 		/* the specs doesn't contain timing information */
-		CopyTableSummary tableSummary = { .table = table };
+		uint64_t tableDurationMs = 0;
+
+		SummaryRecord *record =
+			summary_lookup_record(&records,
+								  SUMMARY_RECORD_TABLE,
+								  table->oid,
+								  tableSpecs->part.partNumber);
 
-		if (!read_table_summary(&tableSummary, tableSpecs->tablePaths.doneFile))
+		if (record != NULL)
 		{
-			/* errors have already been logged */
-			return false;
+			tableDurationMs = record->durationMs;
+		}
+		else
+		{
+			CopyTableSummary tableSummary = { .table = table };
+
+			if (!read_table_summary(&tableSummary,
+									tableSpecs->tablePaths.doneFile))
+			{
+				/* errors have already been logged */
+				free(records.array);
+				return false;
+			}
+
+			tableDurationMs = tableSummary.durationMs;
 		}
 
-		timings->tableDurationMs += tableSummary.durationMs;
+		timings->tableDurationMs += tableDurationMs;
 
-		(void) IntervalToString(tableSummary.durationMs,
+		(void) IntervalToString(tableDurationMs,
 								entry->tableMs,
 								sizeof(entry->tableMs));
 
@@ -1088,10 +1395,11 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 									   tableSpecs->tablePaths.idxListFile))
 			{
 				/* errors have already been logged */
+				free(records.array);
 				return false;
 			}
 
-			/* for reach index, read the index summary */
+			/* for reach index, find the summary record or read the summary */
 			for (int i = 0; i < indexArray.count; i++)
 			{
 				SourceIndex *index = &(indexArray.array[i]);
@@ -1102,17 +1410,32 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 				if (!copydb_init_index_paths(cfPaths, index, &indexPaths))
 				{
 					/* errors have already been logged */
+					free(records.array);
 					return false;
 				}
 
+				SummaryRecord *idxRecord =
+					summary_lookup_record(&records,
+										  SUMMARY_RECORD_INDEX,
+										  index->indexOid,
+										  0);
+
+				if (idxRecord != NULL)
+				{
+					/* accumulate total duration of creating all the indexes */
+					timings->indexDurationMs += idxRecord->durationMs;
+					indexingDurationMs += idxRecord->durationMs;
+				}
+
 				/* when a table has no indexes, the file doesn't exists */
-				if (file_exists(indexPaths.doneFile))
+				else if (file_exists(indexPaths.doneFile))
 				{
 					CopyIndexSummary indexSummary = { .index = index };
 
 					if (!read_index_summary(&indexSummary, indexPaths.doneFile))
 					{
 						/* errors have already been logged */
+						free(records.array);
 						return false;
 					}
 
@@ -1121,7 +1444,18 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 					indexingDurationMs += indexSummary.durationMs;
 				}
 
-				if (file_exists(indexPaths.constraintDoneFile))
+				SummaryRecord *conRecord =
+					summary_lookup_record(&records,
+										  SUMMARY_RECORD_CONSTRAINT,
+										  index->indexOid,
+										  0);
+
+				if (conRecord != NULL)
+				{
+					timings->indexDurationMs += conRecord->durationMs;
+					indexingDurationMs += conRecord->durationMs;
+				}
+				else if (file_exists(indexPaths.constraintDoneFile))
 				{
 					CopyIndexSummary indexSummary = { .index = index };
 
@@ -1129,6 +1463,7 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 											indexPaths.constraintDoneFile))
 					{
 						/* errors have already been logged */
+						free(records.array);
 						return false;
 					}
 
@@ -1150,6 +1485,8 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 								sizeof(entry->indexMs));
 	}
 
+	free(records.array);
+
 	/*
 	 * Also read the blobs summary file.
 	 */
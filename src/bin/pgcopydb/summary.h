@@ -21,7 +21,7 @@
 #include "string_utils.h"
 #include "schema.h"
 
-#define COPY_TABLE_SUMMARY_LINES 8
+#define COPY_TABLE_SUMMARY_LINES 10
 
 typedef struct CopyTableSummary
 {
@@ -30,6 +30,8 @@ typedef struct CopyTableSummary
 	uint64_t startTime;         /* time(NULL) at start time */
 	uint64_t doneTime;          /* time(NULL) at done time */
 	uint64_t durationMs;        /* instr_time duration in milliseconds */
+	uint64_t bytesTransmitted;  /* COPY bytes seen on the wire */
+	uint64_t rowsTransmitted;   /* COPY rows seen on the wire */
 	instr_time startTimeInstr;  /* internal instr_time tracker */
 	instr_time durationInstr;   /* internal instr_time tracker */
 	char command[BUFSIZE];      /* SQL command */
@@ -61,6 +63,46 @@ typedef struct CopyBlobsSummary
 } CopyBlobsSummary;
 
 
+/*
+ * On top of the per-object summary files, workers append a fixed-size binary
+ * record to a single append-only summary log when they are done with a table,
+ * an index, or a constraint. print_summary then reads the whole log back in a
+ * single pass rather than opening one summary file per object, which gets
+ * expensive with hundreds of thousands of tables and indexes.
+ *
+ * Each record carries its own checksum so that a record torn by a crash
+ * mid-append is detected and skipped at read time.
+ */
+#define SUMMARY_RECORD_MAGIC 0x53554d52     /* "SUMR" */
+
+typedef enum
+{
+	SUMMARY_RECORD_UNKNOWN = 0,
+	SUMMARY_RECORD_TABLE,
+	SUMMARY_RECORD_INDEX,
+	SUMMARY_RECORD_CONSTRAINT
+} SummaryRecordType;
+
+typedef struct SummaryRecord
+{
+	uint32_t magic;             /* SUMMARY_RECORD_MAGIC */
+	uint32_t type;              /* SummaryRecordType */
+	uint32_t oid;               /* table oid, or index oid */
+	uint32_t partNumber;        /* table COPY partition number, or zero */
+	uint32_t pid;               /* worker pid */
+	uint64_t startTime;         /* time(NULL) at start time */
+	uint64_t doneTime;          /* time(NULL) at done time */
+	uint64_t durationMs;        /* instr_time duration in milliseconds */
+	uint32_t checksum;          /* checksum of the previous fields */
+} SummaryRecord;
+
+typedef struct SummaryRecordArray
+{
+	int count;
+	SummaryRecord *array;       /* malloc'ed area */
+} SummaryRecordArray;
+
+
 /*
  * To print the summary, we fill-in a table in-memory and then compute the max
  * size of each column and then we can adjust the display to the actual size
@@ -172,6 +214,13 @@ bool read_table_index_file(SourceIndexArray *indexArray, char *filename);
 bool write_blobs_summary(CopyBlobsSummary *summary, char *filename);
 bool read_blobs_summary(CopyBlobsSummary *summary, char *filename);
 
+bool summary_append_record(const char *filename, SummaryRecord *record);
+bool summary_read_records(const char *filename, SummaryRecordArray *records);
+SummaryRecord * summary_lookup_record(SummaryRecordArray *records,
+									  SummaryRecordType type,
+									  uint32_t oid,
+									  uint32_t partNumber);
+
 
 void summary_set_current_time(TopLevelTimings *timings, TimingStep step);
 
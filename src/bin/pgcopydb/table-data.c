@@ -13,6 +13,7 @@
 #include "env_utils.h"
 #include "lock_utils.h"
 #include "log.h"
+#include "metrics.h"
 #include "pidfile.h"
 #include "schema.h"
 #include "signals.h"
@@ -109,10 +110,408 @@ terminate:
 				 specs->indexQueue.qId);
 	}
 
+	if (!queue_unlink(&(specs->constraintQueue)))
+	{
+		log_warn("Failed to remove constraint process queue %d, "
+				 "see above for details",
+				 specs->constraintQueue.qId);
+	}
+
 	return errors == 0;
 }
 
 
+/*
+ * copydb_prepare_table_state creates the shared-memory state table used for
+ * in-run coordination of the COPY worker processes, with one entry per table
+ * specs array item. Entries for tables already copied by a previous run are
+ * marked done, in a single pass over the on-disk doneFiles snapshot.
+ */
+static bool
+copydb_prepare_table_state(CopyDataSpec *specs)
+{
+	CopyTableDataSpecsArray *tableSpecsArray = &(specs->tableSpecsArray);
+
+	if (tableSpecsArray->count == 0)
+	{
+		return true;
+	}
+
+	if (!shmseg_create(&(specs->tableStateSegment),
+					   tableSpecsArray->count * sizeof(TableStateEntry)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	specs->tableState = (TableStateEntry *) specs->tableStateSegment.ptr;
+
+	for (int i = 0; i < tableSpecsArray->count; i++)
+	{
+		CopyTableDataSpecItem *item = &(tableSpecsArray->array[i]);
+		TableStateEntry *entry = &(specs->tableState[i]);
+
+		SourceTable *source = item->sourceTable;
+
+		entry->oid = source->oid;
+		entry->partNumber = item->partNumber;
+
+		TableFilePaths tablePaths = { 0 };
+
+		if (source->partsArray.count >= 1)
+		{
+			(void) copydb_init_tablepaths_for_part(&(specs->cfPaths),
+												   &tablePaths,
+												   source->oid,
+												   item->partNumber);
+		}
+		else
+		{
+			(void) copydb_init_tablepaths(&(specs->cfPaths),
+										  &tablePaths,
+										  source->oid);
+		}
+
+		if (file_exists(tablePaths.doneFile))
+		{
+			entry->state = TABLE_COPY_STATE_DONE;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_truncate_target_tables truncates all the target tables upfront,
+ * before the COPY worker processes are started, using large batched TRUNCATE
+ * statements with many tables each, one transaction per batch. That replaces
+ * the long series of tiny single-table transactions (each with its own lock
+ * acquisition) that a large tables count would otherwise incur.
+ *
+ * The per-table TRUNCATE that pg_copy runs in the same transaction as the
+ * COPY is kept as-is: it is instant on the now-empty tables and it is what
+ * allows using COPY FREEZE, which requires the table to have been truncated
+ * in the current transaction.
+ *
+ * Tables that are split into same-table COPY partitions get their
+ * truncateDoneFile written here, so that the workers skip the serialized
+ * critical section where the first part to be processed does the TRUNCATE.
+ */
+static bool
+copydb_truncate_target_tables(CopyDataSpec *specs)
+{
+	CopyTableDataSpecsArray *tableSpecsArray = &(specs->tableSpecsArray);
+
+	/* when using `pgcopydb copy table-data`, we don't truncate */
+	if (specs->section == DATA_SECTION_TABLE_DATA)
+	{
+		return true;
+	}
+
+	/*
+	 * When resuming, tables that have been copied already must not be
+	 * truncated again: skip the upfront phase entirely and rely on the
+	 * per-table logic, which knows about doneFiles and checkpoints.
+	 */
+	if (specs->resume)
+	{
+		log_debug("Skipping the upfront TRUNCATE phase, per --resume");
+		return true;
+	}
+
+	PGSQL dst = { 0 };
+
+	if (!pgsql_init(&dst, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* execute one TRUNCATE statement (one transaction) per batch of tables */
+	dst.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	int batchSize = 512;
+	int inBatch = 0;
+	int totalCount = 0;
+
+	PQExpBuffer query = NULL;
+
+	for (int i = 0; i < tableSpecsArray->count; i++)
+	{
+		CopyTableDataSpecItem *item = &(tableSpecsArray->array[i]);
+		SourceTable *source = item->sourceTable;
+
+		/* a table split into COPY partitions has one entry per part */
+		if (item->partNumber > 0)
+		{
+			continue;
+		}
+
+		/* respect --filters exclude-table-data: keep the target table data */
+		if (source->excludeData)
+		{
+			continue;
+		}
+
+		if (query == NULL)
+		{
+			query = createPQExpBuffer();
+			appendPQExpBuffer(query, "TRUNCATE ONLY \"%s\".\"%s\"",
+							  source->nspname,
+							  source->relname);
+		}
+		else
+		{
+			appendPQExpBuffer(query, ", \"%s\".\"%s\"",
+							  source->nspname,
+							  source->relname);
+		}
+
+		++inBatch;
+		++totalCount;
+
+		if (inBatch < batchSize)
+		{
+			continue;
+		}
+
+		/* memory allocation could have failed while building string */
+		if (PQExpBufferBroken(query))
+		{
+			log_error("Failed to create TRUNCATE query: out of memory");
+			destroyPQExpBuffer(query);
+			return false;
+		}
+
+		if (!pgsql_execute(&dst, query->data))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(query);
+			return false;
+		}
+
+		destroyPQExpBuffer(query);
+		query = NULL;
+		inBatch = 0;
+	}
+
+	/* send the last, probably incomplete, batch */
+	if (query != NULL)
+	{
+		if (PQExpBufferBroken(query))
+		{
+			log_error("Failed to create TRUNCATE query: out of memory");
+			destroyPQExpBuffer(query);
+			return false;
+		}
+
+		if (!pgsql_execute(&dst, query->data))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(query);
+			return false;
+		}
+
+		destroyPQExpBuffer(query);
+	}
+
+	(void) pgsql_finish(&dst);
+
+	/*
+	 * Mark the TRUNCATE as done for tables that are split into same-table
+	 * COPY partitions, sparing the workers' critical section.
+	 */
+	for (int i = 0; i < tableSpecsArray->count; i++)
+	{
+		CopyTableDataSpecItem *item = &(tableSpecsArray->array[i]);
+		SourceTable *source = item->sourceTable;
+
+		if (source->partsArray.count > 1 &&
+			item->partNumber == 0 &&
+			!source->excludeData)
+		{
+			char truncateDoneFile[MAXPGPATH] = { 0 };
+
+			sformat(truncateDoneFile, sizeof(truncateDoneFile),
+					"%s/%u.truncate",
+					specs->cfPaths.tbldir,
+					source->oid);
+
+			if (!write_file("", 0, truncateDoneFile))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+	}
+
+	if (totalCount > 0)
+	{
+		log_info("TRUNCATEd %d tables on the target database", totalCount);
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_drop_target_indexes drops the target indexes and constraints of the
+ * tables that are about to be copied, per --drop-indexes. Refreshing an
+ * existing target schema would otherwise COPY into fully indexed tables,
+ * which is many times slower than loading into bare tables and rebuilding
+ * the indexes in parallel afterwards, as the regular CREATE INDEX and
+ * constraint workers do once each table's COPY is done.
+ *
+ * The statements are batched the same way as the upfront TRUNCATE phase, and
+ * use IF EXISTS throughout so that the phase runs the same on a pristine
+ * target.
+ */
+static bool
+copydb_drop_target_indexes(CopyDataSpec *specs)
+{
+	CopyTableDataSpecsArray *tableSpecsArray = &(specs->tableSpecsArray);
+
+	/* when using `pgcopydb copy table-data`, indexes are not rebuilt */
+	if (specs->section == DATA_SECTION_TABLE_DATA)
+	{
+		return true;
+	}
+
+	/*
+	 * When resuming, indexes that have been rebuilt already by a previous
+	 * run must not be dropped again: their done files make the CREATE INDEX
+	 * workers skip them.
+	 */
+	if (specs->resume)
+	{
+		log_debug("Skipping the upfront DROP INDEX phase, per --resume");
+		return true;
+	}
+
+	PGSQL dst = { 0 };
+
+	if (!pgsql_init(&dst, specs->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	dst.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	int batchSize = 512;
+	int inBatch = 0;
+	int totalCount = 0;
+
+	PQExpBuffer query = NULL;
+
+	for (int i = 0; i < tableSpecsArray->count; i++)
+	{
+		CopyTableDataSpecItem *item = &(tableSpecsArray->array[i]);
+		SourceTable *source = item->sourceTable;
+
+		/* a table split into COPY partitions has one entry per part */
+		if (item->partNumber > 0)
+		{
+			continue;
+		}
+
+		/* respect --filters exclude-table-data: keep the target indexes */
+		if (source->excludeData)
+		{
+			continue;
+		}
+
+		SourceIndexList *indexListEntry = source->firstIndex;
+
+		for (; indexListEntry != NULL; indexListEntry = indexListEntry->next)
+		{
+			SourceIndex *index = indexListEntry->index;
+
+			if (query == NULL)
+			{
+				query = createPQExpBuffer();
+			}
+
+			/* indexes that back a constraint are dropped with the ALTER */
+			if (index->constraintOid > 0)
+			{
+				appendPQExpBuffer(query,
+								  "ALTER TABLE \"%s\".\"%s\" "
+								  "DROP CONSTRAINT IF EXISTS \"%s\";",
+								  index->tableNamespace,
+								  index->tableRelname,
+								  index->constraintName);
+			}
+			else
+			{
+				appendPQExpBuffer(query,
+								  "DROP INDEX IF EXISTS \"%s\".\"%s\";",
+								  index->indexNamespace,
+								  index->indexRelname);
+			}
+
+			++inBatch;
+			++totalCount;
+
+			if (inBatch < batchSize)
+			{
+				continue;
+			}
+
+			/* memory allocation could have failed while building string */
+			if (PQExpBufferBroken(query))
+			{
+				log_error("Failed to create DROP INDEX query: out of memory");
+				destroyPQExpBuffer(query);
+				return false;
+			}
+
+			if (!pgsql_execute(&dst, query->data))
+			{
+				/* errors have already been logged */
+				destroyPQExpBuffer(query);
+				return false;
+			}
+
+			destroyPQExpBuffer(query);
+			query = NULL;
+			inBatch = 0;
+		}
+	}
+
+	/* send the last, probably incomplete, batch */
+	if (query != NULL)
+	{
+		if (PQExpBufferBroken(query))
+		{
+			log_error("Failed to create DROP INDEX query: out of memory");
+			destroyPQExpBuffer(query);
+			return false;
+		}
+
+		if (!pgsql_execute(&dst, query->data))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(query);
+			return false;
+		}
+
+		destroyPQExpBuffer(query);
+	}
+
+	(void) pgsql_finish(&dst);
+
+	if (totalCount > 0)
+	{
+		log_info("Dropped %d indexes and constraints on the target database",
+				 totalCount);
+	}
+
+	return true;
+}
+
+
 /*
  * copydb_process_table_data forks() as many as specs->tableJobs processes that
  * will all concurrently process TABLE DATA and then CREATE INDEX and then also
@@ -125,11 +524,60 @@ copydb_process_table_data(CopyDataSpec *specs)
 
 	/*
 	 * Now create as many VACUUM ANALYZE sub-processes as needed, per
-	 * --table-jobs. Could be exposed separately as --vacuumJobs too, but
-	 * that's not been done at this time.
+	 * --vacuum-jobs, which defaults to the --table-jobs setting.
 	 */
 	log_trace("copydb_process_table_data: \"%s\"", specs->cfPaths.tbldir);
 
+	/*
+	 * The COPY worker processes coordinate through a shared-memory state
+	 * table, attached before forking them, sparing per-table lock and done
+	 * files metadata traffic during the run.
+	 */
+	if (!copydb_prepare_table_state(specs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/*
+	 * In --distributed mode the local coordination is not enough: several
+	 * pgcopydb hosts share the work and register their claims on the tables
+	 * in the pgcopydb.table_claims table on the target database.
+	 */
+	if (specs->distributed)
+	{
+		if (!coordination_create_claims_table(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/*
+	 * With --drop-indexes, drop the target indexes and constraints before
+	 * the tables are truncated and copied; the regular index and constraint
+	 * workers rebuild them once each table's COPY is done.
+	 */
+	if (specs->dropIndexes)
+	{
+		if (!copydb_drop_target_indexes(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/*
+	 * TRUNCATE the target tables in large batched statements now, rather
+	 * than in one tiny transaction per table as each COPY process reaches
+	 * it.
+	 */
+	if (!copydb_truncate_target_tables(specs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	/*
 	 * Are blobs table data? well pg_dump --section sayth yes.
 	 */
@@ -145,6 +593,12 @@ copydb_process_table_data(CopyDataSpec *specs)
 		return false;
 	}
 
+	if (!copydb_start_constraint_workers(specs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	if (!vacuum_start_workers(specs))
 	{
 		/* errors have already been logged */
@@ -195,6 +649,23 @@ copydb_process_table_data(CopyDataSpec *specs)
 		++errors;
 	}
 
+	/*
+	 * The CREATE INDEX workers queue a table's constraints when they finish
+	 * building its last index: only send the STOP messages to the constraint
+	 * workers once all the CREATE INDEX workers are done producing.
+	 */
+	if (!copydb_wait_for_index_workers(specs))
+	{
+		/* errors have already been logged */
+		++errors;
+	}
+
+	if (!copydb_constraint_workers_send_stop(specs))
+	{
+		/* errors have already been logged */
+		++errors;
+	}
+
 	if (!copydb_wait_for_subprocesses())
 	{
 		log_error("Some sub-processes have exited with error status, "
@@ -269,6 +740,26 @@ copydb_process_table_data_with_workers(CopyDataSpec *specs)
 
 					case 0:
 					{
+						/*
+						 * When --source-standby has been used, spread the
+						 * read load of the COPY workers over the given hot
+						 * standbys, round-robin. The standbys must hold the
+						 * exported snapshot too (hot_standby_feedback), or
+						 * the clone must run with --not-consistent.
+						 */
+						if (specs->sourceStandbyCount > 0)
+						{
+							int n = i % specs->sourceStandbyCount;
+
+							strlcpy(specs->sourceSnapshot.pguri,
+									specs->sourceStandbys[n],
+									sizeof(specs->sourceSnapshot.pguri));
+
+							log_notice("COPY worker %d reads from "
+									   "--source-standby %d",
+									   getpid(), n + 1);
+						}
+
 						/* child process runs the command */
 						if (!copydb_process_table_data_worker(specs))
 						{
@@ -351,13 +842,25 @@ copydb_process_table_data_with_workers(CopyDataSpec *specs)
  * array of tables to COPY over from the source database to the target
  * database.
  *
- * Each process walks through the entire array, and for each entry:
+ * Each process scans through the entire array, and for each entry:
  *
  *  - acquires a semaphore to enter the critical section, alone
  *    - check if the current entry is already done, or being processed
  *    - if not, create the lock file
  *  - exit the critical section
  *  - if we created a lock file, process the selected table
+ *
+ * The array is sorted with the largest tables first, so that workers always
+ * pick the largest remaining table. When a scan finds nothing left to claim
+ * while some entries are still being processed, the worker scans again rather
+ * than exiting: entries left behind by a crashed worker (stale pid in the
+ * lock file) are then stolen, and entries released by a worker that failed
+ * mid-COPY are retried, at most once per worker.
+ *
+ * An idle worker also steals pending work from the CREATE INDEX and VACUUM
+ * queues between two scans, so that worker slots freed by finished COPYs are
+ * put to use where the backlog is, instead of sitting out the end of the
+ * run.
  */
 bool
 copydb_process_table_data_worker(CopyDataSpec *specs)
@@ -376,130 +879,226 @@ copydb_process_table_data_worker(CopyDataSpec *specs)
 		return false;
 	}
 
-	for (int tableIndex = 0; tableIndex < tableSpecsArray->count; tableIndex++)
-	{
-		/* initialize our TableDataProcess entry now */
-		CopyTableDataSpec *tableSpecs = &(tableSpecsArray->array[tableIndex]);
+	/* track the entries that this worker already attempted and failed */
+	bool *failed = (bool *) calloc(tableSpecsArray->count, sizeof(bool));
 
-		if (asked_to_quit || asked_to_stop || asked_to_stop_fast)
-		{
-			int signal = get_current_signal(SIGTERM);
-			const char *signalStr = signal_to_string(signal);
+	if (failed == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
 
-			log_debug("Received signal %s, terminating", signalStr);
-			break;
-		}
+	bool done = false;
 
-		bool isDone = false;
-		bool isBeingProcessed = false;
+	while (!done)
+	{
+		int remaining = 0;
+		int claimed = 0;
 
-		if (!copydb_table_is_being_processed(specs,
-											 tableSpecs,
-											 &isDone,
-											 &isBeingProcessed))
+		for (int tableIndex = 0;
+			 tableIndex < tableSpecsArray->count;
+			 tableIndex++)
 		{
-			/* errors have already been logged */
-			return false;
-		}
+			if (asked_to_quit || asked_to_stop || asked_to_stop_fast)
+			{
+				int signal = get_current_signal(SIGTERM);
+				const char *signalStr = signal_to_string(signal);
 
-		/*
-		 * Skip tables that have been entirely done already either on a
-		 * previous run, or by a concurrent process while we were busy with our
-		 * own work.
-		 *
-		 * Also skip tables that have been claimed by another of the COPY
-		 * worker processes.
-		 */
-		if (isDone || isBeingProcessed)
-		{
-			continue;
-		}
+				log_debug("Received signal %s, terminating", signalStr);
 
-		/*
-		 * 1. Now COPY the TABLE DATA from the source to the destination.
-		 */
-		bool copySucceeded = true;
+				done = true;
+				break;
+			}
 
-		/* check for exclude-table-data filtering */
-		if (!tableSpecs->sourceTable->excludeData)
-		{
-			++copies;
+			/* skip tables that this worker already tried and failed */
+			if (failed[tableIndex])
+			{
+				continue;
+			}
 
 			/*
-			 * If we fail to copy a given table, continue looping. Otherwise
-			 * pgcopydb just continues processing all tables anyways (we wait
-			 * until all the sub-processes are finished, but we don't go and
-			 * signal them to stop immediately). We'd better continue with as
-			 * many processes as --table-jobs was given.
+			 * The tableSpecsArray only registers compact entries, build the
+			 * full table specs on-demand for the current entry.
 			 */
-			if (!copydb_copy_table(specs, tableSpecs))
+			CopyTableDataSpec tableSpecsData = { 0 };
+			CopyTableDataSpec *tableSpecs = &tableSpecsData;
+
+			if (!copydb_init_table_specs_for_item(tableSpecs, specs, tableIndex))
 			{
 				/* errors have already been logged */
-				copySucceeded = false;
-				++errors;
+				free(failed);
+				return false;
 			}
-		}
 
-		/* enter the critical section to communicate that we're done */
-		if (copySucceeded)
-		{
-			if (!copydb_mark_table_as_done(specs, tableSpecs))
+			bool isDone = false;
+			bool isBeingProcessed = false;
+
+			if (!copydb_table_is_being_processed(specs,
+												 tableSpecs,
+												 &isDone,
+												 &isBeingProcessed))
 			{
 				/* errors have already been logged */
+				free(failed);
 				return false;
 			}
-		}
 
-		/*
-		 * 2. Send the indexes and constraints attached to this table to the
-		 *    index job queue.
-		 *
-		 * 3. Send the table to the VACUUM ANALYZE job queue.
-		 *
-		 * If a partial COPY is happening, check that all the other parts are
-		 * done. This check should be done in the critical section too. Only
-		 * one process can see all parts as done already, and that's the one
-		 * finishing last.
-		 */
-		bool allPartsDone = false;
-		bool indexesAreBeingProcessed = false;
+			/*
+			 * Skip tables that have been entirely done already either on a
+			 * previous run, or by a concurrent process while we were busy with
+			 * our own work.
+			 *
+			 * Also skip tables that have been claimed by another of the COPY
+			 * worker processes, while counting them as still remaining: as
+			 * long as some of those are around, this worker keeps scanning
+			 * instead of exiting, and steals work from workers that crashed.
+			 */
+			if (isDone)
+			{
+				continue;
+			}
 
-		if (!copydb_table_parts_are_all_done(specs,
-											 tableSpecs,
-											 &allPartsDone,
-											 &indexesAreBeingProcessed))
-		{
-			/* errors have already been logged */
-			++errors;
-		}
+			if (isBeingProcessed)
+			{
+				++remaining;
+				continue;
+			}
 
-		if (specs->dirState.indexCopyIsDone &&
-			specs->section != DATA_SECTION_CONSTRAINTS)
-		{
-			log_info("Skipping indexes, already done on a previous run");
-		}
-		else if (allPartsDone && !indexesAreBeingProcessed)
-		{
-			if (!copydb_add_table_indexes(specs, tableSpecs))
+			++claimed;
+
+			/*
+			 * 1. Now COPY the TABLE DATA from the source to the destination.
+			 */
+			bool copySucceeded = true;
+
+			/* check for exclude-table-data filtering */
+			if (!tableSpecs->sourceTable->excludeData)
 			{
-				log_warn("Failed to add the indexes for %s, "
-						 "see above for details",
-						 tableSpecs->qname);
-				log_warn("Consider `pgcopydb copy indexes` to try again");
-				++errors;
+				++copies;
+
+				/*
+				 * If we fail to copy a given table, continue looping.
+				 * Otherwise pgcopydb just continues processing all tables
+				 * anyways (we wait until all the sub-processes are finished,
+				 * but we don't go and signal them to stop immediately). We'd
+				 * better continue with as many processes as --table-jobs was
+				 * given.
+				 */
+				if (!copydb_copy_table(specs, tableSpecs))
+				{
+					/* errors have already been logged */
+					copySucceeded = false;
+					++errors;
+				}
 			}
 
-			if (!vacuum_add_table(specs, tableSpecs))
+			if (!copySucceeded)
 			{
-				log_warn("Failed to queue VACUUM ANALYZE %s [%u]",
-						 tableSpecs->qname,
-						 tableSpecs->sourceTable->oid);
+				/*
+				 * Remember not to try this table again in this worker, and
+				 * release our claim on it so that another worker may retry.
+				 */
+				failed[tableIndex] = true;
+
+				(void) copydb_unclaim_table(specs, tableSpecs);
+
+				continue;
+			}
+
+			/* enter the critical section to communicate that we're done */
+			if (!copydb_mark_table_as_done(specs, tableSpecs))
+			{
+				/* errors have already been logged */
+				free(failed);
+				return false;
+			}
+
+			/*
+			 * 2. Send the indexes and constraints attached to this table to
+			 *    the index job queue.
+			 *
+			 * 3. Send the table to the VACUUM ANALYZE job queue.
+			 *
+			 * If a partial COPY is happening, check that all the other parts
+			 * are done. This check should be done in the critical section too.
+			 * Only one process can see all parts as done already, and that's
+			 * the one finishing last.
+			 */
+			bool allPartsDone = false;
+			bool indexesAreBeingProcessed = false;
+
+			if (!copydb_table_parts_are_all_done(specs,
+												 tableSpecs,
+												 &allPartsDone,
+												 &indexesAreBeingProcessed))
+			{
+				/* errors have already been logged */
 				++errors;
 			}
+
+			if (specs->dirState.indexCopyIsDone &&
+				specs->section != DATA_SECTION_CONSTRAINTS)
+			{
+				log_info("Skipping indexes, already done on a previous run");
+			}
+			else if (allPartsDone && !indexesAreBeingProcessed)
+			{
+				if (!copydb_add_table_indexes(specs, tableSpecs))
+				{
+					log_warn("Failed to add the indexes for %s, "
+							 "see above for details",
+							 tableSpecs->qname);
+					log_warn("Consider `pgcopydb copy indexes` to try again");
+					++errors;
+				}
+
+				if (!vacuum_add_table(specs, tableSpecs))
+				{
+					log_warn("Failed to queue VACUUM ANALYZE %s [%u]",
+							 tableSpecs->qname,
+							 tableSpecs->sourceTable->oid);
+					++errors;
+				}
+			}
+		}
+
+		if (!done)
+		{
+			done = remaining == 0;
+
+			if (!done && claimed == 0)
+			{
+				/*
+				 * Idle worker: the remaining tables are all claimed by
+				 * other COPY processes. Rather than just sleeping, lend a
+				 * hand to the CREATE INDEX and VACUUM queues, which are
+				 * typically backing up at this point of a run, and only
+				 * wait before scanning again when both queues are empty.
+				 */
+				bool helped = false;
+
+				if (!copydb_index_steal_work(specs, &helped))
+				{
+					++errors;
+				}
+
+				if (!helped && !vacuum_steal_work(specs, &helped))
+				{
+					++errors;
+				}
+
+				if (!helped)
+				{
+					pg_usleep(1 * 1000 * 1000); /* 1s */
+				}
+			}
 		}
 	}
 
-	/* terminate our connection to the source database now */
+	free(failed);
+
+	/* terminate our connections to the source and target databases now */
+	(void) pgsql_finish(&(specs->targetConn));
 	(void) copydb_close_snapshot(specs);
 
 	log_debug("copydb_process_table_data_worker: done %d copies, %d errors",
@@ -511,10 +1110,10 @@ copydb_process_table_data_worker(CopyDataSpec *specs)
 
 
 /*
- * copydb_table_is_being_processed checks lock and done files to see if a given
- * table is already being processed, or has already been processed entirely by
- * another process. In which case the table is to be skipped by the current
- * process.
+ * copydb_table_is_being_processed checks the shared-memory state table (or the
+ * lock and done files when running without one) to see if a given table is
+ * already being processed, or has already been processed entirely by another
+ * process. In which case the table is to be skipped by the current process.
  */
 bool
 copydb_table_is_being_processed(CopyDataSpec *specs,
@@ -536,78 +1135,178 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 	(void) semaphore_lock(&(specs->tableSemaphore));
 
 	/*
-	 * If the doneFile exists, then the table has been processed already,
-	 * skip it.
-	 *
-	 * If the lockFile exists, then the table is currently being processed
-	 * by another worker process, skip it.
+	 * When the shared-memory state table has been set-up, use it for the
+	 * in-run coordination, sparing the lock and done files metadata traffic
+	 * entirely. Otherwise fall back to checking the on-disk files.
 	 */
-	if (file_exists(tableSpecs->tablePaths.doneFile))
+	if (specs->tableState != NULL)
 	{
-		*isDone = true;
-		*isBeingProcessed = false;
-		(void) semaphore_unlock(&(specs->tableSemaphore));
+		TableStateEntry *entry = &(specs->tableState[tableSpecs->specIndex]);
+
+		if (entry->state == TABLE_COPY_STATE_DONE)
+		{
+			*isDone = true;
+			*isBeingProcessed = false;
+			(void) semaphore_unlock(&(specs->tableSemaphore));
+
+			return true;
+		}
+
+		/* okay so it's not done yet */
+		*isDone = false;
+
+		if (entry->state == TABLE_COPY_STATE_IN_PROGRESS)
+		{
+			/* if we can signal the pid, it is still running */
+			if (kill(entry->pid, 0) == 0)
+			{
+				*isBeingProcessed = true;
+				(void) semaphore_unlock(&(specs->tableSemaphore));
 
-		return true;
-	}
+				log_trace("Skipping table %s processed by concurrent worker %d",
+						  tableSpecs->qname, entry->pid);
+
+				return true;
+			}
+
+			log_warn("Found stale pid %d for table %s, "
+					 "stealing the entry and processing the table",
+					 entry->pid,
+					 tableSpecs->qname);
 
-	/* okay so it's not done yet */
-	*isDone = false;
+			/* pass through and claim the entry ourselves */
+		}
 
-	if (file_exists(tableSpecs->tablePaths.lockFile))
+		/* claim the entry for the current worker process now */
+		entry->state = TABLE_COPY_STATE_IN_PROGRESS;
+		entry->pid = getpid();
+	}
+	else
 	{
 		/*
-		 * Now it could be that the lockFile still exists and has been created
-		 * on a previous run, in which case the pid in there would be a stale
-		 * pid.
+		 * If the doneFile exists, then the table has been processed already,
+		 * skip it.
 		 *
-		 * So check for that situation before returning with the happy path.
+		 * If the lockFile exists, then the table is currently being processed
+		 * by another worker process, skip it.
 		 */
-		CopyTableSummary tableSummary = { .table = tableSpecs->sourceTable };
-
-		if (!read_table_summary(&tableSummary, tableSpecs->tablePaths.lockFile))
+		if (file_exists(tableSpecs->tablePaths.doneFile))
 		{
-			/* errors have already been logged */
+			*isDone = true;
+			*isBeingProcessed = false;
 			(void) semaphore_unlock(&(specs->tableSemaphore));
 
-			return false;
+			return true;
 		}
 
-		/* if we can signal the pid, it is still running */
-		if (kill(tableSummary.pid, 0) == 0)
-		{
-			*isBeingProcessed = true;
-			(void) semaphore_unlock(&(specs->tableSemaphore));
-
-			log_trace("Skipping table %s processed by concurrent worker %d",
-					  tableSpecs->qname, tableSummary.pid);
+		/* okay so it's not done yet */
+		*isDone = false;
 
-			return true;
-		}
-		else
+		if (file_exists(tableSpecs->tablePaths.lockFile))
 		{
-			log_warn("Found stale pid %d in file \"%s\", removing it "
-					 "and processing table %s",
-					 tableSummary.pid,
-					 tableSpecs->tablePaths.lockFile,
-					 tableSpecs->qname);
+			/*
+			 * Now it could be that the lockFile still exists and has been
+			 * created on a previous run, in which case the pid in there would
+			 * be a stale pid.
+			 *
+			 * So check for that situation before returning with the happy
+			 * path.
+			 */
+			CopyTableSummary tableSummary = { .table = tableSpecs->sourceTable };
 
-			/* stale pid, remove the old lockFile now, then process the table */
-			if (!unlink_file(tableSpecs->tablePaths.lockFile))
+			if (!read_table_summary(&tableSummary,
+									tableSpecs->tablePaths.lockFile))
 			{
-				log_error("Failed to remove the lockFile \"%s\"",
-						  tableSpecs->tablePaths.lockFile);
+				/* errors have already been logged */
 				(void) semaphore_unlock(&(specs->tableSemaphore));
+
 				return false;
 			}
 
-			/* pass through to the rest of this function */
+			/* if we can signal the pid, it is still running */
+			if (kill(tableSummary.pid, 0) == 0)
+			{
+				*isBeingProcessed = true;
+				(void) semaphore_unlock(&(specs->tableSemaphore));
+
+				log_trace("Skipping table %s processed by concurrent worker %d",
+						  tableSpecs->qname, tableSummary.pid);
+
+				return true;
+			}
+			else
+			{
+				log_warn("Found stale pid %d in file \"%s\", removing it "
+						 "and processing table %s",
+						 tableSummary.pid,
+						 tableSpecs->tablePaths.lockFile,
+						 tableSpecs->qname);
+
+				/* stale pid, remove the old lockFile, process the table */
+				if (!unlink_file(tableSpecs->tablePaths.lockFile))
+				{
+					log_error("Failed to remove the lockFile \"%s\"",
+							  tableSpecs->tablePaths.lockFile);
+					(void) semaphore_unlock(&(specs->tableSemaphore));
+					return false;
+				}
+
+				/* pass through to the rest of this function */
+			}
 		}
 	}
 
 	/*
-	 * Otherwise, the table is not being processed yet.
+	 * Otherwise, the table is not being processed yet, on this host at least.
+	 *
+	 * In --distributed mode, now that we own the local claim, also register a
+	 * claim in pgcopydb.table_claims on the target database, where another
+	 * pgcopydb host might have won the table already.
 	 */
+	if (specs->distributed)
+	{
+		bool claimed = false;
+		bool doneElsewhere = false;
+
+		if (!coordination_claim_table(specs, tableSpecs, &claimed, &doneElsewhere))
+		{
+			/* errors have already been logged */
+			(void) semaphore_unlock(&(specs->tableSemaphore));
+			return false;
+		}
+
+		if (!claimed)
+		{
+			/*
+			 * Another host owns the table: release our local claim on the
+			 * entry. When the other host is still processing the table, our
+			 * worker loop re-visits it on the next scan.
+			 */
+			if (specs->tableState != NULL)
+			{
+				TableStateEntry *entry =
+					&(specs->tableState[tableSpecs->specIndex]);
+
+				entry->state =
+					doneElsewhere
+					? TABLE_COPY_STATE_DONE
+					: TABLE_COPY_STATE_NOT_STARTED;
+
+				entry->pid = 0;
+			}
+
+			*isDone = doneElsewhere;
+			*isBeingProcessed = !doneElsewhere;
+
+			(void) semaphore_unlock(&(specs->tableSemaphore));
+
+			log_trace("Skipping table %s claimed by another pgcopydb host",
+					  tableSpecs->qname);
+
+			return true;
+		}
+	}
+
 	*isBeingProcessed = false;
 
 	/*
@@ -635,12 +1334,25 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 				tableSpecs->part.copyQuery);
 	}
 
-	if (!open_table_summary(summary, tableSpecs->tablePaths.lockFile))
+	/* in shared-memory coordination mode, refrain from writing a lockFile */
+	char *lockFile =
+		specs->tableState == NULL ? tableSpecs->tablePaths.lockFile : NULL;
+
+	if (!open_table_summary(summary, lockFile))
 	{
 		log_info("Failed to create the lock file for table %s at \"%s\"",
 				 tableSpecs->qname,
 				 tableSpecs->tablePaths.lockFile);
 
+		if (specs->tableState != NULL)
+		{
+			/* release our claim on the shared-memory entry */
+			TableStateEntry *entry = &(specs->tableState[tableSpecs->specIndex]);
+
+			entry->state = TABLE_COPY_STATE_NOT_STARTED;
+			entry->pid = 0;
+		}
+
 		/* end of the critical section */
 		(void) semaphore_unlock(&(specs->tableSemaphore));
 
@@ -669,7 +1381,14 @@ copydb_mark_table_as_done(CopyDataSpec *specs,
 	/* enter the critical section to communicate that we're done */
 	(void) semaphore_lock(&(specs->tableSemaphore));
 
-	if (!unlink_file(tableSpecs->tablePaths.lockFile))
+	if (specs->tableState != NULL)
+	{
+		TableStateEntry *entry = &(specs->tableState[tableSpecs->specIndex]);
+
+		entry->state = TABLE_COPY_STATE_DONE;
+		entry->pid = 0;
+	}
+	else if (!unlink_file(tableSpecs->tablePaths.lockFile))
 	{
 		log_error("Failed to remove the lockFile \"%s\"",
 				  tableSpecs->tablePaths.lockFile);
@@ -677,7 +1396,10 @@ copydb_mark_table_as_done(CopyDataSpec *specs,
 		return false;
 	}
 
-	/* write the doneFile with the summary and timings now */
+	/*
+	 * Write the doneFile with the summary and timings now: that's the
+	 * durability snapshot that allows resuming an interrupted run.
+	 */
 	if (!finish_table_summary(tableSpecs->summary,
 							  tableSpecs->tablePaths.doneFile))
 	{
@@ -691,9 +1413,105 @@ copydb_mark_table_as_done(CopyDataSpec *specs,
 			  tableSpecs->qname,
 			  tableSpecs->tablePaths.doneFile);
 
+	/*
+	 * Also append a fixed-size record to the binary summary log, which is
+	 * what print_summary reads back rather than re-opening every doneFile.
+	 */
+	CopyTableSummary *tableSummary = tableSpecs->summary;
+
+	SummaryRecord record = {
+		.type = SUMMARY_RECORD_TABLE,
+		.oid = tableSpecs->sourceTable->oid,
+		.partNumber = tableSpecs->part.partNumber,
+		.pid = tableSummary->pid,
+		.startTime = tableSummary->startTime,
+		.doneTime = tableSummary->doneTime,
+		.durationMs = tableSummary->durationMs
+	};
+
+	/* failure to append is not fatal, print_summary falls back to files */
+	(void) summary_append_record(specs->cfPaths.summarylog, &record);
+
+	/* and sample a metrics data point for `pgcopydb list metrics` */
+	(void) metrics_emit(specs->cfPaths.metricsfile,
+						"table-copy",
+						tableSpecs->sourceTable->oid,
+						tableSpecs->sourceTable->bytes,
+						tableSummary->durationMs);
+
+	/* end of the critical section */
+	(void) semaphore_unlock(&(specs->tableSemaphore));
+
+	/* in --distributed mode, let the other hosts know that we're done */
+	if (specs->distributed)
+	{
+		if (!coordination_mark_table_as_done(specs, tableSpecs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/*
+	 * Update the live progress counters; tables that have been split are
+	 * counted when their last part is done, see
+	 * copydb_table_parts_are_all_done.
+	 */
+	if (specs->progress != NULL && tableSpecs->part.partCount <= 1)
+	{
+		copydb_progress_add(&(specs->progress->tableDoneCount), 1);
+		copydb_progress_add(&(specs->progress->tableBytesDone),
+							tableSpecs->sourceTable->bytes);
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_unclaim_table removes the lockFile that the current worker created
+ * for the given table, allowing another COPY worker to claim the table and
+ * retry it. To remove a lockFile we must acquire the synchronisation semaphore
+ * first.
+ */
+bool
+copydb_unclaim_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
+{
+	/* enter the critical section to release our claim on the table */
+	(void) semaphore_lock(&(specs->tableSemaphore));
+
+	if (specs->tableState != NULL)
+	{
+		TableStateEntry *entry = &(specs->tableState[tableSpecs->specIndex]);
+
+		entry->state = TABLE_COPY_STATE_NOT_STARTED;
+		entry->pid = 0;
+	}
+	else if (!unlink_file(tableSpecs->tablePaths.lockFile))
+	{
+		log_error("Failed to remove the lockFile \"%s\"",
+				  tableSpecs->tablePaths.lockFile);
+		(void) semaphore_unlock(&(specs->tableSemaphore));
+		return false;
+	}
+
+	/* the summary was attached to the tableSpecs when claiming the table */
+	free(tableSpecs->summary);
+	tableSpecs->summary = NULL;
+
 	/* end of the critical section */
 	(void) semaphore_unlock(&(specs->tableSemaphore));
 
+	/* in --distributed mode, also release our claim on the target database */
+	if (specs->distributed)
+	{
+		if (!coordination_unclaim_table(specs, tableSpecs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -765,6 +1583,14 @@ copydb_table_parts_are_all_done(CopyDataSpec *specs,
 		/* end of the critical section */
 		(void) semaphore_unlock(&(specs->tableSemaphore));
 
+		/* the whole table is done now, update the live progress counters */
+		if (specs->progress != NULL)
+		{
+			copydb_progress_add(&(specs->progress->tableDoneCount), 1);
+			copydb_progress_add(&(specs->progress->tableBytesDone),
+								tableSpecs->sourceTable->bytes);
+		}
+
 		return true;
 	}
 	else
@@ -783,6 +1609,216 @@ copydb_table_parts_are_all_done(CopyDataSpec *specs,
 }
 
 
+/*
+ * copydb_copy_table_checkpoints copies a large table in several ctid ranges of
+ * about COPY_CHECKPOINT_SIZE bytes each, each range being committed separately
+ * on the target. The checkpoint file lists the ranges already copied, so that
+ * resuming after an interruption only has to COPY the missing ranges again,
+ * instead of restarting the whole table from scratch.
+ *
+ * The ctid range scan requires Postgres 14 on the source, the caller is
+ * expected to have checked the source server version already.
+ */
+static bool
+copydb_copy_table_checkpoints(CopyTableDataSpec *tableSpecs,
+							  PGSQL *src,
+							  PGSQL *dst,
+							  bool truncate,
+							  bool binary)
+{
+	SourceTable *sourceTable = tableSpecs->sourceTable;
+	char *chkptFile = tableSpecs->tablePaths.chkptFile;
+
+	/* estimate the source table page count from its size, in 8kB blocks */
+	int64_t relpages = (sourceTable->bytes + 8191) / 8192;
+
+	int64_t rangeCount =
+		(sourceTable->bytes + COPY_CHECKPOINT_SIZE - 1) / COPY_CHECKPOINT_SIZE;
+
+	int64_t pagesPerRange = (relpages + rangeCount - 1) / rangeCount;
+
+	bool *rangeIsDone = (bool *) calloc(rangeCount, sizeof(bool));
+
+	if (rangeIsDone == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	/*
+	 * Read the ranges already copied on a previous run, if any. The first line
+	 * of the checkpoint file repeats the inputs of the range boundaries
+	 * computation: when the source table size changed enough for the
+	 * boundaries to move since then, restart the COPY from scratch.
+	 */
+	bool resuming = false;
+
+	if (file_exists(chkptFile))
+	{
+		char *contents = NULL;
+		long size = 0L;
+
+		if (!read_file(chkptFile, &contents, &size))
+		{
+			/* errors have already been logged */
+			free(rangeIsDone);
+			return false;
+		}
+
+		char *lines[BUFSIZE] = { 0 };
+		int lineCount = splitLines(contents, lines, BUFSIZE);
+
+		long long fileRangeCount = 0;
+		long long filePagesPerRange = 0;
+
+		if (lineCount > 0 &&
+			sscanf(lines[0], "%lld %lld",
+				   &fileRangeCount, &filePagesPerRange) == 2 &&
+			fileRangeCount == (long long) rangeCount &&
+			filePagesPerRange == (long long) pagesPerRange)
+		{
+			resuming = true;
+
+			for (int i = 1; i < lineCount; i++)
+			{
+				long long range = 0;
+
+				if (sscanf(lines[i], "%lld", &range) == 1 &&
+					0 <= range && range < rangeCount)
+				{
+					rangeIsDone[range] = true;
+				}
+			}
+		}
+		else
+		{
+			log_warn("Checkpoint file \"%s\" does not match "
+					 "the current size of table %s, "
+					 "restarting the COPY from scratch",
+					 chkptFile,
+					 tableSpecs->qname);
+
+			if (!unlink_file(chkptFile))
+			{
+				/* errors have already been logged */
+				free(contents);
+				free(rangeIsDone);
+				return false;
+			}
+		}
+
+		free(contents);
+	}
+
+	if (!resuming)
+	{
+		char header[BUFSIZE] = { 0 };
+
+		sformat(header, sizeof(header), "%lld %lld\n",
+				(long long) rangeCount,
+				(long long) pagesPerRange);
+
+		if (!write_file(header, strlen(header), chkptFile))
+		{
+			/* errors have already been logged */
+			free(rangeIsDone);
+			return false;
+		}
+	}
+
+	/*
+	 * TRUNCATE can not be done per-range, and must be skipped entirely when
+	 * resuming, to keep the ranges already committed on the target.
+	 */
+	if (truncate && !resuming)
+	{
+		if (!pgsql_truncate(dst, tableSpecs->qname))
+		{
+			/* errors have already been logged */
+			free(rangeIsDone);
+			return false;
+		}
+	}
+
+	for (int64_t range = 0; range < rangeCount; range++)
+	{
+		if (rangeIsDone[range])
+		{
+			continue;
+		}
+
+		if (asked_to_quit || asked_to_stop || asked_to_stop_fast)
+		{
+			free(rangeIsDone);
+			return false;
+		}
+
+		char copyQuery[BUFSIZE] = { 0 };
+		int64_t startPage = range * pagesPerRange;
+
+		if (range < rangeCount - 1)
+		{
+			sformat(copyQuery, sizeof(copyQuery),
+					"(SELECT * FROM %s"
+					" WHERE ctid >= '(%lld,0)'::tid and ctid < '(%lld,0)'::tid)",
+					tableSpecs->qname,
+					(long long) startPage,
+					(long long) (startPage + pagesPerRange));
+		}
+		else
+		{
+			/* the last range is open-ended: relpages is only an estimate */
+			sformat(copyQuery, sizeof(copyQuery),
+					"(SELECT * FROM %s WHERE ctid >= '(%lld,0)'::tid)",
+					tableSpecs->qname,
+					(long long) startPage);
+		}
+
+		log_notice("%s: COPY checkpoint range %lld/%lld",
+				   tableSpecs->qname,
+				   (long long) range + 1,
+				   (long long) rangeCount);
+
+		bool truncateRange = false;
+
+		CopyTableSummary *summary = tableSpecs->summary;
+
+		uint64_t *bytes = summary == NULL ? NULL : &(summary->bytesTransmitted);
+		uint64_t *rows = summary == NULL ? NULL : &(summary->rowsTransmitted);
+
+		if (!pg_copy(src, dst, copyQuery, tableSpecs->qname,
+					 truncateRange, binary, bytes, rows))
+		{
+			/* errors have already been logged */
+			free(rangeIsDone);
+			return false;
+		}
+
+		char line[BUFSIZE] = { 0 };
+
+		sformat(line, sizeof(line), "%lld\n", (long long) range);
+
+		if (!append_to_file(line, strlen(line), chkptFile))
+		{
+			/* errors have already been logged */
+			free(rangeIsDone);
+			return false;
+		}
+	}
+
+	free(rangeIsDone);
+
+	/* all the ranges are done now, the doneFile tracks the whole table */
+	if (!unlink_file(chkptFile))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * copydb_copy_table implements the sub-process activity to pg_dump |
  * pg_restore the table's data and then create the indexes and the constraints
@@ -801,15 +1837,34 @@ copydb_copy_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 
 	/* we want to set transaction snapshot to the main one on the source */
 	PGSQL *src = &(specs->sourceSnapshot.pgsql);
-	PGSQL dst = { 0 };
+
+	/*
+	 * The target connection belongs to the worker process and is kept open
+	 * across the tables it processes, only initialize it the first time. When
+	 * a COPY fails mid-stream the connection is closed as part of the error
+	 * handling, and re-established here on the next attempt.
+	 */
+	PGSQL *dst = &(specs->targetConn);
 
 	CopyTableSummary *summary = tableSpecs->summary;
 
-	/* initialize our connection to the target database */
-	if (!pgsql_init(&dst, tableSpecs->target_pguri, PGSQL_CONN_TARGET))
+	if (dst->connection == NULL)
 	{
-		/* errors have already been logged */
-		return false;
+		if (!pgsql_init(dst, tableSpecs->target_pguri, PGSQL_CONN_TARGET))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		/* keep the same connection around for the next tables */
+		dst->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+		if (!IS_EMPTY_STRING_BUFFER(specs->targetSessionGucs) &&
+			!pgsql_set_session_gucs(dst, specs->targetSessionGucs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
 	}
 
 	/* when using `pgcopydb copy table-data`, we don't truncate */
@@ -840,7 +1895,7 @@ copydb_copy_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 		/* if the truncate done file already exists, it's been done already */
 		if (!file_exists(tableSpecs->tablePaths.truncateDoneFile))
 		{
-			if (!pgsql_truncate(&dst, tableSpecs->qname))
+			if (!pgsql_truncate(dst, tableSpecs->qname))
 			{
 				/* errors have already been logged */
 				(void) semaphore_unlock(&(specs->tableSemaphore));
@@ -873,16 +1928,54 @@ copydb_copy_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 		copySource = tableSpecs->part.copyQuery;
 	}
 
+	/*
+	 * Use the binary COPY protocol only when --copy-binary has been used, and
+	 * only for tables where all the column data types are known to be safe to
+	 * transfer that way.
+	 */
+	bool binary =
+		specs->useCopyBinary && tableSpecs->sourceTable->copyBinarySafe;
+
+	if (specs->useCopyBinary && !binary)
+	{
+		log_notice("Table %s uses column types that are not safe for "
+				   "binary COPY, using default text format instead",
+				   tableSpecs->qname);
+	}
+
+	/*
+	 * Large enough tables that are not already split in COPY partitions are
+	 * copied in several separately-committed ctid ranges, tracked in a
+	 * checkpoint file, so that resuming an interrupted clone does not restart
+	 * those tables from scratch. The ctid range scan needs Postgres 14 on the
+	 * source.
+	 */
+	bool useCheckpoints =
+		tableSpecs->part.partCount <= 1 &&
+		tableSpecs->sourceTable->bytes >= 2 * COPY_CHECKPOINT_SIZE &&
+		pgsql_server_version(src) &&
+		src->pgversion_num >= 140000;
+
 	int attempts = 0;
 	int maxAttempts = 5;        /* allow 5 attempts total, 4 retries */
 
 	bool retry = true;
 
+	uint64_t *bytes = summary == NULL ? NULL : &(summary->bytesTransmitted);
+	uint64_t *rows = summary == NULL ? NULL : &(summary->rowsTransmitted);
+
 	while (retry)
 	{
 		++attempts;
 
-		if (pg_copy(src, &dst, copySource, tableSpecs->qname, truncate))
+		bool success =
+			useCheckpoints
+			? copydb_copy_table_checkpoints(tableSpecs, src, dst,
+											truncate, binary)
+			: pg_copy(src, dst, copySource, tableSpecs->qname,
+					  truncate, binary, bytes, rows);
+
+		if (success)
 		{
 			/* success, get out of the retry loop */
 			if (attempts > 1)
@@ -900,7 +1993,7 @@ copydb_copy_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 
 			/* retry only on Connection Exception errors */
 			(pgsql_state_is_connection_error(src) ||
-			 pgsql_state_is_connection_error(&dst));
+			 pgsql_state_is_connection_error(dst));
 
 		if (maxAttempts <= attempts)
 		{
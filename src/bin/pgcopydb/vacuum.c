@@ -12,13 +12,13 @@
 #include "env_utils.h"
 #include "lock_utils.h"
 #include "log.h"
+#include "metrics.h"
 #include "signals.h"
 #include "summary.h"
 
 /*
- * vacuum_start_workers create as many sub-process as needed, per --table-jobs.
- * Could be exposed separately as --vacuumJobs too, but that's not been done at
- * this time.
+ * vacuum_start_workers create as many sub-process as needed, per
+ * --vacuum-jobs, which defaults to the --table-jobs setting.
  */
 bool
 vacuum_start_workers(CopyDataSpec *specs)
@@ -69,6 +69,28 @@ vacuum_start_workers(CopyDataSpec *specs)
 }
 
 
+/*
+ * vacuum_defer_table returns true when vacuuming of the given table should
+ * be deferred for now: large tables are not vacuumed while the COPY phase is
+ * still running, so that VACUUM does not steal I/O bandwidth from the COPY
+ * processes. Once the COPY phase is done, nothing is deferred anymore.
+ */
+static bool
+vacuum_defer_table(CopyDataSpec *specs, uint32_t oid)
+{
+	if (file_exists(specs->cfPaths.done.tables))
+	{
+		return false;
+	}
+
+	SourceTable *table = NULL;
+
+	HASH_FIND(hh, specs->sourceTableHashByOid, &oid, sizeof(oid), table);
+
+	return table != NULL && table->bytes >= VACUUM_DEFER_LARGER_THAN;
+}
+
+
 /*
  * vacuum_worker is a worker process that loops over messages received from a
  * queue, each message being the Oid of a table to vacuum on the target
@@ -85,52 +107,184 @@ vacuum_worker(CopyDataSpec *specs)
 
 	while (!stop)
 	{
-		QMessage mesg = { 0 };
+		QMessage mesgs[QUEUE_RECEIVE_BATCH_SIZE] = { 0 };
+		int count = QUEUE_RECEIVE_BATCH_SIZE;
+
+		bool deferred = false;
 
 		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
 		{
 			return false;
 		}
 
-		if (!queue_receive(&(specs->vacuumQueue), &mesg))
+		/* drain a batch of messages, amortizing the queue round trips */
+		if (!queue_receive_batch(&(specs->vacuumQueue), mesgs, &count))
 		{
 			/* errors have already been logged */
 			break;
 		}
 
-		switch (mesg.type)
+		/* sample the queue depth, helps spotting vacuum backlog build-up */
+		int depth = 0;
+
+		if (queue_depth(&(specs->vacuumQueue), &depth))
 		{
-			case QMSG_TYPE_STOP:
-			{
-				stop = true;
-				log_debug("Stop message received by vacuum worker");
-				break;
-			}
+			(void) metrics_emit(specs->cfPaths.metricsfile,
+								"vacuum-queue-depth", 0, depth, 0);
+		}
 
-			case QMSG_TYPE_TABLEOID:
+		for (int i = 0; i < count; i++)
+		{
+			QMessage *mesg = &(mesgs[i]);
+
+			switch (mesg->type)
 			{
-				/* ignore errors */
-				if (!vacuum_analyze_table_by_oid(specs, mesg.data.oid))
+				case QMSG_TYPE_STOP:
 				{
-					++errors;
+					if (stop)
+					{
+						/* this STOP message belongs to a sibling worker */
+						(void) queue_send(&(specs->vacuumQueue), mesg);
+					}
+					else
+					{
+						stop = true;
+						log_debug("Stop message received by vacuum worker");
+					}
+					break;
 				}
-				break;
-			}
 
-			default:
-			{
-				log_error("Received unknown message type %ld on vacuum queue %d",
-						  mesg.type,
-						  specs->vacuumQueue.qId);
-				break;
+				case QMSG_TYPE_TABLEOID:
+				{
+					if (vacuum_defer_table(specs, mesg->data.oid))
+					{
+						/* put the table back at the end of the queue */
+						deferred = true;
+
+						if (!queue_send(&(specs->vacuumQueue), mesg))
+						{
+							++errors;
+						}
+						break;
+					}
+
+					/* ignore errors */
+					if (!vacuum_analyze_table_by_oid(specs, mesg->data.oid))
+					{
+						++errors;
+					}
+					break;
+				}
+
+				default:
+				{
+					log_error("Received unknown message type %ld "
+							  "on vacuum queue %d",
+							  mesg->type,
+							  specs->vacuumQueue.qId);
+					break;
+				}
 			}
 		}
+
+		if (deferred)
+		{
+			/* only deferred large tables are left, don't spin on them */
+			pg_usleep(500 * 1000); /* 500 ms */
+		}
 	}
 
 	return stop == true && errors == 0;
 }
 
 
+/*
+ * vacuum_steal_work lets an idle COPY worker process lend a hand to the
+ * VACUUM workers: receive one message from the vacuum queue when one is
+ * immediately available, and process that table. Large tables are deferred
+ * during the COPY phase as usual, see vacuum_defer_table.
+ */
+bool
+vacuum_steal_work(CopyDataSpec *specs, bool *helped)
+{
+	QMessage mesg = { 0 };
+	bool received = false;
+
+	*helped = false;
+
+	if (!queue_receive_nowait(&(specs->vacuumQueue), &mesg, &received))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!received)
+	{
+		return true;
+	}
+
+	if (mesg.type == QMSG_TYPE_TABLEOID)
+	{
+		if (vacuum_defer_table(specs, mesg.data.oid))
+		{
+			/* put the table back at the end of the queue */
+			return queue_send(&(specs->vacuumQueue), &mesg);
+		}
+
+		*helped = true;
+
+		return vacuum_analyze_table_by_oid(specs, mesg.data.oid);
+	}
+
+	/* STOP (and unknown) messages belong to the dedicated vacuum workers */
+	(void) queue_send(&(specs->vacuumQueue), &mesg);
+
+	return true;
+}
+
+
+/*
+ * vacuum_set_session_gucs applies the --vacuum-io-budget cost-based
+ * throttling to a VACUUM session. The budget is a total vacuum_cost_limit
+ * that is divided evenly across the --vacuum-jobs sessions, so that the
+ * vacuum fleet as a whole does not exceed it while index builds are still
+ * competing for the same I/O bandwidth.
+ */
+static bool
+vacuum_set_session_gucs(CopyDataSpec *specs, PGSQL *dst)
+{
+	GUC settings[3] = { 0 };
+	int count = 0;
+
+	char costLimit[NAMEDATALEN] = { 0 };
+
+	int limit = specs->vacuumIOBudget / specs->vacuumJobs;
+
+	/* Postgres accepts vacuum_cost_limit values from 1 to 10000 */
+	if (limit < 1)
+	{
+		limit = 1;
+	}
+	else if (limit > 10000)
+	{
+		limit = 10000;
+	}
+
+	sformat(costLimit, sizeof(costLimit), "%d", limit);
+
+	settings[count].name = "vacuum_cost_limit";
+	settings[count].value = costLimit;
+	++count;
+
+	/* cost-based throttling is off unless vacuum_cost_delay is positive */
+	settings[count].name = "vacuum_cost_delay";
+	settings[count].value = "'2ms'";
+	++count;
+
+	return pgsql_set_gucs(dst, settings);
+}
+
+
 /*
  * vacuum_analyze_table_by_oid reads the done file for the given table OID,
  * fetches the schemaname and relname from there, and then connects to the
@@ -182,13 +336,59 @@ vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid)
 		return false;
 	}
 
+	/* we might send SET commands before the VACUUM itself */
+	dst.connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	if (specs->vacuumIOBudget > 0 &&
+		!vacuum_set_session_gucs(specs, &dst))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/*
+	 * On Postgres 13 and later VACUUM accepts a PARALLEL option that sizes
+	 * the number of index-parallel vacuum workers. Apply the same backend
+	 * budget as the CREATE INDEX sessions: 8 backends shared across the
+	 * --vacuum-jobs sessions, each running one leader and its workers.
+	 */
+	int parallel = 8 / specs->vacuumJobs - 1;
+
+	if (parallel < 0)
+	{
+		parallel = 0;
+	}
+
+	bool useParallel =
+		!specs->analyzeOnly &&
+		parallel > 0 &&
+		pgsql_server_version(&dst) &&
+		dst.pgversion_num >= 130000;
+
 	/* finally, vacuum analyze the table and its indexes */
 	char vacuum[BUFSIZE] = { 0 };
 
-	sformat(vacuum, sizeof(vacuum),
-			"VACUUM ANALYZE \"%s\".\"%s\"",
-			table.nspname,
-			table.relname);
+	/*
+	 * The --analyze-only option skips the vacuum part: refreshing the
+	 * statistics is what unlocks sane query plans at cutover time, and
+	 * ANALYZE alone is much cheaper than VACUUM ANALYZE.
+	 */
+	if (useParallel)
+	{
+		sformat(vacuum, sizeof(vacuum),
+				"VACUUM (ANALYZE, PARALLEL %d) \"%s\".\"%s\"",
+				parallel,
+				table.nspname,
+				table.relname);
+	}
+	else
+	{
+		sformat(vacuum, sizeof(vacuum),
+				"%s \"%s\".\"%s\"",
+				specs->analyzeOnly ? "ANALYZE" : "VACUUM ANALYZE",
+				table.nspname,
+				table.relname);
+	}
 
 	log_info("%s;", vacuum);
 
@@ -200,6 +400,15 @@ vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid)
 
 	(void) pgsql_finish(&dst);
 
+	/* update the live progress counters */
+	if (specs->progress != NULL)
+	{
+		copydb_progress_add(&(specs->progress->vacuumDoneCount), 1);
+	}
+
+	/* and sample a metrics data point for `pgcopydb list metrics` */
+	(void) metrics_emit(specs->cfPaths.metricsfile, "vacuum", oid, 0, 0);
+
 	return true;
 }
 
@@ -235,19 +444,32 @@ vacuum_add_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 bool
 vacuum_send_stop(CopyDataSpec *specs)
 {
+	QMessage *stops =
+		(QMessage *) calloc(specs->vacuumJobs, sizeof(QMessage));
+
+	if (stops == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
 	for (int i = 0; i < specs->vacuumJobs; i++)
 	{
-		QMessage stop = { .type = QMSG_TYPE_STOP, .data.oid = 0 };
+		stops[i].type = QMSG_TYPE_STOP;
+	}
 
-		log_debug("Send STOP message to VACUUM queue %d",
-				  specs->vacuumQueue.qId);
+	log_debug("Send %d STOP messages to VACUUM queue %d",
+			  specs->vacuumJobs,
+			  specs->vacuumQueue.qId);
 
-		if (!queue_send(&(specs->vacuumQueue), &stop))
-		{
-			/* errors have already been logged */
-			continue;
-		}
+	if (!queue_send_batch(&(specs->vacuumQueue), stops, specs->vacuumJobs))
+	{
+		/* errors have already been logged */
+		free(stops);
+		return false;
 	}
 
+	free(stops);
+
 	return true;
 }
@@ -1,33 +1,33 @@
 BEGIN; -- {"xid":491,"lsn":"0/22E7B10","timestamp":"2022-11-24 17:42:06.383551+0000"}
-INSERT INTO "public"."rental" ("rental_id", "rental_date", "inventory_id", "customer_id", "return_date", "staff_id", "last_update") VALUES (16050 , '2022-06-01 00:00:00+00' , 371 , 291 , NULL, 1 , '2022-06-01 00:00:00+00');
-INSERT INTO "public"."payment_p2022_06" ("payment_id", "customer_id", "staff_id", "rental_id", "amount", "payment_date") VALUES (32099 , 291 , 1 , 16050 , 5.99 , '2022-06-01 00:00:00+00');
+INSERT INTO "public"."rental" ("rental_id", "rental_date", "inventory_id", "customer_id", "return_date", "staff_id", "last_update") VALUES (16050, '2022-06-01 00:00:00+00', 371, 291, NULL, 1, '2022-06-01 00:00:00+00');
+INSERT INTO "public"."payment_p2022_06" ("payment_id", "customer_id", "staff_id", "rental_id", "amount", "payment_date") VALUES (32099, 291, 1, 16050, 5.99, '2022-06-01 00:00:00+00');
 COMMIT; -- {"xid":491,"lsn":"0/22E7F30","timestamp":"2022-11-24 17:42:06.383551+0000"}
 BEGIN; -- {"xid":492,"lsn":"0/22E7F30","timestamp":"2022-11-24 17:42:06.383880+0000"}
-UPDATE "public"."payment_p2022_02" SET "payment_id" = 23757 , "customer_id" = 116 , "staff_id" = 2 , "rental_id" = 14763 , "amount" = 11.95 , "payment_date" = '2022-02-11 03:52:25.634006+00' WHERE "payment_id" = 23757  and "customer_id" = 116  and "staff_id" = 2  and "rental_id" = 14763  and "amount" = 11.99  and "payment_date" = '2022-02-11 03:52:25.634006+00' ;
-UPDATE "public"."payment_p2022_02" SET "payment_id" = 24866 , "customer_id" = 237 , "staff_id" = 2 , "rental_id" = 11479 , "amount" = 11.95 , "payment_date" = '2022-02-07 18:37:34.579143+00' WHERE "payment_id" = 24866  and "customer_id" = 237  and "staff_id" = 2  and "rental_id" = 11479  and "amount" = 11.99  and "payment_date" = '2022-02-07 18:37:34.579143+00' ;
-UPDATE "public"."payment_p2022_03" SET "payment_id" = 17055 , "customer_id" = 196 , "staff_id" = 2 , "rental_id" = 106 , "amount" = 11.95 , "payment_date" = '2022-03-18 18:50:39.243747+00' WHERE "payment_id" = 17055  and "customer_id" = 196  and "staff_id" = 2  and "rental_id" = 106  and "amount" = 11.99  and "payment_date" = '2022-03-18 18:50:39.243747+00' ;
-UPDATE "public"."payment_p2022_03" SET "payment_id" = 28799 , "customer_id" = 591 , "staff_id" = 2 , "rental_id" = 4383 , "amount" = 11.95 , "payment_date" = '2022-03-08 16:41:23.911522+00' WHERE "payment_id" = 28799  and "customer_id" = 591  and "staff_id" = 2  and "rental_id" = 4383  and "amount" = 11.99  and "payment_date" = '2022-03-08 16:41:23.911522+00' ;
-UPDATE "public"."payment_p2022_04" SET "payment_id" = 20403 , "customer_id" = 362 , "staff_id" = 1 , "rental_id" = 14759 , "amount" = 11.95 , "payment_date" = '2022-04-16 04:35:36.904758+00' WHERE "payment_id" = 20403  and "customer_id" = 362  and "staff_id" = 1  and "rental_id" = 14759  and "amount" = 11.99  and "payment_date" = '2022-04-16 04:35:36.904758+00' ;
-UPDATE "public"."payment_p2022_05" SET "payment_id" = 17354 , "customer_id" = 305 , "staff_id" = 1 , "rental_id" = 2166 , "amount" = 11.95 , "payment_date" = '2022-05-12 11:28:17.949049+00' WHERE "payment_id" = 17354  and "customer_id" = 305  and "staff_id" = 1  and "rental_id" = 2166  and "amount" = 11.99  and "payment_date" = '2022-05-12 11:28:17.949049+00' ;
-UPDATE "public"."payment_p2022_06" SET "payment_id" = 22650 , "customer_id" = 204 , "staff_id" = 2 , "rental_id" = 15415 , "amount" = 11.95 , "payment_date" = '2022-06-11 11:17:22.428079+00' WHERE "payment_id" = 22650  and "customer_id" = 204  and "staff_id" = 2  and "rental_id" = 15415  and "amount" = 11.99  and "payment_date" = '2022-06-11 11:17:22.428079+00' ;
-UPDATE "public"."payment_p2022_06" SET "payment_id" = 24553 , "customer_id" = 195 , "staff_id" = 2 , "rental_id" = 16040 , "amount" = 11.95 , "payment_date" = '2022-06-15 02:21:00.279776+00' WHERE "payment_id" = 24553  and "customer_id" = 195  and "staff_id" = 2  and "rental_id" = 16040  and "amount" = 11.99  and "payment_date" = '2022-06-15 02:21:00.279776+00' ;
-UPDATE "public"."payment_p2022_07" SET "payment_id" = 28814 , "customer_id" = 592 , "staff_id" = 1 , "rental_id" = 3973 , "amount" = 11.95 , "payment_date" = '2022-07-06 12:15:38.928947+00' WHERE "payment_id" = 28814  and "customer_id" = 592  and "staff_id" = 1  and "rental_id" = 3973  and "amount" = 11.99  and "payment_date" = '2022-07-06 12:15:38.928947+00' ;
-UPDATE "public"."payment_p2022_07" SET "payment_id" = 29136 , "customer_id" = 13 , "staff_id" = 2 , "rental_id" = 8831 , "amount" = 11.95 , "payment_date" = '2022-07-22 16:15:40.797771+00' WHERE "payment_id" = 29136  and "customer_id" = 13  and "staff_id" = 2  and "rental_id" = 8831  and "amount" = 11.99  and "payment_date" = '2022-07-22 16:15:40.797771+00' ;
+PREPARE p_24a68840ed576022 AS UPDATE "public"."payment_p2022_02" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_24a68840ed576022(23757, 116, 2, 14763, 11.95, '2022-02-11 03:52:25.634006+00', 23757, 116, 2, 14763, 11.99, '2022-02-11 03:52:25.634006+00');
+PREPARE p_24a68840ed576022 AS UPDATE "public"."payment_p2022_02" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_24a68840ed576022(24866, 237, 2, 11479, 11.95, '2022-02-07 18:37:34.579143+00', 24866, 237, 2, 11479, 11.99, '2022-02-07 18:37:34.579143+00');
+PREPARE p_5af57e7b3d39cf0f AS UPDATE "public"."payment_p2022_03" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_5af57e7b3d39cf0f(17055, 196, 2, 106, 11.95, '2022-03-18 18:50:39.243747+00', 17055, 196, 2, 106, 11.99, '2022-03-18 18:50:39.243747+00');
+PREPARE p_5af57e7b3d39cf0f AS UPDATE "public"."payment_p2022_03" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_5af57e7b3d39cf0f(28799, 591, 2, 4383, 11.95, '2022-03-08 16:41:23.911522+00', 28799, 591, 2, 4383, 11.99, '2022-03-08 16:41:23.911522+00');
+PREPARE p_1f9b65d814c687ac AS UPDATE "public"."payment_p2022_04" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_1f9b65d814c687ac(20403, 362, 1, 14759, 11.95, '2022-04-16 04:35:36.904758+00', 20403, 362, 1, 14759, 11.99, '2022-04-16 04:35:36.904758+00');
+PREPARE p_74df6a80915150a1 AS UPDATE "public"."payment_p2022_05" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_74df6a80915150a1(17354, 305, 1, 2166, 11.95, '2022-05-12 11:28:17.949049+00', 17354, 305, 1, 2166, 11.99, '2022-05-12 11:28:17.949049+00');
+PREPARE p_4c536b15c54549ae AS UPDATE "public"."payment_p2022_06" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_4c536b15c54549ae(22650, 204, 2, 15415, 11.95, '2022-06-11 11:17:22.428079+00', 22650, 204, 2, 15415, 11.99, '2022-06-11 11:17:22.428079+00');
+PREPARE p_4c536b15c54549ae AS UPDATE "public"."payment_p2022_06" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_4c536b15c54549ae(24553, 195, 2, 16040, 11.95, '2022-06-15 02:21:00.279776+00', 24553, 195, 2, 16040, 11.99, '2022-06-15 02:21:00.279776+00');
+PREPARE p_a283c08296b33f6b AS UPDATE "public"."payment_p2022_07" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_a283c08296b33f6b(28814, 592, 1, 3973, 11.95, '2022-07-06 12:15:38.928947+00', 28814, 592, 1, 3973, 11.99, '2022-07-06 12:15:38.928947+00');
+PREPARE p_a283c08296b33f6b AS UPDATE "public"."payment_p2022_07" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_a283c08296b33f6b(29136, 13, 2, 8831, 11.95, '2022-07-22 16:15:40.797771+00', 29136, 13, 2, 8831, 11.99, '2022-07-22 16:15:40.797771+00');
 COMMIT; -- {"xid":492,"lsn":"0/22E8D48","timestamp":"2022-11-24 17:42:06.383880+0000"}
 BEGIN; -- {"xid":493,"lsn":"0/22E8F08","timestamp":"2022-11-24 17:42:06.384205+0000"}
-DELETE FROM "public"."payment_p2022_06" WHERE "payment_id" = 32099  and "customer_id" = 291  and "staff_id" = 1  and "rental_id" = 16050  and "amount" = 5.99  and "payment_date" = '2022-06-01 00:00:00+00';
-DELETE FROM "public"."rental" WHERE "rental_id" = 16050;
+PREPARE p_eea0eeacf182f8ef AS DELETE FROM "public"."payment_p2022_06" WHERE "payment_id" = $1 and "customer_id" = $2 and "staff_id" = $3 and "rental_id" = $4 and "amount" = $5 and "payment_date" = $6;EXECUTE p_eea0eeacf182f8ef(32099, 291, 1, 16050, 5.99, '2022-06-01 00:00:00+00');
+PREPARE p_41835c54d9c2ec48 AS DELETE FROM "public"."rental" WHERE "rental_id" = $1;EXECUTE p_41835c54d9c2ec48(16050);
 COMMIT; -- {"xid":493,"lsn":"0/22E9018","timestamp":"2022-11-24 17:42:06.384205+0000"}
 BEGIN; -- {"xid":494,"lsn":"0/22E9018","timestamp":"2022-11-24 17:42:06.384242+0000"}
-UPDATE "public"."payment_p2022_02" SET "payment_id" = 23757 , "customer_id" = 116 , "staff_id" = 2 , "rental_id" = 14763 , "amount" = 11.99 , "payment_date" = '2022-02-11 03:52:25.634006+00' WHERE "payment_id" = 23757  and "customer_id" = 116  and "staff_id" = 2  and "rental_id" = 14763  and "amount" = 11.95  and "payment_date" = '2022-02-11 03:52:25.634006+00' ;
-UPDATE "public"."payment_p2022_02" SET "payment_id" = 24866 , "customer_id" = 237 , "staff_id" = 2 , "rental_id" = 11479 , "amount" = 11.99 , "payment_date" = '2022-02-07 18:37:34.579143+00' WHERE "payment_id" = 24866  and "customer_id" = 237  and "staff_id" = 2  and "rental_id" = 11479  and "amount" = 11.95  and "payment_date" = '2022-02-07 18:37:34.579143+00' ;
-UPDATE "public"."payment_p2022_03" SET "payment_id" = 17055 , "customer_id" = 196 , "staff_id" = 2 , "rental_id" = 106 , "amount" = 11.99 , "payment_date" = '2022-03-18 18:50:39.243747+00' WHERE "payment_id" = 17055  and "customer_id" = 196  and "staff_id" = 2  and "rental_id" = 106  and "amount" = 11.95  and "payment_date" = '2022-03-18 18:50:39.243747+00' ;
-UPDATE "public"."payment_p2022_03" SET "payment_id" = 28799 , "customer_id" = 591 , "staff_id" = 2 , "rental_id" = 4383 , "amount" = 11.99 , "payment_date" = '2022-03-08 16:41:23.911522+00' WHERE "payment_id" = 28799  and "customer_id" = 591  and "staff_id" = 2  and "rental_id" = 4383  and "amount" = 11.95  and "payment_date" = '2022-03-08 16:41:23.911522+00' ;
-UPDATE "public"."payment_p2022_04" SET "payment_id" = 20403 , "customer_id" = 362 , "staff_id" = 1 , "rental_id" = 14759 , "amount" = 11.99 , "payment_date" = '2022-04-16 04:35:36.904758+00' WHERE "payment_id" = 20403  and "customer_id" = 362  and "staff_id" = 1  and "rental_id" = 14759  and "amount" = 11.95  and "payment_date" = '2022-04-16 04:35:36.904758+00' ;
-UPDATE "public"."payment_p2022_05" SET "payment_id" = 17354 , "customer_id" = 305 , "staff_id" = 1 , "rental_id" = 2166 , "amount" = 11.99 , "payment_date" = '2022-05-12 11:28:17.949049+00' WHERE "payment_id" = 17354  and "customer_id" = 305  and "staff_id" = 1  and "rental_id" = 2166  and "amount" = 11.95  and "payment_date" = '2022-05-12 11:28:17.949049+00' ;
-UPDATE "public"."payment_p2022_06" SET "payment_id" = 22650 , "customer_id" = 204 , "staff_id" = 2 , "rental_id" = 15415 , "amount" = 11.99 , "payment_date" = '2022-06-11 11:17:22.428079+00' WHERE "payment_id" = 22650  and "customer_id" = 204  and "staff_id" = 2  and "rental_id" = 15415  and "amount" = 11.95  and "payment_date" = '2022-06-11 11:17:22.428079+00' ;
-UPDATE "public"."payment_p2022_06" SET "payment_id" = 24553 , "customer_id" = 195 , "staff_id" = 2 , "rental_id" = 16040 , "amount" = 11.99 , "payment_date" = '2022-06-15 02:21:00.279776+00' WHERE "payment_id" = 24553  and "customer_id" = 195  and "staff_id" = 2  and "rental_id" = 16040  and "amount" = 11.95  and "payment_date" = '2022-06-15 02:21:00.279776+00' ;
-UPDATE "public"."payment_p2022_07" SET "payment_id" = 28814 , "customer_id" = 592 , "staff_id" = 1 , "rental_id" = 3973 , "amount" = 11.99 , "payment_date" = '2022-07-06 12:15:38.928947+00' WHERE "payment_id" = 28814  and "customer_id" = 592  and "staff_id" = 1  and "rental_id" = 3973  and "amount" = 11.95  and "payment_date" = '2022-07-06 12:15:38.928947+00' ;
-UPDATE "public"."payment_p2022_07" SET "payment_id" = 29136 , "customer_id" = 13 , "staff_id" = 2 , "rental_id" = 8831 , "amount" = 11.99 , "payment_date" = '2022-07-22 16:15:40.797771+00' WHERE "payment_id" = 29136  and "customer_id" = 13  and "staff_id" = 2  and "rental_id" = 8831  and "amount" = 11.95  and "payment_date" = '2022-07-22 16:15:40.797771+00' ;
+PREPARE p_24a68840ed576022 AS UPDATE "public"."payment_p2022_02" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_24a68840ed576022(23757, 116, 2, 14763, 11.99, '2022-02-11 03:52:25.634006+00', 23757, 116, 2, 14763, 11.95, '2022-02-11 03:52:25.634006+00');
+PREPARE p_24a68840ed576022 AS UPDATE "public"."payment_p2022_02" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_24a68840ed576022(24866, 237, 2, 11479, 11.99, '2022-02-07 18:37:34.579143+00', 24866, 237, 2, 11479, 11.95, '2022-02-07 18:37:34.579143+00');
+PREPARE p_5af57e7b3d39cf0f AS UPDATE "public"."payment_p2022_03" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_5af57e7b3d39cf0f(17055, 196, 2, 106, 11.99, '2022-03-18 18:50:39.243747+00', 17055, 196, 2, 106, 11.95, '2022-03-18 18:50:39.243747+00');
+PREPARE p_5af57e7b3d39cf0f AS UPDATE "public"."payment_p2022_03" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_5af57e7b3d39cf0f(28799, 591, 2, 4383, 11.99, '2022-03-08 16:41:23.911522+00', 28799, 591, 2, 4383, 11.95, '2022-03-08 16:41:23.911522+00');
+PREPARE p_1f9b65d814c687ac AS UPDATE "public"."payment_p2022_04" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_1f9b65d814c687ac(20403, 362, 1, 14759, 11.99, '2022-04-16 04:35:36.904758+00', 20403, 362, 1, 14759, 11.95, '2022-04-16 04:35:36.904758+00');
+PREPARE p_74df6a80915150a1 AS UPDATE "public"."payment_p2022_05" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_74df6a80915150a1(17354, 305, 1, 2166, 11.99, '2022-05-12 11:28:17.949049+00', 17354, 305, 1, 2166, 11.95, '2022-05-12 11:28:17.949049+00');
+PREPARE p_4c536b15c54549ae AS UPDATE "public"."payment_p2022_06" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_4c536b15c54549ae(22650, 204, 2, 15415, 11.99, '2022-06-11 11:17:22.428079+00', 22650, 204, 2, 15415, 11.95, '2022-06-11 11:17:22.428079+00');
+PREPARE p_4c536b15c54549ae AS UPDATE "public"."payment_p2022_06" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_4c536b15c54549ae(24553, 195, 2, 16040, 11.99, '2022-06-15 02:21:00.279776+00', 24553, 195, 2, 16040, 11.95, '2022-06-15 02:21:00.279776+00');
+PREPARE p_a283c08296b33f6b AS UPDATE "public"."payment_p2022_07" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_a283c08296b33f6b(28814, 592, 1, 3973, 11.99, '2022-07-06 12:15:38.928947+00', 28814, 592, 1, 3973, 11.95, '2022-07-06 12:15:38.928947+00');
+PREPARE p_a283c08296b33f6b AS UPDATE "public"."payment_p2022_07" SET "payment_id" = $1, "customer_id" = $2, "staff_id" = $3, "rental_id" = $4, "amount" = $5, "payment_date" = $6 WHERE "payment_id" = $7 and "customer_id" = $8 and "staff_id" = $9 and "rental_id" = $10 and "amount" = $11 and "payment_date" = $12;EXECUTE p_a283c08296b33f6b(29136, 13, 2, 8831, 11.99, '2022-07-22 16:15:40.797771+00', 29136, 13, 2, 8831, 11.95, '2022-07-22 16:15:40.797771+00');
 COMMIT; -- {"xid":494,"lsn":"0/22E9598","timestamp":"2022-11-24 17:42:06.384242+0000"}
 -- KEEPALIVE {"lsn":"0/22E9598","timestamp":"2022-11-24 17:42:06.384521+0000"}